@@ -89,6 +89,14 @@ public:
      */
     uint32_t clients{0};
 
+    /**
+     * The number of ItemSendBuffers holding an item of this bucket (waiting
+     * for libevent to send it). The bucket may not be destroyed until they
+     * have all been released. Atomic (rather than protected by mutex) as it
+     * is updated for every value sent by reference.
+     */
+    std::atomic<uint32_t> sendBuffers{0};
+
     /**
      * The current state of the bucket. Atomic as we permit it to be
      * read without acquiring the mutex, for example in
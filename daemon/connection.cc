@@ -51,6 +51,7 @@
 #include <utilities/logtags.h>
 #include <gsl/gsl>
 
+#include <algorithm>
 #include <exception>
 #ifndef WIN32
 #include <netinet/tcp.h> // For TCP_NODELAY etc
@@ -197,6 +198,8 @@ nlohmann::json Connection::toJSON() const {
     ret["dcp_no_value"] = isDcpNoValue();
     ret["max_reqs_per_event"] = max_reqs_per_event;
     ret["nevents"] = numEvents;
+    ret["request_cost"] = std::to_string(requestCost.count());
+    ret["reqs_per_slice"] = getRequestsPerSlice();
 
     switch (state) {
     case State::running:
@@ -212,6 +215,13 @@ nlohmann::json Connection::toJSON() const {
     ret["ssl"] = ssl;
     ret["total_recv"] = totalRecv;
     ret["total_send"] = totalSend;
+    ret["total_recv_syscalls"] = recvSyscalls;
+    ret["total_send_syscalls"] = sendSyscalls;
+    ret["total_ops"] = totalOps;
+    if (totalOps > 0) {
+        ret["syscalls_per_op"] =
+                double(recvSyscalls + sendSyscalls) / double(totalOps);
+    }
 
     ret["datatype"] = mcbp::datatype::to_string(datatypeFilter.getRaw());
 
@@ -417,7 +427,34 @@ void Connection::setBucketIndex(int bucketIndex) {
 void Connection::addCpuTime(std::chrono::nanoseconds ns) {
     total_cpu_time += ns;
     min_sched_time = std::min(min_sched_time, ns);
-    max_sched_time = std::max(min_sched_time, ns);
+    max_sched_time = std::max(max_sched_time, ns);
+
+    // Requests executed in the slice (DCP messages and server events
+    // aren't counted, but their time is spread over the requests)
+    const auto executed = sliceEvents - numEvents;
+    if (executed > 0) {
+        const auto cost = ns / executed;
+        if (requestCost.count() == 0) {
+            requestCost = cost;
+        } else {
+            requestCost = (requestCost * 7 + cost) / 8;
+        }
+    }
+    sliceEvents = numEvents;
+}
+
+int Connection::getRequestsPerSlice() const {
+    using namespace std::chrono;
+    const auto budget =
+            microseconds(Settings::instance().getSchedTimeBudget());
+    if (budget.count() == 0 || requestCost.count() == 0) {
+        return max_reqs_per_event;
+    }
+
+    const auto requests = nanoseconds(budget) / requestCost;
+    return int(std::clamp(requests,
+                          nanoseconds::rep(1),
+                          nanoseconds::rep(MaxRequestsPerSlice)));
 }
 
 void Connection::enqueueServerEvent(std::unique_ptr<ServerEvent> event) {
@@ -521,7 +558,7 @@ bool Connection::processAllReadyCookies() {
 }
 
 void Connection::executeCommandPipeline() {
-    numEvents = max_reqs_per_event;
+    numEvents = sliceEvents = getRequestsPerSlice();
     const auto maxActiveCommands =
             Settings::instance().getMaxConcurrentCommandsPerConnection();
 
@@ -552,6 +589,7 @@ void Connection::executeCommandPipeline() {
 
             cookie->initialize(getPacket(), isTracingEnabled());
             auto drainSize = cookie->getPacket().size();
+            ++totalOps;
 
             const auto status = cookie->validate();
             if (status != cb::mcbp::Status::Success) {
@@ -631,6 +669,12 @@ bool Connection::executeCommandsCallback() {
 
     const auto start = std::chrono::steady_clock::now();
 
+    // If output is still waiting from a previous callback the socket was
+    // full, and the bufferevent is waiting for it to become writable; leave
+    // the writing to it rather than trying (and failing) again.
+    const bool writePending =
+            evbuffer_get_length(bufferevent_get_output(bev.get())) != 0;
+
     shutdownIfSendQueueStuck(start);
     if (state == State::running) {
         try {
@@ -675,8 +719,15 @@ bool Connection::executeCommandsCallback() {
                     Settings::instance().getMaxSendQueueSize();
             bool more = (getSendQueueSize() < maxSendQueueSize);
             while (more) {
-                const auto ret = getBucket().getDcpIface()->step(
-                        static_cast<const void*>(cookies.front().get()), this);
+                // Let the engine fill the send queue with a batch of
+                // messages rather than calling it once per message
+                size_t nmessages = 0;
+                const auto ret = getBucket().getDcpIface()->step_batch(
+                        static_cast<const void*>(cookies.front().get()),
+                        this,
+                        maxSendQueueSize - getSendQueueSize(),
+                        nmessages);
+                totalOps += nmessages;
                 switch (remapErrorCode(ret)) {
                 case ENGINE_SUCCESS:
                     more = (getSendQueueSize() < maxSendQueueSize);
@@ -698,9 +749,16 @@ bool Connection::executeCommandsCallback() {
         }
     }
 
+    if (state == State::running && !ssl && !writePending) {
+        flushOutputStream();
+    } else if (!gatherWriter.empty()) {
+        gatherWriter.spill(bufferevent_get_output(bev.get()));
+    }
+
     const auto stop = std::chrono::steady_clock::now();
     const auto ns = duration_cast<nanoseconds>(stop - start);
     scheduler_info[getThread().index].add(duration_cast<microseconds>(ns));
+    getThread().busyTime += ns.count();
     addCpuTime(ns);
 
     if (state != State::running) {
@@ -717,11 +775,11 @@ bool Connection::executeCommandsCallback() {
             disassociate_bucket(*this);
 
             // Do the final cleanup of the connection:
-            thread.notification.remove(this);
+            getThread().notification.remove(this);
             // remove from pending-io list
             {
-                std::lock_guard<std::mutex> lock(thread.pending_io.mutex);
-                thread.pending_io.map.erase(this);
+                std::lock_guard<std::mutex> lock(getThread().pending_io.mutex);
+                getThread().pending_io.map.erase(this);
             }
 
             // delete the object
@@ -731,6 +789,51 @@ bool Connection::executeCommandsCallback() {
     return true;
 }
 
+void Connection::flushOutputStream() {
+    auto* output = bufferevent_get_output(bev.get());
+    if (!gatherWriter.empty()) {
+        // Errors (and EAGAIN) are picked up by the bufferevent when it
+        // tries to write the rest.
+        sendSyscalls += gatherWriter.write(socketDescriptor);
+        gatherWriter.spill(output);
+    } else if (evbuffer_get_length(output) == 0) {
+        return;
+    } else {
+        // The bufferevent keeps the start of its output buffer frozen, and
+        // unfreezes it around its own writes. Do the same.
+        evbuffer_unfreeze(output, 1);
+        evbuffer_write(output, socketDescriptor);
+        evbuffer_freeze(output, 1);
+    }
+
+    // The bufferevent only calls the write callback after _it_ wrote data,
+    // and that's what lets us continue if we stopped reading commands
+    // because the send queue was full. If we drained it ourselves we need to
+    // schedule that.
+    if (evbuffer_get_length(output) == 0 &&
+        (bufferevent_get_enabled(bev.get()) & EV_READ) == 0) {
+        const auto opt = BEV_TRIG_IGNORE_WATERMARKS | BEV_TRIG_DEFER_CALLBACKS;
+        bufferevent_trigger(bev.get(), EV_WRITE, opt);
+    }
+}
+
+void Connection::input_callback(evbuffer*,
+                                const evbuffer_cb_info* info,
+                                void* ctx) {
+    if (info->n_added > 0) {
+        ++reinterpret_cast<Connection*>(ctx)->recvSyscalls;
+    }
+}
+
+void Connection::output_callback(evbuffer*,
+                                 const evbuffer_cb_info* info,
+                                 void* ctx) {
+    // Nothing but the writes to the socket removes data from the output
+    if (info->n_deleted > 0) {
+        ++reinterpret_cast<Connection*>(ctx)->sendSyscalls;
+    }
+}
+
 void Connection::rw_callback(bufferevent*, void* ctx) {
     auto& instance = *reinterpret_cast<Connection*>(ctx);
     auto& thread = instance.getThread();
@@ -923,8 +1026,10 @@ void Connection::triggerCallback() {
     bufferevent_trigger(bev.get(), EV_READ, opt);
 }
 
-bool Connection::dcpUseWriteBuffer(size_t size) const {
-    return isSslEnabled() && size < thread.scratch_buffer.size();
+bool Connection::useGatherWriter() const {
+    // Anything already in the bufferevent's output must be sent first
+    return !ssl &&
+           evbuffer_get_length(bufferevent_get_output(bev.get())) == 0;
 }
 
 void Connection::copyToOutputStream(std::string_view data) {
@@ -932,15 +1037,52 @@ void Connection::copyToOutputStream(std::string_view data) {
         return;
     }
 
-    if (bufferevent_write(bev.get(), data.data(), data.size()) == -1) {
+    if (useGatherWriter()) {
+        gatherWriter.copy(data);
+    } else if (bufferevent_write(bev.get(), data.data(), data.size()) == -1) {
         throw std::bad_alloc();
     }
 
     totalSend += data.size();
 }
 
-static void sendbuffer_cleanup_cb(const void*, size_t, void* extra) {
-    delete reinterpret_cast<SendBuffer*>(extra);
+cb::char_buffer Connection::reserveOutputSpace(std::size_t size) {
+    if (useGatherWriter()) {
+        reservedSpace = {};
+        return gatherWriter.reserve(size);
+    }
+
+    // A single iovec, so the space is contiguous
+    if (evbuffer_reserve_space(bufferevent_get_output(bev.get()),
+                               size,
+                               &reservedSpace,
+                               1) != 1) {
+        throw std::bad_alloc();
+    }
+    return {static_cast<char*>(reservedSpace.iov_base), size};
+}
+
+void Connection::commitOutputSpace(std::size_t size) {
+    if (reservedSpace.iov_base == nullptr) {
+        gatherWriter.commit(size);
+    } else {
+        reservedSpace.iov_len = size;
+        const auto ret = evbuffer_commit_space(
+                bufferevent_get_output(bev.get()), &reservedSpace, 1);
+        reservedSpace = {};
+        if (ret == -1) {
+            throw std::bad_alloc();
+        }
+    }
+
+    totalSend += size;
+}
+
+bool Connection::useSendBuffer(std::size_t size) const {
+    if (ssl) {
+        return size > SendBuffer::MinimumDataSize;
+    }
+    return size > 0;
 }
 
 void Connection::chainDataToOutputStream(std::unique_ptr<SendBuffer> buffer) {
@@ -950,26 +1092,89 @@ void Connection::chainDataToOutputStream(std::unique_ptr<SendBuffer> buffer) {
     }
 
     auto data = buffer->getPayload();
+    if (useGatherWriter()) {
+        gatherWriter.reference(std::move(buffer));
+        totalSend += data.size();
+        return;
+    }
+
     if (evbuffer_add_reference(bufferevent_get_output(bev.get()),
                                data.data(),
                                data.size(),
-                               sendbuffer_cleanup_cb,
+                               SendBuffer::cleanup,
                                buffer.get()) == -1) {
         throw std::bad_alloc();
     }
 
     // Buffer successfully added to libevent and the callback
-    // (sendbuffer_cleanup_cb) will free the memory.
+    // (SendBuffer::cleanup) will free the memory.
     // Move the ownership of the buffer!
     (void)buffer.release();
     totalSend += data.size();
 }
 
+ENGINE_ERROR_CODE Connection::sendDcpItemMessage(
+        cb::mcbp::ClientOpcode opcode,
+        uint32_t opaque,
+        Vbid vbucket,
+        cb::mcbp::DcpStreamId sid,
+        cb::const_byte_buffer extras,
+        const item_info& info,
+        const DocKey& key,
+        cb::unique_item_ptr it) {
+    char* root = reinterpret_cast<char*>(info.value[0].iov_base);
+    std::string_view value{root, info.value[0].iov_len};
+    cb::mcbp::DcpStreamIdFrameInfo frameInfo(sid);
+    const auto framingExtras =
+            sid ? frameInfo.getBuf() : cb::const_byte_buffer{};
+    const auto chain = useSendBuffer(value.size());
+
+    try {
+        // Encode the message in place, and copy the value in with it
+        // unless it is referenced.
+        const auto size = sizeof(cb::mcbp::Request) + framingExtras.size() +
+                          extras.size() + key.size() +
+                          (chain ? 0 : value.size());
+        cb::mcbp::RequestBuilder builder(reserveOutputSpace(size));
+        builder.setMagic(sid ? cb::mcbp::Magic::AltClientRequest
+                             : cb::mcbp::Magic::ClientRequest);
+        builder.setOpcode(opcode);
+        if (sid) {
+            builder.setFramingExtras(framingExtras);
+        }
+        builder.setExtras(extras);
+        builder.setKey({key.data(), key.size()});
+        builder.setOpaque(opaque);
+        builder.setVBucket(vbucket);
+        builder.setCas(info.cas);
+        builder.setDatatype(cb::mcbp::Datatype(info.datatype));
+        if (chain) {
+            auto* req = builder.getFrame();
+            req->setBodylen(
+                    gsl::narrow<uint32_t>(req->getBodylen() + value.size()));
+        } else {
+            builder.setValue(value);
+        }
+        commitOutputSpace(size);
+
+        if (chain) {
+            chainDataToOutputStream(std::make_unique<ItemSendBuffer>(
+                    std::move(it), value, getBucket()));
+        }
+    } catch (const std::bad_alloc&) {
+        // We might have written a partial message into the buffer so
+        // we need to disconnect the client
+        return ENGINE_DISCONNECT;
+    }
+
+    return ENGINE_SUCCESS;
+}
+
 Connection::Connection(FrontEndThread& thr)
     : socketDescriptor(INVALID_SOCKET),
       connectedToSystemPort(false),
       base(nullptr),
-      thread(thr),
+      thread(&thr),
       peername("unknown"),
       sockname("unknown"),
       max_reqs_per_event(Settings::instance().getRequestsPerEventNotification(
@@ -988,7 +1193,7 @@ Connection::Connection(SOCKET sfd,
     : socketDescriptor(sfd),
       connectedToSystemPort(ifc.system),
       base(b),
-      thread(thr),
+      thread(&thr),
       parent_port(ifc.port),
       peername(cb::net::getpeername(socketDescriptor)),
       sockname(cb::net::getsockname(socketDescriptor)),
@@ -1000,33 +1205,118 @@ Connection::Connection(SOCKET sfd,
     cookies.emplace_back(std::unique_ptr<Cookie>{new Cookie(*this)});
     setConnectionId(peername.c_str());
 
-    const auto options = BEV_OPT_THREADSAFE | BEV_OPT_UNLOCK_CALLBACKS |
-                         BEV_OPT_CLOSE_ON_FREE | BEV_OPT_DEFER_CALLBACKS;
     if (ssl) {
         bev.reset(bufferevent_openssl_socket_new(
                 base,
                 sfd,
                 createSslStructure(ifc).release(),
                 BUFFEREVENT_SSL_ACCEPTING,
-                options));
+                BuffereventOptions));
         bufferevent_setcb(bev.get(),
                           Connection::ssl_read_callback,
                           Connection::rw_callback,
                           Connection::event_callback,
                           static_cast<void*>(this));
+        addBufferCallbacks(bev.get());
     } else {
-        bev.reset(bufferevent_socket_new(base, sfd, options));
-        bufferevent_setcb(bev.get(),
-                          Connection::rw_callback,
-                          Connection::rw_callback,
-                          Connection::event_callback,
-                          static_cast<void*>(this));
+        bev = createPlainBufferevent(base);
     }
 
     bufferevent_enable(bev.get(), EV_READ);
     stats.conn_structs++;
 }
 
+cb::libevent::unique_bufferevent_ptr Connection::createPlainBufferevent(
+        event_base* b) {
+    cb::libevent::unique_bufferevent_ptr ret(
+            bufferevent_socket_new(b, socketDescriptor, BuffereventOptions));
+    if (!ret) {
+        throw std::bad_alloc();
+    }
+    bufferevent_setcb(ret.get(),
+                      Connection::rw_callback,
+                      Connection::rw_callback,
+                      Connection::event_callback,
+                      static_cast<void*>(this));
+    // By default the bufferevent writes at most 16k per iteration of
+    // the event loop; let it send everything the socket accepts
+    // (see flushOutputStream()).
+    bufferevent_set_max_single_write(ret.get(), EV_SSIZE_MAX);
+    addBufferCallbacks(ret.get());
+    return ret;
+}
+
+void Connection::addBufferCallbacks(bufferevent* event) {
+    evbuffer_add_cb(bufferevent_get_input(event),
+                    Connection::input_callback,
+                    static_cast<void*>(this));
+    evbuffer_add_cb(bufferevent_get_output(event),
+                    Connection::output_callback,
+                    static_cast<void*>(this));
+}
+
+bool Connection::isMigratable() const {
+    if (state != State::running || ssl || !bev || isDCP() ||
+        isDuplexSupported() || isClustermapChangeNotificationSupported() ||
+        !server_events.empty()) {
+        return false;
+    }
+
+    for (const auto& c : cookies) {
+        if (c && (!c->empty() || c->getRefcount() > 0)) {
+            return false;
+        }
+    }
+
+    auto& pending = getThread().pending_io;
+    std::lock_guard<std::mutex> guard(pending.mutex);
+    return pending.map.find(const_cast<Connection*>(this)) ==
+           pending.map.end();
+}
+
+void Connection::migrate(FrontEndThread& to) {
+    Expects(gatherWriter.empty());
+    auto next = createPlainBufferevent(to.base);
+
+    // Move the data read but not yet processed, and the data not yet
+    // sent. The bufferevents keep the end of their input and the start of
+    // their output frozen (unfreezing them around their own reads and
+    // writes), so we need to do the same.
+    auto* input = bufferevent_get_input(next.get());
+    evbuffer_unfreeze(input, 0);
+    auto rc = evbuffer_add_buffer(input, bufferevent_get_input(bev.get()));
+    evbuffer_freeze(input, 0);
+    if (rc == 0) {
+        auto* output = bufferevent_get_output(bev.get());
+        evbuffer_unfreeze(output, 1);
+        rc = evbuffer_add_buffer(bufferevent_get_output(next.get()), output);
+        evbuffer_freeze(output, 1);
+    }
+    if (rc != 0) {
+        throw std::runtime_error(
+                "Connection::migrate(): Failed to move the buffered data");
+    }
+
+    getThread().notification.remove(this);
+
+    // The old bufferevent must not close the socket
+    bufferevent_setfd(bev.get(), -1);
+    bev = std::move(next);
+    base = to.base;
+    thread = &to;
+
+    // Any callback scheduled for the old bufferevent was cancelled when
+    // it was freed, and there may already be a command in the input
+    bufferevent_enable(bev.get(), EV_READ);
+    triggerCallback();
+}
+
+std::chrono::nanoseconds Connection::getRecentCpuTime() {
+    const auto ret = total_cpu_time - recent_cpu_time_start;
+    recent_cpu_time_start = total_cpu_time;
+    return ret;
+}
+
 Connection::~Connection() {
     if (connectedToSystemPort) {
         --stats.system_conns;
@@ -1219,8 +1509,8 @@ bool Connection::signalIfIdle() {
     }
 
     if (state != State::immediate_close) {
-        thread.notification.push(this);
-        notify_thread(thread);
+        getThread().notification.push(this);
+        notify_thread(getThread());
         return true;
     }
     return false;
@@ -1287,7 +1577,8 @@ bool Connection::havePendingData() const {
 }
 
 size_t Connection::getSendQueueSize() const {
-    return evbuffer_get_length(bufferevent_get_output(bev.get()));
+    return evbuffer_get_length(bufferevent_get_output(bev.get())) +
+           gatherWriter.size();
 }
 
 void Connection::sendResponseHeaders(Cookie& cookie,
@@ -1300,8 +1591,8 @@ void Connection::sendResponseHeaders(Cookie& cookie,
                           (sizeof(cb::mcbp::Response) + 3),
                   "scratch buffer too small");
     const auto& request = cookie.getRequest();
-    auto wbuf = cb::char_buffer{thread.scratch_buffer.data(),
-                                thread.scratch_buffer.size()};
+    auto wbuf = cb::char_buffer{getThread().scratch_buffer.data(),
+                                getThread().scratch_buffer.size()};
     auto& response = *reinterpret_cast<cb::mcbp::Response*>(wbuf.data());
 
     response.setOpcode(request.getClientOpcode());
@@ -1365,7 +1656,7 @@ void Connection::sendResponseHeaders(Cookie& cookie,
     // if we can fit the key and extras in the scratch buffer lets copy them
     // in to avoid the extra mutex lock
     if ((wbuf.size() + extras.size() + key.size()) <
-        thread.scratch_buffer.size()) {
+        getThread().scratch_buffer.size()) {
         std::copy(extras.begin(), extras.end(), wbuf.end());
         wbuf = {wbuf.data(), wbuf.size() + extras.size()};
         std::copy(key.begin(), key.end(), wbuf.end());
@@ -1595,9 +1886,6 @@ ENGINE_ERROR_CODE Connection::mutation(uint32_t opaque,
         return ENGINE_FAILED;
     }
 
-    char* root = reinterpret_cast<char*>(info.value[0].iov_base);
-    std::string_view value{root, info.value[0].iov_len};
-
     auto key = info.key;
     // The client doesn't support collections, so must not send an encoded key
     if (!isCollectionsSupported()) {
@@ -1612,96 +1900,14 @@ ENGINE_ERROR_CODE Connection::mutation(uint32_t opaque,
             lock_time,
             nru);
 
-    cb::mcbp::DcpStreamIdFrameInfo frameExtras(sid);
-
-    const auto total = sizeof(extras) + key.size() + value.size() +
-                       (sid ? sizeof(cb::mcbp::DcpStreamIdFrameInfo) : 0) +
-                       sizeof(cb::mcbp::Request);
-    if (dcpUseWriteBuffer(total)) {
-        cb::mcbp::RequestBuilder builder(thread.getScratchBuffer());
-        builder.setMagic(sid ? cb::mcbp::Magic::AltClientRequest
-                             : cb::mcbp::Magic::ClientRequest);
-        builder.setOpcode(cb::mcbp::ClientOpcode::DcpMutation);
-        if (sid) {
-            builder.setFramingExtras(frameExtras.getBuf());
-        }
-        builder.setExtras(extras.getBuffer());
-        builder.setKey({key.data(), key.size()});
-        builder.setValue(value);
-        builder.setOpaque(opaque);
-        builder.setVBucket(vbucket);
-        builder.setCas(info.cas);
-        builder.setDatatype(cb::mcbp::Datatype(info.datatype));
-
-        copyToOutputStream(builder.getFrame()->getFrame());
-        return ENGINE_SUCCESS;
-    }
-
-    cb::mcbp::Request req = {};
-    req.setMagic(sid ? cb::mcbp::Magic::AltClientRequest
-                     : cb::mcbp::Magic::ClientRequest);
-    req.setOpcode(cb::mcbp::ClientOpcode::DcpMutation);
-    req.setExtlen(gsl::narrow<uint8_t>(sizeof(extras)));
-    req.setKeylen(gsl::narrow<uint16_t>(key.size()));
-    req.setBodylen(gsl::narrow<uint32_t>(
-            sizeof(extras) + key.size() + value.size() +
-            (sid ? sizeof(cb::mcbp::DcpStreamIdFrameInfo) : 0)));
-    req.setOpaque(opaque);
-    req.setVBucket(vbucket);
-    req.setCas(info.cas);
-    req.setDatatype(cb::mcbp::Datatype(info.datatype));
-
-    if (sid) {
-        req.setFramingExtraslen(sizeof(cb::mcbp::DcpStreamIdFrameInfo));
-    }
-
-    try {
-        // Add the header
-        copyToOutputStream(
-                {reinterpret_cast<const uint8_t*>(&req), sizeof(req)});
-        if (sid) {
-            copyToOutputStream(frameExtras.getBuf());
-        }
-        copyToOutputStream(extras.getBuffer());
-
-        // Add the key
-        copyToOutputStream({key.data(), key.size()});
-
-        // Add the value
-        if (!value.empty()) {
-            if (value.size() > SendBuffer::MinimumDataSize) {
-                auto sendbuffer = std::make_unique<ItemSendBuffer>(
-                        std::move(it), value, getBucket());
-                chainDataToOutputStream(std::move(sendbuffer));
-            } else {
-                copyToOutputStream(value);
-            }
-        }
-    } catch (const std::bad_alloc&) {
-        /// We might have written a partial message into the buffer so
-        /// we need to disconnect the client
-        return ENGINE_DISCONNECT;
-    }
-
-    return ENGINE_SUCCESS;
-}
-
-ENGINE_ERROR_CODE Connection::deletionInner(const item_info& info,
-                                            cb::const_byte_buffer packet,
-                                            const DocKey& key) {
-    try {
-        copyToOutputStream(packet);
-        copyToOutputStream({key.data(), key.size()});
-        copyToOutputStream(
-                {reinterpret_cast<const char*>(info.value[0].iov_base),
-                 info.nbytes});
-    } catch (const std::bad_alloc&) {
-        // We might have written a partial message into the buffer so
-        // we need to disconnect the client
-        return ENGINE_DISCONNECT;
-    }
-
-    return ENGINE_SUCCESS;
+    return sendDcpItemMessage(cb::mcbp::ClientOpcode::DcpMutation,
+                              opaque,
+                              vbucket,
+                              sid,
+                              extras.getBuffer(),
+                              info,
+                              key,
+                              std::move(it));
 }
 
 ENGINE_ERROR_CODE Connection::deletion(uint32_t opaque,
@@ -1721,70 +1927,17 @@ ENGINE_ERROR_CODE Connection::deletion(uint32_t opaque,
     if (!isCollectionsSupported()) {
         key = info.key.makeDocKeyWithoutCollectionID();
     }
-    char* root = reinterpret_cast<char*>(info.value[0].iov_base);
-    std::string_view value{root, info.value[0].iov_len};
 
-    cb::mcbp::DcpStreamIdFrameInfo frameInfo(sid);
     cb::mcbp::request::DcpDeletionV1Payload extdata(by_seqno, rev_seqno);
 
-    const auto total = sizeof(extdata) + key.size() + value.size() +
-                       (sid ? sizeof(cb::mcbp::DcpStreamIdFrameInfo) : 0) +
-                       sizeof(cb::mcbp::Request);
-
-    if (dcpUseWriteBuffer(total)) {
-        cb::mcbp::RequestBuilder builder(thread.getScratchBuffer());
-
-        builder.setMagic(sid ? cb::mcbp::Magic::AltClientRequest
-                             : cb::mcbp::Magic::ClientRequest);
-        builder.setOpcode(cb::mcbp::ClientOpcode::DcpDeletion);
-        if (sid) {
-            builder.setFramingExtras(frameInfo.getBuf());
-        }
-        builder.setExtras(extdata.getBuffer());
-        builder.setKey({key.data(), key.size()});
-        builder.setValue(value);
-        builder.setOpaque(opaque);
-        builder.setVBucket(vbucket);
-        builder.setCas(info.cas);
-        builder.setDatatype(cb::mcbp::Datatype(info.datatype));
-
-        copyToOutputStream(builder.getFrame()->getFrame());
-        return ENGINE_SUCCESS;
-    }
-
-    using cb::mcbp::Request;
-    using cb::mcbp::request::DcpDeletionV1Payload;
-    uint8_t blob[sizeof(Request) + sizeof(DcpDeletionV1Payload) +
-                 sizeof(cb::mcbp::DcpStreamIdFrameInfo)];
-    auto& req = *reinterpret_cast<Request*>(blob);
-    req.setMagic(sid ? cb::mcbp::Magic::AltClientRequest
-                     : cb::mcbp::Magic::ClientRequest);
-    req.setOpcode(cb::mcbp::ClientOpcode::DcpDeletion);
-    req.setExtlen(gsl::narrow<uint8_t>(sizeof(DcpDeletionV1Payload)));
-    req.setKeylen(gsl::narrow<uint16_t>(key.size()));
-    req.setBodylen(gsl::narrow<uint32_t>(
-            sizeof(DcpDeletionV1Payload) + key.size() + info.nbytes +
-            (sid ? sizeof(cb::mcbp::DcpStreamIdFrameInfo) : 0)));
-    req.setOpaque(opaque);
-    req.setVBucket(vbucket);
-    req.setCas(info.cas);
-    req.setDatatype(cb::mcbp::Datatype(info.datatype));
-
-    auto* ptr = blob + sizeof(Request);
-    if (sid) {
-        auto buf = frameInfo.getBuf();
-        std::copy(buf.begin(), buf.end(), ptr);
-        ptr += buf.size();
-        req.setFramingExtraslen(buf.size());
-    }
-
-    std::copy(extdata.getBuffer().begin(), extdata.getBuffer().end(), ptr);
-    cb::const_byte_buffer packetBuffer{
-            blob,
-            sizeof(Request) + sizeof(DcpDeletionV1Payload) +
-                    (sid ? sizeof(cb::mcbp::DcpStreamIdFrameInfo) : 0)};
-
-    return deletionInner(info, packetBuffer, key);
+    return sendDcpItemMessage(cb::mcbp::ClientOpcode::DcpDeletion,
+                              opaque,
+                              vbucket,
+                              sid,
+                              extdata.getBuffer(),
+                              info,
+                              key,
+                              std::move(it));
 }
 
 ENGINE_ERROR_CODE Connection::deletion_v2(uint32_t opaque,
@@ -1808,67 +1961,15 @@ ENGINE_ERROR_CODE Connection::deletion_v2(uint32_t opaque,
 
     cb::mcbp::request::DcpDeletionV2Payload extras(
             by_seqno, rev_seqno, delete_time);
-    cb::mcbp::DcpStreamIdFrameInfo frameInfo(sid);
-    char* root = reinterpret_cast<char*>(info.value[0].iov_base);
-    std::string_view value{root, info.value[0].iov_len};
-
-    const auto total = sizeof(extras) + key.size() + value.size() +
-                       (sid ? sizeof(cb::mcbp::DcpStreamIdFrameInfo) : 0) +
-                       sizeof(cb::mcbp::Request);
-
-    if (dcpUseWriteBuffer(total)) {
-        cb::mcbp::RequestBuilder builder(thread.getScratchBuffer());
-        builder.setMagic(sid ? cb::mcbp::Magic::AltClientRequest
-                             : cb::mcbp::Magic::ClientRequest);
-        builder.setOpcode(cb::mcbp::ClientOpcode::DcpDeletion);
-        if (sid) {
-            builder.setFramingExtras(frameInfo.getBuf());
-        }
-        builder.setExtras(extras.getBuffer());
-        builder.setKey({key.data(), key.size()});
-        builder.setValue(value);
-        builder.setOpaque(opaque);
-        builder.setVBucket(vbucket);
-        builder.setCas(info.cas);
-        builder.setDatatype(cb::mcbp::Datatype(info.datatype));
-        copyToOutputStream(builder.getFrame()->getFrame());
-        return ENGINE_SUCCESS;
-    }
-
-    // Make blob big enough for either delete or expiry
-    uint8_t blob[sizeof(cb::mcbp::Request) + sizeof(extras) +
-                 sizeof(frameInfo)] = {};
-    const size_t payloadLen = sizeof(extras);
-    const size_t frameInfoLen = sid ? sizeof(frameInfo) : 0;
-
-    auto& req = *reinterpret_cast<cb::mcbp::Request*>(blob);
-    req.setMagic(sid ? cb::mcbp::Magic::AltClientRequest
-                     : cb::mcbp::Magic::ClientRequest);
-
-    req.setOpcode(cb::mcbp::ClientOpcode::DcpDeletion);
-    req.setExtlen(gsl::narrow<uint8_t>(payloadLen));
-    req.setKeylen(gsl::narrow<uint16_t>(key.size()));
-    req.setBodylen(gsl::narrow<uint32_t>(payloadLen +
-                                         gsl::narrow<uint16_t>(key.size()) +
-                                         info.nbytes + frameInfoLen));
-    req.setOpaque(opaque);
-    req.setVBucket(vbucket);
-    req.setCas(info.cas);
-    req.setDatatype(cb::mcbp::Datatype(info.datatype));
-    auto size = sizeof(cb::mcbp::Request);
-    auto* ptr = blob + size;
-    if (sid) {
-        auto buf = frameInfo.getBuf();
-        std::copy(buf.begin(), buf.end(), ptr);
-        ptr += buf.size();
-        size += buf.size();
-    }
-
-    auto buffer = extras.getBuffer();
-    std::copy(buffer.begin(), buffer.end(), ptr);
-    size += buffer.size();
 
-    return deletionInner(info, {blob, size}, key);
+    return sendDcpItemMessage(cb::mcbp::ClientOpcode::DcpDeletion,
+                              opaque,
+                              vbucket,
+                              sid,
+                              extras.getBuffer(),
+                              info,
+                              key,
+                              std::move(it));
 }
 
 ENGINE_ERROR_CODE Connection::expiration(uint32_t opaque,
@@ -1892,67 +1993,15 @@ ENGINE_ERROR_CODE Connection::expiration(uint32_t opaque,
 
     cb::mcbp::request::DcpExpirationPayload extras(
             by_seqno, rev_seqno, delete_time);
-    cb::mcbp::DcpStreamIdFrameInfo frameInfo(sid);
-    char* root = reinterpret_cast<char*>(info.value[0].iov_base);
-    std::string_view value{root, info.value[0].iov_len};
-
-    const auto total = sizeof(extras) + key.size() + value.size() +
-                       (sid ? sizeof(cb::mcbp::DcpStreamIdFrameInfo) : 0) +
-                       sizeof(cb::mcbp::Request);
 
-    if (dcpUseWriteBuffer(total)) {
-        cb::mcbp::RequestBuilder builder(thread.getScratchBuffer());
-        builder.setMagic(sid ? cb::mcbp::Magic::AltClientRequest
-                             : cb::mcbp::Magic::ClientRequest);
-        builder.setOpcode(cb::mcbp::ClientOpcode::DcpExpiration);
-        if (sid) {
-            builder.setFramingExtras(frameInfo.getBuf());
-        }
-        builder.setExtras(extras.getBuffer());
-        builder.setKey({key.data(), key.size()});
-        builder.setValue(value);
-        builder.setOpaque(opaque);
-        builder.setVBucket(vbucket);
-        builder.setCas(info.cas);
-        builder.setDatatype(cb::mcbp::Datatype(info.datatype));
-        copyToOutputStream(builder.getFrame()->getFrame());
-        return ENGINE_SUCCESS;
-    }
-
-    // Make blob big enough for either delete or expiry
-    uint8_t blob[sizeof(cb::mcbp::Request) + sizeof(extras) +
-                 sizeof(frameInfo)] = {};
-    const size_t payloadLen = sizeof(extras);
-    const size_t frameInfoLen = sid ? sizeof(frameInfo) : 0;
-
-    auto& req = *reinterpret_cast<cb::mcbp::Request*>(blob);
-    req.setMagic(sid ? cb::mcbp::Magic::AltClientRequest
-                     : cb::mcbp::Magic::ClientRequest);
-
-    req.setOpcode(cb::mcbp::ClientOpcode::DcpExpiration);
-    req.setExtlen(gsl::narrow<uint8_t>(payloadLen));
-    req.setKeylen(gsl::narrow<uint16_t>(key.size()));
-    req.setBodylen(gsl::narrow<uint32_t>(payloadLen +
-                                         gsl::narrow<uint16_t>(key.size()) +
-                                         info.nbytes + frameInfoLen));
-    req.setOpaque(opaque);
-    req.setVBucket(vbucket);
-    req.setCas(info.cas);
-    req.setDatatype(cb::mcbp::Datatype(info.datatype));
-    auto size = sizeof(cb::mcbp::Request);
-    auto* ptr = blob + size;
-    if (sid) {
-        auto buf = frameInfo.getBuf();
-        std::copy(buf.begin(), buf.end(), ptr);
-        ptr += buf.size();
-        size += buf.size();
-    }
-
-    auto buffer = extras.getBuffer();
-    std::copy(buffer.begin(), buffer.end(), ptr);
-    size += buffer.size();
-
-    return deletionInner(info, {blob, size}, key);
+    return sendDcpItemMessage(cb::mcbp::ClientOpcode::DcpExpiration,
+                              opaque,
+                              vbucket,
+                              sid,
+                              extras.getBuffer(),
+                              info,
+                              key,
+                              std::move(it));
 }
 
 ENGINE_ERROR_CODE Connection::set_vbucket_state(uint32_t opaque,
@@ -2077,9 +2126,6 @@ ENGINE_ERROR_CODE Connection::prepare(uint32_t opaque,
         return ENGINE_FAILED;
     }
 
-    char* root = reinterpret_cast<char*>(info.value[0].iov_base);
-    std::string_view buffer{root, info.value[0].iov_len};
-
     auto key = info.key;
 
     // The client doesn't support collections, so must not send an encoded key
@@ -2099,63 +2145,14 @@ ENGINE_ERROR_CODE Connection::prepare(uint32_t opaque,
     }
     extras.setDurabilityLevel(level);
 
-    size_t total = sizeof(extras) + key.size() + buffer.size() +
-                   sizeof(cb::mcbp::Request);
-    if (dcpUseWriteBuffer(total)) {
-        // Format a local copy and send
-        cb::mcbp::RequestBuilder builder(thread.getScratchBuffer());
-        builder.setMagic(cb::mcbp::Magic::ClientRequest);
-        builder.setOpcode(cb::mcbp::ClientOpcode::DcpPrepare);
-        builder.setExtras(extras.getBuffer());
-        builder.setKey({key.data(), key.size()});
-        builder.setOpaque(opaque);
-        builder.setVBucket(vbucket);
-        builder.setCas(info.cas);
-        builder.setDatatype(cb::mcbp::Datatype(info.datatype));
-        builder.setValue(buffer);
-        copyToOutputStream(builder.getFrame()->getFrame());
-        return ENGINE_SUCCESS;
-    }
-
-    cb::mcbp::Request req = {};
-    req.setMagic(cb::mcbp::Magic::ClientRequest);
-    req.setOpcode(cb::mcbp::ClientOpcode::DcpPrepare);
-    req.setExtlen(gsl::narrow<uint8_t>(sizeof(extras)));
-    req.setKeylen(gsl::narrow<uint16_t>(key.size()));
-    req.setBodylen(
-            gsl::narrow<uint32_t>(sizeof(extras) + key.size() + buffer.size()));
-    req.setOpaque(opaque);
-    req.setVBucket(vbucket);
-    req.setCas(info.cas);
-    req.setDatatype(cb::mcbp::Datatype(info.datatype));
-
-    try {
-        // Add the header
-        copyToOutputStream(
-                {reinterpret_cast<const uint8_t*>(&req), sizeof(req)});
-        copyToOutputStream(
-                {reinterpret_cast<const uint8_t*>(&extras), sizeof(extras)});
-
-        // Add the key
-        copyToOutputStream({key.data(), key.size()});
-
-        // Add the value
-        if (!buffer.empty()) {
-            if (buffer.size() > SendBuffer::MinimumDataSize) {
-                auto sendbuffer = std::make_unique<ItemSendBuffer>(
-                        std::move(it), buffer, getBucket());
-                chainDataToOutputStream(std::move(sendbuffer));
-            } else {
-                copyToOutputStream(buffer);
-            }
-        }
-    } catch (const std::bad_alloc&) {
-        /// We might have written a partial message into the buffer so
-        /// we need to disconnect the client
-        return ENGINE_DISCONNECT;
-    }
-
-    return ENGINE_SUCCESS;
+    return sendDcpItemMessage(cb::mcbp::ClientOpcode::DcpPrepare,
+                              opaque,
+                              vbucket,
+                              cb::mcbp::DcpStreamId{},
+                              extras.getBuffer(),
+                              info,
+                              key,
+                              std::move(it));
 }
 
 ENGINE_ERROR_CODE Connection::seqno_acknowledged(uint32_t opaque,
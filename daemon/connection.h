@@ -17,6 +17,7 @@
 #pragma once
 
 #include "datatype_filter.h"
+#include "gather_writer.h"
 #include "sendbuffer.h"
 #include "stats.h"
 #include "task.h"
@@ -24,7 +25,9 @@
 #include <cbsasl/client.h>
 #include <cbsasl/server.h>
 #include <daemon/protocol/mcbp/command_context.h>
+#include <event2/buffer.h>
 #include <libevent/utilities.h>
+#include <mcbp/protocol/opcode.h>
 #include <mcbp/protocol/unsigned_leb128.h>
 #include <memcached/dcp.h>
 #include <memcached/openssl.h>
@@ -33,6 +36,7 @@
 #include <platform/socket.h>
 
 #include <array>
+#include <atomic>
 #include <chrono>
 #include <deque>
 #include <memory>
@@ -114,7 +118,7 @@ public:
     /**
      * Signal a connection if it's idle
      *
-     * The connections thread lock must be held when calling the method
+     * The connection's thread lock must be held when calling the method
      *
      * @return true if the connection was idle, false otherwise
      */
@@ -192,9 +196,38 @@ public:
     }
 
     FrontEndThread& getThread() const {
-        return thread;
+        return *thread.load();
     }
 
+    /**
+     * May the connection be moved to another front end thread? That's only
+     * possible for plain connections which are idle between commands (no
+     * command being executed or waiting for the engine, and no references
+     * from the engine), and which don't receive server pushed messages.
+     *
+     * The connection's thread lock must be held when calling the method
+     */
+    bool isMigratable() const;
+
+    /**
+     * Move the connection to another front end thread: replace the
+     * bufferevent with one on the other thread's event base (carrying
+     * over any data read but not processed, and data not yet sent).
+     *
+     * Must be called from the connection's current thread, holding its
+     * thread lock and the connections (list) lock. See
+     * migrate_thread_connection().
+     *
+     * @param to the thread to serve the connection from now on
+     */
+    void migrate(FrontEndThread& to);
+
+    /**
+     * Get the CPU time the connection used since the previous call (used
+     * to pick a connection to move to another thread)
+     */
+    std::chrono::nanoseconds getRecentCpuTime();
+
     in_port_t getParentPort() const {
         return parent_port;
     }
@@ -315,10 +348,21 @@ public:
      * just wrap it from the method driving the event loop (as we
      * also want to record the delta to the thread scheduler histogram
      *
+     * This also updates the measured cost of the connection's requests
+     * (see getRequestsPerSlice()).
+     *
      * @param ns The number of nanoseconds spent in this iteration.
      */
     void addCpuTime(std::chrono::nanoseconds ns);
 
+    /**
+     * Get the number of requests the connection may execute in its next
+     * time slice. With a sched_time_budget that's the number of requests
+     * (at the measured cost of its recent requests) which fits in the
+     * budget, otherwise max_reqs_per_event.
+     */
+    int getRequestsPerSlice() const;
+
     /**
      * Enqueue a new server event
      *
@@ -378,6 +422,26 @@ public:
                 {reinterpret_cast<const char*>(data.data()), data.size()});
     }
 
+    /**
+     * Reserve contiguous space at the end of the output stream for the
+     * caller to encode data into, rather than encoding it elsewhere and
+     * copying it. Nothing may be added to the output stream before the
+     * space is committed with commitOutputSpace().
+     *
+     * @param size the number of bytes to reserve
+     * @return the reserved space
+     * @throws std::bad_alloc if we failed to reserve the space
+     */
+    cb::char_buffer reserveOutputSpace(std::size_t size);
+
+    /**
+     * Add the first size bytes of the space returned by reserveOutputSpace()
+     * to the output stream.
+     *
+     * @throws std::bad_alloc if we failed to commit the space
+     */
+    void commitOutputSpace(std::size_t size);
+
     /**
      * Add a reference to the data to the output stream.
      *
@@ -387,6 +451,17 @@ public:
      */
     void chainDataToOutputStream(std::unique_ptr<SendBuffer> buffer);
 
+    /**
+     * Should a value of the given size be added to the output stream by
+     * reference (see chainDataToOutputStream) rather than copied?
+     *
+     * On plain connections the output is gathered for sendmsg() (see
+     * GatherWriter), where a reference is cheaper than a copy at any size.
+     * For TLS the bufferevent needs to encrypt the data, and a reference is
+     * only worth it above SendBuffer::MinimumDataSize.
+     */
+    bool useSendBuffer(std::size_t size) const;
+
     /**
      * Enable the datatype which corresponds to the feature
      *
@@ -613,10 +688,6 @@ public:
      */
     void triggerCallback();
 
-    /// Check if DCP should use the write buffer for the message or if it
-    /// should use an IOVector to do so
-    bool dcpUseWriteBuffer(size_t total) const;
-
     // Implementation of dcp_message_producers interface //////////////////////
 
     ENGINE_ERROR_CODE get_failover_log(uint32_t opaque, Vbid vbucket) override;
@@ -774,10 +845,32 @@ protected:
      */
     void updateDescription();
 
-    // Shared DCP_DELETION write function for the v1/v2 commands.
-    ENGINE_ERROR_CODE deletionInner(const item_info& info,
-                                    cb::const_byte_buffer packet,
-                                    const DocKey& key);
+    /**
+     * Add a DCP message carrying a document to the output stream.
+     *
+     * Everything in front of the value (header, framing extras, extras and
+     * key) is encoded in place in the output stream (see
+     * reserveOutputSpace), so it is written once. The value is then either
+     * encoded along with it, or referenced (see useSendBuffer) keeping the
+     * item alive until sent.
+     *
+     * @param opcode the DCP opcode of the message
+     * @param opaque the opaque of the message
+     * @param vbucket the vbucket of the message
+     * @param sid the stream-ID, sent as framing extras if set
+     * @param extras the extras of the message
+     * @param info the item's info (value, cas and datatype)
+     * @param key the key to send
+     * @param it the item owning the value
+     */
+    ENGINE_ERROR_CODE sendDcpItemMessage(cb::mcbp::ClientOpcode opcode,
+                                         uint32_t opaque,
+                                         Vbid vbucket,
+                                         cb::mcbp::DcpStreamId sid,
+                                         cb::const_byte_buffer extras,
+                                         const item_info& info,
+                                         const DocKey& key,
+                                         cb::unique_item_ptr it);
 
     /**
      * Add the provided packet to the send pipe for the connection
@@ -841,8 +934,11 @@ protected:
     /// creator has a reference)
     uint8_t refcount{1};
 
-    /** Pointer to the thread object serving this connection */
-    FrontEndThread& thread;
+    /**
+     * Pointer to the thread object serving this connection. Only changed
+     * by migrate() (holding the thread's mutex and the connections lock)
+     */
+    std::atomic<FrontEndThread*> thread;
 
     /** Listening port that creates this connection instance */
     const in_port_t parent_port{0};
@@ -910,6 +1006,11 @@ protected:
      * The longest time this connection was occupying the thread
      */
     std::chrono::nanoseconds max_sched_time = std::chrono::nanoseconds::zero();
+    /**
+     * total_cpu_time at the previous call to getRecentCpuTime()
+     */
+    std::chrono::nanoseconds recent_cpu_time_start =
+            std::chrono::nanoseconds::zero();
 
     /**
      * The name of the client provided to us by hello
@@ -966,9 +1067,30 @@ protected:
      */
     int numEvents = 0;
 
+    /// The value numEvents started the current timeslice with
+    int sliceEvents = 0;
+
+    /// Moving average of the CPU time of a request (measured over the
+    /// timeslices the requests ran in)
+    std::chrono::nanoseconds requestCost = std::chrono::nanoseconds::zero();
+
+    /// The upper limit of getRequestsPerSlice() when using the time budget
+    static constexpr int MaxRequestsPerSlice = 1000;
+
     /// The bufferevent structure for the object
     cb::libevent::unique_bufferevent_ptr bev;
 
+    /**
+     * The output of the current callback of a plain connection, sent by
+     * flushOutputStream(). Only used while the bufferevent's output is
+     * empty (see useGatherWriter()), so the order of the output is kept.
+     */
+    GatherWriter gatherWriter;
+
+    /// The space returned by reserveOutputSpace() if it is in the
+    /// bufferevent's output (iov_base is nullptr if it is in gatherWriter)
+    evbuffer_iovec reservedSpace{};
+
     /**
      * If the client enabled the mutation seqno feature each mutation
      * command will return the vbucket UUID and sequence number for the
@@ -981,6 +1103,14 @@ protected:
     // Total number of bytes sent to the network
     size_t totalSend = 0;
 
+    /// Number of reads which returned data from the network
+    size_t recvSyscalls = 0;
+    /// Number of writes which sent data to the network
+    size_t sendSyscalls = 0;
+    /// Number of commands received and DCP messages produced (the "ops"
+    /// the syscalls above are spread over)
+    size_t totalOps = 0;
+
     /**
      * The "list" of commands currently being processed. We ALWAYS keep the
      * the first entry in the list (and try to reuse that) due to how DCP
@@ -1071,6 +1201,26 @@ protected:
      */
     bool executeCommandsCallback();
 
+    /**
+     * Write all of the responses produced while executing the commands
+     * (and DCP messages) of this callback to the socket, instead of letting
+     * the bufferevent write them when the event loop next polls the socket.
+     * This sends the responses of a pipeline with a single writev (or
+     * sendmsg, see gatherWriter) as soon as they're produced. Anything the
+     * socket doesn't accept is left for the bufferevent to write as usual.
+     *
+     * Not used if the bufferevent already had output pending when the
+     * callback started (it is waiting for the socket to become writable).
+     *
+     * Only used for plain connections (for TLS the bufferevent needs to
+     * encrypt the data).
+     */
+    void flushOutputStream();
+
+    /// @return true if output should be added to gatherWriter rather than
+    ///         the bufferevent's output.
+    bool useGatherWriter() const;
+
     /**
      * The callback method called from bufferevent for read/write callbacks
      *
@@ -1090,6 +1240,18 @@ protected:
      */
     static void event_callback(bufferevent* bev, short event, void* ctx);
 
+    /**
+     * Callbacks called by libevent whenever data is added to or removed
+     * from the input and output buffers of the bufferevent, used to count
+     * the reads and writes (syscalls) for the connection.
+     */
+    static void input_callback(evbuffer*,
+                               const evbuffer_cb_info* info,
+                               void* ctx);
+    static void output_callback(evbuffer*,
+                                const evbuffer_cb_info* info,
+                                void* ctx);
+
     /**
      * The initial read callback for SSL connections and perform
      * client certificate verification, authentication and authorization
@@ -1097,6 +1259,21 @@ protected:
      * the standard read callback.
      */
     static void ssl_read_callback(bufferevent*, void* ctx);
+
+    /// The options used for all of the bufferevents
+    static constexpr int BuffereventOptions =
+            BEV_OPT_THREADSAFE | BEV_OPT_UNLOCK_CALLBACKS |
+            BEV_OPT_CLOSE_ON_FREE | BEV_OPT_DEFER_CALLBACKS;
+
+    /**
+     * Create the bufferevent for the (plain) connection's socket on the
+     * given event base, with all of our callbacks registered
+     */
+    cb::libevent::unique_bufferevent_ptr createPlainBufferevent(
+            event_base* b);
+
+    /// Register the callbacks counting reads and writes on the bufferevent
+    void addBufferCallbacks(bufferevent* event);
 };
 
 /**
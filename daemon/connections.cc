@@ -23,6 +23,7 @@
 #include <folly/Synchronized.h>
 #include <logger/logger.h>
 #include <nlohmann/json.hpp>
+#include <phosphor/phosphor.h>
 #include <platform/cbassert.h>
 #include <algorithm>
 #include <deque>
@@ -58,6 +59,57 @@ void iterate_thread_connections(FrontEndThread* thread,
     }
 }
 
+bool migrate_thread_connection(FrontEndThread& from,
+                               FrontEndThread& to,
+                               std::chrono::nanoseconds limit) {
+    // Hold the write lock so that nobody may look up the connections of
+    // either thread while the connection moves
+    auto locked = connections.wlock();
+    Connection* candidate = nullptr;
+    std::chrono::nanoseconds candidateTime{0};
+    for (auto* c : *locked) {
+        if (&c->getThread() == &from) {
+            const auto recent = c->getRecentCpuTime();
+            if (recent > candidateTime && recent <= limit &&
+                c->isMigratable()) {
+                candidate = c;
+                candidateTime = recent;
+            }
+        }
+    }
+
+    if (!candidate) {
+        return false;
+    }
+
+    try {
+        candidate->migrate(to);
+    } catch (const std::exception& e) {
+        LOG_WARNING("{}: Failed to move connection from worker thread {} to "
+                    "{}: {}",
+                    candidate->getId(),
+                    from.index,
+                    to.index,
+                    e.what());
+        return false;
+    }
+
+    TRACE_INSTANT2("memcached/rebalance",
+                   "migrate",
+                   "from",
+                   int(from.index),
+                   "to",
+                   int(to.index));
+    LOG_INFO("{}: Moved connection from worker thread {} to {} (used {}us)",
+             candidate->getId(),
+             from.index,
+             to.index,
+             std::chrono::duration_cast<std::chrono::microseconds>(
+                     candidateTime)
+                     .count());
+    return true;
+}
+
 Connection* conn_new(SOCKET sfd,
                      const ListeningPort& interface,
                      struct event_base* base,
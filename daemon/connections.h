@@ -21,6 +21,7 @@
  */
 #include "memcached.h"
 
+#include <chrono>
 #include <functional>
 
 struct FrontEndThread;
@@ -69,3 +70,22 @@ int signal_idle_clients(FrontEndThread& me, bool dumpConnection);
  */
 void iterate_thread_connections(FrontEndThread* thread,
                                 std::function<void(Connection&)> callback);
+
+/**
+ * Move one of the connections bound to a thread to another thread, to even
+ * out the load between them. Pick the migratable connection which used
+ * the most CPU time since the previous call for the thread, without
+ * exceeding the given limit (moving more than half of the difference in
+ * load between the threads would just move the imbalance).
+ *
+ * Must be called from the thread the connections are bound to, with the
+ * thread locked.
+ *
+ * @param from the thread to move a connection from
+ * @param to the thread to move it to
+ * @param limit the max CPU time of the connection to move
+ * @return true if a connection was moved
+ */
+bool migrate_thread_connection(FrontEndThread& from,
+                               FrontEndThread& to,
+                               std::chrono::nanoseconds limit);
@@ -51,7 +51,7 @@ struct FrontEndThread {
     /**
      * Destructor.
      *
-     * Close the notification pipe (if open)
+     * Close the notification channel (if open)
      */
     ~FrontEndThread();
 
@@ -61,18 +61,27 @@ struct FrontEndThread {
     /// libevent handle this thread uses
     struct event_base* base = nullptr;
 
-    /// listen event for notify pipe
+    /// listen event for the notification channel
     struct event notify_event = {};
 
     /**
-     * notification pipe.
+     * notification channel.
      *
      * The various worker threads are listening on index 0,
      * and in order to notify the thread other threads will
-     * write data to index 1.
+     * write data to index 1. On Linux this is an eventfd (and both
+     * entries hold the same descriptor), elsewhere a socketpair.
      */
     SOCKET notify[2] = {INVALID_SOCKET, INVALID_SOCKET};
 
+    /**
+     * Set by the first notify_thread() since the thread last drained its
+     * notification channel. Until the thread drains it again it is already
+     * going to wake up, so further notifications (e.g. a burst of bg-fetch
+     * completions for different connections) don't touch the channel.
+     */
+    std::atomic_bool notificationPending{false};
+
     /**
      * The dispatcher accepts new clients and needs to dispatch them
      * to the worker threads. In order to do so we use the ConnectionQueue
@@ -115,6 +124,10 @@ struct FrontEndThread {
     /// index of this thread in the threads array
     size_t index = 0;
 
+    /// NUMA node (index) this thread is bound to, or -1 if unbound. See
+    /// MEMCACHED_NUMA_BIND_THREADS.
+    int numaNode = -1;
+
     /**
      * Shared sub-document operation for all connections serviced by this
      * thread
@@ -130,6 +143,17 @@ struct FrontEndThread {
     /// Is the thread running or not
     std::atomic_bool running{false};
 
+    /// The total time (in ns) the thread spent serving its connections,
+    /// sampled by the rebalancer (see thread_rebalance_interval)
+    std::atomic<uint64_t> busyTime{0};
+
+    /// Set by the rebalancer to request the thread to move one of its
+    /// connections to another (less loaded) thread
+    std::atomic<FrontEndThread*> migrateTo{nullptr};
+
+    /// The max CPU time (in ns) used by the connection to move
+    std::atomic<uint64_t> migrateLimit{0};
+
     /// A temporary buffer the connections may utilize (never expect anything
     /// about the content of the buffer (expect it to be overwritten when your
     /// method returns) (It is currently big enough to keep a protocol
@@ -150,6 +174,7 @@ struct FrontEndThread {
     time_t shutdown_next_log = 0;
 };
 
+bool create_notification_channel(FrontEndThread& thread);
 void notify_thread(FrontEndThread& thread);
 void notify_dispatcher();
-void drain_notification_channel(evutil_socket_t fd);
+void drain_notification_channel(FrontEndThread& thread);
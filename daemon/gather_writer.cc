@@ -0,0 +1,171 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "gather_writer.h"
+
+#include "sendbuffer.h"
+
+#include <event2/buffer.h>
+
+#include <new>
+#include <stdexcept>
+
+GatherWriter::GatherWriter() = default;
+
+GatherWriter::~GatherWriter() = default;
+
+void GatherWriter::copy(std::string_view data) {
+    if (data.empty()) {
+        return;
+    }
+
+    const auto offset = copied.size();
+    copied.insert(copied.end(), data.begin(), data.end());
+    append(offset, data.size());
+}
+
+cb::char_buffer GatherWriter::reserve(size_t size) {
+    reserved = copied.size();
+    copied.resize(reserved + size);
+    return {copied.data() + reserved, size};
+}
+
+void GatherWriter::commit(size_t size) {
+    if (reserved + size > copied.size()) {
+        throw std::logic_error(
+                "GatherWriter::commit: size exceeds the reserved space");
+    }
+    copied.resize(reserved + size);
+    if (size > 0) {
+        append(reserved, size);
+    }
+}
+
+void GatherWriter::append(size_t offset, size_t size) {
+    // Extend the previous segment if it is the end of the copied data
+    if (!empty() && !segments.back().buffer &&
+        segments.back().offset + segments.back().size == offset) {
+        segments.back().size += size;
+    } else {
+        segments.push_back({offset, size, {}});
+    }
+    bytes += size;
+}
+
+void GatherWriter::reference(std::unique_ptr<SendBuffer> buffer) {
+    const auto size = buffer->getPayload().size();
+    if (size == 0) {
+        return;
+    }
+    segments.push_back({0, size, std::move(buffer)});
+    bytes += size;
+}
+
+std::string_view GatherWriter::getData(size_t index) const {
+    const auto& segment = segments[index];
+    std::string_view data;
+    if (segment.buffer) {
+        data = segment.buffer->getPayload();
+    } else {
+        data = {copied.data() + segment.offset, segment.size};
+    }
+    if (index == first) {
+        data.remove_prefix(written);
+    }
+    return data;
+}
+
+size_t GatherWriter::write(SOCKET sock) {
+    size_t syscalls = 0;
+    while (!empty()) {
+        iov.clear();
+        size_t nbytes = 0;
+        for (auto ii = first; ii < segments.size() && iov.size() < MaxIovecs;
+             ++ii) {
+            auto data = getData(ii);
+            iov.push_back({const_cast<char*>(data.data()), data.size()});
+            nbytes += data.size();
+        }
+
+        // sendmsg() doesn't change the iovecs, but as a C API it doesn't
+        // take them as const.
+        msghdr msg{};
+        msg.msg_iov = iov.data();
+        msg.msg_iovlen = int(iov.size());
+        const auto nw = cb::net::sendmsg(sock, &msg, 0);
+        if (nw <= 0) {
+            break;
+        }
+        ++syscalls;
+        consume(nw);
+        if (size_t(nw) < nbytes) {
+            // The socket is full
+            break;
+        }
+    }
+    return syscalls;
+}
+
+void GatherWriter::consume(size_t nbytes) {
+    bytes -= nbytes;
+    while (nbytes > 0) {
+        const auto remaining = segments[first].size - written;
+        if (nbytes < remaining) {
+            written += nbytes;
+            return;
+        }
+        nbytes -= remaining;
+        segments[first].buffer.reset();
+        ++first;
+        written = 0;
+    }
+    if (empty()) {
+        clear();
+    }
+}
+
+void GatherWriter::spill(evbuffer* output) {
+    for (; !empty(); ++first, written = 0) {
+        const auto data = getData(first);
+        auto& buffer = segments[first].buffer;
+        if (!buffer) {
+            if (evbuffer_add(output, data.data(), data.size()) == -1) {
+                throw std::bad_alloc();
+            }
+        } else {
+            if (evbuffer_add_reference(output,
+                                       data.data(),
+                                       data.size(),
+                                       SendBuffer::cleanup,
+                                       buffer.get()) == -1) {
+                throw std::bad_alloc();
+            }
+            // Now owned by the evbuffer (see SendBuffer::cleanup)
+            (void)buffer.release();
+        }
+    }
+    clear();
+}
+
+void GatherWriter::clear() {
+    // Keep the capacity for the next round of output
+    copied.clear();
+    reserved = 0;
+    segments.clear();
+    first = 0;
+    written = 0;
+    bytes = 0;
+}
@@ -0,0 +1,125 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <platform/sized_buffer.h>
+#include <platform/socket.h>
+
+#include <memory>
+#include <string_view>
+#include <vector>
+
+class SendBuffer;
+struct evbuffer;
+
+/**
+ * The output of a plain connection, gathered to be sent with sendmsg():
+ * data copied into a buffer owned by the writer, interleaved with data
+ * referenced via a SendBuffer (e.g. an item's value).
+ *
+ * Adding a value to the bufferevent's evbuffer by reference costs an
+ * evbuffer chain for the value and another for whatever follows it, which
+ * is more than copying values up to ~4k. Here a referenced value only costs
+ * an iovec, so values of any size can be sent without copying them.
+ *
+ * Whatever the socket doesn't accept is moved to the bufferevent's output
+ * (see spill()) to be sent once the socket is writable.
+ */
+class GatherWriter {
+public:
+    GatherWriter();
+    ~GatherWriter();
+
+    bool empty() const {
+        return first == segments.size();
+    }
+
+    /// @return the number of bytes not yet written.
+    size_t size() const {
+        return bytes;
+    }
+
+    /// Copy the data to the end of the output.
+    void copy(std::string_view data);
+
+    /**
+     * Reserve space at the end of the output for the caller to encode data
+     * into, rather than encoding it elsewhere and copying it. The space is
+     * only valid until the next call to the writer, and nothing is added to
+     * the output until commit().
+     *
+     * @param size the number of bytes to reserve
+     * @return the reserved space
+     */
+    cb::char_buffer reserve(size_t size);
+
+    /// Add the first size bytes of the space returned by reserve() to the
+    /// end of the output.
+    void commit(size_t size);
+
+    /// Add the data of the buffer to the end of the output by reference. The
+    /// buffer is released once the data has been written (or spilled).
+    void reference(std::unique_ptr<SendBuffer> buffer);
+
+    /**
+     * Write as much of the output to the socket as it accepts, without
+     * blocking. Errors (including EAGAIN) are left for the bufferevent to
+     * pick up when sending the rest after a spill().
+     *
+     * @return the number of sendmsg() calls which sent data.
+     */
+    size_t write(SOCKET sock);
+
+    /// Move the output not yet written to the end of the given evbuffer.
+    void spill(evbuffer* output);
+
+private:
+    struct Segment {
+        /// Offset of the data in `copied` (if buffer is not set)
+        size_t offset;
+        size_t size;
+        std::unique_ptr<SendBuffer> buffer;
+    };
+
+    /// @return the data of the given segment not yet written.
+    std::string_view getData(size_t index) const;
+
+    /// Drop the first nbytes of the output (which have been written).
+    void consume(size_t nbytes);
+
+    /// Add size bytes of `copied` at the given offset to the end of the
+    /// output.
+    void append(size_t offset, size_t size);
+
+    void clear();
+
+    /// The maximum number of iovecs passed to a single sendmsg()
+    static constexpr size_t MaxIovecs = 256;
+
+    std::vector<char> copied;
+    /// Offset in `copied` of the space returned by reserve()
+    size_t reserved = 0;
+    std::vector<Segment> segments;
+    /// Index of the first segment not written
+    size_t first = 0;
+    /// Number of bytes of segments[first] already written
+    size_t written = 0;
+    /// Number of bytes not yet written
+    size_t bytes = 0;
+    /// Reused for each sendmsg()
+    std::vector<iovec> iov;
+};
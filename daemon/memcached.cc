@@ -624,6 +624,7 @@ static nlohmann::json get_bucket_details_UNLOCKED(const Bucket& bucket,
             json["index"] = idx;
             json["state"] = to_string(bucket.state.load());
             json["clients"] = bucket.clients;
+            json["send_buffers"] = bucket.sendBuffers.load();
             json["name"] = bucket.name;
             json["type"] = to_string(bucket.type);
         } catch (const std::exception& e) {
@@ -735,9 +736,9 @@ void listen_event_handler(evutil_socket_t, short, void *arg) {
     }
 }
 
-static void dispatch_event_handler(evutil_socket_t fd, short, void *) {
-    // Start by draining the notification pipe fist
-    drain_notification_channel(fd);
+static void dispatch_event_handler(evutil_socket_t, short, void* arg) {
+    // Start by draining the notification channel first
+    drain_notification_channel(*reinterpret_cast<FrontEndThread*>(arg));
     if (check_listen_conn) {
         invalidateSslCache();
         check_listen_conn = false;
@@ -1447,7 +1448,12 @@ void DestroyBucketThread::destroy() {
     auto& bucket = all_buckets[idx];
     {
         std::unique_lock<std::mutex> guard(bucket.mutex);
-        if (bucket.clients > 0) {
+        // Items held in send buffers must also be released before the
+        // engine is destroyed.
+        const auto inUse = [&bucket] {
+            return bucket.clients > 0 || bucket.sendBuffers > 0;
+        };
+        if (inUse()) {
             LOG_INFO("{} Delete bucket [{}]. Wait for {} clients to disconnect",
                      connection_id,
                      name,
@@ -1480,12 +1486,11 @@ void DestroyBucketThread::destroy() {
         //          changed since the previous dump.
         //       3. goto 2.
         //
-        while (bucket.clients > 0) {
-            bucket.cond.wait_for(guard, seconds(1), [&bucket] {
-                return bucket.clients == 0;
-            });
+        while (inUse()) {
+            bucket.cond.wait_for(
+                    guard, seconds(1), [&inUse] { return !inUse(); });
 
-            if (bucket.clients == 0) {
+            if (!inUse()) {
                 break;
             }
 
@@ -126,7 +126,7 @@ ENGINE_ERROR_CODE GatCommandContext::sendResponse() {
     cookie.setCas(info.cas);
 
     std::unique_ptr<SendBuffer> sendbuffer;
-    if (payload.size() > SendBuffer::MinimumDataSize) {
+    if (connection.useSendBuffer(payload.size())) {
         // we may use the item if we've didn't inflate it
         if (buffer.empty()) {
             sendbuffer = std::make_unique<ItemSendBuffer>(
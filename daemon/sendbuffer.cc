@@ -18,6 +18,10 @@
 
 #include "buckets.h"
 
+void SendBuffer::cleanup(const void*, size_t, void* extra) {
+    delete reinterpret_cast<SendBuffer*>(extra);
+}
+
 ItemSendBuffer::ItemSendBuffer(cb::unique_item_ptr itm,
                                std::string_view view,
                                Bucket& bucket)
@@ -25,16 +29,19 @@ ItemSendBuffer::ItemSendBuffer(cb::unique_item_ptr itm,
     // We need to bump a reference to the bucket, because if we try to tear
     // down the bucket and disconnect clients it might try to release the
     // objects _AFTER_ the bucket started its deletion (because we decrement
-    // the reference
-    std::lock_guard<std::mutex> guard(bucket.mutex);
-    bucket.clients++;
+    // the reference). This is done for every value sent by reference, so
+    // use the atomic counter rather than bucket.mutex.
+    bucket.sendBuffers++;
 }
 
 ItemSendBuffer::~ItemSendBuffer() {
     item.reset();
-    std::lock_guard<std::mutex> guard(bucket.mutex);
-    bucket.clients--;
-    if (bucket.clients == 0 && bucket.state == Bucket::State::Destroying) {
+    // The deleter sets the state before checking sendBuffers (both
+    // sequentially consistent), so if it may be waiting on us we see the
+    // state and must wake it (holding the mutex so it can't miss it).
+    if (--bucket.sendBuffers == 0 &&
+        bucket.state == Bucket::State::Destroying) {
+        std::lock_guard<std::mutex> guard(bucket.mutex);
         bucket.cond.notify_one();
     }
 }
@@ -33,7 +33,14 @@ public:
     /// system call (for TLS it gets even worse as it'll result in multiple
     /// TLS frames which add extra CPU cycles and network overhead)
     ///.
-    /// A sendbuffer should not be used unless the payload is >4k
+    /// Each value referenced from an evbuffer also costs an evbuffer chain
+    /// (and a new chain for whatever is added after it), which is more
+    /// expensive than copying the value up to ~4k (see
+    /// tests/mcbp/sendbuffer_bench.cc).
+    ///
+    /// A sendbuffer should not be added to an evbuffer unless the payload
+    /// is >4k. (Plain connections gather their output for sendmsg instead,
+    /// see GatherWriter, where this doesn't apply.)
     constexpr static std::size_t MinimumDataSize = 4096;
 
     explicit SendBuffer(std::string_view view) : payload(view) {
@@ -43,6 +50,10 @@ public:
         return payload;
     }
 
+    /// Cleanup function for evbuffer_add_reference() deleting the
+    /// SendBuffer passed as its argument.
+    static void cleanup(const void*, size_t, void* extra);
+
 protected:
     std::string_view payload;
 };
@@ -50,7 +61,9 @@ protected:
 /**
  * Specialized send buffer which holds an item which needs to be
  * released once libevent is done sending any data held by the
- * object.
+ * object. Holding the item keeps its value (e.g. ep-engine's Blob) alive
+ * without copying it, and the bucket is pinned (see Bucket::sendBuffers)
+ * until the item is released.
  */
 class ItemSendBuffer : public SendBuffer {
 public:
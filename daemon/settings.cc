@@ -309,6 +309,39 @@ static void handle_connection_idle_time(Settings& s,
     s.setConnectionIdleTime(obj.get<unsigned int>());
 }
 
+/**
+ * Handle the "sched_time_budget" tag in the settings
+ *
+ *  The value must be a numeric value
+ *
+ * @param s the settings object to update
+ * @param obj the object in the configuration
+ */
+static void handle_sched_time_budget(Settings& s, const nlohmann::json& obj) {
+    if (!obj.is_number_unsigned()) {
+        cb::throwJsonTypeError(
+                R"("sched_time_budget" must be an unsigned number)");
+    }
+    s.setSchedTimeBudget(obj.get<size_t>());
+}
+
+/**
+ * Handle the "thread_rebalance_interval" tag in the settings
+ *
+ *  The value must be a numeric value
+ *
+ * @param s the settings object to update
+ * @param obj the object in the configuration
+ */
+static void handle_thread_rebalance_interval(Settings& s,
+                                             const nlohmann::json& obj) {
+    if (!obj.is_number_unsigned()) {
+        cb::throwJsonTypeError(
+                R"("thread_rebalance_interval" must be an unsigned number)");
+    }
+    s.setThreadRebalanceInterval(obj.get<size_t>());
+}
+
 /**
  * Handle the "datatype_snappy" tag in the settings
  *
@@ -689,6 +722,8 @@ void Settings::reconfigure(const nlohmann::json& json) {
             {"reqs_per_event_low_priority", handle_low_reqs_event},
             {"verbosity", handle_verbosity},
             {"connection_idle_time", handle_connection_idle_time},
+            {"sched_time_budget", handle_sched_time_budget},
+            {"thread_rebalance_interval", handle_thread_rebalance_interval},
             {"datatype_json", handle_datatype_json},
             {"datatype_snappy", handle_datatype_snappy},
             {"root", handle_root},
@@ -904,6 +939,22 @@ void Settings::updateSettings(const Settings& other, bool apply) {
             setConnectionIdleTime(other.connection_idle_time);
         }
     }
+    if (other.has.sched_time_budget) {
+        if (other.sched_time_budget != sched_time_budget) {
+            LOG_INFO("Change sched time budget from {}us to {}us",
+                     sched_time_budget.load(),
+                     other.sched_time_budget.load());
+            setSchedTimeBudget(other.sched_time_budget);
+        }
+    }
+    if (other.has.thread_rebalance_interval) {
+        if (other.thread_rebalance_interval != thread_rebalance_interval) {
+            LOG_INFO("Change thread rebalance interval from {}s to {}s",
+                     thread_rebalance_interval.load(),
+                     other.thread_rebalance_interval.load());
+            setThreadRebalanceInterval(other.thread_rebalance_interval);
+        }
+    }
     if (other.has.max_packet_size) {
         if (other.max_packet_size != max_packet_size) {
             LOG_INFO("Change max packet size from {} to {}",
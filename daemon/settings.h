@@ -293,6 +293,48 @@ public:
         notify_changed("connection_idle_time");
     }
 
+    /**
+     * Get the CPU time a connection should get on the worker thread
+     * before yielding to the other connections bound to the thread. The
+     * number of requests it may execute per time slice is adjusted to fit
+     * the budget given the measured cost of its requests (see
+     * Connection::getRequestsPerSlice()).
+     *
+     * @return the budget in microseconds, or 0 to use the (static)
+     *         reqs_per_event settings
+     */
+    size_t getSchedTimeBudget() const {
+        return sched_time_budget;
+    }
+
+    /**
+     * Set the CPU time budget of a connection's time slice
+     *
+     * @param value the number of microseconds, or 0 to disable
+     */
+    void setSchedTimeBudget(size_t value) {
+        sched_time_budget = value;
+        has.sched_time_budget = true;
+        notify_changed("sched_time_budget");
+    }
+
+    /**
+     * Get the interval between checks for imbalance in the load of the
+     * front end threads. Every interval the busiest thread may move one
+     * of its idle connections to the least busy thread.
+     *
+     * @return the interval in seconds, or 0 if disabled
+     */
+    size_t getThreadRebalanceInterval() const {
+        return thread_rebalance_interval;
+    }
+
+    void setThreadRebalanceInterval(size_t value) {
+        thread_rebalance_interval = value;
+        has.thread_rebalance_interval = true;
+        notify_changed("thread_rebalance_interval");
+    }
+
     /**
      * Get the root directory of the couchbase installation
      *
@@ -885,6 +927,18 @@ protected:
      */
     cb::RelaxedAtomic<size_t> connection_idle_time{0};
 
+    /**
+     * The CPU time (in microseconds) a connection may spend per time
+     * slice, or 0 to use reqs_per_event
+     */
+    cb::RelaxedAtomic<size_t> sched_time_budget{0};
+
+    /**
+     * The interval (in seconds) between rebalancing connections between
+     * the front end threads, or 0 to disable
+     */
+    cb::RelaxedAtomic<size_t> thread_rebalance_interval{0};
+
     /**
      * The root directory of the installation
      */
@@ -1060,6 +1114,8 @@ public:
         bool default_reqs_per_event = false;
         bool verbose = false;
         bool connection_idle_time = false;
+        bool sched_time_budget = false;
+        bool thread_rebalance_interval = false;
         bool datatype_json = false;
         bool datatype_snappy = false;
         bool root = false;
@@ -13,6 +13,7 @@
 #include "stats.h"
 #include "tracing.h"
 #include <utilities/hdrhistogram.h>
+#include <utilities/numa_topology.h>
 
 #include <nlohmann/json.hpp>
 #include <openssl/conf.h>
@@ -26,6 +27,10 @@
 #include <cstring>
 #ifndef WIN32
 #include <netinet/tcp.h> // For TCP_NODELAY etc
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
 #endif
 #include <mutex>
 #include <queue>
@@ -120,7 +125,16 @@ void iterate_all_connections(std::function<void(Connection&)> callback) {
     }
 }
 
-static bool create_notification_pipe(FrontEndThread& me) {
+bool create_notification_channel(FrontEndThread& me) {
+#ifdef __linux__
+    const int efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (efd == -1) {
+        LOG_WARNING("Can't create notify eventfd: {}", cb_strerror(errno));
+        return false;
+    }
+    me.notify[0] = me.notify[1] = efd;
+    return true;
+#else
     if (cb::net::socketpair(SOCKETPAIR_AF,
                             SOCK_STREAM,
                             0,
@@ -146,6 +160,7 @@ static bool create_notification_pipe(FrontEndThread& me) {
         }
     }
     return true;
+#endif
 }
 
 static void setup_dispatcher(struct event_base *main_base,
@@ -153,8 +168,8 @@ static void setup_dispatcher(struct event_base *main_base,
 {
     dispatcher_thread.base = main_base;
 	dispatcher_thread.thread_id = cb_thread_self();
-        if (!create_notification_pipe(dispatcher_thread)) {
-            FATAL_ERROR(EXIT_FAILURE, "Unable to create notification pipe");
+        if (!create_notification_channel(dispatcher_thread)) {
+            FATAL_ERROR(EXIT_FAILURE, "Unable to create notification channel");
     }
 
     /* Listen for notifications from other threads */
@@ -163,7 +178,7 @@ static void setup_dispatcher(struct event_base *main_base,
                       dispatcher_thread.notify[0],
                       EV_READ | EV_PERSIST,
                       dispatcher_callback,
-                      nullptr) == -1) ||
+                      &dispatcher_thread) == -1) ||
         (event_add(&dispatcher_thread.notify_event, nullptr) == -1)) {
         FATAL_ERROR(EXIT_FAILURE, "Can't monitor libevent notify pipe");
     }
@@ -200,6 +215,18 @@ static void worker_libevent(void *arg) {
 
     // Any per-thread setup can happen here; thread_init() will block until
     // all threads have finished initializing.
+    if (me.numaNode >= 0) {
+        if (cb::numa::bindCurrentThreadToNode(me.numaNode)) {
+            LOG_INFO("Bound worker thread {} to NUMA node {}",
+                     me.index,
+                     me.numaNode);
+        } else {
+            LOG_WARNING("Failed to bind worker thread {} to NUMA node {}",
+                        me.index,
+                        me.numaNode);
+            me.numaNode = -1;
+        }
+    }
     {
         std::lock_guard<std::mutex> guard(init_mutex);
         me.running = true;
@@ -211,28 +238,39 @@ static void worker_libevent(void *arg) {
     me.running = false;
 }
 
-void drain_notification_channel(evutil_socket_t fd) {
-    /* Every time we want to notify a thread, we send 1 byte to its
-     * notification pipe. When the thread wakes up, it tries to drain
-     * it's notification channel before executing any other events.
-     * Other threads (listener and other background threads) may notify
-     * this thread up to 512 times since the last time we checked the
-     * notification pipe, before we'll start draining the it again.
+void drain_notification_channel(FrontEndThread& me) {
+    /* Every time we want to notify a thread which hasn't already been
+     * notified, we write to its notification channel. When the thread
+     * wakes up, it tries to drain it's notification channel before
+     * executing any other events (and then clears notificationPending so
+     * that the next notification wakes it up again).
      */
-
+#ifdef __linux__
+    // Reading an eventfd returns (and resets) the number of writes
+    uint64_t count;
+    if (read(me.notify[0], &count, sizeof(count)) == -1 && errno != EAGAIN) {
+        LOG_WARNING("Can't read from notify eventfd: {}", cb_strerror(errno));
+    }
+#else
     ssize_t nread;
     // Using a small size for devnull will avoid blowing up the stack
     char devnull[512];
 
-    while ((nread = cb::net::recv(fd, devnull, sizeof(devnull), 0)) ==
+    while ((nread = cb::net::recv(
+                    me.notify[0], devnull, sizeof(devnull), 0)) ==
            (int)sizeof(devnull)) {
         /* empty */
     }
 
-    if (nread == -1) {
+    if (nread == -1 && !cb::net::is_blocking(cb::net::get_socket_error())) {
         LOG_WARNING("Can't read from libevent pipe: {}",
                     cb_strerror(cb::net::get_socket_error()));
     }
+#endif
+
+    // Anyone who notifies us after this will write to the channel; anyone
+    // who did before has already queued their work for us to pick up.
+    me.notificationPending = false;
 }
 
 static void dispatch_new_connections(FrontEndThread& me) {
@@ -253,7 +291,7 @@ static void dispatch_new_connections(FrontEndThread& me) {
  * Processes an incoming "handle a new connection" item. This is called when
  * input arrives on the libevent wakeup pipe.
  */
-static void thread_libevent_process(evutil_socket_t fd, short, void* arg) {
+static void thread_libevent_process(evutil_socket_t, short, void* arg) {
     auto& me = *reinterpret_cast<FrontEndThread*>(arg);
 
     // Start by draining the notification channel before doing any work.
@@ -261,7 +299,7 @@ static void thread_libevent_process(evutil_socket_t fd, short, void* arg) {
     // tries to notify us while we're doing the work below (so we don't have
     // to care about race conditions for stuff people try to notify us
     // about.
-    drain_notification_channel(fd);
+    drain_notification_channel(me);
 
     if (memcached_shutdown) {
         if (signal_idle_clients(me, false) == 0) {
@@ -284,6 +322,12 @@ static void thread_libevent_process(evutil_socket_t fd, short, void* arg) {
                           "thread_libevent_process::threadLock",
                           SlowMutexThreshold);
 
+    auto* migrateTo = me.migrateTo.exchange(nullptr);
+    if (migrateTo && !memcached_shutdown) {
+        migrate_thread_connection(
+                me, *migrateTo, std::chrono::nanoseconds(me.migrateLimit));
+    }
+
     std::vector<Connection*> notify;
     me.notification.swap(notify);
 
@@ -385,6 +429,94 @@ void notify_dispatcher() {
     }
 }
 
+/*************************** CONNECTION REBALANCING ***************************/
+
+/// Timer on the dispatcher thread looking for imbalance in the load of
+/// the worker threads
+static struct event rebalance_event;
+/// Seconds since the last rebalance
+static size_t rebalance_ticks = 0;
+/// The busy time of each worker thread at the last rebalance
+static std::vector<uint64_t> rebalance_busy_time;
+
+/*
+ * Look at how busy each worker thread was since the previous call, and if
+ * the load is skewed ask the busiest thread to move a connection to the
+ * least busy one. The busiest thread picks (and moves) the connection
+ * itself the next time it runs thread_libevent_process, as it is the only
+ * thread which may touch its connections.
+ */
+static void rebalance_threads(std::chrono::seconds interval) {
+    if (rebalance_busy_time.size() != threads.size()) {
+        rebalance_busy_time.resize(threads.size());
+    }
+
+    size_t busiest = 0;
+    size_t idlest = 0;
+    std::vector<uint64_t> delta(threads.size());
+    for (size_t ii = 0; ii < threads.size(); ++ii) {
+        const uint64_t busy = threads[ii].busyTime;
+        delta[ii] = busy - rebalance_busy_time[ii];
+        rebalance_busy_time[ii] = busy;
+        if (delta[ii] > delta[busiest]) {
+            busiest = ii;
+        }
+        if (delta[ii] < delta[idlest]) {
+            idlest = ii;
+        }
+    }
+
+    const auto intervalNs = uint64_t(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(interval)
+                    .count());
+    if (busiest == idlest || delta[busiest] < intervalNs / 4 ||
+        delta[busiest] <= 2 * delta[idlest]) {
+        return;
+    }
+
+    auto& from = threads[busiest];
+    // Moving more than half of the difference would just swap the threads
+    from.migrateLimit = (delta[busiest] - delta[idlest]) / 2;
+    from.migrateTo = &threads[idlest];
+    notify_thread(from);
+}
+
+static void rebalance_callback(evutil_socket_t, short, void*) {
+    const auto interval = Settings::instance().getThreadRebalanceInterval();
+    if (interval == 0 || threads.size() < 2 || memcached_shutdown) {
+        rebalance_ticks = 0;
+        rebalance_busy_time.clear();
+        return;
+    }
+
+    if (++rebalance_ticks < interval) {
+        return;
+    }
+    rebalance_ticks = 0;
+
+    if (rebalance_busy_time.empty()) {
+        // First interval after being enabled; just take the baseline
+        for (const auto& thr : threads) {
+            rebalance_busy_time.push_back(thr.busyTime);
+        }
+        return;
+    }
+    rebalance_threads(std::chrono::seconds(interval));
+}
+
+static void setup_rebalancer(struct event_base* main_base) {
+    const struct timeval tick = {1, 0};
+    if (event_assign(&rebalance_event,
+                     main_base,
+                     -1,
+                     EV_PERSIST,
+                     rebalance_callback,
+                     nullptr) == -1 ||
+        event_add(&rebalance_event, &tick) == -1) {
+        FATAL_ERROR(EXIT_FAILURE, "Can't add thread rebalance timer");
+    }
+}
+
 /******************************* GLOBAL STATS ******************************/
 
 void threadlocal_stats_reset(std::vector<thread_stats>& thread_stats) {
@@ -411,12 +543,20 @@ void thread_init(size_t nthr,
     }
 
     setup_dispatcher(main_base, dispatcher_callback);
+    setup_rebalancer(main_base);
+
+    const auto& numa = cb::numa::Topology::get();
+    const bool bindToNuma =
+            getenv("MEMCACHED_NUMA_BIND_THREADS") != nullptr && numa.isNuma();
 
     for (size_t ii = 0; ii < nthr; ii++) {
-        if (!create_notification_pipe(threads[ii])) {
-            FATAL_ERROR(EXIT_FAILURE, "Cannot create notification pipe");
+        if (!create_notification_channel(threads[ii])) {
+            FATAL_ERROR(EXIT_FAILURE, "Cannot create notification channel");
         }
         threads[ii].index = ii;
+        if (bindToNuma) {
+            threads[ii].numaNode = int(ii % numa.getNumNodes());
+        }
 
         setup_thread(threads[ii]);
     }
@@ -434,6 +574,8 @@ void thread_init(size_t nthr,
 }
 
 void threads_shutdown() {
+    event_del(&rebalance_event);
+
     // Notify all of the threads and let them shut down
     for (auto& thread : threads) {
         notify_thread(thread);
@@ -460,19 +602,41 @@ void threads_cleanup() {
 }
 
 FrontEndThread::~FrontEndThread() {
+#ifdef __linux__
+    if (notify[0] != INVALID_SOCKET) {
+        close(notify[0]);
+    }
+#else
     for (auto& sock : notify) {
         if (sock != INVALID_SOCKET) {
             safe_close(sock);
         }
     }
+#endif
 }
 
 void notify_thread(FrontEndThread& thread) {
+    if (thread.notificationPending.exchange(true)) {
+        // Already notified, and it hasn't drained the channel yet
+        return;
+    }
+
+#ifdef __linux__
+    const uint64_t one = 1;
+    if (write(thread.notify[1], &one, sizeof(one)) == -1 && errno != EAGAIN) {
+        LOG_WARNING("Failed to notify thread: {}", cb_strerror(errno));
+        // Nothing was written, so let the next notify try again rather
+        // than leaving the thread waiting for a notification never sent
+        thread.notificationPending = false;
+    }
+#else
     if (cb::net::send(thread.notify[1], "", 1, 0) != 1 &&
         !cb::net::is_blocking(cb::net::get_socket_error())) {
         LOG_WARNING("Failed to notify thread: {}",
                     cb_strerror(cb::net::get_socket_error()));
+        thread.notificationPending = false;
     }
+#endif
 }
 
 int add_conn_to_pending_io_list(Connection* c,
@@ -21,8 +21,10 @@
 
 #include "atomic.h"
 #include "checkpoint_iterator.h"
+#include "chunked_queue.h"
 
 #include <benchmark/benchmark.h>
+#include <utilities/memory_tracking_allocator.h>
 #include <list>
 
 typedef std::unique_ptr<int> TestItem;
@@ -59,3 +61,45 @@ static void BM_CheckpointIteratorCompare(benchmark::State& state) {
 
 // Register the function as a benchmark
 BENCHMARK(BM_CheckpointIteratorCompare);
+
+typedef std::list<TestItem, MemoryTrackingAllocator<TestItem>>
+        TrackedListContainer;
+typedef ChunkedQueue<TestItem, MemoryTrackingAllocator<TestItem>>
+        ChunkedContainer;
+
+/**
+ * Benchmark walking every item of a container via a CheckpointIterator, as a
+ * cursor does when fetching items from a checkpoint. Compares the previous
+ * CheckpointQueue container (std::list) with the chunked one, and reports the
+ * memory used by the container (excluding the items) per item.
+ */
+template <typename Container>
+static void BM_CheckpointIteratorWalk(benchmark::State& state) {
+    const auto numItems = size_t(state.range(0));
+    MemoryTrackingAllocator<TestItem> allocator;
+    Container c(allocator);
+    for (size_t ii = 0; ii < numItems; ++ii) {
+        c.push_back(std::make_unique<int>(ii));
+    }
+
+    const CheckpointIterator<Container> end(
+            c, CheckpointIterator<Container>::Position::end);
+    while (state.KeepRunning()) {
+        int64_t sum = 0;
+        for (CheckpointIterator<Container> it(
+                     c, CheckpointIterator<Container>::Position::begin);
+             it != end;
+             ++it) {
+            sum += **it;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * numItems);
+    state.counters["BytesPerItem"] =
+            double(*allocator.getBytesAllocated()) / numItems;
+}
+
+BENCHMARK_TEMPLATE(BM_CheckpointIteratorWalk, TrackedListContainer)
+        ->Range(1000, 100000);
+BENCHMARK_TEMPLATE(BM_CheckpointIteratorWalk, ChunkedContainer)
+        ->Range(1000, 100000);
@@ -0,0 +1,165 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Benchmarks of a replica catching up: a DcpConsumer applying the mutations
+ * buffered for all of its vBuckets, which are spread over one or more
+ * processors (dcp_consumer_process_buffered_messages_tasks). Each processor
+ * is run on its own thread, as the DcpConsumerTasks are on NONIO threads.
+ */
+
+#include "dcp/passive_stream.h"
+#include "engine_fixture.h"
+#include "kv_bucket.h"
+#include "objectregistry.h"
+#include "stats.h"
+#include "vbucket.h"
+
+#include "../tests/mock/mock_dcp_consumer.h"
+
+#include <thread>
+
+class DcpConsumerBench : public EngineFixture {
+protected:
+    void SetUp(const benchmark::State& state) override {
+        // Keep all of the items in memory
+        varConfig = "max_size=2000000000;max_vbuckets=" +
+                    std::to_string(numVbuckets) +
+                    ";dcp_consumer_process_buffered_messages_tasks=" +
+                    std::to_string(state.range(0));
+        EngineFixture::SetUp(state);
+        if (state.thread_index == 0) {
+            for (uint16_t vb = 0; vb < numVbuckets; ++vb) {
+                engine->getKVBucket()->setVBucketState(Vbid(vb),
+                                                       vbucket_state_replica);
+            }
+        }
+    }
+
+    /**
+     * Create a consumer with a stream for each vBucket, with the given
+     * number of mutations buffered in each stream (following the mutations
+     * of the previous iterations).
+     */
+    std::shared_ptr<MockDcpConsumer> createConsumer(size_t mutations) {
+        auto consumer = std::make_shared<MockDcpConsumer>(
+                *engine, cookie, "DcpConsumerBench");
+
+        // Force the streams to buffer rather than process messages
+        auto& stats = engine->getEpStats();
+        const ssize_t queueCap = stats.replicationThrottleWriteQueueCap;
+        stats.replicationThrottleWriteQueueCap = 0;
+
+        const std::string value(valueSize, 'x');
+        const auto start = lastSeqno + 1;
+        lastSeqno += mutations;
+        for (uint16_t vb = 0; vb < numVbuckets; ++vb) {
+            const Vbid vbid(vb);
+            consumer->addStream(/*opaque*/ 0, vbid, /*flags*/ 0);
+            const auto opaque = consumer->getVbucketStream(vbid)->getOpaque();
+            consumer->snapshotMarker(opaque,
+                                     vbid,
+                                     start,
+                                     lastSeqno,
+                                     /*flags*/ 0,
+                                     /*HCS*/ {},
+                                     /*maxVisibleSeqno*/ {});
+            for (uint64_t seqno = start; seqno <= lastSeqno; ++seqno) {
+                const auto key = "key" + std::to_string(seqno);
+                consumer->mutation(
+                        opaque,
+                        {key, DocKeyEncodesCollectionId::No},
+                        {reinterpret_cast<const uint8_t*>(value.data()),
+                         value.size()},
+                        0, // privileged bytes
+                        PROTOCOL_BINARY_RAW_BYTES, // datatype
+                        0, // cas
+                        vbid,
+                        0, // flags
+                        seqno,
+                        0, // revSeqno
+                        0, // exptime
+                        0, // locktime
+                        {}, // meta
+                        0); // nru
+            }
+            consumer->public_notifyVbucketReady(vbid);
+        }
+
+        stats.replicationThrottleWriteQueueCap = queueCap;
+        return consumer;
+    }
+
+    void destroyConsumer(MockDcpConsumer& consumer) {
+        consumer.closeAllStreams();
+        consumer.cancelTask();
+    }
+
+    /// Apply all the buffered messages of a processor of the consumer
+    static void runProcessor(MockDcpConsumer& consumer, size_t processor) {
+        while (consumer.processBufferedItems(processor) != all_processed) {
+        }
+    }
+
+    const uint16_t numVbuckets = 1024;
+    const size_t valueSize = 256;
+    uint64_t lastSeqno = 0;
+};
+
+/*
+ * Apply the mutations buffered for each vBucket, with all the processors of
+ * the consumer running concurrently.
+ * Variables:
+ *  - range(0) : The number of processors
+ *  - range(1) : The number of mutations per vBucket
+ */
+BENCHMARK_DEFINE_F(DcpConsumerBench, ReplicaCatchUp)(benchmark::State& state) {
+    size_t messages = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto consumer = createConsumer(state.range(1));
+        const auto processors = consumer->getNumProcessors();
+        state.ResumeTiming();
+
+        std::vector<std::thread> threads;
+        for (size_t ii = 1; ii < processors; ++ii) {
+            threads.emplace_back([this, &consumer, ii]() {
+                ObjectRegistry::onSwitchThread(engine.get());
+                runProcessor(*consumer, ii);
+                ObjectRegistry::onSwitchThread(nullptr);
+            });
+        }
+        runProcessor(*consumer, 0);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        state.PauseTiming();
+        messages += numVbuckets * state.range(1);
+        destroyConsumer(*consumer);
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(messages);
+}
+
+BENCHMARK_REGISTER_F(DcpConsumerBench, ReplicaCatchUp)
+        ->Args({1, 100})
+        ->Args({2, 100})
+        ->Args({4, 100})
+        ->Args({8, 100})
+        ->Unit(benchmark::kMillisecond)
+        ->Iterations(5);
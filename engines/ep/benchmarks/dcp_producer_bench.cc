@@ -0,0 +1,155 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Benchmarks of the throughput of a DcpProducer sending in-memory mutations,
+ * driven through the engine's DcpIface one message per step() call, or in
+ * batches with step_batch() (as memcached does).
+ */
+
+#include "engine_fixture.h"
+#include "failover-table.h"
+#include "item.h"
+#include "kv_bucket.h"
+#include "vbucket.h"
+
+#include "../tests/mock/mock_dcp.h"
+#include "../tests/mock/mock_dcp_producer.h"
+#include "../tests/mock/mock_stream.h"
+
+class DcpProducerBench : public EngineFixture {
+protected:
+    void SetUp(const benchmark::State& state) override {
+        // Keep all of the items in memory
+        varConfig = "max_size=1000000000";
+        EngineFixture::SetUp(state);
+        if (state.thread_index == 0) {
+            engine->getKVBucket()->setVBucketState(vbid,
+                                                   vbucket_state_active);
+            const std::string value(state.range(0), 'x');
+            const std::string keyPrefix(20, 'a');
+            for (size_t ii = 0; ii < numItems; ++ii) {
+                auto item = make_item(
+                        vbid, keyPrefix + std::to_string(ii), value);
+                engine->getKVBucket()->set(item, cookie);
+            }
+        }
+    }
+
+    /**
+     * Create a producer (known to the engine as the connection of the
+     * cookie) streaming all the items of the vBucket, with its stream's
+     * readyQ already filled from the checkpoint.
+     */
+    std::shared_ptr<MockDcpProducer> createProducer(benchmark::State& state) {
+        auto producer = std::make_shared<MockDcpProducer>(
+                *engine, cookie, "DcpProducerBench", 0 /*flags*/);
+        auto vb = engine->getKVBucket()->getVBucket(vbid);
+        auto stream = producer->mockActiveStreamRequest(
+                0 /*flags*/,
+                0 /*opaque*/,
+                *vb,
+                0 /*start_seqno*/,
+                ~0 /*end_seqno*/,
+                vb->failovers->getLatestUUID(),
+                0 /*snap_start_seqno*/,
+                ~0 /*snap_end_seqno*/);
+        stream->next();
+        if (!stream->isInMemory()) {
+            state.SkipWithError("DcpProducerBench: stream not in-memory");
+        }
+        for (;;) {
+            auto result = stream->public_getOutstandingItems(*vb);
+            if (result.items.empty()) {
+                break;
+            }
+            stream->public_processItems(result);
+        }
+        engine->storeEngineSpecific(cookie, producer.get());
+        return producer;
+    }
+
+    void destroyProducer(MockDcpProducer& producer) {
+        engine->storeEngineSpecific(cookie, nullptr);
+        producer.closeAllStreams();
+        producer.cancelCheckpointCreatorTask();
+    }
+
+    /**
+     * Stream all the items each iteration, in batches of up to the given
+     * number of bytes (or with step() if zero).
+     */
+    void run(benchmark::State& state, size_t batchBytes) {
+        MockDcpMessageProducers producers(engine.get());
+        size_t messages = 0;
+        size_t calls = 0;
+        for (auto _ : state) {
+            state.PauseTiming();
+            auto producer = createProducer(state);
+            state.ResumeTiming();
+
+            ENGINE_ERROR_CODE ret;
+            do {
+                size_t nmessages = 0;
+                if (batchBytes) {
+                    ret = engine->step_batch(
+                            cookie, &producers, batchBytes, nmessages);
+                } else {
+                    ret = engine->step(cookie, &producers);
+                    nmessages = (ret == ENGINE_SUCCESS) ? 1 : 0;
+                }
+                messages += nmessages;
+                ++calls;
+            } while (ret == ENGINE_SUCCESS);
+
+            state.PauseTiming();
+            destroyProducer(*producer);
+            state.ResumeTiming();
+        }
+        state.SetItemsProcessed(messages);
+        state.counters["messages_per_call"] = double(messages) / calls;
+    }
+
+    const size_t numItems = 10000;
+};
+
+/*
+ * Send all the items with one step() call per message.
+ * Variables:
+ *  - range(0) : The size of the values
+ */
+BENCHMARK_DEFINE_F(DcpProducerBench, Step)(benchmark::State& state) {
+    run(state, 0);
+}
+
+/*
+ * Send all the items with step_batch() calls.
+ * Variables:
+ *  - range(0) : The size of the values
+ *  - range(1) : The (maximum) number of bytes sent per call
+ */
+BENCHMARK_DEFINE_F(DcpProducerBench, StepBatch)(benchmark::State& state) {
+    run(state, state.range(1));
+}
+
+BENCHMARK_REGISTER_F(DcpProducerBench, Step)->Arg(64)->Arg(1024)->Arg(8192);
+BENCHMARK_REGISTER_F(DcpProducerBench, StepBatch)
+        ->Args({64, 4096})
+        ->Args({64, 65536})
+        ->Args({1024, 65536})
+        ->Args({8192, 65536})
+        ->Args({8192, 1048576});
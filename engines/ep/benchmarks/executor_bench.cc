@@ -0,0 +1,312 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Benchmarks relating to the ExecutorPool - scheduling, waking and running
+ * tasks, with and without work stealing between threads; and the
+ * TaskQueue's queue of snoozed tasks with many tasks registered.
+ */
+
+#include "executorpool.h"
+#include "globaltask.h"
+#include "taskable.h"
+#include "taskqueue.h"
+#include "timer_wheel_future_queue.h"
+#include "workload.h"
+
+#include "../tests/module_tests/lambda_task.h"
+
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include <random>
+#include <vector>
+
+class BenchTaskable : public Taskable {
+public:
+    const std::string& getName() const override {
+        return name;
+    }
+
+    task_gid_t getGID() const override {
+        return 0;
+    }
+
+    bucket_priority_t getWorkloadPriority() const override {
+        return HIGH_BUCKET_PRIORITY;
+    }
+
+    void setWorkloadPriority(bucket_priority_t prio) override {
+    }
+
+    WorkLoadPolicy& getWorkLoadPolicy() override {
+        return policy;
+    }
+
+    void logQTime(TaskId id,
+                  const std::chrono::steady_clock::duration enqTime) override {
+    }
+
+    void logRunTime(TaskId id,
+                    const std::chrono::steady_clock::duration runTime) override {
+    }
+
+private:
+    const std::string name{"executor_bench"};
+    WorkLoadPolicy policy{HIGH_BUCKET_PRIORITY, 1};
+};
+
+/// ExecutorPool with only the given number of NonIO threads being exercised.
+class BenchExecutorPool : public ExecutorPool {
+public:
+    BenchExecutorPool(size_t numNonIO, bool workStealing)
+        : ExecutorPool(numNonIO,
+                       NUM_TASK_GROUPS,
+                       ThreadPoolConfig::ThreadCount(1),
+                       ThreadPoolConfig::ThreadCount(1),
+                       1,
+                       numNonIO,
+                       workStealing) {
+    }
+
+    size_t getNumSteals() {
+        LockHolder lh(tMutex);
+        return hpTaskQ[NONIO_TASK_IDX]->getNumSteals();
+    }
+
+    ~BenchExecutorPool() override = default;
+};
+
+/// Lets the benchmark thread wait for a number of tasks to have run.
+class TaskCountdown {
+public:
+    void reset(int count) {
+        remaining = count;
+    }
+
+    void taskRan() {
+        if (--remaining == 0) {
+            std::lock_guard<std::mutex> lh(mutex);
+            cv.notify_one();
+        }
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lh(mutex);
+        cv.wait(lh, [this] { return remaining.load() == 0; });
+    }
+
+private:
+    std::atomic<int> remaining{0};
+    std::mutex mutex;
+    std::condition_variable cv;
+};
+
+/// Task which snoozes "forever" each time it runs.
+class WakeableTask : public GlobalTask {
+public:
+    WakeableTask(Taskable& t, TaskCountdown& countdown)
+        : GlobalTask(t, TaskId::ItemPager, forever, false),
+          countdown(countdown) {
+    }
+
+    bool run() override {
+        // Snooze before signalling, so a wake() issued once all tasks have
+        // run isn't overwritten.
+        snooze(forever);
+        countdown.taskRan();
+        return true;
+    }
+
+    std::string getDescription() override {
+        return "Wakeable task";
+    }
+
+    std::chrono::microseconds maxExpectedDuration() override {
+        return std::chrono::seconds(60);
+    }
+
+private:
+    static constexpr double forever = std::numeric_limits<int>::max();
+
+    TaskCountdown& countdown;
+};
+
+/*
+ * Throughput of scheduling short-lived tasks and running them to completion,
+ * for the given number of threads, with (1) and without (0) work stealing.
+ */
+static void BM_ExecutorScheduleRun(benchmark::State& state) {
+    const size_t numThreads = state.range(0);
+    const bool workStealing = state.range(1);
+    const int tasksPerIteration = 1000;
+
+    TaskCountdown countdown;
+    BenchTaskable taskable;
+    BenchExecutorPool pool(numThreads, workStealing);
+    pool.registerTaskable(taskable);
+
+    for (auto _ : state) {
+        countdown.reset(tasksPerIteration);
+        for (int ii = 0; ii < tasksPerIteration; ++ii) {
+            pool.schedule(std::make_shared<LambdaTask>(
+                    taskable, TaskId::ItemPager, 0, false, [&countdown] {
+                        countdown.taskRan();
+                        return false;
+                    }));
+        }
+        countdown.wait();
+    }
+
+    state.SetItemsProcessed(state.iterations() * tasksPerIteration);
+    state.counters["Steals"] = pool.getNumSteals();
+    pool.unregisterTaskable(taskable, false);
+}
+
+/*
+ * Throughput of waking snoozed tasks and running them, for the given number
+ * of threads, with (1) and without (0) work stealing.
+ */
+static void BM_ExecutorWakeRun(benchmark::State& state) {
+    const size_t numThreads = state.range(0);
+    const bool workStealing = state.range(1);
+    const int numTasks = 256;
+
+    TaskCountdown countdown;
+    BenchTaskable taskable;
+    BenchExecutorPool pool(numThreads, workStealing);
+    pool.registerTaskable(taskable);
+
+    std::vector<ExTask> tasks;
+    for (int ii = 0; ii < numTasks; ++ii) {
+        tasks.push_back(std::make_shared<WakeableTask>(taskable, countdown));
+        pool.schedule(tasks.back());
+    }
+
+    for (auto _ : state) {
+        countdown.reset(numTasks);
+        for (auto& task : tasks) {
+            pool.wake(task->getId());
+        }
+        countdown.wait();
+    }
+
+    state.SetItemsProcessed(state.iterations() * numTasks);
+    state.counters["Steals"] = pool.getNumSteals();
+    pool.unregisterTaskable(taskable, false);
+}
+
+static void ExecutorArguments(benchmark::internal::Benchmark* b) {
+    for (int threads : {1, 2, 4, 8, 16}) {
+        b->Args({threads, 0});
+        b->Args({threads, 1});
+    }
+}
+
+static std::unique_ptr<TaskFutureQueue> makeFutureQueue(
+        FutureQueueType type) {
+    if (type == FutureQueueType::TimerWheel) {
+        return std::make_unique<TimerWheelFutureQueue>();
+    }
+    return std::make_unique<FutureQueue<>>();
+}
+
+/// Populate the queue with the given number of tasks snoozed for up to an
+/// hour.
+static std::vector<ExTask> makeSnoozedTasks(Taskable& taskable,
+                                            TaskFutureQueue& queue,
+                                            size_t numTasks) {
+    std::mt19937 gen(0);
+    std::uniform_real_distribution<double> snoozeDist(1, 3600);
+    std::vector<ExTask> tasks;
+    for (size_t ii = 0; ii < numTasks; ++ii) {
+        tasks.push_back(std::make_shared<LambdaTask>(
+                taskable, TaskId::ItemPager, snoozeDist(gen), false, [] {
+                    return false;
+                }));
+        queue.push(tasks.back());
+    }
+    return tasks;
+}
+
+/*
+ * Cost of waking a snoozed task and snoozing it again (the common pattern of
+ * a periodic task being woken early), for the given number of queued tasks
+ * and FutureQueueType.
+ */
+static void BM_FutureQueueWakeSnooze(benchmark::State& state) {
+    const size_t numTasks = state.range(0);
+    BenchTaskable taskable;
+    auto queue = makeFutureQueue(FutureQueueType(state.range(1)));
+    auto tasks = makeSnoozedTasks(taskable, *queue, numTasks);
+
+    std::mt19937 gen(1);
+    std::uniform_int_distribution<size_t> taskDist(0, numTasks - 1);
+    for (auto _ : state) {
+        auto& task = tasks[taskDist(gen)];
+        queue->updateWaketime(task, std::chrono::steady_clock::now());
+        queue->snooze(task, 60);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+/*
+ * Cost of moving due tasks out of the queue (as TaskQueue does on each fetch)
+ * and re-queueing them, for the given number of queued tasks and
+ * FutureQueueType. 1% of the tasks are due on each iteration.
+ */
+static void BM_FutureQueuePopReady(benchmark::State& state) {
+    const size_t numTasks = state.range(0);
+    BenchTaskable taskable;
+    auto queue = makeFutureQueue(FutureQueueType(state.range(1)));
+    auto tasks = makeSnoozedTasks(taskable, *queue, numTasks);
+
+    std::mt19937 gen(1);
+    std::uniform_int_distribution<size_t> taskDist(0, numTasks - 1);
+    std::vector<ExTask> ready;
+    for (auto _ : state) {
+        const auto now = std::chrono::steady_clock::now();
+        for (size_t ii = 0; ii < numTasks / 100; ++ii) {
+            queue->updateWaketime(tasks[taskDist(gen)], now);
+        }
+        queue->popReady(now, [&ready](ExTask task) {
+            ready.push_back(std::move(task));
+        });
+        state.PauseTiming();
+        for (auto& task : ready) {
+            task->snooze(60);
+            queue->push(task);
+        }
+        ready.clear();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * (numTasks / 100));
+}
+
+static void FutureQueueArguments(benchmark::internal::Benchmark* b) {
+    for (int tasks : {1000, 10000, 100000}) {
+        b->Args({tasks, int(FutureQueueType::Heap)});
+        b->Args({tasks, int(FutureQueueType::TimerWheel)});
+    }
+}
+
+BENCHMARK(BM_ExecutorScheduleRun)->Apply(ExecutorArguments)->UseRealTime();
+BENCHMARK(BM_ExecutorWakeRun)->Apply(ExecutorArguments)->UseRealTime();
+BENCHMARK(BM_FutureQueueWakeSnooze)->Apply(FutureQueueArguments);
+BENCHMARK(BM_FutureQueuePopReady)->Apply(FutureQueueArguments);
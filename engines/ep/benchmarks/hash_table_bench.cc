@@ -26,15 +26,20 @@
 #include <engines/ep/src/syncobject.h>
 #include <folly/portability/GTest.h>
 #include <spdlog/fmt/fmt.h>
+#include <utilities/hdrhistogram.h>
+
+#include <thread>
 
 // Benchmarks inserting items into a HashTable
 class HashTableBench : public benchmark::Fixture {
 public:
-    HashTableBench()
+    HashTableBench(HashTable::Layout layout = HashTable::Layout::Chained,
+                   size_t inlineValueThreshold = 0)
         : ht(stats,
-             std::make_unique<StoredValueFactory>(stats),
+             std::make_unique<StoredValueFactory>(stats, inlineValueThreshold),
              Configuration().getHtSize(),
-             Configuration().getHtLocks()) {
+             Configuration().getHtLocks(),
+             layout) {
     }
 
     void SetUp(benchmark::State& state) override {
@@ -118,6 +123,127 @@ public:
         }
     }
 
+    /**
+     * Benchmark finding items in the HashTable (for read, or for write).
+     * Includes extra  50% of Items are prepared SyncWrites -  an
+     * unrealistically high percentage in a real-world, but want to measure
+     * any performance impact in having such items present in the HashTable.
+     */
+    void benchFind(benchmark::State& state, bool forWrite) {
+        // Populate the HashTable with numItems.
+        if (state.thread_index == 0) {
+            sharedItems = createUniqueItems(
+                    "Thread" + std::to_string(state.thread_index) + "::", 50);
+            for (auto& item : sharedItems) {
+                ASSERT_EQ(MutationStatus::WasClean, ht.set(item));
+            }
+        }
+
+        // Benchmark - find them.
+        while (state.KeepRunning()) {
+            auto& key = sharedItems[state.iterations() % numItems].getKey();
+            if (forWrite) {
+                benchmark::DoNotOptimize(ht.findForWrite(key));
+            } else {
+                benchmark::DoNotOptimize(ht.findForRead(key));
+            }
+        }
+
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    /**
+     * Benchmark GETs as the front-end performs them: find the key and copy
+     * it out of the HashTable as an Item, which is then freed.
+     * Variables:
+     *  - range(0) : The value size
+     *  - range(1) : The number of keys read (1 = a single hot key, shared by
+     *               all threads)
+     */
+    void benchGet(benchmark::State& state) {
+        const size_t valueSize = state.range(0);
+        const size_t numKeys = state.range(1);
+        if (state.thread_index == 0) {
+            const std::string value(valueSize, 'x');
+            for (size_t i = 0; i < numKeys; ++i) {
+                Item item(makeStoredDocKey("key" + std::to_string(i)),
+                          0,
+                          0,
+                          value.data(),
+                          value.size());
+                ASSERT_EQ(MutationStatus::WasClean, ht.set(item));
+            }
+        }
+        std::vector<StoredDocKey> keys;
+        for (size_t i = 0; i < numKeys; ++i) {
+            keys.push_back(makeStoredDocKey("key" + std::to_string(i)));
+        }
+        while (ht.getNumItems() < numKeys) {
+            std::this_thread::yield();
+        }
+
+        while (state.KeepRunning()) {
+            const auto& key = keys[state.iterations() % numKeys];
+            auto item = ht.findForRead(key).storedValue->toItem(Vbid(0));
+            benchmark::DoNotOptimize(item);
+        }
+
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    /**
+     * Benchmark looking up keys which do not exist in a populated
+     * HashTable - e.g. adds, or GETs of missing keys which will need a
+     * bgFetch. Such lookups must check every StoredValue in the key's
+     * bucket.
+     */
+    void benchFindMissing(benchmark::State& state) {
+        if (state.thread_index == 0) {
+            sharedItems = createUniqueItems("Present::");
+            for (auto& item : sharedItems) {
+                ASSERT_EQ(MutationStatus::WasClean, ht.set(item));
+            }
+        }
+        auto missing = createUniqueItems(
+                "Missing" + std::to_string(state.thread_index) + "::");
+
+        while (state.KeepRunning()) {
+            auto& key = missing[state.iterations() % numItems].getKey();
+            benchmark::DoNotOptimize(ht.findForRead(key));
+        }
+
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    /// Benchmark inserting an item into the HashTable.
+    void benchInsert(benchmark::State& state) {
+        // To ensure we insert and not replace items, create a per-thread
+        // items vector so each thread inserts a different set of items.
+        auto items = createUniqueItems(
+                "Thread" + std::to_string(state.thread_index) + "::");
+
+        while (state.KeepRunning()) {
+            const auto index = state.iterations() % numItems;
+            ASSERT_EQ(MutationStatus::WasClean, ht.set(items[index]));
+
+            // Once a thread gets to the end of it's items; pause timing and
+            // let the *last* thread clear them all - this is to avoid
+            // measuring any of the ht.clear() cost indirectly when other
+            // threads are trying to insert.
+            // Note: state.iterations() starts at 0; hence checking for
+            // state.iterations() % numItems (aka 'index') is zero to
+            // represent we wrapped.
+            if (index == 0) {
+                state.PauseTiming();
+                waitForAllThreadsThenExecuteOnce(state,
+                                                 [this]() { ht.clear(); });
+                state.ResumeTiming();
+            }
+        }
+
+        state.SetItemsProcessed(state.iterations());
+    }
+
     auto& getValFact() {
         return ht.valFact;
     }
@@ -139,78 +265,57 @@ public:
     int waiters = 0;
 };
 
-// Benchmark finding items in the HashTable.
-// Includes extra  50% of Items are prepared SyncWrites -  an unrealistically
-// high percentage in a real-world, but want to measure any performance impact
-// in having such items present in the HashTable.
-BENCHMARK_DEFINE_F(HashTableBench, FindForRead)(benchmark::State& state) {
-    // Populate the HashTable with numItems.
-    if (state.thread_index == 0) {
-        sharedItems = createUniqueItems(
-                "Thread" + std::to_string(state.thread_index) + "::", 50);
-        for (auto& item : sharedItems) {
-            ASSERT_EQ(MutationStatus::WasClean, ht.set(item));
-        }
+// Variant of HashTableBench using the Tagged HashTable layout, to compare
+// against the default (Chained) layout.
+class TaggedHashTableBench : public HashTableBench {
+public:
+    TaggedHashTableBench() : HashTableBench(HashTable::Layout::Tagged) {
     }
+};
 
-    // Benchmark - find them.
-    while (state.KeepRunning()) {
-        auto& key = sharedItems[state.iterations() % numItems].getKey();
-        benchmark::DoNotOptimize(ht.findForRead(key));
+// Variant of HashTableBench which stores values of up to the maximum inline
+// size inline in the StoredValue, to compare against values held in a Blob.
+class InlineValueHashTableBench : public HashTableBench {
+public:
+    InlineValueHashTableBench()
+        : HashTableBench(HashTable::Layout::Chained,
+                         StoredValue::maxInlineValueSize) {
     }
+};
 
-    state.SetItemsProcessed(state.iterations());
+BENCHMARK_DEFINE_F(HashTableBench, FindForRead)(benchmark::State& state) {
+    benchFind(state, false);
 }
 
-// Benchmark finding items (for write) in the HashTable.
-// Includes extra  50% of Items are prepared SyncWrites -  an unrealistically
-// high percentage in a real-world, but want to measure any performance impact
-// in having such items present in the HashTable.
-BENCHMARK_DEFINE_F(HashTableBench, FindForWrite)(benchmark::State& state) {
-    // Populate the HashTable with numItems.
-    if (state.thread_index == 0) {
-        sharedItems = createUniqueItems(
-                "Thread" + std::to_string(state.thread_index) + "::", 50);
-        for (auto& item : sharedItems) {
-            ASSERT_EQ(MutationStatus::WasClean, ht.set(item));
-        }
-    }
+BENCHMARK_DEFINE_F(TaggedHashTableBench, FindForRead)
+(benchmark::State& state) {
+    benchFind(state, false);
+}
 
-    // Benchmark - find them.
-    while (state.KeepRunning()) {
-        auto& key = sharedItems[state.iterations() % numItems].getKey();
-        benchmark::DoNotOptimize(ht.findForWrite(key));
-    }
+BENCHMARK_DEFINE_F(HashTableBench, FindForWrite)(benchmark::State& state) {
+    benchFind(state, true);
+}
 
-    state.SetItemsProcessed(state.iterations());
+BENCHMARK_DEFINE_F(TaggedHashTableBench, FindForWrite)
+(benchmark::State& state) {
+    benchFind(state, true);
 }
 
-// Benchmark inserting an item into the HashTable.
-BENCHMARK_DEFINE_F(HashTableBench, Insert)(benchmark::State& state) {
-    // To ensure we insert and not replace items, create a per-thread items
-    // vector so each thread inserts a different set of items.
-    auto items = createUniqueItems("Thread" +
-                                   std::to_string(state.thread_index) + "::");
+BENCHMARK_DEFINE_F(HashTableBench, FindMissing)(benchmark::State& state) {
+    benchFindMissing(state);
+}
 
-    while (state.KeepRunning()) {
-        const auto index = state.iterations() % numItems;
-        ASSERT_EQ(MutationStatus::WasClean, ht.set(items[index]));
+BENCHMARK_DEFINE_F(TaggedHashTableBench, FindMissing)
+(benchmark::State& state) {
+    benchFindMissing(state);
+}
 
-        // Once a thread gets to the end of it's items; pause timing and let
-        // the *last* thread clear them all - this is to avoid measuring any
-        // of the ht.clear() cost indirectly when other threads are trying to
-        // insert.
-        // Note: state.iterations() starts at 0; hence checking for
-        // state.iterations() % numItems (aka 'index') is zero to represent we
-        // wrapped.
-        if (index == 0) {
-            state.PauseTiming();
-            waitForAllThreadsThenExecuteOnce(state, [this]() { ht.clear(); });
-            state.ResumeTiming();
-        }
-    }
+BENCHMARK_DEFINE_F(HashTableBench, Insert)(benchmark::State& state) {
+    benchInsert(state);
+}
 
-    state.SetItemsProcessed(state.iterations());
+BENCHMARK_DEFINE_F(TaggedHashTableBench, Insert)(benchmark::State& state) {
+    benchInsert(state);
 }
 
 // Benchmark replacing an existing item in the HashTable.
@@ -267,6 +372,114 @@ BENCHMARK_DEFINE_F(HashTableBench, Delete)(benchmark::State& state) {
     state.SetItemsProcessed(state.iterations());
 }
 
+// Benchmark the latency of finding items in the HashTable while it is being
+// resized. A background thread repeatedly grows and shrinks the HashTable,
+// while all benchmark threads perform findForRead() and record the latency of
+// each one. Reports the p50 / p99 / max find latency (averaged across
+// threads).
+BENCHMARK_DEFINE_F(HashTableBench, FindForReadDuringResize)
+(benchmark::State& state) {
+    std::atomic<bool> keepResizing{true};
+    std::thread resizer;
+    if (state.thread_index == 0) {
+        sharedItems = createUniqueItems("Thread0::");
+        for (auto& item : sharedItems) {
+            ASSERT_EQ(MutationStatus::WasClean, ht.set(item));
+        }
+        resizer = std::thread([this, &keepResizing]() {
+            const size_t sizes[] = {numItems / 4, numItems * 2};
+            for (size_t i = 0; keepResizing; ++i) {
+                ht.resize(sizes[i % 2]);
+            }
+        });
+    }
+
+    // Wait for the table to be populated before starting.
+    while (ht.getNumItems() < numItems) {
+        std::this_thread::yield();
+    }
+
+    Hdr1sfMicroSecHistogram latency;
+    while (state.KeepRunning()) {
+        auto& key = sharedItems[state.iterations() % numItems].getKey();
+        const auto start = std::chrono::steady_clock::now();
+        benchmark::DoNotOptimize(ht.findForRead(key));
+        latency.add(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start));
+    }
+
+    // All threads have finished the timed loop; stop resizing.
+    if (state.thread_index == 0) {
+        keepResizing = false;
+        resizer.join();
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    state.counters["FindLatencyP50us"] =
+            benchmark::Counter(latency.getValueAtPercentile(50),
+                               benchmark::Counter::kAvgThreads);
+    state.counters["FindLatencyP99us"] =
+            benchmark::Counter(latency.getValueAtPercentile(99),
+                               benchmark::Counter::kAvgThreads);
+    state.counters["FindLatencyMaxus"] = benchmark::Counter(
+            latency.getMaxValue(), benchmark::Counter::kAvgThreads);
+}
+
+// Benchmark GETs of a single hot key from many threads, copying the item out
+// of the HashTable as a front-end GET would. state.range(0) selects locking
+// findForRead() (0) or findForReadOptimistic() (1). Reports how many times
+// (per read) acquiring the bucket lock had to wait, and for how long.
+BENCHMARK_DEFINE_F(HashTableBench, FindForReadHotKey)
+(benchmark::State& state) {
+    const bool optimistic = state.range(0);
+    const auto key = makeStoredDocKey("hotkey");
+    if (state.thread_index == 0) {
+        const std::string value(100, 'x');
+        ASSERT_EQ(MutationStatus::WasClean,
+                  ht.set(Item(key, 0, 0, value.data(), value.size())));
+    }
+    while (ht.getNumItems() == 0) {
+        std::this_thread::yield();
+    }
+
+    const auto contendedBefore = ht.getNumContendedLocks();
+    const auto waitBefore = ht.getLockWaitTime();
+    while (state.KeepRunning()) {
+        std::unique_ptr<Item> item;
+        auto reader = [&item](const StoredValue* v) {
+            item = v->toItem(Vbid(0));
+            return true;
+        };
+        if (!optimistic || !ht.findForReadOptimistic(key,
+                                                     TrackReference::Yes,
+                                                     WantsDeleted::No,
+                                                     ForGetReplicaOp::No,
+                                                     reader)) {
+            auto res = ht.findForRead(key);
+            reader(res.storedValue);
+        }
+        benchmark::DoNotOptimize(item);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    // Lock stats are per HashTable, so only report them from one thread.
+    if (state.thread_index == 0) {
+        const double reads = state.iterations() * state.threads;
+        state.counters["LockContendedPerRead"] =
+                (ht.getNumContendedLocks() - contendedBefore) / reads;
+        state.counters["LockWaitNsPerRead"] =
+                (ht.getLockWaitTime() - waitBefore).count() / reads;
+    }
+}
+
+BENCHMARK_DEFINE_F(HashTableBench, Get)(benchmark::State& state) {
+    benchGet(state);
+}
+
+BENCHMARK_DEFINE_F(InlineValueHashTableBench, Get)(benchmark::State& state) {
+    benchGet(state);
+}
+
 // Benchmark inserting an item into the HashTable.
 BENCHMARK_DEFINE_F(HashTableBench, MultiCollectionInsert)
 (benchmark::State& state) {
@@ -373,6 +586,9 @@ BENCHMARK_REGISTER_F(HashTableBench, FindForRead)
 BENCHMARK_REGISTER_F(HashTableBench, FindForWrite)
         ->ThreadPerCpu()
         ->Iterations(HashTableBench::numItems);
+BENCHMARK_REGISTER_F(HashTableBench, FindMissing)
+        ->ThreadPerCpu()
+        ->Iterations(HashTableBench::numItems);
 BENCHMARK_REGISTER_F(HashTableBench, Insert)
         ->ThreadPerCpu()
         ->Iterations(HashTableBench::numItems);
@@ -383,6 +599,35 @@ BENCHMARK_REGISTER_F(HashTableBench, Delete)
         ->ThreadPerCpu()
         ->Iterations(HashTableBench::numItems);
 
+BENCHMARK_REGISTER_F(HashTableBench, FindForReadDuringResize)
+        ->ThreadRange(1, 16)
+        ->Iterations(HashTableBench::numItems)
+        ->UseRealTime();
+
+BENCHMARK_REGISTER_F(HashTableBench, FindForReadHotKey)
+        ->ArgName("optimistic")
+        ->Arg(0)
+        ->Arg(1)
+        ->ThreadRange(1, 16)
+        ->UseRealTime();
+
+// Compare GETs of values held in a Blob against values stored inline.
+static void getArgs(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"valueSize", "keys"});
+    for (int64_t valueSize : {8, 64, 128}) {
+        b->Args({valueSize, 1});
+        b->Args({valueSize, int64_t(HashTableBench::numItems)});
+    }
+}
+BENCHMARK_REGISTER_F(HashTableBench, Get)
+        ->Apply(getArgs)
+        ->ThreadRange(1, 16)
+        ->UseRealTime();
+BENCHMARK_REGISTER_F(InlineValueHashTableBench, Get)
+        ->Apply(getArgs)
+        ->ThreadRange(1, 16)
+        ->UseRealTime();
+
 BENCHMARK_REGISTER_F(HashTableBench, MultiCollectionInsert)
         ->ThreadPerCpu()
         ->Iterations(HashTableBench::numItems)
@@ -392,3 +637,16 @@ BENCHMARK_REGISTER_F(HashTableBench, HTStatsEpilogue)
         ->ThreadPerCpu()
         ->Iterations(HashTableBench::numItems)
         ->Range(1, 1000);
+
+BENCHMARK_REGISTER_F(TaggedHashTableBench, FindForRead)
+        ->ThreadPerCpu()
+        ->Iterations(HashTableBench::numItems);
+BENCHMARK_REGISTER_F(TaggedHashTableBench, FindForWrite)
+        ->ThreadPerCpu()
+        ->Iterations(HashTableBench::numItems);
+BENCHMARK_REGISTER_F(TaggedHashTableBench, FindMissing)
+        ->ThreadPerCpu()
+        ->Iterations(HashTableBench::numItems);
+BENCHMARK_REGISTER_F(TaggedHashTableBench, Insert)
+        ->ThreadPerCpu()
+        ->Iterations(HashTableBench::numItems);
@@ -17,6 +17,7 @@
 
 #include "callbacks.h"
 #include "collections/vbucket_manifest.h"
+#include "couch-kvstore/couch-kvstore-config.h"
 #include "item.h"
 #include "kvstore.h"
 #include "kvstore_config.h"
@@ -36,7 +37,9 @@
 using namespace std::string_literals;
 
 enum Storage {
-    COUCHSTORE = 0
+    COUCHSTORE = 0,
+    /// Couchstore with couchstore_io_backend=io_uring
+    COUCHSTORE_IO_URING
 #ifdef EP_USE_ROCKSDB
     ,
     ROCKSDB
@@ -102,7 +105,20 @@ protected:
                                       get_mock_server_api());
             WorkLoadPolicy workload(config.getMaxNumWorkers(),
                                     config.getMaxNumShards());
-            kvstoreConfig = std::make_unique<KVStoreConfig>(
+            kvstoreConfig = std::make_unique<CouchKVStoreConfig>(
+                    config, workload.getNumShards(), shardId);
+            break;
+        }
+        case COUCHSTORE_IO_URING: {
+            state.SetLabel("Couchstore io_uring");
+            config.parseConfiguration(
+                    (configStr +
+                     ";backend=couchdb;couchstore_io_backend=io_uring")
+                            .c_str(),
+                    get_mock_server_api());
+            WorkLoadPolicy workload(config.getMaxNumWorkers(),
+                                    config.getMaxNumShards());
+            kvstoreConfig = std::make_unique<CouchKVStoreConfig>(
                     config, workload.getNumShards(), shardId);
             break;
         }
@@ -194,11 +210,47 @@ BENCHMARK_DEFINE_F(KVStoreBench, Scan)(benchmark::State& state) {
     state.SetItemsProcessed(itemCountTotal);
 }
 
+/*
+ * Benchmark for KVStore::commit() - a flusher batch of state.range(2) new
+ * items, persisted (and synced) to the store.
+ */
+BENCHMARK_DEFINE_F(KVStoreBench, Commit)(benchmark::State& state) {
+    const int batchSize = state.range(2);
+    const std::string value(512, 'x');
+    int64_t seqno = numItems;
+    size_t itemsTotal = 0;
+
+    while (state.KeepRunning()) {
+        kvstore->begin(std::make_unique<TransactionContext>(vbid));
+        for (int i = 0; i < batchSize; i++) {
+            ++seqno;
+            auto qi = makeCommittedItem(
+                    makeStoredDocKey("key" + std::to_string(seqno)), value);
+            qi->setBySeqno(seqno);
+            kvstore->set(qi);
+        }
+        Collections::VB::Manifest m;
+        VB::Commit f(m);
+        ASSERT_TRUE(kvstore->commit(f));
+        itemsTotal += batchSize;
+    }
+
+    state.SetItemsProcessed(itemsTotal);
+}
+
 const int NUM_ITEMS = 100000;
 
 BENCHMARK_REGISTER_F(KVStoreBench, Scan)
         ->Args({NUM_ITEMS, COUCHSTORE})
+        ->Args({NUM_ITEMS, COUCHSTORE_IO_URING})
 #ifdef EP_USE_ROCKSDB
         ->Args({NUM_ITEMS, ROCKSDB})
 #endif
         ;
+
+BENCHMARK_REGISTER_F(KVStoreBench, Commit)
+        ->Args({1000, COUCHSTORE, 100})
+        ->Args({1000, COUCHSTORE_IO_URING, 100})
+        ->Args({1000, COUCHSTORE, 10000})
+        ->Args({1000, COUCHSTORE_IO_URING, 10000})
+        ;
@@ -48,6 +48,7 @@ void BgFetcher::start() {
     ExecutorPool* iom = ExecutorPool::get();
     auto task =
             std::make_shared<MultiBGFetcherTask>(&(store.getEPEngine()), this);
+    task->setNumaNode(iom->getNumaNodeForShard(shard.getId()));
     this->setTaskId(task->getId());
     iom->schedule(task);
 }
@@ -306,7 +306,14 @@ QueueDirtyStatus Checkpoint::queueDirty(const queued_item& qi,
                 // item being removed.
                 queuedItemsMemUsage -= ((*currPos)->size());
                 // Remove the existing item for the same key from the list.
-                toWrite.erase(currPos);
+                // This may compact the chunk it was in, moving other items.
+                toWrite.erase(currPos,
+                              [this, checkpointManager](
+                                      CheckpointQueue::iterator from,
+                                      CheckpointQueue::iterator to) {
+                                  relocateQueuedItem(
+                                          from, to, *checkpointManager);
+                              });
             } else {
                 // The old item has been expelled, but we can continue to use
                 // this checkpoint in most cases. If the previous op was a
@@ -427,10 +434,37 @@ void Checkpoint::addItemToCheckpoint(const queued_item& qi) {
     }
 }
 
-CheckpointQueue Checkpoint::expelItems(
-        CheckpointCursor& expelUpToAndIncluding) {
-    CheckpointQueue expelledItems(toWrite.get_allocator());
+void Checkpoint::relocateQueuedItem(CheckpointQueue::iterator from,
+                                    CheckpointQueue::iterator to,
+                                    CheckpointManager& checkpointManager) {
+    const ChkptQueueIterator newPos(toWrite, to);
+    const CheckpointQueue::const_iterator oldPos(from);
+
+    const auto& qi = *to;
+    if (qi->getKey().size() > 0) {
+        auto& keyIndex = qi->isCheckPointMetaItem()
+                                 ? metaKeyIndex
+                                 : qi->isCommitted() ? committedKeyIndex
+                                                     : preparedKeyIndex;
+        auto it = keyIndex.find(qi->getKey());
+        if (it != keyIndex.end() &&
+            CheckpointQueue::const_iterator(it->second.position) == oldPos) {
+            it->second.position = newPos;
+        }
+    }
 
+    for (auto& cursor : checkpointManager.cursors) {
+        if (cursor.second->currentCheckpoint->get() == this &&
+            CheckpointQueue::const_iterator(cursor.second->currentPos) ==
+                    oldPos) {
+            cursor.second->currentPos = newPos;
+        }
+    }
+}
+
+CheckpointQueue Checkpoint::expelItems(
+        CheckpointCursor& expelUpToAndIncluding,
+        std::vector<queued_item>& partial) {
     ChkptQueueIterator iterator = expelUpToAndIncluding.currentPos;
 
     // Record the seqno of the last item to be expelled.
@@ -493,14 +527,9 @@ CheckpointQueue Checkpoint::expelItems(
      * Move from (and including) the first item in the checkpoint queue upto
      * (but not including) the item pointed to by iterator.  The item pointed
      * to by iterator is now the new dummy item for the checkpoint queue.
+     * Return the items that have been expelled in a separate queue.
      */
-    expelledItems.splice(expelledItems.begin(),
-                         toWrite,
-                         begin(),
-                         iterator);
-
-    // Return the items that have been expelled in a separate queue.
-    return expelledItems;
+    return toWrite.extractFront(iterator, partial);
 }
 
 int64_t Checkpoint::getMutationId(const CheckpointCursor& cursor) const {
@@ -19,6 +19,7 @@
 
 #include "checkpoint_iterator.h"
 #include "checkpoint_types.h"
+#include "chunked_queue.h"
 #include "ep_types.h"
 #include "item.h"
 #include "monotonic.h"
@@ -57,10 +58,13 @@ enum checkpoint_state {
 
 const char* to_string(enum checkpoint_state);
 
-// List is used for queueing mutations as vector incurs shift operations for
-// de-duplication.  We template the list on a queued_item and our own
-// memory allocator which allows memory usage to be tracked.
-typedef std::list<queued_item, MemoryTrackingAllocator<queued_item>>
+// A chunked queue is used for queueing mutations; it avoids the per-item
+// node allocation (and two link pointers) of a list and keeps items
+// contiguous for cursor walks, while de-duplication only nulls out the
+// replaced item rather than shifting as a vector would. We template the
+// queue on a queued_item and our own memory allocator which allows memory
+// usage to be tracked.
+typedef ChunkedQueue<queued_item, MemoryTrackingAllocator<queued_item>>
         CheckpointQueue;
 
 // Iterator for the Checkpoint queue.  The iterator is templated on the
@@ -616,13 +620,28 @@ public:
      */
     void addItemToCheckpoint(const queued_item& qi);
 
+    /**
+     * Update the key index entry and any cursor which refer to the queued
+     * item at `from`, which toWrite has moved to `to` (see
+     * CheckpointQueue::erase).
+     */
+    void relocateQueuedItem(CheckpointQueue::iterator from,
+                            CheckpointQueue::iterator to,
+                            CheckpointManager& checkpointManager);
+
     /**
      * Expel those items in the checkpoint where all cursors have passed.
      * @param expelUpToAndIncluding  a cursor pointing where we will expel
      *                               upto and including.
-     * @return  a CheckpointQueue of items that have been expelled.
+     * @param partial  receives the expelled items which shared a queue chunk
+     *                 with items which remain; reserve capacity for
+     *                 CheckpointQueue::maxChunkSize items beforehand so that
+     *                 no memory is allocated while expelling.
+     * @return  a CheckpointQueue of (the other) items that have been
+     *          expelled.
      */
-    CheckpointQueue expelItems(CheckpointCursor& expelUpToAndIncluding);
+    CheckpointQueue expelItems(CheckpointCursor& expelUpToAndIncluding,
+                               std::vector<queued_item>& partial);
 
     /// @return true if this is a disk checkpoint (replica streaming from disk)
     bool isDiskCheckpoint() const {
@@ -648,6 +667,15 @@ public:
         return *trackingAllocator.getBytesAllocated();
     }
 
+    /**
+     * @return bytes of the chunks owned by toWrite. Unlike
+     * getWriteQueueAllocatorBytes() this excludes chunks of any expelled
+     * items queue (which shares toWrite's allocator) still in existence.
+     */
+    size_t getWriteQueueChunkBytes() const {
+        return toWrite.getAllocatedBytes();
+    }
+
     // see member variable definition for info
     size_t getQueuedItemsMemUsage() const {
         return queuedItemsMemUsage;
@@ -64,6 +64,11 @@ public:
         }
     }
 
+    /// Iterator to the given (non-null) element of the container.
+    CheckpointIterator(std::reference_wrapper<C> c, underlying_iterator it)
+        : container(c), iter(it) {
+    }
+
     auto operator++() {
         moveForward();
 
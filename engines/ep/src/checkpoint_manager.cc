@@ -573,6 +573,11 @@ size_t CheckpointManager::removeClosedUnrefCheckpoints(
 CheckpointManager::ExpelResult
 CheckpointManager::expelUnreferencedCheckpointItems() {
     CheckpointQueue expelledItems;
+    // Expelled items which shared a queue chunk with remaining items.
+    // Reserved before taking the queueLock so expelling doesn't allocate.
+    std::vector<queued_item> expelledFromPartialChunk;
+    expelledFromPartialChunk.reserve(CheckpointQueue::maxChunkSize);
+    size_t queueMemoryReleased = 0;
     {
         LockHolder lh(queueLock);
 
@@ -662,28 +667,35 @@ CheckpointManager::expelUnreferencedCheckpointItems() {
          * queue thereby ensuring they still have a reference whilst
          * the queuelock is being held.
          */
-        expelledItems = oldestCheckpoint->expelItems(expelUpToAndIncluding);
+        const auto queueMemoryBefore =
+                oldestCheckpoint->getWriteQueueChunkBytes();
+        expelledItems = oldestCheckpoint->expelItems(expelUpToAndIncluding,
+                                                     expelledFromPartialChunk);
+        queueMemoryReleased =
+                queueMemoryBefore - oldestCheckpoint->getWriteQueueChunkBytes();
     }
 
+    const auto expelCount =
+            expelledItems.size() + expelledFromPartialChunk.size();
+
     // If called currentCheckpoint->expelItems but did not manage to expel
     // anything then just return.
-    if (expelledItems.empty()) {
+    if (expelCount == 0) {
         return {};
     }
 
-    stats.itemsExpelledFromCheckpoints.fetch_add(expelledItems.size());
+    stats.itemsExpelledFromCheckpoints.fetch_add(expelCount);
 
     /*
      * Calculate an *estimate* of the amount of memory we will recover.
      * This is comprised of two parts:
      * 1. Memory used by each item to be expelled.  For each item this
      *    is calculated as the sizeof(Item) + key size + value size.
-     * 2. Memory used to hold the items in the checkpoint list.
-     *    The checkpoint list will be shorter by expelledItems.size().
-     *    This saving is equal to the memory allocated by the
-     *    expelledItems list.  Note: On Windows this is not strictly
-     *    true as we allocate space for size + 1.  However as its
-     *    an estimate we do not need to adjust.
+     * 2. Memory used to hold the items in the checkpoint queue.
+     *    The checkpoint queue releases every chunk which only held
+     *    expelled items; those chunks are now owned by expelledItems.
+     *    (Expelled items which shared a chunk with the remaining items
+     *    do not free any queue memory.)
      *
      * It is an optimistic estimate as it assumes that each queued_item
      * is not referenced by anyone else (e.g. a DCP stream) and therefore
@@ -696,10 +708,12 @@ CheckpointManager::expelUnreferencedCheckpointItems() {
     for (const auto& ei : expelledItems) {
         estimateOfAmountOfRecoveredMemory += ei->size();
     }
+    for (const auto& ei : expelledFromPartialChunk) {
+        estimateOfAmountOfRecoveredMemory += ei->size();
+    }
 
     // Part 2 of calculating the estimate (see comment above).
-    estimateOfAmountOfRecoveredMemory +=
-            *(expelledItems.get_allocator().getBytesAllocated());
+    estimateOfAmountOfRecoveredMemory += queueMemoryReleased;
 
     /*
      * We are now outside of the queueLock when the method exits,
@@ -707,7 +721,7 @@ CheckpointManager::expelUnreferencedCheckpointItems() {
      * of expelled items will go to zero and hence will be deleted
      * outside of the queuelock.
      */
-    return {expelledItems.size(), estimateOfAmountOfRecoveredMemory};
+    return {expelCount, estimateOfAmountOfRecoveredMemory};
 }
 
 std::vector<Cursor> CheckpointManager::getListOfCursorsToDrop() {
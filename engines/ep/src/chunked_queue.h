@@ -0,0 +1,558 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Append-only queue of nullable handles (e.g. queued_item), stored in a
+ * doubly-linked list of chunks.
+ *
+ * Designed as the storage for a Checkpoint, which needs:
+ *
+ * - push_back at the tail;
+ * - erase of arbitrary elements (de-duplication), without invalidating
+ *   iterators to any other element (or with the caller told which elements
+ *   moved - see erase(pos, relocated));
+ * - removal of a prefix of the queue (expelling) without invalidating
+ *   iterators to the remaining elements;
+ * - stable iterators, including end().
+ *
+ * Compared to a std::list this stores one pointer-sized element per item
+ * (plus a small per-chunk header) instead of a heap-allocated node with two
+ * link pointers per item, and elements are laid out contiguously, so walking
+ * the queue is cache and prefetcher friendly.
+ *
+ * The first chunk holds MinChunkSize elements and each following chunk
+ * doubles in size up to MaxChunkSize, so a short queue (e.g. a checkpoint
+ * holding a few items) does not pay for a whole large chunk.
+ *
+ * Erasing an element resets its slot to a default-constructed (null) T,
+ * which iterators skip over. A chunk is freed once all of its slots have
+ * been erased (and it is not the tail chunk), hence T must be
+ * default-constructible and contextually convertible to bool. Interleaved
+ * erases could otherwise leave a few live elements pinning each large
+ * chunk; erase(pos, relocated) moves the remaining elements of a sparsely
+ * used chunk to a new chunk of just the size required.
+ *
+ * Memory is allocated one chunk at a time via the given Allocator (rebound to
+ * char), so tracking allocators such as MemoryTrackingAllocator account for
+ * all memory used by the queue.
+ */
+template <class T,
+          class Allocator = std::allocator<T>,
+          size_t MaxChunkSize = 64,
+          size_t MinChunkSize = 4>
+class ChunkedQueue {
+    static_assert(MinChunkSize > 0 && MinChunkSize <= MaxChunkSize,
+                  "ChunkedQueue: require 0 < MinChunkSize <= MaxChunkSize");
+
+    /// Header of each chunk; its slots follow it in the same allocation.
+    struct Chunk {
+        explicit Chunk(uint32_t capacity) : capacity(capacity) {
+        }
+
+        T* slots() {
+            return reinterpret_cast<T*>(this + 1);
+        }
+
+        Chunk* prev = nullptr;
+        Chunk* next = nullptr;
+        /// Number of slots in this chunk.
+        const uint32_t capacity;
+        /// Index of the first slot in use; slots before it have been
+        /// extracted (see extractFront).
+        uint32_t first = 0;
+        /// One past the last slot written.
+        uint32_t last = 0;
+        /// Number of non-null slots in [first, last).
+        uint32_t live = 0;
+    };
+    static_assert(sizeof(Chunk) % alignof(T) == 0,
+                  "ChunkedQueue: slots must be aligned after the Chunk");
+    static_assert(alignof(T) <= alignof(std::max_align_t),
+                  "ChunkedQueue: over-aligned T not supported");
+
+    using ByteAllocator = typename std::allocator_traits<
+            Allocator>::template rebind_alloc<char>;
+    using ByteTraits = std::allocator_traits<ByteAllocator>;
+
+public:
+    using value_type = T;
+    using allocator_type = Allocator;
+    using size_type = size_t;
+    using difference_type = std::ptrdiff_t;
+    using reference = T&;
+    using const_reference = const T&;
+    using pointer = T*;
+    using const_pointer = const T*;
+
+    /// Number of elements in the first chunk.
+    static constexpr size_t minChunkSize = MinChunkSize;
+
+    /// Largest number of elements in a chunk.
+    static constexpr size_t maxChunkSize = MaxChunkSize;
+
+    /// @return the bytes allocated for a chunk of the given number of slots.
+    static constexpr size_t getChunkAllocationSize(size_t capacity) {
+        return sizeof(Chunk) + capacity * sizeof(T);
+    }
+
+    /**
+     * @return the bytes allocated by an (initially empty) queue after n
+     *         elements have been appended to it, if none have been erased.
+     */
+    static size_t getAllocationForAppends(size_t n) {
+        size_t bytes = 0;
+        size_t capacity = MinChunkSize;
+        while (n > 0) {
+            bytes += getChunkAllocationSize(capacity);
+            n -= std::min(n, capacity);
+            capacity = std::min(capacity * 2, MaxChunkSize);
+        }
+        return bytes;
+    }
+
+    template <bool Const>
+    class Iterator {
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<Const, const T*, T*>;
+        using reference = std::conditional_t<Const, const T&, T&>;
+
+        Iterator() = default;
+
+        /// Allow conversion of iterator to const_iterator.
+        template <bool C = Const, typename = std::enable_if_t<C>>
+        Iterator(const Iterator<false>& other)
+            : queue(other.queue), chunk(other.chunk), index(other.index) {
+        }
+
+        reference operator*() const {
+            return chunk->slots()[index];
+        }
+
+        pointer operator->() const {
+            return &chunk->slots()[index];
+        }
+
+        Iterator& operator++() {
+            ++index;
+            skipForward();
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            auto old = *this;
+            operator++();
+            return old;
+        }
+
+        Iterator& operator--() {
+            skipBackward();
+            return *this;
+        }
+
+        Iterator operator--(int) {
+            auto old = *this;
+            operator--();
+            return old;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return chunk == other.chunk && index == other.index;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return !operator==(other);
+        }
+
+    private:
+        friend class ChunkedQueue;
+        template <bool>
+        friend class Iterator;
+
+        Iterator(const ChunkedQueue* queue, Chunk* chunk, uint32_t index)
+            : queue(queue), chunk(chunk), index(index) {
+        }
+
+        /// Move forwards from the current slot (inclusive) to the first
+        /// non-null element, or to end().
+        void skipForward() {
+            while (chunk) {
+                for (; index < chunk->last; ++index) {
+                    if (chunk->slots()[index]) {
+                        return;
+                    }
+                }
+                chunk = chunk->next;
+                index = chunk ? chunk->first : 0;
+            }
+        }
+
+        /// Move backwards from the current slot (exclusive) to the previous
+        /// non-null element. Undefined if there is no such element.
+        void skipBackward() {
+            if (!chunk) {
+                chunk = queue->tail;
+                index = chunk->last;
+            }
+            for (;;) {
+                while (index > chunk->first) {
+                    --index;
+                    if (chunk->slots()[index]) {
+                        return;
+                    }
+                }
+                chunk = chunk->prev;
+                index = chunk->last;
+            }
+        }
+
+        const ChunkedQueue* queue = nullptr;
+        /// Chunk of the current element; nullptr for end().
+        Chunk* chunk = nullptr;
+        uint32_t index = 0;
+    };
+
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    explicit ChunkedQueue(const Allocator& alloc = Allocator())
+        : allocator(alloc) {
+    }
+
+    ChunkedQueue(ChunkedQueue&& other) noexcept
+        : allocator(other.allocator),
+          head(other.head),
+          tail(other.tail),
+          count(other.count),
+          allocatedBytes(other.allocatedBytes) {
+        other.head = other.tail = nullptr;
+        other.count = 0;
+        other.allocatedBytes = 0;
+    }
+
+    ChunkedQueue& operator=(ChunkedQueue&& other) noexcept {
+        if (this != &other) {
+            clear();
+            allocator = other.allocator;
+            head = other.head;
+            tail = other.tail;
+            count = other.count;
+            allocatedBytes = other.allocatedBytes;
+            other.head = other.tail = nullptr;
+            other.count = 0;
+            other.allocatedBytes = 0;
+        }
+        return *this;
+    }
+
+    ChunkedQueue(const ChunkedQueue&) = delete;
+    ChunkedQueue& operator=(const ChunkedQueue&) = delete;
+
+    ~ChunkedQueue() {
+        clear();
+    }
+
+    allocator_type get_allocator() const {
+        return allocator;
+    }
+
+    /// @return the number of (non-erased) elements in the queue.
+    size_type size() const {
+        return count;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    /// @return the bytes allocated for the chunks currently owned by this
+    ///         queue.
+    size_t getAllocatedBytes() const {
+        return allocatedBytes;
+    }
+
+    iterator begin() {
+        iterator it(this, head, head ? head->first : 0);
+        it.skipForward();
+        return it;
+    }
+
+    const_iterator begin() const {
+        const_iterator it(this, head, head ? head->first : 0);
+        it.skipForward();
+        return it;
+    }
+
+    const_iterator cbegin() const {
+        return begin();
+    }
+
+    iterator end() {
+        return iterator(this, nullptr, 0);
+    }
+
+    const_iterator end() const {
+        return const_iterator(this, nullptr, 0);
+    }
+
+    const_iterator cend() const {
+        return end();
+    }
+
+    void push_back(const T& value) {
+        auto* chunk = getTailForAppend();
+        chunk->slots()[chunk->last++] = value;
+        ++chunk->live;
+        ++count;
+    }
+
+    void push_back(T&& value) {
+        auto* chunk = getTailForAppend();
+        chunk->slots()[chunk->last++] = std::move(value);
+        ++chunk->live;
+        ++count;
+    }
+
+    /**
+     * Erase the element at pos. Iterators to all other elements remain valid.
+     * @return iterator to the element following pos.
+     */
+    iterator erase(const_iterator pos) {
+        auto* chunk = pos.chunk;
+        iterator next(this, chunk, pos.index + 1);
+        next.skipForward();
+
+        eraseSlot(chunk, pos.index);
+
+        // Release chunks which no longer hold any element; as next has
+        // already moved past all of the (null) slots of this chunk it is
+        // unaffected. The tail is kept as it will be appended to.
+        if (chunk->live == 0 && chunk != tail) {
+            unlinkChunk(chunk);
+            destroyChunk(chunk);
+        }
+        return next;
+    }
+
+    /**
+     * Erase the element at pos, as erase(pos). Additionally, if that leaves
+     * the chunk of pos sparsely used (at most a quarter of its slots live)
+     * the remaining elements of the chunk are moved to a new chunk of just
+     * the required size, so a few long-lived elements don't pin a large,
+     * mostly erased chunk. The tail chunk is never compacted.
+     *
+     * Iterators to moved elements are invalidated; relocated(from, to) is
+     * called for each of them (with `from` still comparable) so the caller
+     * can update any it holds. Iterators to all other elements remain valid.
+     *
+     * @param relocated Callable of the form void(iterator from, iterator to)
+     * @return iterator to the element following pos.
+     */
+    template <class Relocated>
+    iterator erase(const_iterator pos, Relocated&& relocated) {
+        auto* chunk = pos.chunk;
+        if (chunk == tail || chunk->live <= 1 ||
+            !isSparse(*chunk, chunk->live - 1)) {
+            return erase(pos);
+        }
+        eraseSlot(chunk, pos.index);
+        return compactChunk(chunk, pos.index, relocated);
+    }
+
+    /**
+     * Remove all elements before pos from this queue and return them (in
+     * order): whole chunks before the chunk of pos are transferred without
+     * copying any element into the returned queue, which uses the same
+     * allocator as this one. The elements before pos in its own chunk are
+     * moved (in order, after those of the returned queue) to the back of
+     * `partial`.
+     * Iterators to pos and all following elements remain valid.
+     *
+     * No memory is allocated if `partial` has capacity for maxChunkSize more
+     * elements, so the caller can reserve it before taking any lock it needs
+     * to hold for the extraction.
+     */
+    ChunkedQueue extractFront(const_iterator pos, std::vector<T>& partial) {
+        ChunkedQueue extracted(allocator);
+        while (head && head != pos.chunk) {
+            auto* chunk = head;
+            unlinkChunk(chunk);
+            count -= chunk->live;
+            extracted.linkChunkAtTail(chunk);
+        }
+
+        if (pos.chunk) {
+            auto* chunk = pos.chunk;
+            for (auto ii = chunk->first; ii < pos.index; ++ii) {
+                auto& slot = chunk->slots()[ii];
+                if (slot) {
+                    partial.push_back(std::move(slot));
+                    slot = T{};
+                    --chunk->live;
+                    --count;
+                }
+            }
+            chunk->first = pos.index;
+        }
+        return extracted;
+    }
+
+    /// Erase all elements and free all chunks.
+    void clear() {
+        while (head) {
+            auto* chunk = head;
+            head = chunk->next;
+            destroyChunk(chunk);
+        }
+        tail = nullptr;
+        count = 0;
+        allocatedBytes = 0;
+    }
+
+private:
+    Chunk* getTailForAppend() {
+        if (!tail || tail->last == tail->capacity) {
+            const size_t capacity =
+                    tail ? std::min(size_t(tail->capacity) * 2, MaxChunkSize)
+                         : MinChunkSize;
+            linkChunkAtTail(createChunk(capacity));
+        }
+        return tail;
+    }
+
+    /// @return true if a chunk with `live` elements is worth compacting.
+    static bool isSparse(const Chunk& chunk, size_t live) {
+        return chunk.capacity > MinChunkSize && live * 4 <= chunk.capacity;
+    }
+
+    void eraseSlot(Chunk* chunk, uint32_t index) {
+        chunk->slots()[index] = T{};
+        --chunk->live;
+        --count;
+    }
+
+    /**
+     * Move the live elements of chunk (which must not be the tail) to a new
+     * chunk of exactly the required size, which replaces it.
+     * @return iterator to the element following slot `erased` of chunk.
+     */
+    template <class Relocated>
+    iterator compactChunk(Chunk* chunk, uint32_t erased, Relocated& relocated) {
+        auto* compacted = createChunk(chunk->live);
+        iterator next;
+        for (auto ii = chunk->first; ii < chunk->last; ++ii) {
+            auto& slot = chunk->slots()[ii];
+            if (!slot) {
+                continue;
+            }
+            const auto index = compacted->last++;
+            compacted->slots()[index] = std::move(slot);
+            slot = T{};
+            ++compacted->live;
+            const iterator to(this, compacted, index);
+            if (ii > erased && !next.chunk) {
+                next = to;
+            }
+            relocated(iterator(this, chunk, ii), to);
+        }
+
+        compacted->prev = chunk->prev;
+        compacted->next = chunk->next;
+        if (chunk->prev) {
+            chunk->prev->next = compacted;
+        } else {
+            head = compacted;
+        }
+        // Not the tail, so there is a next chunk.
+        chunk->next->prev = compacted;
+        allocatedBytes += getChunkAllocationSize(compacted->capacity);
+        allocatedBytes -= getChunkAllocationSize(chunk->capacity);
+        destroyChunk(chunk);
+
+        if (!next.chunk) {
+            next = iterator(this, compacted->next, compacted->next->first);
+            next.skipForward();
+        }
+        return next;
+    }
+
+    Chunk* createChunk(size_t capacity) {
+        ByteAllocator byteAllocator(allocator);
+        const auto bytes = getChunkAllocationSize(capacity);
+        auto* memory = ByteTraits::allocate(byteAllocator, bytes);
+        auto* chunk = new (memory) Chunk(static_cast<uint32_t>(capacity));
+        std::uninitialized_value_construct_n(chunk->slots(), capacity);
+        return chunk;
+    }
+
+    void linkChunkAtTail(Chunk* chunk) {
+        chunk->prev = tail;
+        chunk->next = nullptr;
+        if (tail) {
+            tail->next = chunk;
+        } else {
+            head = chunk;
+        }
+        tail = chunk;
+        count += chunk->live;
+        allocatedBytes += getChunkAllocationSize(chunk->capacity);
+    }
+
+    void unlinkChunk(Chunk* chunk) {
+        if (chunk->prev) {
+            chunk->prev->next = chunk->next;
+        } else {
+            head = chunk->next;
+        }
+        if (chunk->next) {
+            chunk->next->prev = chunk->prev;
+        } else {
+            tail = chunk->prev;
+        }
+        chunk->prev = chunk->next = nullptr;
+        allocatedBytes -= getChunkAllocationSize(chunk->capacity);
+    }
+
+    void destroyChunk(Chunk* chunk) {
+        const auto bytes = getChunkAllocationSize(chunk->capacity);
+        std::destroy_n(chunk->slots(), chunk->capacity);
+        chunk->~Chunk();
+        ByteAllocator byteAllocator(allocator);
+        ByteTraits::deallocate(
+                byteAllocator, reinterpret_cast<char*>(chunk), bytes);
+    }
+
+    Allocator allocator;
+    Chunk* head = nullptr;
+    Chunk* tail = nullptr;
+    size_type count = 0;
+    /// Bytes of the chunks currently linked into this queue.
+    size_t allocatedBytes = 0;
+};
@@ -232,6 +232,15 @@ ENGINE_ERROR_CODE ConnHandler::step(struct dcp_message_producers* producers) {
     return ENGINE_DISCONNECT;
 }
 
+ENGINE_ERROR_CODE ConnHandler::stepBatch(
+        struct dcp_message_producers* producers,
+        size_t maxBytes,
+        size_t& nmessages) {
+    const auto ret = step(producers);
+    nmessages = (ret == ENGINE_SUCCESS) ? 1 : 0;
+    return ret;
+}
+
 bool ConnHandler::handleResponse(const protocol_binary_response_header* resp) {
     logger->warn(
             "Disconnecting - This connection doesn't "
@@ -192,6 +192,19 @@ public:
 
     virtual ENGINE_ERROR_CODE step(struct dcp_message_producers* producers);
 
+    /**
+     * Add a batch of messages to the stream (see DcpIface::step_batch()).
+     * By default a single message is added with step().
+     *
+     * @param producers the message producers to add the messages with
+     * @param maxBytes the (approximate) size of the messages to add
+     * @param nmessages set to the number of messages added
+     */
+    virtual ENGINE_ERROR_CODE stepBatch(
+            struct dcp_message_producers* producers,
+            size_t maxBytes,
+            size_t& nmessages);
+
     /**
      * Sub-classes must implement a method that processes a response
      * to a request initiated by itself.
@@ -163,6 +163,18 @@ couchstore_error_t StatsOps::advise(couchstore_error_info_t* errinfo,
     return sf->orig_ops->advise(errinfo, sf->orig_handle, offs, len, adv);
 }
 
+couchstore_error_t StatsOps::advise(couchstore_error_info_t* errinfo,
+                                    FHStats* file,
+                                    cs_off_t offs,
+                                    cs_off_t len,
+                                    couchstore_file_advice_t adv) {
+    auto* sf = dynamic_cast<StatFile*>(file);
+    if (sf == nullptr) {
+        return COUCHSTORE_ERROR_INVALID_ARGUMENTS;
+    }
+    return sf->orig_ops->advise(errinfo, sf->orig_handle, offs, len, adv);
+}
+
 FileOpsInterface::FHStats* StatsOps::get_stats(couch_file_handle h) {
     // StatFile implements FHStats interface directly.
     auto* sf = reinterpret_cast<StatFile*>(h);
@@ -71,6 +71,20 @@ public:
     FHStats* get_stats(couch_file_handle handle) override;
     void destructor(couch_file_handle handle) override;
 
+    /**
+     * Advise on the access pattern of a range of an open file, for a caller
+     * which only has the file's stats (see couchstore_get_db_filestats).
+     * The advice goes through the FileOps the file was opened with.
+     *
+     * @return COUCHSTORE_ERROR_INVALID_ARGUMENTS if the file wasn't opened
+     *         via StatsOps.
+     */
+    static couchstore_error_t advise(couchstore_error_info_t* errinfo,
+                                     FHStats* file,
+                                     cs_off_t offset,
+                                     cs_off_t len,
+                                     couchstore_file_advice_t advice);
+
 protected:
     FileStats& stats;
     FileOpsInterface& wrapped_ops;
@@ -0,0 +1,392 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "couch-fs-syncgroup.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+#endif
+
+SyncGroupOps::SyncGroupOps(FileOpsInterface& ops, size_t syncThreads)
+    : wrapped_ops(ops) {
+    for (size_t ii = 1; ii < syncThreads; ++ii) {
+        syncWorkers.emplace_back([this]() { runWorker(); });
+    }
+}
+
+SyncGroupOps::~SyncGroupOps() {
+    {
+        std::lock_guard<std::mutex> guard(syncMutex);
+        stopWorkers = true;
+    }
+    syncStart.notify_all();
+    for (auto& worker : syncWorkers) {
+        worker.join();
+    }
+#ifdef __linux__
+    if (dirFd != -1) {
+        ::close(dirFd);
+    }
+#endif
+}
+
+bool SyncGroupOps::enableSyncfs(const std::string& dir) {
+#ifdef __linux__
+    if (dirFd == -1 && isSyncfsReliable()) {
+        dirFd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+#endif
+    return dirFd != -1;
+}
+
+bool SyncGroupOps::isSyncfsReliable() {
+#ifdef __linux__
+    struct utsname name;
+    int major = 0;
+    int minor = 0;
+    if (uname(&name) != 0 ||
+        std::sscanf(name.release, "%d.%d", &major, &minor) != 2) {
+        return false;
+    }
+    return major > 5 || (major == 5 && minor >= 8);
+#else
+    return false;
+#endif
+}
+
+void SyncGroupOps::beginGroup() {
+    auto none = std::thread::id();
+    if (!groupThread.compare_exchange_strong(none,
+                                             std::this_thread::get_id())) {
+        throw std::logic_error(
+                "SyncGroupOps::beginGroup: a group is already in progress");
+    }
+}
+
+bool SyncGroupOps::isInGroup() const {
+    return groupThread.load() == std::this_thread::get_id();
+}
+
+couchstore_error_t SyncGroupOps::completeGroup(
+        couchstore_error_info_t* errinfo) {
+    if (!isInGroup()) {
+        throw std::logic_error(
+                "SyncGroupOps::completeGroup: no group in progress on this "
+                "thread");
+    }
+
+    couchstore_error_t result = COUCHSTORE_SUCCESS;
+    size_t rounds = 0;
+    for (const auto* file : groupFiles) {
+        rounds = std::max(rounds, file->stages.size());
+    }
+
+    std::vector<File*> syncing;
+    for (size_t round = 0; round < rounds && result == COUCHSTORE_SUCCESS;
+         ++round) {
+        // The files whose round'th deferred sync is due; everything written
+        // before it has been issued to the wrapped ops.
+        syncing.clear();
+        for (auto* file : groupFiles) {
+            if (file->stages.size() > round) {
+                syncing.push_back(file);
+            }
+        }
+        result = barrier(errinfo, syncing);
+
+        // Now issue the writes which were held behind that sync.
+        for (auto* file : syncing) {
+            for (const auto& write : file->stages[round]) {
+                if (result != COUCHSTORE_SUCCESS) {
+                    break;
+                }
+                const auto written = wrapped_ops.pwrite(errinfo,
+                                                        file->handle,
+                                                        write.data.data(),
+                                                        write.data.size(),
+                                                        write.offset);
+                if (written != ssize_t(write.data.size())) {
+                    result = written < 0 ? couchstore_error_t(written)
+                                         : COUCHSTORE_ERROR_WRITE;
+                }
+            }
+        }
+    }
+
+    for (auto* file : groupFiles) {
+        file->stages.clear();
+        if (file->closePending) {
+            file->closePending = false;
+            const auto closed = wrapped_ops.close(errinfo, file->handle);
+            if (result == COUCHSTORE_SUCCESS) {
+                result = closed;
+            }
+        }
+        if (file->destroyPending) {
+            wrapped_ops.destructor(file->handle);
+            delete file;
+        }
+    }
+    groupFiles.clear();
+    groupThread.store(std::thread::id());
+    return result;
+}
+
+couchstore_error_t SyncGroupOps::barrier(couchstore_error_info_t* errinfo,
+                                         const std::vector<File*>& files) {
+#ifdef __linux__
+    if (dirFd != -1) {
+        // Writes buffered by the wrapped ops (e.g. IoUringOps) are issued
+        // when seeking to EOF.
+        for (auto* file : files) {
+            if (wrapped_ops.goto_eof(errinfo, file->handle) < 0) {
+                return COUCHSTORE_ERROR_WRITE;
+            }
+        }
+        if (::syncfs(dirFd) == -1) {
+            errinfo->error = errno;
+            return COUCHSTORE_ERROR_WRITE;
+        }
+        return COUCHSTORE_SUCCESS;
+    }
+#endif
+    if (syncWorkers.empty() || files.size() < 2) {
+        for (auto* file : files) {
+            const auto status = wrapped_ops.sync(errinfo, file->handle);
+            if (status != COUCHSTORE_SUCCESS) {
+                return status;
+            }
+        }
+        return COUCHSTORE_SUCCESS;
+    }
+
+    // Hand the files to the workers, and sync them alongside the workers.
+    std::unique_lock<std::mutex> lock(syncMutex);
+    barrierFiles = &files;
+    nextSync = 0;
+    syncsOutstanding = files.size();
+    syncStatus = COUCHSTORE_SUCCESS;
+    syncStart.notify_all();
+    syncFiles(lock);
+    syncDone.wait(lock, [this]() { return syncsOutstanding == 0; });
+    barrierFiles = nullptr;
+    if (syncStatus != COUCHSTORE_SUCCESS) {
+        *errinfo = syncErrinfo;
+    }
+    return syncStatus;
+}
+
+void SyncGroupOps::runWorker() {
+    std::unique_lock<std::mutex> lock(syncMutex);
+    while (true) {
+        syncStart.wait(lock, [this]() {
+            return stopWorkers ||
+                   (barrierFiles && nextSync < barrierFiles->size());
+        });
+        if (stopWorkers) {
+            return;
+        }
+        syncFiles(lock);
+    }
+}
+
+void SyncGroupOps::syncFiles(std::unique_lock<std::mutex>& lock) {
+    while (barrierFiles && nextSync < barrierFiles->size()) {
+        auto* file = (*barrierFiles)[nextSync++];
+        if (syncStatus != COUCHSTORE_SUCCESS) {
+            // The barrier has failed; don't start any more syncs.
+            if (--syncsOutstanding == 0) {
+                syncDone.notify_one();
+            }
+            continue;
+        }
+        lock.unlock();
+        couchstore_error_info_t errinfo{};
+        const auto status = wrapped_ops.sync(&errinfo, file->handle);
+        lock.lock();
+        if (status != COUCHSTORE_SUCCESS && syncStatus == COUCHSTORE_SUCCESS) {
+            syncStatus = status;
+            syncErrinfo = errinfo;
+        }
+        if (--syncsOutstanding == 0) {
+            syncDone.notify_one();
+        }
+    }
+}
+
+couch_file_handle SyncGroupOps::constructor(couchstore_error_info_t* errinfo) {
+    auto handle = wrapped_ops.constructor(errinfo);
+    if (!handle) {
+        return nullptr;
+    }
+    auto* file = new File;
+    file->handle = handle;
+    return reinterpret_cast<couch_file_handle>(file);
+}
+
+couchstore_error_t SyncGroupOps::open(couchstore_error_info_t* errinfo,
+                                      couch_file_handle* handle,
+                                      const char* path,
+                                      int oflag) {
+    return wrapped_ops.open(errinfo, &getFile(*handle).handle, path, oflag);
+}
+
+couchstore_error_t SyncGroupOps::close(couchstore_error_info_t* errinfo,
+                                       couch_file_handle handle) {
+    auto& file = getFile(handle);
+    if (!file.stages.empty()) {
+        file.closePending = true;
+        return COUCHSTORE_SUCCESS;
+    }
+    return wrapped_ops.close(errinfo, file.handle);
+}
+
+couchstore_error_t SyncGroupOps::set_periodic_sync(couch_file_handle handle,
+                                                   uint64_t period_bytes) {
+    return wrapped_ops.set_periodic_sync(getFile(handle).handle, period_bytes);
+}
+
+couchstore_error_t SyncGroupOps::set_tracing_enabled(couch_file_handle handle) {
+    return wrapped_ops.set_tracing_enabled(getFile(handle).handle);
+}
+
+couchstore_error_t SyncGroupOps::set_write_validation_enabled(
+        couch_file_handle handle) {
+    return wrapped_ops.set_write_validation_enabled(getFile(handle).handle);
+}
+
+couchstore_error_t SyncGroupOps::set_mprotect_enabled(
+        couch_file_handle handle) {
+    return wrapped_ops.set_mprotect_enabled(getFile(handle).handle);
+}
+
+ssize_t SyncGroupOps::pread(couchstore_error_info_t* errinfo,
+                            couch_file_handle handle,
+                            void* buf,
+                            size_t nbytes,
+                            cs_off_t offset) {
+    auto& file = getFile(handle);
+    auto rv = wrapped_ops.pread(errinfo, file.handle, buf, nbytes, offset);
+    if (rv < 0 || file.stages.empty()) {
+        return rv;
+    }
+
+    // Overlay any held writes (in the order they were made).
+    const auto end = offset + cs_off_t(nbytes);
+    auto* dest = static_cast<uint8_t*>(buf);
+    for (const auto& stage : file.stages) {
+        for (const auto& write : stage) {
+            const auto writeEnd = write.offset + cs_off_t(write.data.size());
+            const auto from = std::max(offset, write.offset);
+            const auto to = std::min(end, writeEnd);
+            if (from >= to) {
+                continue;
+            }
+            if (from - offset > rv) {
+                // Beyond the end of the file; zero the gap.
+                std::memset(dest + rv, 0, from - offset - rv);
+            }
+            std::memcpy(dest + (from - offset),
+                        write.data.data() + (from - write.offset),
+                        to - from);
+            rv = std::max(rv, ssize_t(to - offset));
+        }
+    }
+    return rv;
+}
+
+ssize_t SyncGroupOps::pwrite(couchstore_error_info_t* errinfo,
+                             couch_file_handle handle,
+                             const void* buf,
+                             size_t nbytes,
+                             cs_off_t offset) {
+    auto& file = getFile(handle);
+    if (file.stages.empty()) {
+        return wrapped_ops.pwrite(errinfo, file.handle, buf, nbytes, offset);
+    }
+
+    // Hold the write behind the last deferred sync, coalescing appends.
+    auto& stage = file.stages.back();
+    const auto* data = static_cast<const uint8_t*>(buf);
+    if (!stage.empty() &&
+        stage.back().offset + cs_off_t(stage.back().data.size()) == offset) {
+        stage.back().data.insert(stage.back().data.end(), data, data + nbytes);
+    } else {
+        stage.push_back({offset, {data, data + nbytes}});
+    }
+    return nbytes;
+}
+
+cs_off_t SyncGroupOps::goto_eof(couchstore_error_info_t* errinfo,
+                                couch_file_handle handle) {
+    auto& file = getFile(handle);
+    auto eof = wrapped_ops.goto_eof(errinfo, file.handle);
+    if (eof < 0) {
+        return eof;
+    }
+    for (const auto& stage : file.stages) {
+        for (const auto& write : stage) {
+            eof = std::max(eof, write.offset + cs_off_t(write.data.size()));
+        }
+    }
+    return eof;
+}
+
+couchstore_error_t SyncGroupOps::sync(couchstore_error_info_t* errinfo,
+                                      couch_file_handle handle) {
+    auto& file = getFile(handle);
+    if (!isInGroup()) {
+        return wrapped_ops.sync(errinfo, file.handle);
+    }
+
+    if (file.stages.empty()) {
+        groupFiles.push_back(&file);
+    }
+    file.stages.emplace_back();
+    return COUCHSTORE_SUCCESS;
+}
+
+couchstore_error_t SyncGroupOps::advise(couchstore_error_info_t* errinfo,
+                                        couch_file_handle handle,
+                                        cs_off_t offset,
+                                        cs_off_t len,
+                                        couchstore_file_advice_t advice) {
+    return wrapped_ops.advise(
+            errinfo, getFile(handle).handle, offset, len, advice);
+}
+
+FileOpsInterface::FHStats* SyncGroupOps::get_stats(couch_file_handle handle) {
+    return wrapped_ops.get_stats(getFile(handle).handle);
+}
+
+void SyncGroupOps::destructor(couch_file_handle handle) {
+    auto& file = getFile(handle);
+    if (!file.stages.empty()) {
+        file.destroyPending = true;
+        return;
+    }
+    wrapped_ops.destructor(file.handle);
+    delete &file;
+}
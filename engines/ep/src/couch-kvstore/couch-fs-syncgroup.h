@@ -0,0 +1,209 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <libcouchstore/couch_db.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * FileOpsInterface implementation which wraps another FileOps, and allows
+ * the syncs of a group of files (e.g. the commits of many vBuckets) to be
+ * performed together - with a single durability barrier per round of syncs,
+ * instead of one fsync per file per sync.
+ *
+ * Between beginGroup() and completeGroup(), a sync() by the thread which
+ * began the group is deferred: it returns immediately, and any writes made
+ * to that file after it are held in memory (reads see them) until the sync
+ * has been performed. This preserves couchstore's crash-consistency - a
+ * commit's header never reaches the file before the data it references is
+ * durable.
+ *
+ * completeGroup() then, for each round of deferred syncs (a couchstore
+ * commit syncs twice: before and after writing the header), issues a single
+ * barrier for all the files with a sync in that round, followed by the
+ * writes which were held behind it. By default the barrier syncs each of
+ * those files (fdatasync by the default FileOps), so only the group's own
+ * files are flushed. The syncs are issued concurrently by up to syncThreads
+ * threads (the group's thread and syncThreads - 1 workers), so a barrier
+ * costs about one sync's latency rather than one per file. See
+ * enableSyncfs() for a single syncfs() barrier instead.
+ *
+ * Closing or destroying a file with deferred syncs is also deferred until
+ * completeGroup(). Files used by other threads are not affected by a group.
+ */
+class SyncGroupOps : public FileOpsInterface {
+public:
+    /**
+     * @param ops The FileOps to wrap. Its sync() must be safe to call
+     *        concurrently for different files.
+     * @param syncThreads The number of files a barrier syncs at once
+     */
+    explicit SyncGroupOps(FileOpsInterface& ops, size_t syncThreads = 1);
+
+    ~SyncGroupOps() override;
+
+    /**
+     * Use a single syncfs() of the filesystem containing the given directory
+     * as the barrier, instead of syncing each file of the group. This also
+     * flushes the dirty data of every other file on that filesystem
+     * (including those of other buckets and shards).
+     *
+     * syncfs() only reports writeback errors since Linux 5.8; before that a
+     * failed write could be acknowledged as persisted, so syncfs is refused
+     * unless isSyncfsReliable().
+     *
+     * @param dir A directory on the filesystem of the files synced in groups
+     * @return true if syncfs() will be used.
+     */
+    bool enableSyncfs(const std::string& dir);
+
+    /// @return true if syncfs() reports writeback errors on the running
+    ///         kernel (Linux 5.8 or later).
+    static bool isSyncfsReliable();
+
+    /**
+     * Begin deferring the syncs of the calling thread.
+     * @throws std::logic_error if a group is already in progress.
+     */
+    void beginGroup();
+
+    /// @return true if the calling thread has a group in progress.
+    bool isInGroup() const;
+
+    /**
+     * Perform the syncs (and writes held behind them) deferred since
+     * beginGroup(), then complete any deferred closes.
+     *
+     * If a barrier fails the writes held behind it are discarded, so each
+     * file is left as of its last successful sync.
+     *
+     * @return COUCHSTORE_SUCCESS, or the first error encountered.
+     */
+    couchstore_error_t completeGroup(couchstore_error_info_t* errinfo);
+
+    couch_file_handle constructor(couchstore_error_info_t* errinfo) override;
+    couchstore_error_t open(couchstore_error_info_t* errinfo,
+                            couch_file_handle* handle,
+                            const char* path,
+                            int oflag) override;
+    couchstore_error_t close(couchstore_error_info_t* errinfo,
+                             couch_file_handle handle) override;
+    couchstore_error_t set_periodic_sync(couch_file_handle handle,
+                                         uint64_t period_bytes) override;
+    couchstore_error_t set_tracing_enabled(couch_file_handle handle) override;
+    couchstore_error_t set_write_validation_enabled(
+            couch_file_handle handle) override;
+    couchstore_error_t set_mprotect_enabled(couch_file_handle handle) override;
+
+    ssize_t pread(couchstore_error_info_t* errinfo,
+                  couch_file_handle handle,
+                  void* buf,
+                  size_t nbytes,
+                  cs_off_t offset) override;
+    ssize_t pwrite(couchstore_error_info_t* errinfo,
+                   couch_file_handle handle,
+                   const void* buf,
+                   size_t nbytes,
+                   cs_off_t offset) override;
+    cs_off_t goto_eof(couchstore_error_info_t* errinfo,
+                      couch_file_handle handle) override;
+    couchstore_error_t sync(couchstore_error_info_t* errinfo,
+                            couch_file_handle handle) override;
+    couchstore_error_t advise(couchstore_error_info_t* errinfo,
+                              couch_file_handle handle,
+                              cs_off_t offset,
+                              cs_off_t len,
+                              couchstore_file_advice_t advice) override;
+    FHStats* get_stats(couch_file_handle handle) override;
+    void destructor(couch_file_handle handle) override;
+
+protected:
+    /// A run of contiguous held write data.
+    struct PendingWrite {
+        cs_off_t offset;
+        std::vector<uint8_t> data;
+    };
+
+    struct File {
+        couch_file_handle handle = nullptr;
+        /// The writes held behind each deferred sync: stages[i] are the
+        /// writes made after the i'th deferred sync. Empty if the file has
+        /// no deferred sync.
+        std::vector<std::vector<PendingWrite>> stages;
+        bool closePending = false;
+        bool destroyPending = false;
+    };
+
+    static File& getFile(couch_file_handle handle) {
+        return *reinterpret_cast<File*>(handle);
+    }
+
+    /// Make the writes issued to the given files durable.
+    couchstore_error_t barrier(couchstore_error_info_t* errinfo,
+                               const std::vector<File*>& files);
+
+    /// Body of the sync worker threads.
+    void runWorker();
+
+    /**
+     * Sync the files of the current barrier which no other thread has
+     * started, until there are none left (or one has failed).
+     * @param lock Holds syncMutex (released while syncing)
+     */
+    void syncFiles(std::unique_lock<std::mutex>& lock);
+
+    FileOpsInterface& wrapped_ops;
+
+    /// Threads which sync files alongside the group's thread in a barrier.
+    std::vector<std::thread> syncWorkers;
+
+    /// Guards the fields below, which describe the barrier in progress.
+    std::mutex syncMutex;
+    /// Signalled when a barrier begins (or the workers must stop).
+    std::condition_variable syncStart;
+    /// Signalled when the last file of a barrier has been synced.
+    std::condition_variable syncDone;
+    /// The files of the barrier in progress, or null if none.
+    const std::vector<File*>* barrierFiles = nullptr;
+    /// Index in barrierFiles of the next file to sync.
+    size_t nextSync = 0;
+    /// The files of the barrier not yet synced.
+    size_t syncsOutstanding = 0;
+    /// The first error of the barrier, and its error info.
+    couchstore_error_t syncStatus = COUCHSTORE_SUCCESS;
+    couchstore_error_info_t syncErrinfo{};
+    bool stopWorkers = false;
+
+    /// Descriptor of the directory used for syncfs(), or -1 to sync each
+    /// file instead.
+    int dirFd = -1;
+
+    /// The thread with a group in progress (default-constructed if none).
+    std::atomic<std::thread::id> groupThread{};
+
+    /// Files with deferred syncs in the current group, in the order of their
+    /// first deferred sync. Only accessed by groupThread.
+    std::vector<File*> groupFiles;
+};
@@ -0,0 +1,839 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "couch-fs-uring.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <system_error>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef HAVE_IO_URING
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// The io_uring syscall numbers are common to all architectures.
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup 425
+#endif
+#ifndef __NR_io_uring_enter
+#define __NR_io_uring_enter 426
+#endif
+#ifndef __NR_io_uring_register
+#define __NR_io_uring_register 427
+#endif
+
+namespace {
+
+/**
+ * Minimal io_uring submission/completion ring, used by a single thread.
+ *
+ * Only the operations available since the first io_uring kernel (5.1) are
+ * used - READV, WRITEV, READ_FIXED and FSYNC.
+ */
+class Ring {
+public:
+    explicit Ring(unsigned entries) {
+        io_uring_params params{};
+        fd = int(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0) {
+            throw std::system_error(
+                    errno, std::system_category(), "io_uring_setup");
+        }
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes +
+                     params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMmap = false;
+#ifdef IORING_FEAT_SINGLE_MMAP
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            singleMmap = true;
+            sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+        }
+#endif
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        try {
+            sqRing = map(sqRingSize, IORING_OFF_SQ_RING);
+            cqRing = singleMmap ? sqRing
+                                : map(cqRingSize, IORING_OFF_CQ_RING);
+            sqes = static_cast<io_uring_sqe*>(
+                    map(sqesSize, IORING_OFF_SQES));
+        } catch (const std::system_error&) {
+            // The destructor doesn't run for a throwing constructor
+            release();
+            throw;
+        }
+
+        auto* sq = static_cast<uint8_t*>(sqRing);
+        sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        capacity = params.sq_entries;
+        auto* cq = static_cast<uint8_t*>(cqRing);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        localTail = *sqTail;
+    }
+
+    ~Ring() {
+        release();
+    }
+
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+
+    /// @return the maximum number of requests which can be prepared before
+    ///         calling submitAndWait().
+    unsigned getCapacity() const {
+        return capacity;
+    }
+
+    /// @return a zeroed submission entry to fill in. At most getCapacity()
+    ///         may be prepared at once.
+    io_uring_sqe& prepare() {
+        auto& sqe = sqes[localTail & sqMask];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqArray[localTail & sqMask] = localTail & sqMask;
+        ++localTail;
+        ++prepared;
+        return sqe;
+    }
+
+    /**
+     * Submit all prepared requests and wait for them to complete.
+     *
+     * All the requests the kernel accepted are waited for (and their
+     * completions consumed) before returning, even on error, so that no
+     * completion is left on the ring for a later call to pick up.
+     *
+     * @param results Set to the result of each request, indexed by the
+     *        user_data the request was prepared with (which must be less
+     *        than the number of requests).
+     * @return 0 on success, otherwise the errno of io_uring_enter.
+     */
+    int submitAndWait(std::vector<int>& results) {
+        unsigned count = prepared;
+        prepared = 0;
+        results.assign(count, 0);
+
+        // Completions of requests an earlier call failed to wait for.
+        if (const int error = drainAbandoned()) {
+            localTail -= count;
+            return error;
+        }
+        __atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE);
+
+        int error = 0;
+        unsigned toSubmit = count;
+        unsigned completed = 0;
+        while (completed < count) {
+            const int rv = enter(toSubmit, count - completed);
+            if (rv < 0) {
+                if (isTransient(errno)) {
+                    completed += reap(results, completed, count);
+                    continue;
+                }
+                if (error) {
+                    // Can't wait for the requests in flight (their buffers
+                    // must outlive them, so this only happens if the ring
+                    // itself is broken); drain their completions before the
+                    // ring is used again.
+                    abandoned = count - completed;
+                    return error;
+                }
+                error = errno;
+                // Withdraw the requests the kernel didn't consume, then
+                // wait for those it did.
+                localTail -= toSubmit;
+                __atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE);
+                count -= toSubmit;
+                toSubmit = 0;
+                continue;
+            }
+            toSubmit -= std::min(toSubmit, unsigned(rv));
+            completed += reap(results, completed, count);
+        }
+        return error;
+    }
+
+    /**
+     * Register the given buffer for use by READ_FIXED requests (as buffer
+     * index 0).
+     * @return true on success.
+     */
+    bool registerBuffer(void* buf, size_t len) {
+        iovec iov{buf, len};
+        return syscall(__NR_io_uring_register,
+                       fd,
+                       IORING_REGISTER_BUFFERS,
+                       &iov,
+                       1) == 0;
+    }
+
+private:
+    void* map(size_t size, off_t offset) {
+        void* ptr = mmap(nullptr,
+                         size,
+                         PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE,
+                         fd,
+                         offset);
+        if (ptr == MAP_FAILED) {
+            throw std::system_error(
+                    errno, std::system_category(), "io_uring mmap");
+        }
+        return ptr;
+    }
+
+    /// Unmap whatever has been mapped, and close the ring.
+    void release() {
+        if (sqes) {
+            munmap(sqes, sqesSize);
+        }
+        if (cqRing && cqRing != sqRing) {
+            munmap(cqRing, cqRingSize);
+        }
+        if (sqRing) {
+            munmap(sqRing, sqRingSize);
+        }
+        ::close(fd);
+    }
+
+    int enter(unsigned toSubmit, unsigned minComplete) {
+        return int(syscall(__NR_io_uring_enter,
+                           fd,
+                           toSubmit,
+                           minComplete,
+                           IORING_ENTER_GETEVENTS,
+                           nullptr,
+                           0));
+    }
+
+    /// @return true if io_uring_enter may be retried after the error:
+    ///         interrupted, or short of resources until completions are
+    ///         consumed.
+    static bool isTransient(int error) {
+        return error == EINTR || error == EAGAIN || error == EBUSY;
+    }
+
+    /// Wait for and discard the completions of abandoned requests.
+    /// @return 0 on success, otherwise the errno of io_uring_enter.
+    int drainAbandoned() {
+        std::vector<int> discard;
+        while (abandoned > 0) {
+            if (enter(0, abandoned) < 0 && !isTransient(errno)) {
+                return errno;
+            }
+            abandoned -= reap(discard, 0, abandoned);
+        }
+        return 0;
+    }
+
+    /// Consume available completions, until `completed` reaches `until`.
+    /// @return the number of completions consumed.
+    unsigned reap(std::vector<int>& results,
+                  unsigned completed,
+                  unsigned until) {
+        unsigned head = *cqHead;
+        const unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        unsigned reaped = 0;
+        while (head != tail && completed + reaped < until) {
+            const auto& cqe = cqes[head & cqMask];
+            if (cqe.user_data < results.size()) {
+                results[cqe.user_data] = cqe.res;
+            }
+            ++head;
+            ++reaped;
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        return reaped;
+    }
+
+    int fd = -1;
+
+    void* sqRing = nullptr;
+    size_t sqRingSize = 0;
+    void* cqRing = nullptr;
+    size_t cqRingSize = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqesSize = 0;
+
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned sqMask = 0;
+    unsigned* sqArray = nullptr;
+    unsigned capacity = 0;
+    /// Tail of the submission queue including prepared (not yet published)
+    /// entries.
+    unsigned localTail = 0;
+    unsigned prepared = 0;
+    /// Number of requests submitted by a failed submitAndWait() whose
+    /// completions are yet to be consumed.
+    unsigned abandoned = 0;
+
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+};
+
+constexpr unsigned ringEntries = 64;
+
+/// The ring (and direct read buffer) of a thread.
+struct ThreadContext {
+    ThreadContext() : ring(ringEntries) {
+    }
+
+    ~ThreadContext() {
+        free(directBuffer);
+    }
+
+    /// @return the bounce buffer for direct reads, allocating (and
+    ///         registering) it on first use; nullptr if it can't be
+    ///         allocated.
+    uint8_t* getDirectBuffer() {
+        if (!directBuffer &&
+            posix_memalign(&directBuffer,
+                           IoUringOps::directAlignment,
+                           IoUringOps::directBufferSize) == 0) {
+            // Registration pins the buffer's pages, which may exceed
+            // RLIMIT_MEMLOCK - fall back to unregistered reads if so.
+            directBufferRegistered = ring.registerBuffer(
+                    directBuffer, IoUringOps::directBufferSize);
+        }
+        return static_cast<uint8_t*>(directBuffer);
+    }
+
+    Ring ring;
+    void* directBuffer = nullptr;
+    bool directBufferRegistered = false;
+};
+
+ThreadContext& getThreadContext() {
+    thread_local ThreadContext context;
+    return context;
+}
+
+void prepareRw(io_uring_sqe& sqe,
+               uint8_t opcode,
+               int fd,
+               const void* addr,
+               uint32_t len,
+               cs_off_t offset,
+               uint64_t userData) {
+    sqe.opcode = opcode;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<uint64_t>(addr);
+    sqe.len = len;
+    sqe.off = uint64_t(offset);
+    sqe.user_data = userData;
+}
+
+/// Submit a single prepared request and wait for it.
+/// @return the (negative errno on error) result of the request.
+int runOne(Ring& ring) {
+    std::vector<int> results;
+    const int error = ring.submitAndWait(results);
+    return error ? -error : results.front();
+}
+
+} // anonymous namespace
+
+#endif // HAVE_IO_URING
+
+static void save_errno(couchstore_error_info_t* errinfo, int error) {
+    if (errinfo) {
+        errinfo->error = error;
+    }
+}
+
+IoUringOps::IoUringOps(bool directReads) : directReads(directReads) {
+}
+
+bool IoUringOps::isSupported() {
+#ifdef HAVE_IO_URING
+    static const bool supported = [] {
+        try {
+            Ring ring(1);
+            return true;
+        } catch (const std::system_error&) {
+            return false;
+        }
+    }();
+    return supported;
+#else
+    return false;
+#endif
+}
+
+couch_file_handle IoUringOps::constructor(couchstore_error_info_t* errinfo) {
+    return reinterpret_cast<couch_file_handle>(new File);
+}
+
+#ifdef HAVE_IO_URING
+
+couchstore_error_t IoUringOps::open(couchstore_error_info_t* errinfo,
+                                    couch_file_handle* handle,
+                                    const char* path,
+                                    int oflag) {
+    auto* file = &getFile(*handle);
+    if (file->fd != -1) {
+        throw std::logic_error("IoUringOps::open: file already open");
+    }
+
+    int fd;
+    do {
+        fd = ::open(path, oflag | O_LARGEFILE | O_CLOEXEC, 0666);
+    } while (fd == -1 && errno == EINTR);
+    if (fd < 0) {
+        save_errno(errinfo, errno);
+        return errno == ENOENT ? COUCHSTORE_ERROR_NO_SUCH_FILE
+                               : COUCHSTORE_ERROR_OPEN_FILE;
+    }
+
+    *file = File{};
+    file->fd = fd;
+    if (directReads) {
+        // Not all filesystems support O_DIRECT (e.g. tmpfs); reads then
+        // just go via the page cache.
+        file->directFd = ::open(path, O_RDONLY | O_DIRECT | O_CLOEXEC);
+    }
+    return COUCHSTORE_SUCCESS;
+}
+
+couchstore_error_t IoUringOps::close(couchstore_error_info_t* errinfo,
+                                     couch_file_handle handle) {
+    auto* file = &getFile(handle);
+    if (file->fd == -1) {
+        return COUCHSTORE_SUCCESS;
+    }
+
+    auto status = flushWrites(errinfo, *file, false);
+    if (file->directFd != -1) {
+        ::close(file->directFd);
+    }
+    int rv;
+    do {
+        rv = ::close(file->fd);
+    } while (rv == -1 && errno == EINTR);
+    if (rv < 0 && status == COUCHSTORE_SUCCESS) {
+        save_errno(errinfo, errno);
+        status = COUCHSTORE_ERROR_FILE_CLOSE;
+    }
+    *file = File{};
+    return status;
+}
+
+couchstore_error_t IoUringOps::set_periodic_sync(couch_file_handle handle,
+                                                 uint64_t period_bytes) {
+    getFile(handle).periodicSyncBytes = period_bytes;
+    return COUCHSTORE_SUCCESS;
+}
+
+ssize_t IoUringOps::pread(couchstore_error_info_t* errinfo,
+                          couch_file_handle handle,
+                          void* buf,
+                          size_t nbytes,
+                          cs_off_t offset) {
+    auto& file = getFile(handle);
+
+    // Data still buffered must be written before it can be read back.
+    const bool overlapsPending = std::any_of(
+            file.pending.begin(),
+            file.pending.end(),
+            [offset, nbytes](const PendingWrite& write) {
+                return write.offset < offset + cs_off_t(nbytes) &&
+                       offset < write.offset + cs_off_t(write.data.size());
+            });
+    if (overlapsPending) {
+        const auto status = flushWrites(errinfo, file, false);
+        if (status != COUCHSTORE_SUCCESS) {
+            return status;
+        }
+    }
+
+    if (file.directFd != -1) {
+        return readDirect(errinfo, file, buf, nbytes, offset);
+    }
+
+    auto& ring = getThreadContext().ring;
+    size_t done = 0;
+    while (done < nbytes) {
+        iovec iov{static_cast<uint8_t*>(buf) + done, nbytes - done};
+        prepareRw(ring.prepare(),
+                  IORING_OP_READV,
+                  file.fd,
+                  &iov,
+                  1,
+                  offset + done,
+                  0);
+        const int rv = runOne(ring);
+        if (rv < 0) {
+            save_errno(errinfo, -rv);
+            return COUCHSTORE_ERROR_READ;
+        }
+        if (rv == 0) {
+            // EOF
+            break;
+        }
+        done += rv;
+    }
+    return done;
+}
+
+ssize_t IoUringOps::readDirect(couchstore_error_info_t* errinfo,
+                               File& file,
+                               void* buf,
+                               size_t nbytes,
+                               cs_off_t offset) {
+    auto& context = getThreadContext();
+    auto* bounce = context.getDirectBuffer();
+    if (!bounce) {
+        save_errno(errinfo, ENOMEM);
+        return COUCHSTORE_ERROR_ALLOC_FAIL;
+    }
+
+    size_t done = 0;
+    while (done < nbytes) {
+        const cs_off_t position = offset + done;
+        const cs_off_t aligned = position & ~cs_off_t(directAlignment - 1);
+        const size_t skip = size_t(position - aligned);
+        const size_t wanted = nbytes - done;
+        const size_t len = std::min(
+                directBufferSize,
+                (skip + wanted + directAlignment - 1) & ~(directAlignment - 1));
+
+        auto& sqe = context.ring.prepare();
+        iovec iov{bounce, len};
+        if (context.directBufferRegistered) {
+            prepareRw(sqe,
+                      IORING_OP_READ_FIXED,
+                      file.directFd,
+                      bounce,
+                      uint32_t(len),
+                      aligned,
+                      0);
+            sqe.buf_index = 0;
+        } else {
+            prepareRw(sqe,
+                      IORING_OP_READV,
+                      file.directFd,
+                      &iov,
+                      1,
+                      aligned,
+                      0);
+        }
+        const int rv = runOne(context.ring);
+        if (rv < 0) {
+            save_errno(errinfo, -rv);
+            return COUCHSTORE_ERROR_READ;
+        }
+        if (size_t(rv) <= skip) {
+            // EOF
+            break;
+        }
+        const size_t copied = std::min(size_t(rv) - skip, wanted);
+        std::memcpy(static_cast<uint8_t*>(buf) + done, bounce + skip, copied);
+        done += copied;
+    }
+    return done;
+}
+
+ssize_t IoUringOps::pwrite(couchstore_error_info_t* errinfo,
+                           couch_file_handle handle,
+                           const void* buf,
+                           size_t nbytes,
+                           cs_off_t offset) {
+    auto& file = getFile(handle);
+    if (file.writeError) {
+        save_errno(errinfo, file.writeError);
+        return COUCHSTORE_ERROR_WRITE;
+    }
+
+    const auto* data = static_cast<const uint8_t*>(buf);
+    if (!file.pending.empty() &&
+        file.pending.back().offset +
+                        cs_off_t(file.pending.back().data.size()) ==
+                offset) {
+        // Couchstore (almost) always appends; extend the current run.
+        auto& run = file.pending.back().data;
+        run.insert(run.end(), data, data + nbytes);
+    } else {
+        file.pending.push_back({offset, {data, data + nbytes}});
+    }
+    file.pendingBytes += nbytes;
+
+    if (file.pendingBytes >= maxPendingBytes) {
+        const auto status = flushWrites(errinfo, file, false);
+        if (status != COUCHSTORE_SUCCESS) {
+            return status;
+        }
+    }
+    return nbytes;
+}
+
+couchstore_error_t IoUringOps::flushWrites(couchstore_error_info_t* errinfo,
+                                           File& file,
+                                           bool sync) {
+    if (file.writeError) {
+        save_errno(errinfo, file.writeError);
+        return COUCHSTORE_ERROR_WRITE;
+    }
+
+    struct Request {
+        const uint8_t* data;
+        size_t len;
+        cs_off_t offset;
+        iovec iov;
+    };
+    // Each run is split into requests of at most maxPendingBytes (runs may
+    // exceed that as a single large pwrite is buffered whole).
+    std::vector<Request> requests;
+    for (const auto& write : file.pending) {
+        for (size_t pos = 0; pos < write.data.size(); pos += maxPendingBytes) {
+            requests.push_back(
+                    {write.data.data() + pos,
+                     std::min(maxPendingBytes, write.data.size() - pos),
+                     write.offset + cs_off_t(pos),
+                     {}});
+        }
+    }
+    file.unsyncedBytes += file.pendingBytes;
+    sync = sync || (file.periodicSyncBytes != 0 &&
+                    file.unsyncedBytes >= file.periodicSyncBytes);
+
+    auto& ring = getThreadContext().ring;
+    std::vector<int> results;
+    int error = 0;
+    // Indices of the requests still to be (completely) written.
+    std::vector<size_t> todo(requests.size());
+    for (size_t ii = 0; ii < todo.size(); ++ii) {
+        todo[ii] = ii;
+    }
+
+    while (!error && (!todo.empty() || sync)) {
+        const size_t batch = std::min(todo.size(), size_t(ring.getCapacity()));
+        for (size_t ii = 0; ii < batch; ++ii) {
+            auto& request = requests[todo[ii]];
+            request.iov = {const_cast<uint8_t*>(request.data), request.len};
+            prepareRw(ring.prepare(),
+                      IORING_OP_WRITEV,
+                      file.fd,
+                      &request.iov,
+                      1,
+                      request.offset,
+                      ii);
+        }
+        // Sync in the same submission as the final batch of writes,
+        // ordered after them.
+        const bool syncNow = sync && batch == todo.size() &&
+                             batch < ring.getCapacity();
+        if (syncNow) {
+            auto& sqe = ring.prepare();
+            sqe.opcode = IORING_OP_FSYNC;
+            sqe.fd = file.fd;
+            sqe.fsync_flags = IORING_FSYNC_DATASYNC;
+            sqe.flags = IOSQE_IO_DRAIN;
+            sqe.user_data = batch;
+        }
+
+        error = ring.submitAndWait(results);
+        if (error) {
+            break;
+        }
+
+        std::vector<size_t> remaining;
+        for (size_t ii = 0; ii < batch && !error; ++ii) {
+            auto& request = requests[todo[ii]];
+            const int rv = results[ii];
+            if (rv < 0) {
+                error = -rv;
+            } else if (rv == 0) {
+                error = EIO;
+            } else if (size_t(rv) < request.len) {
+                // Short write - resubmit the rest.
+                request.data += rv;
+                request.len -= rv;
+                request.offset += rv;
+                remaining.push_back(todo[ii]);
+            }
+        }
+        if (syncNow && !error) {
+            if (!remaining.empty()) {
+                // The sync may not have covered the resubmitted data.
+                sync = true;
+            } else if (results[batch] < 0) {
+                error = -results[batch];
+            } else {
+                sync = false;
+                file.unsyncedBytes = 0;
+            }
+        }
+        remaining.insert(remaining.end(), todo.begin() + batch, todo.end());
+        todo = std::move(remaining);
+    }
+
+    file.pending.clear();
+    file.pendingBytes = 0;
+    if (error) {
+        file.writeError = error;
+        save_errno(errinfo, error);
+        return COUCHSTORE_ERROR_WRITE;
+    }
+    return COUCHSTORE_SUCCESS;
+}
+
+cs_off_t IoUringOps::goto_eof(couchstore_error_info_t* errinfo,
+                              couch_file_handle handle) {
+    auto& file = getFile(handle);
+    const auto status = flushWrites(errinfo, file, false);
+    if (status != COUCHSTORE_SUCCESS) {
+        return status;
+    }
+    const cs_off_t rv = ::lseek(file.fd, 0, SEEK_END);
+    if (rv < 0) {
+        save_errno(errinfo, errno);
+        return COUCHSTORE_ERROR_READ;
+    }
+    return rv;
+}
+
+couchstore_error_t IoUringOps::sync(couchstore_error_info_t* errinfo,
+                                    couch_file_handle handle) {
+    return flushWrites(errinfo, getFile(handle), true);
+}
+
+couchstore_error_t IoUringOps::advise(couchstore_error_info_t* errinfo,
+                                      couch_file_handle handle,
+                                      cs_off_t offset,
+                                      cs_off_t len,
+                                      couchstore_file_advice_t advice) {
+    const int error =
+            posix_fadvise(getFile(handle).fd, offset, len, int(advice));
+    if (error != 0) {
+        save_errno(errinfo, error);
+        return COUCHSTORE_ERROR_FILE_CLOSE;
+    }
+    return COUCHSTORE_SUCCESS;
+}
+
+#else // !HAVE_IO_URING
+
+// isSupported() is false; CouchKVStore never selects these ops.
+
+couchstore_error_t IoUringOps::open(couchstore_error_info_t* errinfo,
+                                    couch_file_handle*,
+                                    const char*,
+                                    int) {
+    save_errno(errinfo, ENOTSUP);
+    return COUCHSTORE_ERROR_OPEN_FILE;
+}
+
+couchstore_error_t IoUringOps::close(couchstore_error_info_t*,
+                                     couch_file_handle) {
+    return COUCHSTORE_SUCCESS;
+}
+
+couchstore_error_t IoUringOps::set_periodic_sync(couch_file_handle, uint64_t) {
+    return COUCHSTORE_SUCCESS;
+}
+
+ssize_t IoUringOps::pread(couchstore_error_info_t* errinfo,
+                          couch_file_handle,
+                          void*,
+                          size_t,
+                          cs_off_t) {
+    save_errno(errinfo, ENOTSUP);
+    return COUCHSTORE_ERROR_READ;
+}
+
+ssize_t IoUringOps::pwrite(couchstore_error_info_t* errinfo,
+                           couch_file_handle,
+                           const void*,
+                           size_t,
+                           cs_off_t) {
+    save_errno(errinfo, ENOTSUP);
+    return COUCHSTORE_ERROR_WRITE;
+}
+
+cs_off_t IoUringOps::goto_eof(couchstore_error_info_t* errinfo,
+                              couch_file_handle) {
+    save_errno(errinfo, ENOTSUP);
+    return COUCHSTORE_ERROR_READ;
+}
+
+couchstore_error_t IoUringOps::sync(couchstore_error_info_t* errinfo,
+                                    couch_file_handle) {
+    save_errno(errinfo, ENOTSUP);
+    return COUCHSTORE_ERROR_WRITE;
+}
+
+couchstore_error_t IoUringOps::advise(couchstore_error_info_t*,
+                                      couch_file_handle,
+                                      cs_off_t,
+                                      cs_off_t,
+                                      couchstore_file_advice_t) {
+    return COUCHSTORE_SUCCESS;
+}
+
+#endif // HAVE_IO_URING
+
+couchstore_error_t IoUringOps::set_tracing_enabled(couch_file_handle) {
+    return COUCHSTORE_SUCCESS;
+}
+
+couchstore_error_t IoUringOps::set_write_validation_enabled(couch_file_handle) {
+    return COUCHSTORE_SUCCESS;
+}
+
+couchstore_error_t IoUringOps::set_mprotect_enabled(couch_file_handle) {
+    return COUCHSTORE_SUCCESS;
+}
+
+FileOpsInterface::FHStats* IoUringOps::get_stats(couch_file_handle) {
+    return nullptr;
+}
+
+void IoUringOps::destructor(couch_file_handle handle) {
+    delete reinterpret_cast<File*>(handle);
+}
+
+FileOpsInterface& getCouchstoreBaseOps(const std::string& ioBackend,
+                                       bool directReads) {
+    if (ioBackend == "io_uring" && IoUringOps::isSupported()) {
+        static IoUringOps buffered(false);
+        static IoUringOps direct(true);
+        return directReads ? direct : buffered;
+    }
+    return *couchstore_get_default_file_ops();
+}
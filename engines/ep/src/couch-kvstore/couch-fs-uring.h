@@ -0,0 +1,166 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <libcouchstore/couch_db.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * FileOpsInterface implementation which performs couchstore's file IO via
+ * Linux io_uring. Only writes (and their syncs) are batched, instead of one
+ * pwrite()/fsync() syscall per operation.
+ *
+ * Writes are buffered per file (contiguous appends are coalesced), and
+ * submitted as a single batch of write requests when the buffer reaches
+ * maxPendingBytes, or when couchstore syncs, seeks to EOF, closes the file or
+ * reads back data which is still buffered. A sync is submitted in the same
+ * io_uring_enter() call as the writes preceding it, so a flusher commit
+ * (saveDocs) costs a couple of syscalls instead of one per block written.
+ *
+ * Reads are not batched: couchstore reads synchronously, one pread() at a
+ * time, each depending on the last (a B-tree node, then the next node or a
+ * document), so each read is a single request waited for on its own - the
+ * same cost as pread(). To overlap the reads of a getMulti batch
+ * CouchKVStore advises the kernel of them up front when they go via the
+ * page cache (see prefetchDocs).
+ *
+ * Reads optionally bypass the page cache (O_DIRECT). They are then performed
+ * into a per-thread, page-aligned bounce buffer which is registered with the
+ * ring, saving the kernel mapping the buffer on each read.
+ *
+ * A ring is created per thread using the ops, on first use. Errors from
+ * buffered writes are reported by the call which submitted them (a later
+ * pwrite, sync, goto_eof or close).
+ *
+ * Only available on Linux; see isSupported().
+ */
+class IoUringOps : public FileOpsInterface {
+public:
+    /// Maximum number of bytes of writes buffered per file before they are
+    /// submitted.
+    static constexpr size_t maxPendingBytes = 1024 * 1024;
+
+    /// Size of the per-thread bounce buffer used for direct reads.
+    static constexpr size_t directBufferSize = 1024 * 1024;
+
+    /// Alignment of direct reads (offset, length and buffer).
+    static constexpr size_t directAlignment = 4096;
+
+    /**
+     * @param directReads If true read via an O_DIRECT file descriptor
+     *        (falling back to buffered reads for files which don't
+     *        support it).
+     */
+    explicit IoUringOps(bool directReads = false);
+
+    /**
+     * @return true if io_uring is available: the platform supports it and a
+     *         ring could be created (io_uring may be disabled by the kernel
+     *         configuration, sysctl or seccomp).
+     */
+    static bool isSupported();
+
+    couch_file_handle constructor(couchstore_error_info_t* errinfo) override;
+    couchstore_error_t open(couchstore_error_info_t* errinfo,
+                            couch_file_handle* handle,
+                            const char* path,
+                            int oflag) override;
+    couchstore_error_t close(couchstore_error_info_t* errinfo,
+                             couch_file_handle handle) override;
+    couchstore_error_t set_periodic_sync(couch_file_handle handle,
+                                         uint64_t period_bytes) override;
+    couchstore_error_t set_tracing_enabled(couch_file_handle handle) override;
+    couchstore_error_t set_write_validation_enabled(
+            couch_file_handle handle) override;
+    couchstore_error_t set_mprotect_enabled(couch_file_handle handle) override;
+
+    ssize_t pread(couchstore_error_info_t* errinfo,
+                  couch_file_handle handle,
+                  void* buf,
+                  size_t nbytes,
+                  cs_off_t offset) override;
+    ssize_t pwrite(couchstore_error_info_t* errinfo,
+                   couch_file_handle handle,
+                   const void* buf,
+                   size_t nbytes,
+                   cs_off_t offset) override;
+    cs_off_t goto_eof(couchstore_error_info_t* errinfo,
+                      couch_file_handle handle) override;
+    couchstore_error_t sync(couchstore_error_info_t* errinfo,
+                            couch_file_handle handle) override;
+    couchstore_error_t advise(couchstore_error_info_t* errinfo,
+                              couch_file_handle handle,
+                              cs_off_t offset,
+                              cs_off_t len,
+                              couchstore_file_advice_t advice) override;
+    FHStats* get_stats(couch_file_handle handle) override;
+    void destructor(couch_file_handle handle) override;
+
+protected:
+    /// A run of contiguous buffered write data.
+    struct PendingWrite {
+        cs_off_t offset;
+        std::vector<uint8_t> data;
+    };
+
+    struct File {
+        int fd = -1;
+        /// O_DIRECT descriptor of the same file for reads, or -1.
+        int directFd = -1;
+        std::vector<PendingWrite> pending;
+        size_t pendingBytes = 0;
+        /// Bytes written since the last sync, and the number after which
+        /// to sync automatically (0 = never).
+        uint64_t unsyncedBytes = 0;
+        uint64_t periodicSyncBytes = 0;
+        /// errno of the first failed write since open, or 0. Once set all
+        /// further writes fail.
+        int writeError = 0;
+    };
+
+    static File& getFile(couch_file_handle handle) {
+        return *reinterpret_cast<File*>(handle);
+    }
+
+    /**
+     * Submit the buffered writes of file, followed (if sync is true or the
+     * periodic sync threshold has been reached) by a datasync.
+     */
+    couchstore_error_t flushWrites(couchstore_error_info_t* errinfo,
+                                   File& file,
+                                   bool sync);
+
+    ssize_t readDirect(couchstore_error_info_t* errinfo,
+                       File& file,
+                       void* buf,
+                       size_t nbytes,
+                       cs_off_t offset);
+
+    const bool directReads;
+};
+
+/**
+ * @return the FileOpsInterface couchstore should use for the given
+ *         io_backend ("posix" or "io_uring"). Falls back to couchstore's
+ *         default (posix) ops if io_uring is requested but not supported.
+ */
+FileOpsInterface& getCouchstoreBaseOps(const std::string& ioBackend,
+                                       bool directReads);
@@ -33,6 +33,9 @@ public:
         if (key == "couchstore_mprotect") {
             config.setCouchstoreMprotectEnabled(value);
         }
+        if (key == "couchstore_bg_fetch_prefetch") {
+            config.setBgFetchPrefetch(value);
+        }
     }
 
 private:
@@ -42,7 +45,13 @@ private:
 CouchKVStoreConfig::CouchKVStoreConfig(Configuration& config,
                                        uint16_t maxShards,
                                        uint16_t shardId)
-    : KVStoreConfig(config, maxShards, shardId), buffered(true) {
+    : KVStoreConfig(config, maxShards, shardId),
+      buffered(true),
+      ioBackend(config.getCouchstoreIoBackend()),
+      ioUringDirectReads(config.isCouchstoreIoUringDirectReads()),
+      groupCommit(config.isFlusherGroupCommit()),
+      groupCommitSyncfs(config.isFlusherGroupCommitSyncfs()),
+      groupCommitSyncThreads(config.getFlusherGroupCommitSyncThreads()) {
     setCouchstoreTracingEnabled(config.isCouchstoreTracing());
     config.addValueChangedListener(
             "couchstore_tracing",
@@ -55,6 +64,10 @@ CouchKVStoreConfig::CouchKVStoreConfig(Configuration& config,
     config.addValueChangedListener(
             "couchstore_mprotect",
             std::make_unique<ConfigChangeListener>(*this));
+    setBgFetchPrefetch(config.isCouchstoreBgFetchPrefetch());
+    config.addValueChangedListener(
+            "couchstore_bg_fetch_prefetch",
+            std::make_unique<ConfigChangeListener>(*this));
 }
 
 CouchKVStoreConfig::CouchKVStoreConfig(uint16_t maxVBuckets,
@@ -64,7 +77,13 @@ CouchKVStoreConfig::CouchKVStoreConfig(uint16_t maxVBuckets,
                                        uint16_t shardId)
     : KVStoreConfig(maxVBuckets, maxShards, dbname, backend, shardId),
       buffered(true),
+      ioBackend("posix"),
+      ioUringDirectReads(false),
+      groupCommit(false),
+      groupCommitSyncfs(false),
+      groupCommitSyncThreads(1),
       couchstoreTracingEnabled(false),
       couchstoreWriteValidationEnabled(false),
-      couchstoreMprotectEnabled(false) {
+      couchstoreMprotectEnabled(false),
+      bgFetchPrefetch(true) {
 }
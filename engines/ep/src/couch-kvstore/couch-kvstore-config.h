@@ -83,11 +83,77 @@ public:
         return couchstoreMprotectEnabled;
     }
 
+    void setBgFetchPrefetch(bool value) {
+        bgFetchPrefetch = value;
+    }
+
+    bool getBgFetchPrefetch() const {
+        return bgFetchPrefetch;
+    }
+
+    void setIoBackend(const std::string& value) {
+        ioBackend = value;
+    }
+
+    /// @return how couchstore performs file IO ("posix" or "io_uring").
+    const std::string& getIoBackend() const {
+        return ioBackend;
+    }
+
+    void setIoUringDirectReads(bool value) {
+        ioUringDirectReads = value;
+    }
+
+    bool getIoUringDirectReads() const {
+        return ioUringDirectReads;
+    }
+
+    void setGroupCommit(bool value) {
+        groupCommit = value;
+    }
+
+    /// @return true if the store supports group commit (see
+    ///         KVStore::beginSyncGroup).
+    bool getGroupCommit() const {
+        return groupCommit;
+    }
+
+    void setGroupCommitSyncfs(bool value) {
+        groupCommitSyncfs = value;
+    }
+
+    /// @return true if group commits should use a syncfs() barrier (see
+    ///         SyncGroupOps::enableSyncfs).
+    bool getGroupCommitSyncfs() const {
+        return groupCommitSyncfs;
+    }
+
+    void setGroupCommitSyncThreads(size_t value) {
+        groupCommitSyncThreads = value;
+    }
+
+    /// @return the number of files a group commit barrier syncs at once
+    ///         (see SyncGroupOps).
+    size_t getGroupCommitSyncThreads() const {
+        return groupCommitSyncThreads;
+    }
+
 private:
     class ConfigChangeListener;
 
     bool buffered;
 
+    /* couchstore file IO backend; see getCouchstoreBaseOps() */
+    std::string ioBackend;
+    /* use O_DIRECT reads with the io_uring backend */
+    bool ioUringDirectReads;
+    /* defer the syncs of flusher commits to a group barrier */
+    bool groupCommit;
+    /* make that barrier a syncfs() of the data directory's filesystem */
+    bool groupCommitSyncfs;
+    /* the number of files that barrier syncs concurrently */
+    size_t groupCommitSyncThreads;
+
     // Following config variables are atomic as can be changed (via
     // ConfigChangeListener) at runtime by front-end threads while read by
     // IO threads.
@@ -98,4 +164,6 @@ private:
     std::atomic_bool couchstoreWriteValidationEnabled;
     /* enbale mprotect of couchstore internal io buffer */
     std::atomic_bool couchstoreMprotectEnabled;
+    /* prefetch the documents of bg-fetch batches */
+    std::atomic_bool bgFetchPrefetch;
 };
\ No newline at end of file
@@ -20,6 +20,8 @@
 #include "collections/collection_persisted_stats.h"
 #include "collections/kvstore_generated.h"
 #include "common.h"
+#include "couch-fs-syncgroup.h"
+#include "couch-fs-uring.h"
 #include "couch-kvstore-config.h"
 #include "diskdockey.h"
 #include "ep_time.h"
@@ -33,6 +35,7 @@
 #include "vbucket_state.h"
 
 #include <JSON_checker.h>
+#include <folly/portability/Fcntl.h>
 #include <mcbp/protocol/unsigned_leb128.h>
 #include <nlohmann/json.hpp>
 #include <phosphor/phosphor.h>
@@ -217,9 +220,17 @@ struct GetMultiCbCtx {
         : cks(c), vbId(v), fetches(f) {
     }
 
+    ~GetMultiCbCtx() {
+        for (auto& found : docInfos) {
+            couchstore_free_docinfo(found.first);
+        }
+    }
+
     CouchKVStore &cks;
     Vbid vbId;
     vb_bgfetch_queue_t &fetches;
+    /// The DocInfo (owned copy) of each key found, with its fetch context.
+    std::vector<std::pair<DocInfo*, vb_bgfetch_item_ctx_t*>> docInfos;
 };
 
 struct AllKeysCtx {
@@ -320,7 +331,14 @@ static constexpr const char* droppedCollectionsName =
 } // namespace Collections
 
 CouchKVStore::CouchKVStore(CouchKVStoreConfig& config)
-    : CouchKVStore(config, *couchstore_get_default_file_ops()) {
+    : CouchKVStore(config,
+                   getCouchstoreBaseOps(config.getIoBackend(),
+                                        config.getIoUringDirectReads())) {
+    if (config.getIoBackend() == "io_uring" && !IoUringOps::isSupported()) {
+        logger.warn(
+                "CouchKVStore::CouchKVStore: io_uring is not supported, "
+                "using couchstore_io_backend:posix");
+    }
 }
 
 CouchKVStore::CouchKVStore(CouchKVStoreConfig& config,
@@ -335,7 +353,26 @@ CouchKVStore::CouchKVStore(CouchKVStoreConfig& config,
       logger(config.getLogger()),
       base_ops(ops) {
     createDataDir(dbname);
-    statCollectingFileOps = getCouchstoreStatsOps(st.fsStats, base_ops);
+    if (!readOnly && config.getGroupCommit()) {
+        syncGroupOps = std::make_unique<SyncGroupOps>(
+                base_ops, config.getGroupCommitSyncThreads());
+        if (config.getGroupCommitSyncfs() &&
+            !syncGroupOps->enableSyncfs(dbname)) {
+            // Without a reliable syncfs a failed write could be reported as
+            // persisted; don't group commits at all rather than fall back
+            // silently to a different barrier than configured.
+            logger.warn(
+                    "CouchKVStore::CouchKVStore: flusher_group_commit_syncfs "
+                    "requires Linux 5.8 or later (syncfs error reporting); "
+                    "disabling group commit for {}",
+                    dbname);
+            syncGroupOps.reset();
+        }
+    }
+    statCollectingFileOps = getCouchstoreStatsOps(
+            st.fsStats,
+            syncGroupOps ? static_cast<FileOpsInterface&>(*syncGroupOps)
+                         : base_ops);
     statCollectingFileOpsCompaction = getCouchstoreStatsOps(
         st.fsStatsCompaction, base_ops);
 
@@ -372,7 +409,8 @@ std::unique_ptr<CouchKVStore> CouchKVStore::makeReadOnlyStore() {
 CouchKVStore::CouchKVStore(CouchKVStoreConfig& config,
                            std::shared_ptr<RevisionMap> dbFileRevMap)
     : CouchKVStore(config,
-                   *couchstore_get_default_file_ops(),
+                   getCouchstoreBaseOps(config.getIoBackend(),
+                                        config.getIoUringDirectReads()),
                    true /*readonly*/,
                    dbFileRevMap) {
 }
@@ -607,8 +645,12 @@ void CouchKVStore::getMulti(Vbid vb, vb_bgfetch_queue_t& itms) {
         ++idx;
     }
 
+    const auto startTime = std::chrono::steady_clock::now();
     GetMultiCbCtx ctx(*this, vb, itms);
 
+    // Look up the DocInfos of all keys first, then read the documents in
+    // file order (and, for multiple documents, hint their reads to the
+    // kernel up front so they are performed concurrently).
     errCode = couchstore_docinfos_by_id(
             db, ids.data(), itms.size(), 0, getMultiCbC, &ctx);
     if (errCode != COUCHSTORE_SUCCESS) {
@@ -622,7 +664,19 @@ void CouchKVStore::getMulti(Vbid vb, vb_bgfetch_queue_t& itms) {
         for (auto& item : itms) {
             item.second.value.setStatus(couchErr2EngineErr(errCode));
         }
+    } else {
+        std::sort(ctx.docInfos.begin(),
+                  ctx.docInfos.end(),
+                  [](const auto& a, const auto& b) {
+                      return a.first->bp < b.first->bp;
+                  });
+        prefetchDocs(db, ctx.docInfos);
+        for (auto& found : ctx.docInfos) {
+            fetchMultiDoc(db, vb, *found.first, *found.second);
+        }
     }
+    st.getMultiHisto.add(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - startTime));
 
     // If available, record how many reads() we did for this getMulti;
     // and the average reads per document.
@@ -1414,6 +1468,40 @@ bool CouchKVStore::commit(VB::Commit& commitData) {
     return !intransaction;
 }
 
+bool CouchKVStore::beginSyncGroup() {
+    if (!syncGroupOps) {
+        return false;
+    }
+    syncGroupOps->beginGroup();
+    return true;
+}
+
+bool CouchKVStore::completeSyncGroup() {
+    if (!syncGroupOps) {
+        return true;
+    }
+
+    couchstore_error_info_t errinfo{};
+    const auto errCode = syncGroupOps->completeGroup(&errinfo);
+    if (errCode != COUCHSTORE_SUCCESS) {
+        logger.warn(
+                "CouchKVStore::completeSyncGroup: error:{} [{}], {} commits "
+                "failed",
+                couchstore_strerror(errCode),
+                cb_strerror(errinfo.error),
+                deferredCommits.size());
+    }
+
+    for (auto& deferred : deferredCommits) {
+        commitCallback(*deferred.transactionCtx,
+                       deferred.committedReqs,
+                       *deferred.kvctx,
+                       errCode);
+    }
+    deferredCommits.clear();
+    return errCode == COUCHSTORE_SUCCESS;
+}
+
 bool CouchKVStore::getStat(const char* name, size_t& value)  {
     if (strcmp("failure_compaction", name) == 0) {
         value = st.numCompactionFailure.load();
@@ -1444,6 +1532,9 @@ bool CouchKVStore::getStat(const char* name, size_t& value)  {
     } else if (strcmp("io_bg_fetch_read_count", name) == 0) {
         value = st.getMultiFsReadCount;
         return true;
+    } else if (strcmp("io_bg_fetch_prefetch_count", name) == 0) {
+        value = st.getMultiPrefetchCount;
+        return true;
     }
 
     return false;
@@ -2172,9 +2263,10 @@ bool CouchKVStore::commit2couchstore(VB::Commit& commitData) {
         docinfos[i] = req.getDbDocInfo();
     }
 
-    kvstats_ctx kvctx(commitData);
+    auto kvctx = std::make_unique<kvstats_ctx>(commitData);
     // flush all
-    couchstore_error_t errCode = saveDocs(vbucket2flush, docs, docinfos, kvctx);
+    couchstore_error_t errCode =
+            saveDocs(vbucket2flush, docs, docinfos, *kvctx);
 
     if (errCode) {
         success = false;
@@ -2185,7 +2277,15 @@ bool CouchKVStore::commit2couchstore(VB::Commit& commitData) {
                 vbucket2flush);
     }
 
-    commitCallback(pendingReqsQ, kvctx, errCode);
+    if (success && syncGroupOps && syncGroupOps->isInGroup()) {
+        // Not durable until the group completes; defer the callbacks until
+        // then (see completeSyncGroup).
+        deferredCommits.push_back({std::move(pendingReqsQ),
+                                   std::move(kvctx),
+                                   std::move(transactionCtx)});
+    } else {
+        commitCallback(*transactionCtx, pendingReqsQ, *kvctx, errCode);
+    }
 
     pendingReqsQ.clear();
     return success;
@@ -2422,7 +2522,8 @@ couchstore_error_t CouchKVStore::saveDocs(Vbid vbid,
     return errCode;
 }
 
-void CouchKVStore::commitCallback(PendingRequestQueue& committedReqs,
+void CouchKVStore::commitCallback(TransactionContext& txnCtx,
+                                  PendingRequestQueue& committedReqs,
                                   kvstats_ctx& kvctx,
                                   couchstore_error_t errCode) {
     for (auto& committed : committedReqs) {
@@ -2453,7 +2554,7 @@ void CouchKVStore::commitCallback(PendingRequestQueue& committedReqs,
             } else {
                 st.delTimeHisto.add(committed.getDelta());
             }
-            transactionCtx->deleteCallback(committed.getItem(), mutationStatus);
+            txnCtx.deleteCallback(committed.getItem(), mutationStatus);
         } else {
             auto mutationStatus = getMutationStatus(errCode);
             const auto& key = committed.getKey();
@@ -2476,7 +2577,7 @@ void CouchKVStore::commitCallback(PendingRequestQueue& committedReqs,
             } else if (mutationStatus == MutationStatus::DocNotFound) {
                 setState = MutationSetResultState::DocNotFound;
             }
-            transactionCtx->setCallback(committed.getItem(), setState);
+            txnCtx.setCallback(committed.getItem(), setState);
         }
     }
 }
@@ -2745,7 +2846,6 @@ int CouchKVStore::getMultiCb(Db *db, DocInfo *docinfo, void *ctx) {
 
     auto *cbCtx = static_cast<GetMultiCbCtx *>(ctx);
     auto key = makeDiskDocKey(docinfo->id);
-    KVStoreStats& st = cbCtx->cks.getKVStoreStat();
 
     auto qitr = cbCtx->fetches.find(key);
     if (qitr == cbCtx->fetches.end()) {
@@ -2761,16 +2861,40 @@ int CouchKVStore::getMultiCb(Db *db, DocInfo *docinfo, void *ctx) {
         return 0;
     }
 
-    vb_bgfetch_item_ctx_t& bg_itm_ctx = (*qitr).second;
+    // Keep a copy of the DocInfo (couchstore frees docinfo on return) to
+    // fetch the document once all have been found. As for
+    // edit_docinfo_hook, the copy is a single allocation which
+    // couchstore_free_docinfo() can free.
+    char* buffer = static_cast<char*>(cb_malloc(
+            sizeof(DocInfo) + docinfo->id.size + docinfo->rev_meta.size));
+    if (buffer == nullptr) {
+        throw std::bad_alloc();
+    }
+    auto* copy = reinterpret_cast<DocInfo*>(buffer);
+    *copy = *docinfo;
+    copy->id.buf = buffer + sizeof(DocInfo);
+    std::memcpy(copy->id.buf, docinfo->id.buf, docinfo->id.size);
+    copy->rev_meta.buf = copy->id.buf + copy->id.size;
+    std::memcpy(
+            copy->rev_meta.buf, docinfo->rev_meta.buf, docinfo->rev_meta.size);
+    cbCtx->docInfos.emplace_back(copy, &qitr->second);
+
+    return 0;
+}
+
+void CouchKVStore::fetchMultiDoc(Db* db,
+                                 Vbid vb,
+                                 DocInfo& docinfo,
+                                 vb_bgfetch_item_ctx_t& bg_itm_ctx) {
     GetMetaOnly meta_only = bg_itm_ctx.isMetaOnly;
 
-    couchstore_error_t errCode = cbCtx->cks.fetchDoc(
-            db, docinfo, bg_itm_ctx.value, cbCtx->vbId, meta_only);
+    couchstore_error_t errCode =
+            fetchDoc(db, &docinfo, bg_itm_ctx.value, vb, meta_only);
     if (errCode != COUCHSTORE_SUCCESS && (meta_only == GetMetaOnly::No)) {
         st.numGetFailure++;
     }
 
-    bg_itm_ctx.value.setStatus(cbCtx->cks.couchErr2EngineErr(errCode));
+    bg_itm_ctx.value.setStatus(couchErr2EngineErr(errCode));
 
     bool return_val_ownership_transferred = false;
     for (auto& fetch : bg_itm_ctx.bgfetched_list) {
@@ -2787,16 +2911,74 @@ int CouchKVStore::getMultiCb(Db *db, DocInfo *docinfo, void *ctx) {
         }
     }
     if (!return_val_ownership_transferred) {
-        cbCtx->cks.logger.warn(
-                "CouchKVStore::getMultiCb called with zero"
+        logger.warn(
+                "CouchKVStore::fetchMultiDoc called with zero"
                 "items in bgfetched_list, {}, seqno:{}",
-                cbCtx->vbId,
-                docinfo->rev_seq);
+                vb,
+                docinfo.rev_seq);
     }
-
-    return 0;
 }
 
+void CouchKVStore::prefetchDocs(
+        Db* db,
+        const std::vector<std::pair<DocInfo*, vb_bgfetch_item_ctx_t*>>&
+                docInfos) {
+    if (!configuration.getBgFetchPrefetch() ||
+        (configuration.getIoBackend() == "io_uring" &&
+         configuration.getIoUringDirectReads())) {
+        // Disabled, or reads bypass the page cache.
+        return;
+    }
+
+    // Extents of the document bodies to read (in file order), merging
+    // those within a page of each other.
+    std::vector<std::pair<cs_off_t, cs_off_t>> extents;
+    size_t numDocs = 0;
+    for (const auto& found : docInfos) {
+        const auto& docinfo = *found.first;
+        if (found.second->isMetaOnly == GetMetaOnly::Yes ||
+            docinfo.size == 0) {
+            continue;
+        }
+        ++numDocs;
+        // A body is stored as a chunk (with a header) in which couchstore
+        // inserts a marker byte at each 4KiB block boundary.
+        const cs_off_t start = docinfo.bp;
+        const cs_off_t end = start + docinfo.size + docinfo.size / 4095 + 16;
+        if (!extents.empty() && start <= extents.back().second + 4096) {
+            extents.back().second = std::max(extents.back().second, end);
+        } else {
+            extents.emplace_back(start, end);
+        }
+    }
+    if (numDocs < 2) {
+        // Nothing to overlap - the read itself is next.
+        return;
+    }
+
+    // Through the FileOps of the open file, rather than opening it again.
+    auto* file = couchstore_get_db_filestats(db);
+    if (file == nullptr) {
+        return;
+    }
+#ifdef POSIX_FADV_WILLNEED
+    // couchstore_file_advice_t values are the POSIX_FADV_* advice, which
+    // the FileOps pass on to posix_fadvise().
+    const auto willNeed = couchstore_file_advice_t(POSIX_FADV_WILLNEED);
+    for (const auto& extent : extents) {
+        couchstore_error_info_t errinfo;
+        if (StatsOps::advise(&errinfo,
+                             file,
+                             extent.first,
+                             extent.second - extent.first,
+                             willNeed) !=
+            COUCHSTORE_SUCCESS) {
+            return;
+        }
+    }
+    st.getMultiPrefetchCount += extents.size();
+#endif
+}
 
 void CouchKVStore::closeDatabaseHandle(Db *db) {
     couchstore_error_t ret = couchstore_close_file(db);
@@ -40,6 +40,7 @@
 
 class CouchKVStoreConfig;
 class EventuallyPersistentEngine;
+class SyncGroupOps;
 
 /**
  * Class representing a document to be persisted in couchstore.
@@ -161,6 +162,15 @@ public:
      */
     bool commit(VB::Commit& commitData) override;
 
+    /**
+     * Begin a group commit (see KVStore::beginSyncGroup). Only supported if
+     * the store was created with group commit enabled (see
+     * CouchKVStoreConfig::getGroupCommit).
+     */
+    bool beginSyncGroup() override;
+
+    bool completeSyncGroup() override;
+
     /**
      * Rollback a transaction (unless not currently in one).
      */
@@ -324,6 +334,27 @@ public:
 
     static int getMultiCb(Db *db, DocInfo *docinfo, void *ctx);
 
+    /**
+     * Fetch the document described by docinfo into bg_itm_ctx, as part of
+     * getMulti().
+     */
+    void fetchMultiDoc(Db* db,
+                       Vbid vb,
+                       DocInfo& docinfo,
+                       vb_bgfetch_item_ctx_t& bg_itm_ctx);
+
+    /**
+     * Advise the kernel that the bodies of the given documents (sorted by
+     * file offset) are about to be read, so that the reads are issued
+     * concurrently rather than one at a time as couchstore reads each
+     * document. Contiguous documents are coalesced into one read. The
+     * advice goes through db's FileOps.
+     */
+    void prefetchDocs(
+            Db* db,
+            const std::vector<std::pair<DocInfo*, vb_bgfetch_item_ctx_t*>>&
+                    docInfos);
+
     couchstore_error_t fetchDoc(Db* db,
                                 DocInfo* docinfo,
                                 GetValue& docValue,
@@ -556,7 +587,8 @@ protected:
                                 std::vector<DocInfo*>& docinfos,
                                 kvstats_ctx& kvctx);
 
-    void commitCallback(PendingRequestQueue& committedReqs,
+    void commitCallback(TransactionContext& txnCtx,
+                        PendingRequestQueue& committedReqs,
                         kvstats_ctx& kvctx,
                         couchstore_error_t errCode);
     couchstore_error_t saveVBState(Db *db, const vbucket_state &vbState);
@@ -813,6 +845,22 @@ protected:
      */
     std::unique_ptr<FileOpsInterface> statCollectingFileOpsCompaction;
 
+    /**
+     * Wraps base_ops (beneath statCollectingFileOps) to defer the syncs of
+     * the flusher's commits to a group barrier. Null unless group commit is
+     * enabled.
+     */
+    std::unique_ptr<SyncGroupOps> syncGroupOps;
+
+    /// A commit written in a sync group, whose callbacks are deferred until
+    /// the group is durable.
+    struct DeferredCommit {
+        PendingRequestQueue committedReqs;
+        std::unique_ptr<kvstats_ctx> kvctx;
+        std::unique_ptr<TransactionContext> transactionCtx;
+    };
+    std::vector<DeferredCommit> deferredCommits;
+
     /* deleted docs in each file, indexed by vBucket. RelaxedAtomic
        to allow stats access witout lock */
     std::vector<cb::RelaxedAtomic<size_t>> cachedDeleteCount;
@@ -19,6 +19,7 @@
 
 #include "checkpoint.h"
 #include "checkpoint_manager.h"
+#include "dcp/dcpconnmap.h"
 #include "dcp/producer.h"
 #include "dcp/response.h"
 #include "ep_time.h"
@@ -732,6 +733,24 @@ std::unique_ptr<DcpResponse> ActiveStream::deadPhase() {
     return resp;
 }
 
+void ActiveStream::compressItemValue(Item& item) {
+    const auto bytesIn = item.getNBytes();
+    const auto start = std::chrono::steady_clock::now();
+    if (!item.compressValue(
+                false, engine->getDcpConnMap().getForcedCompressionRatio())) {
+        log(spdlog::level::level_enum::warn,
+            "{} Failed to snappy compress an uncompressed value",
+            logPrefix);
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    compressedValues.time +=
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+                    .count();
+    compressedValues.items++;
+    compressedValues.bytesIn += bytesIn;
+    compressedValues.bytesOut += item.getNBytes();
+}
+
 bool ActiveStream::isCompressionEnabled() {
     auto producer = producerPtr.lock();
     if (producer) {
@@ -825,6 +844,45 @@ void ActiveStream::addStats(const AddStatFn& add_stat, const void* c) {
                          vb_.get());
         add_casted_stat(buffer, cursor.lock() != nullptr, add_stat, c);
 
+        if (isForceValueCompressionEnabled()) {
+            const size_t bytesIn = compressedValues.bytesIn;
+            const size_t bytesOut = compressedValues.bytesOut;
+            checked_snprintf(buffer,
+                             bsize,
+                             "%s:stream_%d_compression_items",
+                             name_.c_str(),
+                             vb_.get());
+            add_casted_stat(buffer, compressedValues.items, add_stat, c);
+            checked_snprintf(buffer,
+                             bsize,
+                             "%s:stream_%d_compression_bytes_in",
+                             name_.c_str(),
+                             vb_.get());
+            add_casted_stat(buffer, bytesIn, add_stat, c);
+            checked_snprintf(buffer,
+                             bsize,
+                             "%s:stream_%d_compression_bytes_out",
+                             name_.c_str(),
+                             vb_.get());
+            add_casted_stat(buffer, bytesOut, add_stat, c);
+            checked_snprintf(buffer,
+                             bsize,
+                             "%s:stream_%d_compression_ratio",
+                             name_.c_str(),
+                             vb_.get());
+            add_casted_stat(buffer,
+                            bytesIn ? double(bytesOut) / bytesIn : 1.0,
+                            add_stat,
+                            c);
+            checked_snprintf(buffer,
+                             bsize,
+                             "%s:stream_%d_compression_time_us",
+                             name_.c_str(),
+                             vb_.get());
+            add_casted_stat(
+                    buffer, compressedValues.time / 1000, add_stat, c);
+        }
+
         if (isTakeoverSend() && takeoverStart != 0) {
             checked_snprintf(buffer,
                              bsize,
@@ -1098,12 +1156,7 @@ std::unique_ptr<DcpResponse> ActiveStream::makeResponseFromItem(
             if (isSnappyEnabled()) {
                 if (isForceValueCompressionEnabled()) {
                     if (!mcbp::datatype::is_snappy(finalItem->getDataType())) {
-                        if (!finalItem->compressValue()) {
-                            log(spdlog::level::level_enum::warn,
-                                "{} Failed to snappy compress an uncompressed "
-                                "value",
-                                logPrefix);
-                        }
+                        compressItemValue(*finalItem);
                     }
                 }
             } else {
@@ -366,6 +366,13 @@ protected:
             const queued_item& item,
             SendCommitSyncWriteAs sendCommitSyncWriteAs);
 
+    /**
+     * Snappy compress the value of an item to be sent (unless that doesn't
+     * achieve DcpConnMap::getForcedCompressionRatio()), and account for it
+     * in the compression stats of the stream.
+     */
+    void compressItemValue(Item& item);
+
     /* The transitionState function is protected (as opposed to private) for
      * testing purposes.
      */
@@ -590,6 +597,17 @@ private:
         std::atomic<size_t> items = 0;
     } bufferedBackfill;
 
+    //! Stats to track the values compressed by the stream (when forcing value
+    //! compression), to report the compression ratio and its CPU cost
+    struct {
+        std::atomic<size_t> items = 0;
+        //! Size of the values before and after compression
+        std::atomic<size_t> bytesIn = 0;
+        std::atomic<size_t> bytesOut = 0;
+        //! Time spent compressing (ns)
+        std::atomic<uint64_t> time = 0;
+    } compressedValues;
+
     /// Records the time at which the TakeoverSend phase begins.
     std::atomic<rel_time_t> takeoverStart = 0;
 
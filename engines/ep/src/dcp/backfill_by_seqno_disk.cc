@@ -21,16 +21,26 @@
 #include "kv_bucket.h"
 #include "vbucket.h"
 
+#include <algorithm>
+#include <tuple>
+
 // Here we must force call the baseclass (DCPBackfill(s) )because of the use of
 // multiple inheritance (and virtual inheritance), otherwise stream will be null
 // as DCPBackfill() would be used.
-DCPBackfillBySeqnoDisk::DCPBackfillBySeqnoDisk(KVBucket& bucket,
-                                               std::shared_ptr<ActiveStream> s,
-                                               uint64_t startSeqno,
-                                               uint64_t endSeqno)
+DCPBackfillBySeqnoDisk::DCPBackfillBySeqnoDisk(
+        KVBucket& bucket,
+        std::shared_ptr<ActiveStream> s,
+        uint64_t startSeqno,
+        uint64_t endSeqno,
+        std::shared_ptr<SharedBackfillScans> sharedScans)
     : DCPBackfill(s),
       DCPBackfillDisk(bucket),
-      DCPBackfillBySeqno(s, startSeqno, endSeqno) {
+      DCPBackfillBySeqno(s, startSeqno, endSeqno),
+      sharedScans(std::move(sharedScans)) {
+}
+
+DCPBackfillBySeqnoDisk::~DCPBackfillBySeqnoDisk() {
+    leaveSharedScan();
 }
 
 backfill_status_t DCPBackfillBySeqnoDisk::create() {
@@ -70,13 +80,39 @@ backfill_status_t DCPBackfillBySeqnoDisk::create() {
         }
     }
 
-    auto scanCtx = kvstore->initBySeqnoScanContext(
-            std::make_unique<DiskCallback>(stream),
-            std::make_unique<CacheCallback>(bucket, stream),
-            vbid,
-            startSeqno,
-            DocumentFilter::ALL_ITEMS,
-            valFilter);
+    if (sharedScans) {
+        std::tie(sharedScan, sharedScanMember) =
+                sharedScans->join(stream, startSeqno, endSeqno, valFilter);
+        if (sharedScanMember) {
+            stream->log(spdlog::level::level_enum::info,
+                        "({}) Backfill ({} to {}) joined a shared scan",
+                        vbid,
+                        startSeqno,
+                        endSeqno);
+            transitionState(sharedScanMember->cancelled
+                                    ? backfill_state_completing
+                                    : backfill_state_scanning);
+            return backfill_success;
+        }
+    }
+
+    // The scan context; owned by the shared scan if we open one
+    std::unique_ptr<BySeqnoScanContext> scanCtx;
+    const BySeqnoScanContext* ctx;
+    if (sharedScans) {
+        sharedScan =
+                std::make_shared<SharedBackfillScan>(bucket, vbid, valFilter);
+        ctx = sharedScan->create(startSeqno);
+    } else {
+        scanCtx = kvstore->initBySeqnoScanContext(
+                std::make_unique<DiskCallback>(stream),
+                std::make_unique<CacheCallback>(bucket, stream),
+                vbid,
+                startSeqno,
+                DocumentFilter::ALL_ITEMS,
+                valFilter);
+        ctx = scanCtx.get();
+    }
 
     // Check startSeqno against the purge-seqno of the opened datafile.
     // 1) A normal stream request would of checked inside streamRequest, but
@@ -85,15 +121,15 @@ backfill_status_t DCPBackfillBySeqnoDisk::create() {
     //    behind the current purge-seqno
     // If the startSeqno != 1 (a client 0 to n request becomes 1 to n) then
     // start-seqno must be above purge-seqno
-    if (!scanCtx || (startSeqno != 1 && (startSeqno <= scanCtx->purgeSeqno))) {
+    if (!ctx || (startSeqno != 1 && (startSeqno <= ctx->purgeSeqno))) {
         auto vb = bucket.getVBucket(vbid);
         std::stringstream log;
         log << "DCPBackfillBySeqnoDisk::create(): (" << getVBucketId()
             << ") cannot be scanned. Associated stream is set to dead state.";
         end_stream_status_t status = END_STREAM_BACKFILL_FAIL;
-        if (scanCtx) {
+        if (ctx) {
             log << " startSeqno:" << startSeqno
-                << " < purgeSeqno:" << scanCtx->purgeSeqno;
+                << " < purgeSeqno:" << ctx->purgeSeqno;
             status = END_STREAM_ROLLBACK;
         } else {
             log << " failed to create scan";
@@ -107,18 +143,33 @@ backfill_status_t DCPBackfillBySeqnoDisk::create() {
 
         stream->log(spdlog::level::level_enum::warn, "{}", log.str());
         stream->setDead(status);
+        sharedScan.reset();
         transitionState(backfill_state_done);
     } else {
-        bool markerSent =
-                stream->markDiskSnapshot(startSeqno,
-                                         scanCtx->maxSeqno,
-                                         scanCtx->persistedCompletedSeqno,
-                                         scanCtx->maxVisibleSeqno);
+        bool markerSent;
+        if (sharedScan) {
+            // Joining the scan sends the marker, and lets the backfills
+            // scheduled from now on join too
+            sharedScanMember = sharedScan->join(
+                    stream, startSeqno, std::min(endSeqno, ctx->maxSeqno));
+            markerSent = sharedScanMember && !sharedScanMember->cancelled;
+            if (markerSent) {
+                sharedScans->add(sharedScan);
+            }
+        } else {
+            markerSent = stream->markDiskSnapshot(startSeqno,
+                                                  ctx->maxSeqno,
+                                                  ctx->persistedCompletedSeqno,
+                                                  ctx->maxVisibleSeqno);
+            if (markerSent) {
+                // This value may be an overestimate - it includes
+                // prepares/aborts which will not be sent if the stream is not
+                // sync write aware
+                stream->setBackfillRemaining(ctx->documentCount);
+            }
+        }
 
         if (markerSent) {
-            // This value may be an overestimate - it includes prepares/aborts
-            // which will not be sent if the stream is not sync write aware
-            stream->setBackfillRemaining(scanCtx->documentCount);
             transitionState(backfill_state_scanning);
         } else {
             transitionState(backfill_state_completing);
@@ -142,9 +193,16 @@ backfill_status_t DCPBackfillBySeqnoDisk::scan() {
         return complete(true);
     }
 
-    KVStore* kvstore = bucket.getROUnderlying(vbid);
-    scan_error_t error =
-            kvstore->scan(static_cast<BySeqnoScanContext&>(*scanCtx));
+    scan_error_t error;
+    if (sharedScan) {
+        if (sharedScan->mustWait(*sharedScanMember)) {
+            return backfill_snooze;
+        }
+        error = sharedScan->scan();
+    } else {
+        KVStore* kvstore = bucket.getROUnderlying(vbid);
+        error = kvstore->scan(static_cast<BySeqnoScanContext&>(*scanCtx));
+    }
 
     if (error == scan_again) {
         return backfill_success;
@@ -156,6 +214,8 @@ backfill_status_t DCPBackfillBySeqnoDisk::scan() {
 }
 
 backfill_status_t DCPBackfillBySeqnoDisk::complete(bool cancelled) {
+    leaveSharedScan();
+
     auto stream = streamPtr.lock();
     if (!stream) {
         EP_LOG_WARN(
@@ -183,3 +243,11 @@ backfill_status_t DCPBackfillBySeqnoDisk::complete(bool cancelled) {
 
     return backfill_success;
 }
+
+void DCPBackfillBySeqnoDisk::leaveSharedScan() {
+    if (sharedScanMember) {
+        sharedScanMember->cancelled = true;
+        sharedScanMember.reset();
+    }
+    sharedScan.reset();
+}
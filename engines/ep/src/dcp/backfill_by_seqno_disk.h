@@ -19,6 +19,7 @@
 
 #include "dcp/backfill_by_seqno.h"
 #include "dcp/backfill_disk.h"
+#include "dcp/shared_backfill_scan.h"
 
 class KVBucket;
 
@@ -32,10 +33,18 @@ class KVBucket;
 class DCPBackfillBySeqnoDisk : public DCPBackfillDisk,
                                public DCPBackfillBySeqno {
 public:
-    DCPBackfillBySeqnoDisk(KVBucket& bucket,
-                           std::shared_ptr<ActiveStream> stream,
-                           uint64_t startSeqno,
-                           uint64_t endSeqno);
+    /**
+     * @param sharedScans if set, the scans of the vBucket the backfill may
+     *        share (see dcp_backfill_shared_scans)
+     */
+    DCPBackfillBySeqnoDisk(
+            KVBucket& bucket,
+            std::shared_ptr<ActiveStream> stream,
+            uint64_t startSeqno,
+            uint64_t endSeqno,
+            std::shared_ptr<SharedBackfillScans> sharedScans = {});
+
+    ~DCPBackfillBySeqnoDisk() override;
 
     // explicitly state how we want run to be called as it technically exists
     // from both parent classes
@@ -72,4 +81,13 @@ private:
      *                  cancelled in between; for debug
      */
     backfill_status_t complete(bool cancelled) override;
+
+    /// Leave the shared scan (if any)
+    void leaveSharedScan();
+
+    const std::shared_ptr<SharedBackfillScans> sharedScans;
+
+    /// The shared scan the backfill is reading, and its membership
+    std::shared_ptr<SharedBackfillScan> sharedScan;
+    std::shared_ptr<SharedBackfillScan::Member> sharedScanMember;
 };
\ No newline at end of file
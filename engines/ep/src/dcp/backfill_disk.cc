@@ -29,9 +29,10 @@ CacheCallback::CacheCallback(KVBucket& bucket, std::shared_ptr<ActiveStream> s)
 }
 
 // Do a get and restrict the collections lock scope to just these checks.
-GetValue CacheCallback::get(VBucket& vb,
+GetValue CacheCallback::get(KVBucket& bucket,
+                            VBucket& vb,
                             CacheLookup& lookup,
-                            ActiveStream& stream) {
+                            bool keyOnly) {
     // getInternal may generate expired items and thus may for example need to
     // update a collection high-seqno, get a handle on the collection manifest
     auto cHandle = vb.lockCollections(lookup.getKey().getDocKey());
@@ -41,8 +42,8 @@ GetValue CacheCallback::get(VBucket& vb,
     return vb.getInternal(nullptr,
                           bucket.getEPEngine(),
                           /*options*/ NONE,
-                          stream.isKeyOnly() ? VBucket::GetKeyOnly::Yes
-                                             : VBucket::GetKeyOnly::No,
+                          keyOnly ? VBucket::GetKeyOnly::Yes
+                                  : VBucket::GetKeyOnly::No,
                           cHandle);
 }
 
@@ -75,7 +76,7 @@ void CacheCallback::callback(CacheLookup& lookup) {
         return;
     }
 
-    auto gv = get(*vb, lookup, *stream_);
+    auto gv = get(bucket, *vb, lookup, stream_->isKeyOnly());
     if (gv.getStatus() == ENGINE_SUCCESS) {
         // If the value is a commit of a SyncWrite then the in-memory
         // StoredValue isn't sufficient - as it doesn't contain the prepareSeqno
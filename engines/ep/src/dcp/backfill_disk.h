@@ -40,14 +40,18 @@ public:
 
     void callback(CacheLookup& lookup) override;
 
-private:
     /**
      * Attempt to perform the get of lookup
      *
+     * @param keyOnly whether the backfill only needs the key (and metadata)
      * @return return a GetValue by performing a vb::get with lookup::getKey.
      */
-    GetValue get(VBucket& vb, CacheLookup& lookup, ActiveStream& stream);
+    static GetValue get(KVBucket& bucket,
+                        VBucket& vb,
+                        CacheLookup& lookup,
+                        bool keyOnly);
 
+private:
     KVBucket& bucket;
     std::weak_ptr<ActiveStream> streamPtr;
 };
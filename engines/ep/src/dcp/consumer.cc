@@ -54,6 +54,7 @@ class DcpConsumerTask : public GlobalTask {
 public:
     DcpConsumerTask(EventuallyPersistentEngine* e,
                     std::shared_ptr<DcpConsumer> c,
+                    size_t processor,
                     double sleeptime = 1,
                     bool completeBeforeShutdown = true)
         : GlobalTask(e,
@@ -61,8 +62,12 @@ public:
                      sleeptime,
                      completeBeforeShutdown),
           consumerPtr(c),
+          processor(processor),
           description("DcpConsumerTask, processing buffered items for " +
-                      c->getName()) {
+                      c->getName() +
+                      (processor ? " (processor " + std::to_string(processor) +
+                                           ")"
+                                 : "")) {
     }
 
     ~DcpConsumerTask() override {
@@ -84,7 +89,8 @@ public:
         }
 
         double sleepFor = 0.0;
-        enum process_items_error_t state = consumer->processBufferedItems();
+        enum process_items_error_t state =
+                consumer->processBufferedItems(processor);
         switch (state) {
             case all_processed:
                 sleepFor = INT_MAX;
@@ -102,30 +108,30 @@ public:
         // Check if we've been notified of more work to do - if not then sleep;
         // if so then wakeup and re-run the task.
         // Note: The order of the wakeUp / snooze here is *critical* - another
-        // thread may concurrently notify us (set processorNotification=true)
+        // thread may concurrently notify us (set the processor notification)
         // while we are performing the checks, so we need to ensure we don't
         // loose a wakeup as that would result in this Task sleeping forever
         // (and DCP hanging).
         // To prevent this, we perform an initial check of notifiedProcessor(),
         // which if false we initially sleep, and then check a second time.
-        // We could race if the other actor sets processorNotification=true
+        // We could race if the other actor sets the processor notification
         // between the second `if(consumer->notifiedProcessor)` and us calling
         // `wakeUp()`; but that's essentially a benign race as it will just
         // result in wakeUp() being called twice which is benign.
-        if (consumer->notifiedProcessor(false)) {
+        if (consumer->notifiedProcessor(false, processor)) {
             wakeUp();
             state = more_to_process;
         } else {
             snooze(sleepFor);
             // Check if the processor was notified again,
             // in which case the task should wake immediately.
-            if (consumer->notifiedProcessor(false)) {
+            if (consumer->notifiedProcessor(false, processor)) {
                 wakeUp();
                 state = more_to_process;
             }
         }
 
-        consumer->setProcessorTaskState(state);
+        consumer->setProcessorTaskState(state, processor);
 
         return true;
     }
@@ -141,9 +147,11 @@ public:
     }
 
 private:
-    /* we have one task per consumer. the task only needs a reference to the
-       consumer object and does not own it. Hence std::weak_ptr should be used*/
+    /* we have one task per processor of a consumer. the task only needs a
+       reference to the consumer object and does not own it. Hence
+       std::weak_ptr should be used*/
     const std::weak_ptr<DcpConsumer> consumerPtr;
+    const size_t processor;
     const std::string description;
 };
 
@@ -155,9 +163,6 @@ DcpConsumer::DcpConsumer(EventuallyPersistentEngine& engine,
       lastMessageTime(ep_current_time()),
       engine(engine),
       opaqueCounter(0),
-      processorTaskId(0),
-      processorTaskState(all_processed),
-      processorNotification(false),
       backoffs(0),
       dcpNoopTxInterval(engine.getConfiguration().getDcpNoopTxInterval()),
       pendingSendStreamEndOnClientStreamClose(true),
@@ -172,6 +177,12 @@ DcpConsumer::DcpConsumer(EventuallyPersistentEngine& engine,
               engine.getConfiguration()
                       .getDcpConsumerProcessBufferedMessagesBatchSize()) {
     Configuration& config = engine.getConfiguration();
+    processors.resize(
+            std::max(config.getDcpConsumerProcessBufferedMessagesTasks(),
+                     size_t(1)));
+    for (auto& processor : processors) {
+        processor = std::make_unique<Processor>();
+    }
     setSupportAck(false);
     setLogHeader("DCP (Consumer) " + getName() + " -");
     setReserved(true);
@@ -207,7 +218,9 @@ DcpConsumer::~DcpConsumer() {
 void DcpConsumer::cancelTask() {
     bool exp = true;
     if (processorTaskRunning.compare_exchange_strong(exp, false)) {
-        ExecutorPool::get()->cancel(processorTaskId);
+        for (const auto& processor : processors) {
+            ExecutorPool::get()->cancel(processor->taskId);
+        }
     }
 }
 
@@ -298,13 +311,15 @@ ENGINE_ERROR_CODE DcpConsumer::addStream(uint32_t opaque,
         }
     }
 
-    /* We need 'Processor' task only when we have a stream. Hence create it
-     only once when the first stream is added */
+    /* We need 'Processor' tasks only when we have a stream. Hence create
+     them only once when the first stream is added */
     bool exp = false;
     if (processorTaskRunning.compare_exchange_strong(exp, true)) {
-        ExTask task = std::make_shared<DcpConsumerTask>(
-                &engine, shared_from_this(), 1);
-        processorTaskId = ExecutorPool::get()->schedule(task);
+        for (size_t ii = 0; ii < processors.size(); ++ii) {
+            ExTask task = std::make_shared<DcpConsumerTask>(
+                    &engine, shared_from_this(), ii, 1);
+            processors[ii]->taskId = ExecutorPool::get()->schedule(task);
+        }
     }
 
     stream = makePassiveStream(engine_,
@@ -1100,14 +1115,26 @@ void DcpConsumer::addStats(const AddStatFn& add_stat, const void* c) {
     }
 
     addStat("total_backoffs", backoffs, add_stat, c);
-    addStat("processor_task_state", getProcessorTaskStatusStr(), add_stat, c);
     flowControl.addStats(add_stat, c);
 
-    vbReady.addStats(getName() + ":dcp_buffered_ready_queue_", add_stat, c);
-    addStat("processor_notification",
-            processorNotification.load(),
-            add_stat,
-            c);
+    // The stats of the first processor keep their names from before vBuckets
+    // were spread over processors
+    for (size_t ii = 0; ii < processors.size(); ++ii) {
+        const auto& processor = *processors[ii];
+        const std::string suffix = ii ? "_" + std::to_string(ii) : "";
+        addStat(("processor_task_state" + suffix).c_str(),
+                getProcessorTaskStatusStr(ii),
+                add_stat,
+                c);
+        processor.vbReady.addStats(
+                getName() + ":dcp_buffered_ready_queue" + suffix + "_",
+                add_stat,
+                c);
+        addStat(("processor_notification" + suffix).c_str(),
+                processor.notification.load(),
+                add_stat,
+                c);
+    }
 
     addStat("synchronous_replication", isSyncReplicationEnabled(), add_stat, c);
 }
@@ -1125,12 +1152,14 @@ process_items_error_t DcpConsumer::drainStreamsBufferedItems(
         switch (engine_.getReplicationThrottle().getStatus()) {
         case ReplicationThrottle::Status::Pause:
             backoffs++;
-            vbReady.pushUnique(stream->getVBucket());
+            getProcessor(stream->getVBucket())
+                    .vbReady.pushUnique(stream->getVBucket());
             return cannot_process;
 
         case ReplicationThrottle::Status::Disconnect:
             backoffs++;
-            vbReady.pushUnique(stream->getVBucket());
+            getProcessor(stream->getVBucket())
+                    .vbReady.pushUnique(stream->getVBucket());
             logger->warn(
                     "{} Processor task indicating disconnection "
                     "as there is no memory to complete replication",
@@ -1158,7 +1187,8 @@ process_items_error_t DcpConsumer::drainStreamsBufferedItems(
 
     // The stream may not be done yet so must go back in the ready queue
     if (bytesProcessed > 0) {
-        vbReady.pushUnique(stream->getVBucket());
+        getProcessor(stream->getVBucket())
+                .vbReady.pushUnique(stream->getVBucket());
         if (rval == stop_processing) {
             return stop_processing;
         }
@@ -1168,7 +1198,8 @@ process_items_error_t DcpConsumer::drainStreamsBufferedItems(
     return rval;
 }
 
-process_items_error_t DcpConsumer::processBufferedItems() {
+process_items_error_t DcpConsumer::processBufferedItems(size_t processor) {
+    auto& vbReady = processors.at(processor)->vbReady;
     process_items_error_t process_ret = all_processed;
     Vbid vbucket = Vbid(0);
     while (vbReady.popFront(vbucket)) {
@@ -1204,23 +1235,26 @@ process_items_error_t DcpConsumer::processBufferedItems() {
 }
 
 void DcpConsumer::notifyVbucketReady(Vbid vbucket) {
-    if (vbReady.pushUnique(vbucket) &&
-        notifiedProcessor(true)) {
-        ExecutorPool::get()->wake(processorTaskId);
+    auto& processor = getProcessor(vbucket);
+    if (processor.vbReady.pushUnique(vbucket) &&
+        notifiedProcessor(true, getProcessorIndex(vbucket))) {
+        ExecutorPool::get()->wake(processor.taskId);
     }
 }
 
-bool DcpConsumer::notifiedProcessor(bool to) {
+bool DcpConsumer::notifiedProcessor(bool to, size_t processor) {
     bool inverse = !to;
-    return processorNotification.compare_exchange_strong(inverse, to);
+    return processors.at(processor)->notification.compare_exchange_strong(
+            inverse, to);
 }
 
-void DcpConsumer::setProcessorTaskState(enum process_items_error_t to) {
-    processorTaskState = to;
+void DcpConsumer::setProcessorTaskState(enum process_items_error_t to,
+                                        size_t processor) {
+    processors.at(processor)->taskState = to;
 }
 
-std::string DcpConsumer::getProcessorTaskStatusStr() {
-    switch (processorTaskState.load()) {
+std::string DcpConsumer::getProcessorTaskStatusStr(size_t processor) {
+    switch (processors.at(processor)->taskState.load()) {
         case all_processed:
             return "ALL_PROCESSED";
         case more_to_process:
@@ -31,6 +31,7 @@
 
 #include <list>
 #include <map>
+#include <vector>
 #include <engines/ep/src/collections/collections_types.h>
 
 class DcpResponse;
@@ -265,7 +266,11 @@ public:
 
     void closeStreamDueToVbStateChange(Vbid vbucket, vbucket_state_t state);
 
-    process_items_error_t processBufferedItems();
+    /**
+     * Apply the buffered messages of the ready vBuckets of the given
+     * processor (see Processor).
+     */
+    process_items_error_t processBufferedItems(size_t processor = 0);
 
     uint64_t incrOpaqueCounter();
 
@@ -281,11 +286,17 @@ public:
 
     void taskCancelled();
 
-    bool notifiedProcessor(bool to);
+    bool notifiedProcessor(bool to, size_t processor = 0);
 
-    void setProcessorTaskState(enum process_items_error_t to);
+    void setProcessorTaskState(enum process_items_error_t to,
+                               size_t processor = 0);
 
-    std::string getProcessorTaskStatusStr();
+    std::string getProcessorTaskStatusStr(size_t processor = 0);
+
+    /// @return the number of processors the vBuckets are spread over
+    size_t getNumProcessors() const {
+        return processors.size();
+    }
 
     /**
      * Check if the enough bytes have been removed from the flow control
@@ -534,11 +545,32 @@ protected:
     /* Reference to the ep engine; need to create the 'Processor' task */
     EventuallyPersistentEngine& engine;
     uint64_t opaqueCounter;
-    size_t processorTaskId;
-    std::atomic<enum process_items_error_t> processorTaskState;
 
-    VBReadyQueue vbReady;
-    std::atomic<bool> processorNotification;
+    /**
+     * A 'Processor' task (DcpConsumerTask) applies the buffered messages of
+     * the vBuckets assigned to it. The vBuckets are spread over
+     * dcp_consumer_process_buffered_messages_tasks processors by id, so the
+     * messages of vBuckets of different processors are applied concurrently
+     * (on NONIO threads), while the messages of a vBucket are applied in
+     * order by the one task.
+     */
+    struct Processor {
+        size_t taskId = 0;
+        std::atomic<enum process_items_error_t> taskState{all_processed};
+
+        VBReadyQueue vbReady;
+        std::atomic<bool> notification{false};
+    };
+
+    size_t getProcessorIndex(Vbid vbucket) const {
+        return vbucket.get() % processors.size();
+    }
+
+    Processor& getProcessor(Vbid vbucket) {
+        return *processors[getProcessorIndex(vbucket)];
+    }
+
+    std::vector<std::unique_ptr<Processor>> processors;
 
     std::mutex readyMutex;
     std::list<Vbid> ready;
@@ -598,7 +630,7 @@ protected:
     } getErrorMapState;
     bool producerIsVersion5orHigher;
 
-    /* Indicates if the 'Processor' task is running */
+    /* Indicates if the 'Processor' tasks are running */
     std::atomic<bool> processorTaskRunning;
 
     FlowControl flowControl;
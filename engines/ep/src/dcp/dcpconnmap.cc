@@ -41,6 +41,7 @@ public:
     ~DcpConfigChangeListener() override {
     }
     void sizeValueChanged(const std::string& key, size_t value) override;
+    void booleanValueChanged(const std::string& key, bool value) override;
 
 private:
     DcpConnMap& myConnMap;
@@ -48,11 +49,18 @@ private:
 
 DcpConnMap::DcpConnMap(EventuallyPersistentEngine &e)
     : ConnMap(e),
-      aggrDcpConsumerBufferSize(0) {
+      aggrDcpConsumerBufferSize(0),
+      aggrDcpProducerBytesOutstanding(0) {
     backfills.numActiveSnoozing = 0;
     updateMaxActiveSnoozingBackfills(engine.getEpStats().getMaxDataSize());
     minCompressionRatioForProducer.store(
                     engine.getConfiguration().getDcpMinCompressionRatio());
+    applyMinCompressionRatio.store(
+            engine.getConfiguration().isDcpProducerApplyMinCompressionRatio());
+    producerFlowControlAdaptive.store(
+            engine.getConfiguration().isDcpProducerAdaptiveFlowControl());
+    producerFlowControlMemThreshold.store(
+            engine.getConfiguration().getDcpProducerFlowControlMemThreshold());
 
     // Note: these allocations are deleted by ~Configuration
     engine.getConfiguration().addValueChangedListener(
@@ -64,6 +72,15 @@ DcpConnMap::DcpConnMap(EventuallyPersistentEngine &e)
     engine.getConfiguration().addValueChangedListener(
             "dcp_idle_timeout",
             std::make_unique<DcpConfigChangeListener>(*this));
+    engine.getConfiguration().addValueChangedListener(
+            "dcp_producer_apply_min_compression_ratio",
+            std::make_unique<DcpConfigChangeListener>(*this));
+    engine.getConfiguration().addValueChangedListener(
+            "dcp_producer_adaptive_flow_control",
+            std::make_unique<DcpConfigChangeListener>(*this));
+    engine.getConfiguration().addValueChangedListener(
+            "dcp_producer_flow_control_mem_threshold",
+            std::make_unique<DcpConfigChangeListener>(*this));
 }
 
 DcpConnMap::~DcpConnMap() {
@@ -511,6 +528,14 @@ void DcpConnMap::addStats(const AddStatFn& add_stat, const void* c) {
     LockHolder lh(connsLock);
     add_casted_stat("ep_dcp_dead_conn_count", deadConnections.size(), add_stat,
                     c);
+    add_casted_stat("ep_dcp_producer_unacked_bytes",
+                    aggrDcpProducerBytesOutstanding,
+                    add_stat,
+                    c);
+    add_casted_stat("ep_dcp_producer_flow_control_mem_budget",
+                    getProducerFlowControlMemBudget(),
+                    add_stat,
+                    c);
 }
 
 void DcpConnMap::updateMinCompressionRatioForProducers(float value) {
@@ -521,6 +546,31 @@ float DcpConnMap::getMinCompressionRatio() {
     return minCompressionRatioForProducer.load();
 }
 
+float DcpConnMap::getForcedCompressionRatio() const {
+    if (applyMinCompressionRatio) {
+        return minCompressionRatioForProducer.load();
+    }
+    return 1.0;
+}
+
+void DcpConnMap::incrProducerBytesOutstanding(size_t bytes) {
+    aggrDcpProducerBytesOutstanding.fetch_add(bytes);
+}
+
+void DcpConnMap::decrProducerBytesOutstanding(size_t bytes) {
+    aggrDcpProducerBytesOutstanding.fetch_sub(bytes);
+}
+
+size_t DcpConnMap::getProducerFlowControlMemBudget() const {
+    return (engine.getEpStats().getMaxDataSize() / 100) *
+           producerFlowControlMemThreshold;
+}
+
+bool DcpConnMap::isProducerFlowControlMemBudgetFull() const {
+    return aggrDcpProducerBytesOutstanding >=
+           getProducerFlowControlMemBudget();
+}
+
 DcpConnMap::DcpConfigChangeListener::DcpConfigChangeListener(DcpConnMap& connMap)
     : myConnMap(connMap){}
 
@@ -532,6 +582,17 @@ void DcpConnMap::DcpConfigChangeListener::sizeValueChanged(const std::string &ke
         myConnMap.consumerBatchSizeConfigChanged(value);
     } else if (key == "dcp_idle_timeout") {
         myConnMap.idleTimeoutConfigChanged(value);
+    } else if (key == "dcp_producer_flow_control_mem_threshold") {
+        myConnMap.producerFlowControlMemThreshold = value;
+    }
+}
+
+void DcpConnMap::DcpConfigChangeListener::booleanValueChanged(
+        const std::string& key, bool value) {
+    if (key == "dcp_producer_apply_min_compression_ratio") {
+        myConnMap.applyMinCompressionRatio = value;
+    } else if (key == "dcp_producer_adaptive_flow_control") {
+        myConnMap.producerFlowControlAdaptive = value;
     }
 }
 
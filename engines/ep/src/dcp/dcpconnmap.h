@@ -153,6 +153,32 @@ public:
 
     float getMinCompressionRatio();
 
+    /**
+     * @return the fraction of its size a value must be compressed to for a
+     * stream forcing value compression to send it compressed. That's
+     * getMinCompressionRatio() if dcp_producer_apply_min_compression_ratio
+     * is enabled, else 1 (the value must only not get larger).
+     */
+    float getForcedCompressionRatio() const;
+
+    /// @return true if producers size their flow control window from the
+    /// timing of the consumer's acks (dcp_producer_adaptive_flow_control)
+    bool isProducerFlowControlAdaptive() const {
+        return producerFlowControlAdaptive;
+    }
+
+    /// Account for bytes sent by (or acked to) a flow controlled producer in
+    /// the total outstanding across all producers
+    void incrProducerBytesOutstanding(size_t bytes);
+    void decrProducerBytesOutstanding(size_t bytes);
+
+    /**
+     * @return true if the bytes outstanding across all flow controlled
+     * producers reached dcp_producer_flow_control_mem_threshold percent of
+     * the bucket quota
+     */
+    bool isProducerFlowControlMemBudgetFull() const;
+
     std::shared_ptr<ConnHandler> findByName(const std::string& name);
 
     bool isConnections() override;
@@ -185,6 +211,9 @@ protected:
      */
     void idleTimeoutConfigChanged(size_t newValue);
 
+    /// @return the memory budget for the bytes outstanding across producers
+    size_t getProducerFlowControlMemBudget() const;
+
     /**
      * @param engine The engine
      * @param cookie The cookie that identifies the connection
@@ -227,8 +256,22 @@ protected:
 
     std::atomic<float> minCompressionRatioForProducer;
 
+    /* Whether streams forcing value compression apply
+       minCompressionRatioForProducer */
+    std::atomic<bool> applyMinCompressionRatio;
+
     /* Total memory used by all DCP consumer buffers */
     std::atomic<size_t> aggrDcpConsumerBufferSize;
 
+    /* Total bytes sent and not yet acked across all flow controlled DCP
+       producers */
+    std::atomic<size_t> aggrDcpProducerBytesOutstanding;
+
+    std::atomic<bool> producerFlowControlAdaptive;
+
+    /* Percentage of the bucket quota the bytes outstanding across all
+       producers are limited to (with adaptive flow control) */
+    std::atomic<size_t> producerFlowControlMemThreshold;
+
     class DcpConfigChangeListener;
 };
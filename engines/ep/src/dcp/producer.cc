@@ -39,8 +39,17 @@
 
 #include <memcached/server_cookie_iface.h>
 
+#include <algorithm>
+
 const std::chrono::seconds DcpProducer::defaultDcpNoopTxInterval(20);
 
+/// Gain applied to the bandwidth-delay product to size an adaptive window
+static const double adaptiveWindowGain = 2.0;
+
+/// How long the min RTT of an adaptive window is kept before being sampled
+/// again, so that it follows a link whose latency increased
+static const std::chrono::seconds minRttExpiry(10);
+
 DcpProducer::BufferLog::State DcpProducer::BufferLog::getState_UNLOCKED() {
     if (isEnabled_UNLOCKED()) {
         if (isFull_UNLOCKED()) {
@@ -52,13 +61,44 @@ DcpProducer::BufferLog::State DcpProducer::BufferLog::getState_UNLOCKED() {
     return Disabled;
 }
 
+bool DcpProducer::BufferLog::isAdaptive() const {
+    return producer.engine_.getDcpConnMap().isProducerFlowControlAdaptive();
+}
+
+size_t DcpProducer::BufferLog::getLimit_UNLOCKED() const {
+    if (adaptive.window && isAdaptive()) {
+        return adaptive.window;
+    }
+    return maxBytes;
+}
+
+std::optional<DcpProducer::BufferLog::FullReason>
+DcpProducer::BufferLog::getFullReason_UNLOCKED() {
+    if (bytesOutstanding >= maxBytes) {
+        return FullReason::BufferSize;
+    }
+    if (!isAdaptive()) {
+        return {};
+    }
+    if (bytesOutstanding >= getLimit_UNLOCKED()) {
+        return FullReason::Window;
+    }
+    if (bytesOutstanding >= getMinWindow_UNLOCKED() &&
+        producer.engine_.getDcpConnMap().isProducerFlowControlMemBudgetFull()) {
+        return FullReason::MemBudget;
+    }
+    return {};
+}
+
 void DcpProducer::BufferLog::setBufferSize(size_t maxBytes) {
     std::unique_lock<folly::SharedMutex> wlh(logLock);
     this->maxBytes = maxBytes;
     if (maxBytes == 0) {
         bytesOutstanding = 0;
         ackedBytes.reset(0);
+        releaseMemBudget_UNLOCKED();
     }
+    resetWindow_UNLOCKED();
 }
 
 bool DcpProducer::BufferLog::insert(size_t bytes) {
@@ -66,8 +106,16 @@ bool DcpProducer::BufferLog::insert(size_t bytes) {
     bool inserted = false;
     // If the log is not enabled
     // or there is space, allow the insert
-    if (!isEnabled_UNLOCKED() || !isFull_UNLOCKED()) {
+    if (!isEnabled_UNLOCKED()) {
+        bytesOutstanding += bytes;
+        inserted = true;
+    } else if (!isFull_UNLOCKED()) {
         bytesOutstanding += bytes;
+        bytesInMemBudget += bytes;
+        producer.engine_.getDcpConnMap().incrProducerBytesOutstanding(bytes);
+        if (isAdaptive()) {
+            startProbe_UNLOCKED();
+        }
         inserted = true;
     }
     return inserted;
@@ -84,15 +132,38 @@ void DcpProducer::BufferLog::release_UNLOCKED(size_t bytes) {
     }
 
     bytesOutstanding -= bytes;
+
+    const auto budgetBytes = std::min(bytes, bytesInMemBudget);
+    if (budgetBytes) {
+        bytesInMemBudget -= budgetBytes;
+        producer.engine_.getDcpConnMap().decrProducerBytesOutstanding(
+                budgetBytes);
+    }
 }
 
 bool DcpProducer::BufferLog::pauseIfFull() {
     std::shared_lock<folly::SharedMutex> rhl(logLock);
-    if (getState_UNLOCKED() == Full) {
-        producer.pause(PausedReason::BufferLogFull);
-        return true;
+    if (!isEnabled_UNLOCKED()) {
+        return false;
     }
-    return false;
+    const auto reason = getFullReason_UNLOCKED();
+    if (!reason) {
+        return false;
+    }
+    switch (*reason) {
+    case FullReason::BufferSize:
+        pauses.bufferSize++;
+        break;
+    case FullReason::Window:
+        pauses.window++;
+        break;
+    case FullReason::MemBudget:
+        pauses.memBudget++;
+        break;
+    }
+    adaptive.probeFull = true;
+    producer.pause(PausedReason::BufferLogFull);
+    return true;
 }
 
 void DcpProducer::BufferLog::unpauseIfSpaceAvailable() {
@@ -101,11 +172,12 @@ void DcpProducer::BufferLog::unpauseIfSpaceAvailable() {
         EP_LOG_INFO(
                 "{} Unable to notify paused connection because "
                 "DcpProducer::BufferLog is full; ackedBytes:{}"
-                ", bytesSent:{}, maxBytes:{}",
+                ", bytesSent:{}, maxBytes:{}, limit:{}",
                 producer.logHeader(),
                 uint64_t(ackedBytes),
                 uint64_t(bytesOutstanding),
-                uint64_t(maxBytes));
+                uint64_t(maxBytes),
+                uint64_t(getLimit_UNLOCKED()));
     } else {
         producer.scheduleNotify();
     }
@@ -117,21 +189,92 @@ void DcpProducer::BufferLog::acknowledge(size_t bytes) {
     if (state != Disabled) {
         release_UNLOCKED(bytes);
         ackedBytes += bytes;
+        completeProbe_UNLOCKED();
 
         if (state == Full) {
             EP_LOG_INFO(
                     "{} Notifying paused connection now that "
                     "DcpProducer::BufferLog is no longer full; ackedBytes:{}"
-                    ", bytesSent:{}, maxBytes:{}",
+                    ", bytesSent:{}, maxBytes:{}, limit:{}",
                     producer.logHeader(),
                     uint64_t(ackedBytes),
                     uint64_t(bytesOutstanding),
-                    uint64_t(maxBytes));
+                    uint64_t(maxBytes),
+                    uint64_t(getLimit_UNLOCKED()));
             producer.scheduleNotify();
         }
     }
 }
 
+void DcpProducer::BufferLog::releaseMemBudget() {
+    std::unique_lock<folly::SharedMutex> wlh(logLock);
+    releaseMemBudget_UNLOCKED();
+}
+
+void DcpProducer::BufferLog::releaseMemBudget_UNLOCKED() {
+    if (bytesInMemBudget) {
+        producer.engine_.getDcpConnMap().decrProducerBytesOutstanding(
+                bytesInMemBudget);
+        bytesInMemBudget = 0;
+    }
+}
+
+void DcpProducer::BufferLog::startProbe_UNLOCKED() {
+    if (adaptive.probeEnd != 0) {
+        return;
+    }
+    adaptive.probeStart = std::chrono::steady_clock::now();
+    adaptive.probeStartAcked = ackedBytes;
+    adaptive.probeEnd = size_t(ackedBytes) + size_t(bytesOutstanding);
+    adaptive.probeFull = false;
+}
+
+void DcpProducer::BufferLog::completeProbe_UNLOCKED() {
+    if (adaptive.probeEnd == 0 || ackedBytes < adaptive.probeEnd) {
+        return;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    const auto rtt = now - adaptive.probeStart;
+    const size_t delivered = size_t(ackedBytes) - adaptive.probeStartAcked;
+    adaptive.probeEnd = 0;
+    if (rtt.count() <= 0) {
+        return;
+    }
+
+    if (adaptive.minRtt.count() == 0 || rtt < adaptive.minRtt ||
+        now - adaptive.minRttStart > minRttExpiry) {
+        adaptive.minRtt = rtt;
+        adaptive.minRttStart = now;
+    }
+
+    // A producer which didn't fill the log during the probe only sent what
+    // it had; its rate only says the link is at least that fast.
+    const double rate =
+            delivered / std::chrono::duration<double>(rtt).count();
+    auto& rates = adaptive.deliveryRates;
+    auto maxRate = *std::max_element(rates.begin(), rates.end());
+    if (adaptive.probeFull || rate > maxRate) {
+        rates[adaptive.nextDeliveryRate] = rate;
+        adaptive.nextDeliveryRate =
+                (adaptive.nextDeliveryRate + 1) % deliveryRateSamples;
+        maxRate = *std::max_element(rates.begin(), rates.end());
+    }
+
+    const auto bdp = maxRate *
+                     std::chrono::duration<double>(adaptive.minRtt).count();
+    adaptive.window = std::clamp(size_t(adaptiveWindowGain * bdp),
+                                 std::max(getMinWindow_UNLOCKED(), size_t(1)),
+                                 maxBytes);
+}
+
+void DcpProducer::BufferLog::resetWindow_UNLOCKED() {
+    adaptive.window = 0;
+    adaptive.minRtt = std::chrono::nanoseconds(0);
+    adaptive.deliveryRates.fill(0);
+    adaptive.nextDeliveryRate = 0;
+    adaptive.probeEnd = 0;
+}
+
 void DcpProducer::BufferLog::addStats(const AddStatFn& add_stat,
                                       const void* c) {
     std::shared_lock<folly::SharedMutex> rhl(logLock);
@@ -140,6 +283,33 @@ void DcpProducer::BufferLog::addStats(const AddStatFn& add_stat,
         producer.addStat("unacked_bytes", bytesOutstanding, add_stat, c);
         producer.addStat("total_acked_bytes", ackedBytes, add_stat, c);
         producer.addStat("flow_control", "enabled", add_stat, c);
+        if (isAdaptive()) {
+            const auto& rates = adaptive.deliveryRates;
+            producer.addStat(
+                    "flow_control_window", getLimit_UNLOCKED(), add_stat, c);
+            producer.addStat(
+                    "flow_control_min_rtt_us",
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                            adaptive.minRtt)
+                            .count(),
+                    add_stat,
+                    c);
+            producer.addStat(
+                    "flow_control_max_delivery_rate",
+                    uint64_t(*std::max_element(rates.begin(), rates.end())),
+                    add_stat,
+                    c);
+        }
+        producer.addStat("flow_control_paused_buffer_full",
+                         pauses.bufferSize,
+                         add_stat,
+                         c);
+        producer.addStat(
+                "flow_control_paused_window_full", pauses.window, add_stat, c);
+        producer.addStat("flow_control_paused_mem_budget",
+                         pauses.memBudget,
+                         add_stat,
+                         c);
     } else {
         producer.addStat("flow_control", "disabled", add_stat, c);
     }
@@ -604,30 +774,62 @@ cb::unique_item_ptr DcpProducer::toUniqueItemPtr(
 }
 
 ENGINE_ERROR_CODE DcpProducer::step(struct dcp_message_producers* producers) {
+    size_t nmessages;
+    return stepBatch(producers, 0, nmessages);
+}
 
+ENGINE_ERROR_CODE DcpProducer::stepBatch(
+        struct dcp_message_producers* producers,
+        size_t maxBytes,
+        size_t& nmessages) {
+    nmessages = 0;
     if (doDisconnect()) {
         return ENGINE_DISCONNECT;
     }
 
     ENGINE_ERROR_CODE ret;
     if ((ret = maybeDisconnect()) != ENGINE_FAILED) {
-          return ret;
+        return ret;
     }
 
     if ((ret = maybeSendNoop(producers)) != ENGINE_FAILED) {
+        if (ret == ENGINE_SUCCESS) {
+            nmessages = 1;
+        }
         return ret;
     }
 
-    std::unique_ptr<DcpResponse> resp;
-    if (rejectResp) {
-        resp = std::move(rejectResp);
-    } else {
-        resp = getNextItem();
-        if (!resp) {
-            return ENGINE_EWOULDBLOCK;
+    // Send at least one response, and then carry on while there are more
+    // ready until we've sent maxBytes
+    size_t bytes = 0;
+    do {
+        std::unique_ptr<DcpResponse> resp;
+        if (rejectResp) {
+            resp = std::move(rejectResp);
+        } else {
+            resp = getNextItem();
+            if (!resp) {
+                return nmessages ? ENGINE_SUCCESS : ENGINE_EWOULDBLOCK;
+            }
         }
-    }
 
+        const auto size = resp->getMessageSize();
+        ret = sendResponse(producers, std::move(resp));
+        if (ret != ENGINE_SUCCESS) {
+            // A response rejected with E2BIG is retried by the next step
+            return (ret == ENGINE_E2BIG && nmessages) ? ENGINE_SUCCESS : ret;
+        }
+        ++nmessages;
+        bytes += size;
+    } while (bytes < maxBytes);
+
+    return ENGINE_SUCCESS;
+}
+
+ENGINE_ERROR_CODE DcpProducer::sendResponse(
+        struct dcp_message_producers* producers,
+        std::unique_ptr<DcpResponse> resp) {
+    ENGINE_ERROR_CODE ret = ENGINE_FAILED;
     std::unique_ptr<Item> itmCpy;
     totalUncompressedDataSize.fetch_add(resp->getMessageSize());
 
@@ -1614,6 +1816,10 @@ void DcpProducer::closeAllStreams() {
         closeAllStreamsHook();
     }
 
+    // Nothing more will be acked, so stop counting the outstanding bytes
+    // against the flow control memory budget of all producers
+    log.releaseMemBudget();
+
     // Destroy the backfillManager. (BackfillManager task also
     // may hold a weak reference to it while running, but that is
     // guaranteed to decay and free the BackfillManager once it
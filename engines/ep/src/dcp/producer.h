@@ -28,6 +28,11 @@
 #include <folly/AtomicHashMap.h>
 #include <folly/CachelinePadded.h>
 #include <folly/SharedMutex.h>
+#include <relaxed_atomic.h>
+
+#include <array>
+#include <chrono>
+#include <optional>
 
 class BackfillManager;
 class CheckpointCursor;
@@ -79,6 +84,10 @@ public:
 
     ENGINE_ERROR_CODE step(struct dcp_message_producers* producers) override;
 
+    ENGINE_ERROR_CODE stepBatch(struct dcp_message_producers* producers,
+                                size_t maxBytes,
+                                size_t& nmessages) override;
+
     ENGINE_ERROR_CODE bufferAcknowledgement(uint32_t opaque,
                                             Vbid vbucket,
                                             uint32_t buffer_bytes) override;
@@ -239,6 +248,16 @@ public:
      * When the buffer becomes full (outstanding >= limit), the producer is
      * paused. Similarly when data is subsequently acknowledged and outstanding
      * < limit; the producer is un-paused.
+     *
+     * With dcp_producer_adaptive_flow_control, the limit is a window sized
+     * from the timing of the acks (BBR style): twice the bandwidth-delay
+     * product of the link to the consumer, estimated as the max delivery rate
+     * of recent acks times their min round trip time. The window stays within
+     * the buffer size advertised by the consumer, and above a quarter of it,
+     * as the consumer only acks once a fifth of its buffer has drained.
+     * The producer is also paused once the bytes outstanding across all
+     * producers reach dcp_producer_flow_control_mem_threshold (but only when
+     * it has outstanding bytes the consumer will ack, so that it resumes).
      */
     class BufferLog {
     public:
@@ -295,23 +314,60 @@ public:
         /// Unpause the producer if there's space (or disabled).
         void unpauseIfSpaceAvailable();
 
+        /**
+         * Remove the outstanding bytes from the total of all producers (for
+         * a producer closing its streams, whose bytes won't be acked).
+         */
+        void releaseMemBudget();
+
         size_t getBytesOutstanding() const {
             return bytesOutstanding;
         }
 
     private:
+        /// Why a full log paused the producer
+        enum class FullReason { BufferSize, Window, MemBudget };
+
         bool isEnabled_UNLOCKED() {
             return maxBytes != 0;
         }
 
         bool isFull_UNLOCKED() {
-            return bytesOutstanding >= maxBytes;
+            return getFullReason_UNLOCKED().has_value();
+        }
+
+        /// @return why the log is full, or none if there is space
+        std::optional<FullReason> getFullReason_UNLOCKED();
+
+        bool isAdaptive() const;
+
+        /// Limit on the bytes outstanding: the window with adaptive flow
+        /// control (once sized), else the buffer size
+        size_t getLimit_UNLOCKED() const;
+
+        /// The smallest adaptive window, still large enough for the
+        /// consumer to ack
+        size_t getMinWindow_UNLOCKED() const {
+            return maxBytes / 4;
         }
 
         void release_UNLOCKED(size_t bytes);
 
+        void releaseMemBudget_UNLOCKED();
+
         State getState_UNLOCKED();
 
+        /// Start a round trip time probe at the bytes now outstanding, if
+        /// none is in flight
+        void startProbe_UNLOCKED();
+
+        /// Complete the probe in flight if the bytes it waits for are
+        /// acked, and resize the window from its RTT and delivery rate
+        void completeProbe_UNLOCKED();
+
+        /// Reset the adaptive window to be sized again from new samples
+        void resetWindow_UNLOCKED();
+
         folly::SharedMutex logLock;
         DcpProducer& producer;
 
@@ -326,6 +382,46 @@ public:
         /// Total number of bytes acknowledeged. Should be non-decreasing in
         /// normal usage; but can be reset to zero when buffer size changes.
         Monotonic<size_t> ackedBytes;
+
+        /// Bytes accounted for in the DcpConnMap's total of outstanding
+        /// bytes across all producers (the outstanding bytes sent with flow
+        /// control enabled).
+        size_t bytesInMemBudget = 0;
+
+        /// Number of recent delivery rate samples the bandwidth estimate is
+        /// the max of
+        static constexpr size_t deliveryRateSamples = 10;
+
+        /// State of the adaptive window
+        struct {
+            /// The window; zero until sized from a first sample
+            size_t window = 0;
+
+            /// Min RTT seen since minRttStart (reset every minRttExpiry)
+            std::chrono::nanoseconds minRtt{0};
+            std::chrono::steady_clock::time_point minRttStart;
+
+            /// Recent delivery rate samples (bytes/s)
+            std::array<double, deliveryRateSamples> deliveryRates{};
+            size_t nextDeliveryRate = 0;
+
+            /// The probe in flight: it completes when ackedBytes reaches
+            /// probeEnd (zero if there is none)
+            size_t probeEnd = 0;
+            size_t probeStartAcked = 0;
+            std::chrono::steady_clock::time_point probeStart;
+
+            /// Set if the log filled up during the probe, so its delivery
+            /// rate isn't limited by the producer having nothing to send
+            cb::RelaxedAtomic<bool> probeFull{false};
+        } adaptive;
+
+        /// Number of times the producer paused on a full log, by reason
+        struct {
+            cb::RelaxedAtomic<size_t> bufferSize{0};
+            cb::RelaxedAtomic<size_t> window{0};
+            cb::RelaxedAtomic<size_t> memBudget{0};
+        } pauses;
     };
 
     /*
@@ -405,6 +501,16 @@ protected:
 
     std::unique_ptr<DcpResponse> getNextItem();
 
+    /**
+     * Send the response to the consumer with the message producers, and
+     * account for it (or keep it in rejectResp if it was rejected with
+     * ENGINE_E2BIG).
+     *
+     * @return the status of the message producer
+     */
+    ENGINE_ERROR_CODE sendResponse(struct dcp_message_producers* producers,
+                                   std::unique_ptr<DcpResponse> resp);
+
     size_t getItemsRemaining();
 
     /**
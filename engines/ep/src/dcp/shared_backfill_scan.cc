@@ -0,0 +1,299 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "dcp/shared_backfill_scan.h"
+#include "dcp/active_stream.h"
+#include "dcp/backfill_disk.h"
+#include "item.h"
+#include "kv_bucket.h"
+#include "vbucket.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+/**
+ * Give a copy of the item to each of the members; the last one gets the
+ * item itself.
+ *
+ * @return true if all of them took it
+ */
+bool giveToMembers(
+        std::vector<std::shared_ptr<SharedBackfillScan::Member>>& recipients,
+        std::unique_ptr<Item> item,
+        backfill_source_t source) {
+    bool ret = true;
+    const uint64_t seqno = item->getBySeqno();
+    for (size_t ii = 0; ii < recipients.size(); ++ii) {
+        auto& member = *recipients[ii];
+        auto stream = member.stream.lock();
+        if (!stream) {
+            member.lastSeqno = seqno;
+            continue;
+        }
+        auto copy = (ii + 1 == recipients.size())
+                            ? std::move(item)
+                            : std::make_unique<Item>(*item);
+        if (stream->backfillReceived(std::move(copy), source, false)) {
+            member.lastSeqno = seqno;
+        } else {
+            member.blocked = true;
+            ret = false;
+        }
+    }
+    return ret;
+}
+
+/**
+ * The CacheCallback of a shared scan: give the item to the members needing
+ * it from memory if it is resident.
+ */
+class SharedCacheCallback : public StatusCallback<CacheLookup> {
+public:
+    SharedCacheCallback(KVBucket& bucket, SharedBackfillScan& scan)
+        : bucket(bucket), scan(scan) {
+    }
+
+    void callback(CacheLookup& lookup) override {
+        auto recipients = scan.getRecipients(lookup.getBySeqno());
+
+        // Skip the item for the members which don't want its collection (to
+        // avoid reading its value if nobody does)
+        const auto cid = lookup.getKey().getDocKey().getCollectionID();
+        recipients.erase(
+                std::remove_if(recipients.begin(),
+                               recipients.end(),
+                               [cid, &lookup](const auto& member) {
+                                   auto stream = member->stream.lock();
+                                   if (stream &&
+                                       stream->collectionAllowed(cid)) {
+                                       return false;
+                                   }
+                                   member->lastSeqno = lookup.getBySeqno();
+                                   return true;
+                               }),
+                recipients.end());
+        if (recipients.empty()) {
+            setStatus(ENGINE_KEY_EEXISTS);
+            return;
+        }
+
+        // See CacheCallback::callback()
+        VBucketPtr vb = bucket.getVBucket(lookup.getVBucketId());
+        if (!vb || lookup.getKey().isPrepared()) {
+            setStatus(ENGINE_SUCCESS);
+            return;
+        }
+
+        auto gv = CacheCallback::get(
+                bucket,
+                *vb,
+                lookup,
+                scan.getValueFilter() == ValueFilter::KEYS_ONLY);
+        if (gv.getStatus() != ENGINE_SUCCESS ||
+            gv.item->isCommitSyncWrite() ||
+            gv.item->getBySeqno() != lookup.getBySeqno()) {
+            setStatus(ENGINE_SUCCESS);
+            return;
+        }
+
+        if (giveToMembers(
+                    recipients, std::move(gv.item), BACKFILL_FROM_MEMORY)) {
+            setStatus(ENGINE_KEY_EEXISTS);
+        } else {
+            setStatus(ENGINE_ENOMEM); // Pause the backfill
+        }
+    }
+
+private:
+    KVBucket& bucket;
+    SharedBackfillScan& scan;
+};
+
+/**
+ * The DiskCallback of a shared scan: give the item read to the members
+ * needing it.
+ */
+class SharedDiskCallback : public StatusCallback<GetValue> {
+public:
+    explicit SharedDiskCallback(SharedBackfillScan& scan) : scan(scan) {
+    }
+
+    void callback(GetValue& val) override {
+        if (!val.item) {
+            throw std::invalid_argument(
+                    "SharedDiskCallback::callback: val is NULL");
+        }
+
+        auto recipients = scan.getRecipients(val.item->getBySeqno());
+        // MB-26705: Make the backfilled item cold
+        val.item->setFreqCounterValue(0);
+        if (recipients.empty() ||
+            giveToMembers(
+                    recipients, std::move(val.item), BACKFILL_FROM_DISK)) {
+            setStatus(ENGINE_SUCCESS);
+        } else {
+            setStatus(ENGINE_ENOMEM); // Pause the backfill
+        }
+    }
+
+private:
+    SharedBackfillScan& scan;
+};
+
+} // namespace
+
+SharedBackfillScan::Member::Member(std::shared_ptr<ActiveStream> stream,
+                                   uint64_t startSeqno)
+    : stream(stream), startSeqno(startSeqno), lastSeqno(startSeqno - 1) {
+}
+
+SharedBackfillScan::SharedBackfillScan(KVBucket& bucket,
+                                       Vbid vbid,
+                                       ValueFilter valFilter)
+    : bucket(bucket), vbid(vbid), valFilter(valFilter) {
+}
+
+const BySeqnoScanContext* SharedBackfillScan::create(uint64_t startSeqno) {
+    std::lock_guard<std::mutex> lh(scanMutex);
+    if (scanCtx) {
+        throw std::logic_error("SharedBackfillScan::create: " +
+                               vbid.to_string() + " scan already created");
+    }
+
+    KVStore* kvstore = bucket.getROUnderlying(vbid);
+    scanCtx = kvstore->initBySeqnoScanContext(
+            std::make_unique<SharedDiskCallback>(*this),
+            std::make_unique<SharedCacheCallback>(bucket, *this),
+            vbid,
+            startSeqno,
+            DocumentFilter::ALL_ITEMS,
+            valFilter);
+    if (scanCtx) {
+        std::lock_guard<std::mutex> guard(membersMutex);
+        position = startSeqno - 1;
+        maxSeqno = scanCtx->maxSeqno;
+        purgeSeqno = scanCtx->purgeSeqno;
+    }
+    return scanCtx.get();
+}
+
+std::shared_ptr<SharedBackfillScan::Member> SharedBackfillScan::join(
+        std::shared_ptr<ActiveStream> stream,
+        uint64_t startSeqno,
+        uint64_t endSeqno) {
+    std::lock_guard<std::mutex> lh(membersMutex);
+    // The scan context is immutable (apart from the scan position) once
+    // created, and members may only join after that
+    if (finished || startSeqno <= position || endSeqno > maxSeqno ||
+        (startSeqno != 1 && startSeqno <= purgeSeqno)) {
+        return {};
+    }
+
+    auto member = std::make_shared<Member>(stream, startSeqno);
+    // Send the marker while holding the lock, so that the scan doesn't
+    // give the stream any item before it
+    if (!stream->markDiskSnapshot(startSeqno,
+                                  scanCtx->maxSeqno,
+                                  scanCtx->persistedCompletedSeqno,
+                                  scanCtx->maxVisibleSeqno)) {
+        member->cancelled = true;
+        return member;
+    }
+
+    // This value may be an overestimate - see DCPBackfillBySeqnoDisk
+    stream->setBackfillRemaining(scanCtx->documentCount);
+    members.push_back(member);
+    return member;
+}
+
+bool SharedBackfillScan::mustWait(Member& member) {
+    member.blocked = false;
+    std::lock_guard<std::mutex> lh(membersMutex);
+    return std::any_of(
+            members.begin(), members.end(), [](const auto& other) {
+                return other->blocked && !other->cancelled &&
+                       !other->stream.expired();
+            });
+}
+
+scan_error_t SharedBackfillScan::scan() {
+    std::lock_guard<std::mutex> lh(scanMutex);
+    if (status != scan_again) {
+        return status;
+    }
+
+    KVStore* kvstore = bucket.getROUnderlying(vbid);
+    status = kvstore->scan(*scanCtx);
+    if (status != scan_again) {
+        std::lock_guard<std::mutex> guard(membersMutex);
+        finished = true;
+        members.clear();
+    }
+    return status;
+}
+
+std::vector<std::shared_ptr<SharedBackfillScan::Member>>
+SharedBackfillScan::getRecipients(uint64_t seqno) {
+    std::lock_guard<std::mutex> lh(membersMutex);
+    position = std::max(position, seqno);
+
+    members.erase(std::remove_if(members.begin(),
+                                 members.end(),
+                                 [](const auto& member) {
+                                     return member->cancelled.load();
+                                 }),
+                  members.end());
+
+    std::vector<std::shared_ptr<Member>> ret;
+    for (const auto& member : members) {
+        if (seqno >= member->startSeqno && seqno > member->lastSeqno) {
+            ret.push_back(member);
+        }
+    }
+    return ret;
+}
+
+std::pair<std::shared_ptr<SharedBackfillScan>,
+          std::shared_ptr<SharedBackfillScan::Member>>
+SharedBackfillScans::join(std::shared_ptr<ActiveStream> stream,
+                          uint64_t startSeqno,
+                          uint64_t endSeqno,
+                          ValueFilter valFilter) {
+    std::lock_guard<std::mutex> lh(mutex);
+    for (auto iter = scans.begin(); iter != scans.end();) {
+        auto scan = iter->lock();
+        if (!scan) {
+            iter = scans.erase(iter);
+            continue;
+        }
+        if (scan->getValueFilter() == valFilter) {
+            auto member = scan->join(stream, startSeqno, endSeqno);
+            if (member) {
+                return {scan, member};
+            }
+        }
+        ++iter;
+    }
+    return {};
+}
+
+void SharedBackfillScans::add(std::shared_ptr<SharedBackfillScan> scan) {
+    std::lock_guard<std::mutex> lh(mutex);
+    scans.push_back(scan);
+}
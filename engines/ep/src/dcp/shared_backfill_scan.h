@@ -0,0 +1,181 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include "kvstore.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class ActiveStream;
+class KVBucket;
+
+/**
+ * A by-seqno disk scan of a vBucket shared by the backfills of a number of
+ * streams - typically of different DcpProducers (replication, indexing,
+ * XDCR...) which all need to backfill the same vBucket after a node
+ * (re)joins (see dcp_backfill_shared_scans).
+ *
+ * The scan is opened by the first backfill, from its start seqno. Other
+ * backfills of the vBucket (with the same value filter) join it as long
+ * as the scan hasn't yet passed their start seqno and its snapshot covers
+ * their end seqno, instead of opening a scan of their own. Every item read
+ * is given to each member stream (which applies its own collection filter,
+ * value/xattr stripping and, through its producer's BackfillManager, flow
+ * control). If a stream cannot take an item the scan pauses, and resumes
+ * at the item when that stream's backfill next runs (i.e. once its
+ * BackfillManager has space again); the members which already got the item
+ * skip it. Until then the backfills of the other members snooze rather than
+ * re-read the item from disk only to pause again (see mustWait()).
+ *
+ * The scan is driven by the backfills of all the members (whichever runs
+ * first), and is closed when the last of them goes away.
+ */
+class SharedBackfillScan {
+public:
+    /// A stream served by the scan
+    struct Member {
+        Member(std::shared_ptr<ActiveStream> stream, uint64_t startSeqno);
+
+        const std::weak_ptr<ActiveStream> stream;
+        const uint64_t startSeqno;
+        /// The highest seqno given to (or skipped for) the stream. Only
+        /// used by the thread driving the scan.
+        uint64_t lastSeqno;
+        /// Set when the stream's backfill ends (before the scan does)
+        std::atomic_bool cancelled{false};
+        /// Set when the stream couldn't take an item of the scan; cleared
+        /// when its backfill next runs (see mustWait())
+        std::atomic_bool blocked{false};
+    };
+
+    SharedBackfillScan(KVBucket& bucket, Vbid vbid, ValueFilter valFilter);
+
+    /**
+     * Open the scan of the vBucket.
+     *
+     * @param startSeqno the seqno to scan from
+     * @return the scan context (owned by the scan), or nullptr if the scan
+     *         could not be opened
+     */
+    const BySeqnoScanContext* create(uint64_t startSeqno);
+
+    /**
+     * Add a stream to the scan and send its disk snapshot marker.
+     *
+     * @param stream the stream to serve
+     * @param startSeqno the first seqno the stream needs
+     * @param endSeqno the seqno the stream needs to backfill up to
+     * @return the new member, or nullptr if the scan can't serve the
+     *         stream (it is past startSeqno, or ends before endSeqno).
+     *         The member is returned (but not added) if the stream is no
+     *         longer backfilling; see Member::cancelled.
+     */
+    std::shared_ptr<Member> join(std::shared_ptr<ActiveStream> stream,
+                                 uint64_t startSeqno,
+                                 uint64_t endSeqno);
+
+    /**
+     * Should the backfill of the given member snooze rather than read the
+     * scan? That's the case while another (live) member is blocked: the
+     * scan would only pause at the same item again. The blocked member's
+     * backfill runs once its BackfillManager has space, and reads on.
+     *
+     * As the given member's backfill is running its BackfillManager has
+     * space, so it is no longer blocked itself.
+     */
+    bool mustWait(Member& member);
+
+    /**
+     * Read the next chunk of the scan (unless another member's backfill is
+     * already reading it, in which case wait for it).
+     *
+     * @return scan_again if the scan was paused, else the final status of
+     *         the scan
+     */
+    scan_error_t scan();
+
+    ValueFilter getValueFilter() const {
+        return valFilter;
+    }
+
+    /**
+     * The callbacks of the scan context: return the members which need
+     * the item with the given seqno, and note that the scan reached it.
+     */
+    std::vector<std::shared_ptr<Member>> getRecipients(uint64_t seqno);
+
+private:
+    KVBucket& bucket;
+    const Vbid vbid;
+    const ValueFilter valFilter;
+
+    /// Serialises reading the scan, and guards scanCtx and status
+    std::mutex scanMutex;
+    std::unique_ptr<BySeqnoScanContext> scanCtx;
+    scan_error_t status = scan_again;
+
+    /// Guards members and position
+    std::mutex membersMutex;
+    std::vector<std::shared_ptr<Member>> members;
+    /// The highest seqno the scan got to; streams may only join with a
+    /// start seqno above it
+    uint64_t position = 0;
+    /// The snapshot (end) of the scan; streams may only join with an end
+    /// seqno up to it
+    uint64_t maxSeqno = 0;
+    uint64_t purgeSeqno = 0;
+    bool finished = false;
+};
+
+/**
+ * The shared backfill scans open on a vBucket.
+ */
+class SharedBackfillScans {
+public:
+    /**
+     * Join the stream to one of the scans (with the given value filter)
+     * which can serve it.
+     *
+     * @param stream the stream to backfill
+     * @param startSeqno the first seqno the stream needs
+     * @param endSeqno the seqno the stream needs to backfill up to
+     * @param valFilter the values the stream needs
+     * @return the scan and the stream's membership (see
+     *         SharedBackfillScan::join()), or nulls if no scan can serve the
+     *         stream
+     */
+    std::pair<std::shared_ptr<SharedBackfillScan>,
+              std::shared_ptr<SharedBackfillScan::Member>>
+    join(std::shared_ptr<ActiveStream> stream,
+         uint64_t startSeqno,
+         uint64_t endSeqno,
+         ValueFilter valFilter);
+
+    /**
+     * Add a newly opened scan, for the backfills scheduled from now on to
+     * join. (Backfills opening scans at the same time won't find each
+     * other's scans, and read the vBucket separately.)
+     */
+    void add(std::shared_ptr<SharedBackfillScan> scan);
+
+private:
+    std::mutex mutex;
+    std::vector<std::weak_ptr<SharedBackfillScan>> scans;
+};
@@ -17,6 +17,8 @@
 
 #include "defragmenter_visitor.h"
 
+#include "slab_allocator.h"
+
 // DegragmentVisitor implementation ///////////////////////////////////////////
 
 DefragmentVisitor::DefragmentVisitor(size_t max_size_class)
@@ -50,7 +52,9 @@ bool DefragmentVisitor::visit(const HashTable::HashBucketLock& lh,
     // and no larger than the biggest size class the allocator
     // supports, so it can be successfully reallocated to a run with other
     // objects of the same size.
-    if (value_len > 0 && value_len <= max_size_class) {
+    // Inline values live within the StoredValue itself, so are covered by
+    // StoredValue defragmentation below.
+    if (value_len > 0 && value_len <= max_size_class && !v.isValueInline()) {
         // If sufficiently old and if it looks like nothing else holds a
         // reference to the blob reallocate, otherwise increment it's age.
         // It may be possible to add a reference to the blob without holding
@@ -66,7 +70,13 @@ bool DefragmentVisitor::visit(const HashTable::HashBucketLock& lh,
     }
 
     if (sv_age_threshold) {
-        if (v.getAge() >= sv_age_threshold.value()) {
+        if (v.isSlabAllocated()) {
+            // Slab allocated StoredValues are only moved if they live in a
+            // sparsely used slab; moving them allows that slab to be freed.
+            if (SlabAllocator::isFragmented(&v)) {
+                defragmentStoredValue(v);
+            }
+        } else if (v.getAge() >= sv_age_threshold.value()) {
             defragmentStoredValue(v);
         } else {
             v.incrementAge();
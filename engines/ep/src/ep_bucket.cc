@@ -223,6 +223,9 @@ public:
     void sizeValueChanged(const std::string& key, size_t value) override {
         if (key == "flusher_total_batch_limit") {
             bucket.setFlusherBatchSplitTrigger(value);
+        } else if (key == "flusher_batch_target_latency_ms") {
+            bucket.setFlusherBatchTargetLatency(
+                    std::chrono::milliseconds(value));
         } else if (key == "alog_sleep_time") {
             bucket.setAccessScannerSleeptime(value, false);
         } else if (key == "alog_task_time") {
@@ -241,6 +244,10 @@ public:
             }
         } else if (key == "retain_erroneous_tombstones") {
             bucket.setRetainErroneousTombstones(value);
+        } else if (key == "flusher_pipelined") {
+            bucket.setFlusherPipelined(value);
+        } else if (key == "flusher_batch_auto_tune") {
+            bucket.setFlusherBatchAutoTune(value);
         } else  {
             EP_LOG_WARN("Failed to change value for unknown variable, {}", key);
         }
@@ -251,7 +258,9 @@ private:
 };
 
 EPBucket::EPBucket(EventuallyPersistentEngine& theEngine)
-    : KVBucket(theEngine) {
+    : KVBucket(theEngine),
+      flusherGroupCommit(
+              theEngine.getConfiguration().isFlusherGroupCommit()) {
     auto& config = engine.getConfiguration();
     const std::string& policy = config.getItemEvictionPolicy();
     if (policy.compare("value_only") == 0) {
@@ -262,18 +271,34 @@ EPBucket::EPBucket(EventuallyPersistentEngine& theEngine)
     replicationThrottle = std::make_unique<ReplicationThrottle>(
             engine.getConfiguration(), stats);
 
-    vbMap.enablePersistence(*this);
-
+    // The Flushers' FlushBatchControllers are created from these.
     setFlusherBatchSplitTrigger(config.getFlusherTotalBatchLimit());
     config.addValueChangedListener(
             "flusher_total_batch_limit",
             std::make_unique<ValueChangedListener>(*this));
 
+    flusherBatchAutoTune = config.isFlusherBatchAutoTune();
+    config.addValueChangedListener(
+            "flusher_batch_auto_tune",
+            std::make_unique<ValueChangedListener>(*this));
+
+    setFlusherBatchTargetLatency(
+            std::chrono::milliseconds(config.getFlusherBatchTargetLatencyMs()));
+    config.addValueChangedListener(
+            "flusher_batch_target_latency_ms",
+            std::make_unique<ValueChangedListener>(*this));
+
+    vbMap.enablePersistence(*this);
+
     retainErroneousTombstones = config.isRetainErroneousTombstones();
     config.addValueChangedListener(
             "retain_erroneous_tombstones",
             std::make_unique<ValueChangedListener>(*this));
 
+    flusherPipelined = config.isFlusherPipelined();
+    config.addValueChangedListener(
+            "flusher_pipelined", std::make_unique<ValueChangedListener>(*this));
+
     initializeWarmupTask();
 }
 
@@ -358,13 +383,110 @@ EPBucket::FlushResult EPBucket::flushVBucket(Vbid vbid) {
         return {MoreAvailable::No, 0, WakeCkptRemover::No};
     }
 
+    return commitFlush(vb, prepareFlush(*vb), flushStart);
+}
+
+VBucket::ItemsToFlush EPBucket::prepareFlush(VBucket& vb) {
     // Obtain the set of items to flush, up to the maximum allowed for
     // a single flush.
-    auto toFlush = vb->getItemsToPersist(flusherBatchSplitTrigger);
+    auto toFlush = vb.getItemsToPersist(getFlushBatchLimit(vb));
 
     // Callback must be initialized at persistence
     Expects(toFlush.flushHandle.get());
 
+    getRWUnderlying(vb.getId())->optimizeWrites(toFlush.items);
+
+    return toFlush;
+}
+
+std::vector<EPBucket::FlushResult> EPBucket::flushVBucketsGrouped(
+        std::vector<LockedVBucketPtr>& vbs) {
+    std::vector<FlushResult> results(
+            vbs.size(), {MoreAvailable::No, 0, WakeCkptRemover::No});
+    if (vbs.empty()) {
+        return results;
+    }
+
+    // All the vBuckets belong to the same shard, hence the same KVStore.
+    auto& kvstore = *getRWUnderlying(vbs.front()->getId());
+    std::vector<PendingFlush> pending;
+    bool inGroup = false;
+    size_t groupItems = 0;
+
+    // Make the group durable, then complete its flushes in order.
+    auto completeGroup = [&]() {
+        inGroup = false;
+        groupItems = 0;
+        const auto durable = kvstore.completeSyncGroup();
+        if (!durable) {
+            ++stats.commitFailed;
+            EP_LOG_WARN(
+                    "EPBucket::flushVBucketsGrouped: completeSyncGroup failed "
+                    "for {} vBuckets",
+                    pending.size());
+        }
+        for (auto& flush : pending) {
+            results[flush.resultIndex] = completeFlush(flush, durable);
+        }
+        pending.clear();
+    };
+
+    try {
+        for (size_t i = 0; i < vbs.size(); ++i) {
+            const auto flushStart = std::chrono::steady_clock::now();
+            if (!inGroup) {
+                // If the KVStore doesn't support group commit then every
+                // commit is durable on return, and this is just a sequence
+                // of flushVBucket.
+                inGroup = kvstore.beginSyncGroup();
+            }
+
+            auto toFlush = prepareFlush(*vbs[i]);
+            groupItems += toFlush.items.size();
+            const auto numPending = pending.size();
+            results[i] = commitFlushBatch(vbs[i],
+                                          std::move(toFlush),
+                                          flushStart,
+                                          inGroup ? &pending : nullptr);
+            if (pending.size() > numPending) {
+                pending.back().resultIndex = i;
+            }
+
+            // Bound the work (and memory held by SyncGroupOps) which is
+            // not yet durable.
+            if (inGroup && groupItems >= flusherBatchSplitTrigger) {
+                completeGroup();
+            }
+        }
+        if (inGroup) {
+            completeGroup();
+        }
+    } catch (...) {
+        // Don't leave a group open on the KVStore (nor the flushes which
+        // made it this far incomplete).
+        if (inGroup) {
+            completeGroup();
+        }
+        throw;
+    }
+
+    return results;
+}
+
+EPBucket::FlushResult EPBucket::commitFlush(
+        LockedVBucketPtr& vb,
+        VBucket::ItemsToFlush toFlush,
+        std::chrono::steady_clock::time_point flushStart) {
+    return commitFlushBatch(vb, std::move(toFlush), flushStart, nullptr);
+}
+
+EPBucket::FlushResult EPBucket::commitFlushBatch(
+        LockedVBucketPtr& vb,
+        VBucket::ItemsToFlush toFlush,
+        std::chrono::steady_clock::time_point flushStart,
+        std::vector<PendingFlush>* pending) {
+    const auto vbid = vb->getId();
+
     const auto moreAvailable =
             toFlush.moreAvailable ? MoreAvailable::Yes : MoreAvailable::No;
 
@@ -401,8 +523,6 @@ EPBucket::FlushResult EPBucket::flushVBucket(Vbid vbid) {
         std::this_thread::sleep_for(std::chrono::seconds(1));
     }
 
-    rwUnderlying->optimizeWrites(toFlush.items);
-
     Item* prev = nullptr;
 
     // Read the vbucket_state from disk as many values from the
@@ -417,8 +537,10 @@ EPBucket::FlushResult EPBucket::flushVBucket(Vbid vbid) {
         vbstate = *persistedVbState;
     }
 
-    VB::Commit commitData(vb->getManifest(), vbstate);
-    vbucket_state& proposedVBState = commitData.proposedVBState;
+    // Heap-allocated as the KVStore may reference it until the flush is
+    // completed (see PendingFlush).
+    auto commitData = std::make_unique<VB::Commit>(vb->getManifest(), vbstate);
+    vbucket_state& proposedVBState = commitData->proposedVBState;
 
     // We need to set a few values from the in-memory state.
     uint64_t maxSeqno = 0;
@@ -476,8 +598,8 @@ EPBucket::FlushResult EPBucket::flushVBucket(Vbid vbid) {
     // (b) can de-duplicate as the previous key was the same, or (c)
     // actually need to persist.
     // Note: This assumes items have been sorted by key and then by
-    // seqno (see optimizeWrites() above) such that duplicate keys are
-    // adjacent but with the highest seqno first.
+    // seqno (see optimizeWrites() in prepareFlush()) such that duplicate
+    // keys are adjacent but with the highest seqno first.
     // Note(2): The de-duplication here is an optimization to save
     // creating and enqueuing multiple set() operations on the
     // underlying KVStore - however the KVStore itself only stores a
@@ -616,8 +738,9 @@ EPBucket::FlushResult EPBucket::flushVBucket(Vbid vbid) {
             // Item is the same key as the previous[1] one - don't need
             // to flush to disk.
             // [1] Previous here really means 'next' - optimizeWrites()
-            //     above has actually re-ordered items such that items
-            //     with the same key are ordered from high->low seqno.
+            //     in prepareFlush() has actually re-ordered items such
+            //     that items with the same key are ordered from high->low
+            //     seqno.
             //     This means we only write the highest (i.e. newest)
             //     item for a given key, and discard any duplicate,
             //     older items.
@@ -693,7 +816,8 @@ EPBucket::FlushResult EPBucket::flushVBucket(Vbid vbid) {
         // Also, when we re-attempt to flush a set-vbstate item we may fail
         // again because of the optimization at
         // vbucket_state::needsToBePersisted().
-        if (!rwUnderlying->snapshotVBucket(vbid, commitData.proposedVBState)) {
+        if (!rwUnderlying->snapshotVBucket(vbid,
+                                           commitData->proposedVBState)) {
             // @todo: MB-36773, vbstate update is not retried
 
             // Flush failed, we need to reset the pcursor to the original
@@ -705,16 +829,19 @@ EPBucket::FlushResult EPBucket::flushVBucket(Vbid vbid) {
         }
 
         // Update in-memory vbstate
-        rwUnderlying->setVBucketState(vbid, commitData.proposedVBState);
+        rwUnderlying->setVBucketState(vbid, commitData->proposedVBState);
 
-        // The new vbstate was the only thing to flush. All done.
-        flushSuccessEpilogue(*vb,
-                             flushStart,
-                             0 /*itemsFlushed*/,
-                             aggStats,
-                             commitData.collections);
-
-        return {moreAvailable, 0, wakeupCheckpointRemover};
+        // The new vbstate was the only thing to flush.
+        return completeOrDeferFlush(
+                {*vb,
+                 flushStart,
+                 std::move(toFlush.flushHandle),
+                 std::move(commitData),
+                 std::nullopt,
+                 0 /*flushBatchSize*/,
+                 std::move(aggStats),
+                 {moreAvailable, 0, wakeupCheckpointRemover}},
+                pending);
     }
 
     // The flush-batch must be non-empty by logic at this point.
@@ -737,7 +864,7 @@ EPBucket::FlushResult EPBucket::flushVBucket(Vbid vbid) {
     }
 
     // Persist the flush-batch.
-    const auto flushSuccess = commit(vbid, *rwUnderlying, commitData);
+    const auto flushSuccess = commit(vbid, *rwUnderlying, *commitData);
 
     if (!flushSuccess) {
         // Flush failed, we need to reset the pcursor to the original
@@ -751,11 +878,57 @@ EPBucket::FlushResult EPBucket::flushVBucket(Vbid vbid) {
     // Note: We want to update the snap-range only if we have flushed at least
     // one item. I.e. don't appear to be in a snap when you have no data for it
     Expects(range.has_value());
-    vb->setPersistedSnapshot(*range);
+    return completeOrDeferFlush(
+            {*vb,
+             flushStart,
+             std::move(toFlush.flushHandle),
+             std::move(commitData),
+             range,
+             flushBatchSize,
+             std::move(aggStats),
+             {moreAvailable, flushBatchSize, wakeupCheckpointRemover}},
+            pending);
+}
+
+EPBucket::FlushResult EPBucket::completeOrDeferFlush(
+        PendingFlush flush, std::vector<PendingFlush>* pending) {
+    if (pending) {
+        auto result = flush.result;
+        pending->push_back(std::move(flush));
+        return result;
+    }
+    return completeFlush(flush, true /*durable*/);
+}
+
+EPBucket::FlushResult EPBucket::completeFlush(PendingFlush& flush,
+                                              bool durable) {
+    auto& vb = flush.vb;
+    const auto vbid = vb.getId();
+
+    if (!durable) {
+        // The flush-batch was written but may not have reached the disk.
+        // As for a failed commit, reset the pcursor so that the flusher
+        // re-attempts the whole batch.
+        flush.flushHandle->markFlushFailed();
+        return {MoreAvailable::Yes, 0, WakeCkptRemover::No};
+    }
+
+    if (!flush.range) {
+        // Only a new vbstate was flushed. All done.
+        flushSuccessEpilogue(vb,
+                             flush.flushStart,
+                             0 /*itemsFlushed*/,
+                             flush.aggStats,
+                             flush.commitData->collections);
+        return flush.result;
+    }
+
+    KVStore* rwUnderlying = getRWUnderlying(vbid);
+    vb.setPersistedSnapshot(*flush.range);
 
     uint64_t highSeqno = rwUnderlying->getLastPersistedSeqno(vbid);
-    if (highSeqno > 0 && highSeqno != vb->getPersistenceSeqno()) {
-        vb->setPersistenceSeqno(highSeqno);
+    if (highSeqno > 0 && highSeqno != vb.getPersistenceSeqno()) {
+        vb.setPersistenceSeqno(highSeqno);
     }
 
     // Notify the local DM that the Flusher has run. Persistence
@@ -790,19 +963,19 @@ EPBucket::FlushResult EPBucket::flushVBucket(Vbid vbid) {
     //     So, given that here we are executing in a slow bg-thread
     //     (write+sync to disk), then we can just afford to calling
     //     back to the DM unconditionally.
-    vb->notifyPersistenceToDurabilityMonitor();
+    vb.notifyPersistenceToDurabilityMonitor();
 
-    flushSuccessEpilogue(*vb,
-                         flushStart,
-                         flushBatchSize /*itemsFlushed*/,
-                         aggStats,
-                         commitData.collections);
+    flushSuccessEpilogue(vb,
+                         flush.flushStart,
+                         flush.flushBatchSize /*itemsFlushed*/,
+                         flush.aggStats,
+                         flush.commitData->collections);
 
     // Handle Seqno Persistence requests
-    vb->notifyHighPriorityRequests(
-            engine, vb->getPersistenceSeqno(), HighPriorityVBNotify::Seqno);
+    vb.notifyHighPriorityRequests(
+            engine, vb.getPersistenceSeqno(), HighPriorityVBNotify::Seqno);
 
-    return {moreAvailable, flushBatchSize, wakeupCheckpointRemover};
+    return flush.result;
 }
 
 void EPBucket::handleCheckpointPersistence(VBucket& vb) const {
@@ -839,6 +1012,15 @@ void EPBucket::flushSuccessEpilogue(
 
     vb.doAggregatedFlushStats(aggStats);
 
+    if (isFlusherBatchAutoTune()) {
+        auto* flusher = vbMap.getShardByVbId(vb.getId())->getFlusher();
+        flusher->getBatchController().recordBatch(
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                        flushEnd - flushStart),
+                vb.checkpointManager->getNumItemsForPersistence(),
+                hasPersistenceWaiters(vb));
+    }
+
     // By definition, does not need to be called if no flush performed or
     // if flush failed.
     collectionFlush.checkAndTriggerPurge(vb.getId(), *this);
@@ -858,6 +1040,36 @@ void EPBucket::setFlusherBatchSplitTrigger(size_t limit) {
     // limit of 1 as a 0 limit could cause us to fail to flush anything.
     flusherBatchSplitTrigger =
             std::max(size_t(1), limit / ExecutorPool::get()->getNumWriters());
+
+    // The static limit is the ceiling of the auto-tuned limit.
+    for (const auto& shard : vbMap.shards) {
+        if (auto* flusher = shard->getFlusher()) {
+            flusher->getBatchController().setMaxLimit(flusherBatchSplitTrigger);
+        }
+    }
+}
+
+void EPBucket::setFlusherBatchTargetLatency(std::chrono::milliseconds value) {
+    flusherBatchTargetLatency = value;
+    for (const auto& shard : vbMap.shards) {
+        if (auto* flusher = shard->getFlusher()) {
+            flusher->getBatchController().setTargetLatency(value);
+        }
+    }
+}
+
+size_t EPBucket::getFlushBatchLimit(VBucket& vb) {
+    if (!isFlusherBatchAutoTune()) {
+        return flusherBatchSplitTrigger;
+    }
+    auto* flusher = vbMap.getShardByVbId(vb.getId())->getFlusher();
+    return flusher->getBatchController().getBatchLimit(
+            hasPersistenceWaiters(vb));
+}
+
+bool EPBucket::hasPersistenceWaiters(VBucket& vb) {
+    return vb.getHighPriorityChkSize() > 0 ||
+           vb.getSyncWriteTrackedCount() > 0;
 }
 
 size_t EPBucket::getFlusherBatchSplitTrigger() {
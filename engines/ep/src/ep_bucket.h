@@ -18,6 +18,7 @@
 #pragma once
 
 #include "kv_bucket.h"
+#include "vb_commit.h"
 
 /**
  * Eventually Persistent Bucket
@@ -64,6 +65,46 @@ public:
      */
     FlushResult flushVBucket(Vbid vbid);
 
+    /**
+     * First stage of flushVBucket: obtain the next flush-batch of the given
+     * vBucket, ordered for de-duplication (see KVStore::optimizeWrites).
+     *
+     * The caller must hold the vBucket's lock (see getLockedVBucket) until
+     * the batch has been passed to commitFlush; the batch itself may be
+     * prepared on a different thread to the lock holder.
+     */
+    VBucket::ItemsToFlush prepareFlush(VBucket& vb);
+
+    /**
+     * Second stage of flushVBucket: persist a batch obtained from
+     * prepareFlush() and notify everything waiting for it.
+     *
+     * @param vb The locked vBucket the batch was prepared for
+     * @param toFlush The batch to persist
+     * @param flushStart When the flush of the batch started (for stats)
+     * @return an instance of FlushResult
+     */
+    FlushResult commitFlush(LockedVBucketPtr& vb,
+                            VBucket::ItemsToFlush toFlush,
+                            std::chrono::steady_clock::time_point flushStart);
+
+    /**
+     * Flush the given vBuckets as a group commit: the batch of each vBucket
+     * is written, then the whole group is made durable together (see
+     * KVStore::beginSyncGroup) before persistence is notified for any of
+     * them. If the KVStore does not support group commit this is the same
+     * as calling flushVBucket for each in turn.
+     *
+     * A group is completed early once it has flushed
+     * flusherBatchSplitTrigger items, to bound the data not yet durable.
+     *
+     * @param vbs The locked (non-null) vBuckets to flush, all of which must
+     *        belong to the same shard
+     * @return the FlushResult of each vBucket, in the order of vbs
+     */
+    std::vector<FlushResult> flushVBucketsGrouped(
+            std::vector<LockedVBucketPtr>& vbs);
+
     /**
      * Set the number of flusher items which can be included in a
      * single flusher commit. For more details see flusherBatchSplitTrigger
@@ -73,6 +114,24 @@ public:
 
     size_t getFlusherBatchSplitTrigger();
 
+    void setFlusherBatchAutoTune(bool value) {
+        flusherBatchAutoTune = value;
+    }
+
+    /// @return true if the size of each flush-batch is chosen by the
+    ///         Flusher's FlushBatchController (with flusherBatchSplitTrigger
+    ///         as the ceiling), rather than always flusherBatchSplitTrigger.
+    bool isFlusherBatchAutoTune() const {
+        return flusherBatchAutoTune.load();
+    }
+
+    /// Set the p99 flush-batch latency the FlushBatchControllers target.
+    void setFlusherBatchTargetLatency(std::chrono::milliseconds value);
+
+    std::chrono::milliseconds getFlusherBatchTargetLatency() const {
+        return flusherBatchTargetLatency;
+    }
+
     /**
      * Persist whatever flush-batch previously queued into KVStore.
      *
@@ -185,6 +244,22 @@ public:
         return retainErroneousTombstones.load();
     }
 
+    void setFlusherPipelined(bool value) {
+        flusherPipelined = value;
+    }
+
+    /// @return true if the Flusher should prepare the next vBucket's batch
+    ///         while committing the current one.
+    bool isFlusherPipelined() const {
+        return flusherPipelined.load();
+    }
+
+    /// @return true if the Flusher should flush the vBuckets of a shard
+    ///         as a group commit (see flushVBucketsGrouped).
+    bool isFlusherGroupCommit() const {
+        return flusherGroupCommit;
+    }
+
     Warmup* getWarmup() const override;
 
     bool isWarmingUp() override;
@@ -232,6 +307,52 @@ protected:
 
     void flushOneDelOrSet(const queued_item& qi, VBucketPtr& vb);
 
+    /**
+     * A flush-batch which has been committed to the KVStore, but whose
+     * completion (persistence notifications, stats) is waiting for the
+     * batch to be durable.
+     */
+    struct PendingFlush {
+        /// Locked by the caller until the flush is completed
+        VBucket& vb;
+        std::chrono::steady_clock::time_point flushStart;
+        UniqueFlushHandle flushHandle;
+        std::unique_ptr<VB::Commit> commitData;
+        /// The persisted snapshot range; empty if only a vbstate was flushed
+        std::optional<snapshot_range_t> range;
+        size_t flushBatchSize;
+        VBucket::AggregatedFlushStats aggStats;
+        /// The result of the flush if it completes successfully
+        FlushResult result;
+        /// Index of the flush in the results of flushVBucketsGrouped
+        size_t resultIndex = 0;
+    };
+
+    /**
+     * Implementation of commitFlush. If pending is non-null then a
+     * successfully committed batch is appended to it rather than completed,
+     * and the returned result is provisional.
+     */
+    FlushResult commitFlushBatch(
+            LockedVBucketPtr& vb,
+            VBucket::ItemsToFlush toFlush,
+            std::chrono::steady_clock::time_point flushStart,
+            std::vector<PendingFlush>* pending);
+
+    /// Append flush to pending if non-null, otherwise complete it now.
+    FlushResult completeOrDeferFlush(PendingFlush flush,
+                                     std::vector<PendingFlush>* pending);
+
+    /**
+     * Complete a committed flush-batch.
+     *
+     * @param flush The batch
+     * @param durable Whether the batch was made durable. If not then the
+     *        flush is failed, and will be re-attempted.
+     * @return the FlushResult of the flush
+     */
+    FlushResult completeFlush(PendingFlush& flush, bool durable);
+
     /**
      * Compaction of a database file
      *
@@ -271,6 +392,18 @@ protected:
      */
     void handleCheckpointPersistence(VBucket& vb) const;
 
+    /**
+     * @return the approximate number of items to include in the next
+     *         flush-batch of the given vBucket.
+     */
+    size_t getFlushBatchLimit(VBucket& vb);
+
+    /**
+     * @return true if anything is waiting for the vBucket to be persisted
+     *         (SeqnoPersistence requests or in-flight SyncWrites).
+     */
+    static bool hasPersistenceWaiters(VBucket& vb);
+
     /**
      * Performs operations that must be performed after flush succeeds,
      * regardless of whether we flush non-meta items or a new vbstate only.
@@ -304,5 +437,16 @@ protected:
      */
     cb::RelaxedAtomic<bool> retainErroneousTombstones;
 
+    /// See isFlusherPipelined()
+    cb::RelaxedAtomic<bool> flusherPipelined;
+
+    /// See isFlusherBatchAutoTune()
+    cb::RelaxedAtomic<bool> flusherBatchAutoTune;
+
+    std::atomic<std::chrono::milliseconds> flusherBatchTargetLatency;
+
+    /// See isFlusherGroupCommit(). Fixed at bucket creation.
+    const bool flusherGroupCommit;
+
     std::unique_ptr<Warmup> warmupTask;
 };
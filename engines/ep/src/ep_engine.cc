@@ -599,6 +599,13 @@ cb::mcbp::Status EventuallyPersistentEngine::setFlushParam(
             getConfiguration().setExpPagerStime(std::stoull(val));
         } else if (key == "exp_pager_initial_run_time") {
             getConfiguration().setExpPagerInitialRunTime(std::stoll(val));
+        } else if (key == "flusher_batch_auto_tune") {
+            getConfiguration().setFlusherBatchAutoTune(cb_stob(val));
+        } else if (key == "flusher_batch_target_latency_ms") {
+            getConfiguration().setFlusherBatchTargetLatencyMs(
+                    std::stoull(val));
+        } else if (key == "flusher_pipelined") {
+            getConfiguration().setFlusherPipelined(cb_stob(val));
         } else if (key == "flusher_total_batch_limit") {
             getConfiguration().setFlusherTotalBatchLimit(std::stoll(val));
         } else if (key == "getl_default_timeout") {
@@ -744,6 +751,8 @@ cb::mcbp::Status EventuallyPersistentEngine::setFlushParam(
             getConfiguration().setCouchstoreWriteValidation(cb_stob(val));
         } else if (key == "couchstore_mprotect") {
             getConfiguration().setCouchstoreMprotect(cb_stob(val));
+        } else if (key == "couchstore_bg_fetch_prefetch") {
+            getConfiguration().setCouchstoreBgFetchPrefetch(cb_stob(val));
         } else if (key == "allow_del_with_meta_prune_user_data") {
             getConfiguration().setAllowDelWithMetaPruneUserData(cb_stob(val));
         } else {
@@ -815,15 +824,29 @@ cb::mcbp::Status EventuallyPersistentEngine::setDcpParam(const std::string& key,
             getConfiguration().setDcpIdleTimeout(v);
         } else if (key == "dcp_noop_tx_interval") {
             getConfiguration().setDcpNoopTxInterval(std::stoull(val));
+        } else if (key == "dcp_producer_apply_min_compression_ratio") {
+            getConfiguration().setDcpProducerApplyMinCompressionRatio(
+                    cb_stob(val));
+        } else if (key == "dcp_producer_adaptive_flow_control") {
+            getConfiguration().setDcpProducerAdaptiveFlowControl(cb_stob(val));
+        } else if (key == "dcp_producer_flow_control_mem_threshold") {
+            getConfiguration().setDcpProducerFlowControlMemThreshold(
+                    std::stoull(val));
         } else if (key == "dcp_producer_snapshot_marker_yield_limit") {
             getConfiguration().setDcpProducerSnapshotMarkerYieldLimit(
                     std::stoull(val));
+        } else if (key == "dcp_backfill_shared_scans") {
+            getConfiguration().setDcpBackfillSharedScans(cb_stob(val));
         } else if (key == "dcp_takeover_max_time") {
             getConfiguration().setDcpTakeoverMaxTime(std::stoull(val));
         } else {
             msg = "Unknown config param";
             rv = cb::mcbp::Status::KeyEnoent;
         }
+        // Handles exceptions thrown by the cb_stob function
+    } catch (invalid_argument_bool& error) {
+        msg = error.what();
+        rv = cb::mcbp::Status::Einval;
     } catch (std::runtime_error&) {
         msg = "Value out of range.";
         rv = cb::mcbp::Status::Einval;
@@ -1311,6 +1334,21 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::step(
     return ENGINE_DISCONNECT;
 }
 
+ENGINE_ERROR_CODE EventuallyPersistentEngine::step_batch(
+        gsl::not_null<const void*> cookie,
+        gsl::not_null<dcp_message_producers*> producers,
+        size_t max_bytes,
+        size_t& nmessages) {
+    auto engine = acquireEngine(this);
+    ConnHandler* conn = engine->getConnHandler(cookie);
+    if (conn) {
+        DcpMsgProducersBorderGuard guardedProducers(*producers);
+        return conn->stepBatch(&guardedProducers, max_bytes, nmessages);
+    }
+    nmessages = 0;
+    return ENGINE_DISCONNECT;
+}
+
 ENGINE_ERROR_CODE EventuallyPersistentEngine::open(
         gsl::not_null<const void*> cookie,
         uint32_t opaque,
@@ -2684,6 +2722,39 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doEngineStats(
                         flusher->stateName(), add_stat, cookie);
         add_casted_stat("ep_flusher_todo",
                         epstats.flusher_todo, add_stat, cookie);
+
+        // Decisions of the flushers' batch size controllers, aggregated
+        // across shards.
+        size_t batchLimit = 0;
+        size_t batchLimitIncreases = 0;
+        size_t batchLimitDecreases = 0;
+        std::chrono::microseconds batchP99Latency{0};
+        const auto numShards = kvBucket->getVBuckets().getNumShards();
+        for (uint16_t shardId = 0; shardId < numShards; ++shardId) {
+            const auto* shardFlusher = kvBucket->getFlusher(shardId);
+            if (!shardFlusher) {
+                continue;
+            }
+            const auto& controller = shardFlusher->getBatchController();
+            batchLimit += controller.getLimit();
+            batchLimitIncreases += controller.getNumIncreases();
+            batchLimitDecreases += controller.getNumDecreases();
+            batchP99Latency =
+                    std::max(batchP99Latency, controller.getP99Latency());
+        }
+        add_casted_stat("ep_flusher_batch_limit", batchLimit, add_stat, cookie);
+        add_casted_stat("ep_flusher_batch_limit_increases",
+                        batchLimitIncreases,
+                        add_stat,
+                        cookie);
+        add_casted_stat("ep_flusher_batch_limit_decreases",
+                        batchLimitDecreases,
+                        add_stat,
+                        cookie);
+        add_casted_stat("ep_flusher_batch_p99_latency_us",
+                        batchP99Latency.count(),
+                        add_stat,
+                        cookie);
         add_casted_stat("ep_total_persisted",
                         epstats.totalPersisted, add_stat, cookie);
         add_casted_stat("ep_uncommitted_items",
@@ -3392,6 +3463,32 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doHashStats(
                         buf, sizeof(buf), "vb_%d:num_system_items", vbid.get());
                 add_casted_stat(
                         buf, vb->ht.getNumSystemItems(), add_stat, cookie);
+
+                checked_snprintf(
+                        buf, sizeof(buf), "vb_%d:lock_contended", vbid.get());
+                add_casted_stat(
+                        buf, vb->ht.getNumContendedLocks(), add_stat, cookie);
+                checked_snprintf(
+                        buf, sizeof(buf), "vb_%d:lock_wait_us", vbid.get());
+                add_casted_stat(
+                        buf,
+                        std::chrono::duration_cast<std::chrono::microseconds>(
+                                vb->ht.getLockWaitTime())
+                                .count(),
+                        add_stat,
+                        cookie);
+                checked_snprintf(
+                        buf, sizeof(buf), "vb_%d:opt_reads", vbid.get());
+                add_casted_stat(
+                        buf, vb->ht.getNumOptimisticReads(), add_stat, cookie);
+                checked_snprintf(buf,
+                                 sizeof(buf),
+                                 "vb_%d:opt_read_fallbacks",
+                                 vbid.get());
+                add_casted_stat(buf,
+                                vb->ht.getNumOptimisticReadFallbacks(),
+                                add_stat,
+                                cookie);
             } catch (std::exception& error) {
                 EP_LOG_WARN(
                         "StatVBucketVisitor::visitBucket: Failed to build "
@@ -4176,6 +4273,17 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doWorkloadStats(
     return ENGINE_SUCCESS;
 }
 
+ENGINE_ERROR_CODE EventuallyPersistentEngine::doNumaStats(
+        const void* cookie, const AddStatFn& add_stat) {
+    try {
+        ExecutorPool::get()->doNumaStat(
+                workload->getNumShards(), cookie, add_stat);
+    } catch (std::exception& error) {
+        EP_LOG_WARN("doNumaStats: Error building stats: {}", error.what());
+    }
+    return ENGINE_SUCCESS;
+}
+
 void EventuallyPersistentEngine::addSeqnoVbStats(const void* cookie,
                                                  const AddStatFn& add_stat,
                                                  const VBucketPtr& vb) {
@@ -4641,6 +4749,9 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::getStats(
     if (key == "workload"sv) {
         return doWorkloadStats(cookie, add_stat);
     }
+    if (key == "numa"sv) {
+        return doNumaStats(cookie, add_stat);
+    }
     if (cb_isPrefix(key, "failovers")) {
         return doFailoversStats(cookie, add_stat, key);
     }
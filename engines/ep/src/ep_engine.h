@@ -232,6 +232,12 @@ public:
             gsl::not_null<const void*> cookie,
             gsl::not_null<dcp_message_producers*> producers) override;
 
+    ENGINE_ERROR_CODE step_batch(
+            gsl::not_null<const void*> cookie,
+            gsl::not_null<dcp_message_producers*> producers,
+            size_t max_bytes,
+            size_t& nmessages) override;
+
     ENGINE_ERROR_CODE open(gsl::not_null<const void*> cookie,
                            uint32_t opaque,
                            uint32_t seqno,
@@ -937,6 +943,8 @@ protected:
                                             const AddStatFn& add_stat);
     ENGINE_ERROR_CODE doWorkloadStats(const void* cookie,
                                       const AddStatFn& add_stat);
+    ENGINE_ERROR_CODE doNumaStats(const void* cookie,
+                                  const AddStatFn& add_stat);
     ENGINE_ERROR_CODE doSeqnoStats(const void* cookie,
                                    const AddStatFn& add_stat,
                                    const char* stat_key,
@@ -71,7 +71,10 @@ EPVBucket::EPVBucket(Vbid i,
               lastSnapEnd,
               std::move(table),
               flusherCb,
-              std::make_unique<StoredValueFactory>(st),
+              std::make_unique<StoredValueFactory>(
+                      st,
+                      config.getHtInlineValueThreshold(),
+                      config.isHtSlabAllocator()),
               std::move(newSeqnoCb),
               syncWriteResolvedCb,
               syncWriteCb,
@@ -286,7 +289,7 @@ void EPVBucket::completeCompactionExpiryBgFetch(
                 processExpiredItem(res.lock, *result.storedValue, cHandle);
         // we unlock ht lock here because we want to avoid potential
         // lock inversions arising from notifyNewSeqno() call
-        res.lock.getHTLock().unlock();
+        res.lock.unlock();
         notifyNewSeqno(notifyCtx);
         doCollectionsStats(cHandle, notifyCtx);
         incExpirationStat(ExpireBy::Compactor);
@@ -531,7 +534,13 @@ UniqueDCPBackfillPtr EPVBucket::createDCPBackfill(
         uint64_t endSeqno) {
     /* create a DCPBackfillBySeqnoDisk object */
     return std::make_unique<DCPBackfillBySeqnoDisk>(
-            *e.getKVBucket(), stream, startSeqno, endSeqno);
+            *e.getKVBucket(),
+            stream,
+            startSeqno,
+            endSeqno,
+            e.getConfiguration().isDcpBackfillSharedScans()
+                    ? sharedBackfillScans
+                    : nullptr);
 }
 
 UniqueDCPBackfillPtr EPVBucket::createDCPBackfill(
@@ -764,7 +773,7 @@ EPVBucket::addTempItemAndBGFetch(HashTable::HashBucketLock& hbl,
     case TempAddStatus::NoMem:
         return ENGINE_ENOMEM;
     case TempAddStatus::BgFetch:
-        hbl.getHTLock().unlock();
+        hbl.unlock();
         bgFetch(key, cookie, engine, metadataOnly);
         return ENGINE_EWOULDBLOCK;
     }
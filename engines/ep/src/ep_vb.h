@@ -343,5 +343,10 @@ private:
      */
     std::atomic<uint64_t> deferredDeletionFileRevision;
 
+    /// The by-seqno backfill scans which backfills of the vBucket may join
+    /// (see dcp_backfill_shared_scans)
+    const std::shared_ptr<SharedBackfillScans> sharedBackfillScans =
+            std::make_shared<SharedBackfillScans>();
+
     friend class EPVBucketTest;
 };
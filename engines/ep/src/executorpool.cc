@@ -27,6 +27,7 @@
 #include <platform/checked_snprintf.h>
 #include <platform/string_hex.h>
 #include <platform/sysinfo.h>
+#include <utilities/numa_topology.h>
 #include <algorithm>
 #include <chrono>
 #include <queue>
@@ -100,7 +101,11 @@ ExecutorPool *ExecutorPool::get() {
                     ThreadPoolConfig::ThreadCount(config.getNumReaderThreads()),
                     ThreadPoolConfig::ThreadCount(config.getNumWriterThreads()),
                     config.getNumAuxioThreads(),
-                    config.getNumNonioThreads());
+                    config.getNumNonioThreads(),
+                    config.isExecutorPoolWorkStealing(),
+                    TaskQueue::futureQueueTypeFromString(
+                            config.getExecutorPoolFutureQueue()),
+                    config.isExecutorPoolNumaAware());
             instance.store(tmp);
         }
     }
@@ -122,8 +127,14 @@ ExecutorPool::ExecutorPool(size_t maxThreads,
                            ThreadPoolConfig::ThreadCount maxReaders,
                            ThreadPoolConfig::ThreadCount maxWriters,
                            size_t maxAuxIO,
-                           size_t maxNonIO)
+                           size_t maxNonIO,
+                           bool workStealing,
+                           FutureQueueType futureQueueType,
+                           bool numaAware)
     : numTaskSets(nTaskSets),
+      workStealing(workStealing),
+      futureQueueType(futureQueueType),
+      numaNodes(numaAware ? cb::numa::Topology::get().getNumNodes() : 1),
       maxGlobalThreads(maxThreads ? maxThreads
                                   : Couchbase::get_available_cpu_count()),
       totReadyTasks(0),
@@ -443,8 +454,13 @@ void ExecutorPool::_registerTaskable(Taskable& taskable) {
         if (!(*whichQset)) {
             taskQ->reserve(numTaskSets);
             for (size_t i = 0; i < numTaskSets; ++i) {
-                taskQ->push_back(
-                        new TaskQueue(this, (task_type_t)i, queueName));
+                taskQ->push_back(new TaskQueue(
+                        this,
+                        (task_type_t)i,
+                        queueName,
+                        calcNumTaskQueueShards((task_type_t)i),
+                        futureQueueType,
+                        numaNodes));
             }
             *whichQset = true;
         }
@@ -496,7 +512,9 @@ ssize_t ExecutorPool::_adjustWorkers(task_type_t type, size_t desiredNumItems) {
                 threadQ.push_back(new ExecutorThread(
                         this,
                         type,
-                        typeName + "_worker_" + std::to_string(tidx)));
+                        typeName + "_worker_" + std::to_string(tidx),
+                        tidx,
+                        numaNodes > 1 ? int(tidx % numaNodes) : -1));
                 threadQ.back()->start();
             }
         } else if (numItems > desiredNumItems) {
@@ -720,6 +738,59 @@ void ExecutorPool::doTaskQStat(EventuallyPersistentEngine* engine,
     }
 }
 
+void ExecutorPool::doNumaStat(size_t numShards,
+                              const void* cookie,
+                              const AddStatFn& add_stat) {
+    NonBucketAllocationGuard guard;
+    const auto& topology = cb::numa::Topology::get();
+    const auto numNodes = topology.getNumNodes();
+
+    std::vector<size_t> threads(numNodes);
+    size_t unbound = 0;
+    {
+        LockHolder lh(tMutex);
+        for (const auto* thread : threadQ) {
+            const auto node = thread->getNumaNode();
+            if (node >= 0 && size_t(node) < numNodes) {
+                threads[node]++;
+            } else {
+                unbound++;
+            }
+        }
+    }
+
+    std::vector<size_t> shards(numNodes);
+    for (size_t shard = 0; shard < numShards; ++shard) {
+        const auto node = getNumaNodeForShard(shard);
+        if (node >= 0 && size_t(node) < numNodes) {
+            shards[node]++;
+        }
+    }
+
+    const auto residentBytes = cb::numa::getResidentBytesPerNode();
+
+    add_casted_stat("ep_numa:enabled", numaNodes > 1, add_stat, cookie);
+    add_casted_stat("ep_numa:num_nodes", numNodes, add_stat, cookie);
+    add_casted_stat("ep_numa:unbound_threads", unbound, add_stat, cookie);
+    for (size_t node = 0; node < numNodes; ++node) {
+        const std::string prefix = "ep_numa:node_" + std::to_string(node);
+        add_casted_stat(
+                prefix + ":id", topology.getNodeId(node), add_stat, cookie);
+        add_casted_stat(prefix + ":cpus",
+                        topology.getCpus(node).size(),
+                        add_stat,
+                        cookie);
+        add_casted_stat(prefix + ":threads", threads[node], add_stat, cookie);
+        add_casted_stat(prefix + ":shards", shards[node], add_stat, cookie);
+        if (node < residentBytes.size()) {
+            add_casted_stat(prefix + ":resident_bytes",
+                            residentBytes[node],
+                            add_stat,
+                            cookie);
+        }
+    }
+}
+
 static void addWorkerStats(const char* prefix,
                            ExecutorThread* t,
                            const void* cookie,
@@ -925,3 +996,32 @@ size_t ExecutorPool::calcNumWriters(
         return static_cast<size_t>(threadCount);
     }
 }
+
+size_t ExecutorPool::calcNumTaskQueueShards(task_type_t type) {
+    if (!workStealing && numaNodes == 1) {
+        return 1;
+    }
+    // One shard per thread (NUMA placement needs per-thread shards to keep
+    // tasks on their node's threads); if the number of threads is later
+    // changed the shards are shared by / stolen from as needed.
+    size_t threads;
+    switch (type) {
+    case READER_TASK_IDX:
+        threads = getNumReaders();
+        break;
+    case WRITER_TASK_IDX:
+        threads = getNumWriters();
+        break;
+    case AUXIO_TASK_IDX:
+        threads = getNumAuxIO();
+        break;
+    case NONIO_TASK_IDX:
+        threads = getNumNonIO();
+        break;
+    default:
+        throw std::invalid_argument(
+                "ExecutorPool::calcNumTaskQueueShards: invalid type " +
+                std::to_string(type));
+    }
+    return std::max(threads, size_t{1});
+}
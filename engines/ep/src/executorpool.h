@@ -39,6 +39,13 @@
  * queue of tasks is empty will we consider looking for more eligible tasks.
  * In this context, an eligible task is one that has a wakeTime <= now.
  *
+ * When work stealing is enabled (executor_pool_work_stealing), each TaskQueue
+ * is split into one shard per thread of its type, each with its own lock,
+ * future queue and ready queue. A task always belongs to the same shard, and
+ * a thread first services its own shard; only once that has nothing ready
+ * does it steal ready tasks from its peers' shards. This avoids all threads
+ * of a type contending on the single mutex of their TaskQueue.
+ *
  * === Important methods of the ExecutorPool ===
  *
  * ExecutorPool* ExecutorPool::get()
@@ -65,6 +72,7 @@
  */
 #pragma once
 
+#include "futurequeue.h"
 #include "syncobject.h"
 #include "task_type.h"
 #include "taskable.h"
@@ -156,6 +164,29 @@ public:
                      const void* cookie,
                      const AddStatFn& add_stat);
 
+    /**
+     * Generates stats regarding the NUMA placement of the pool's threads and
+     * of the given number of KVShards, plus the process' memory per node.
+     */
+    void doNumaStat(size_t numShards,
+                    const void* cookie,
+                    const AddStatFn& add_stat);
+
+    /// @return the number of NUMA nodes threads are bound to; 1 if NUMA
+    ///         placement is disabled.
+    size_t getNumaNodes() const {
+        return numaNodes;
+    }
+
+    /**
+     * @return the NUMA node (index) the given KVShard is placed on, whose
+     *         threads its Flusher and BgFetcher tasks should run on; or -1
+     *         if NUMA placement is disabled.
+     */
+    int getNumaNodeForShard(size_t shardId) const {
+        return numaNodes > 1 ? int(shardId % numaNodes) : -1;
+    }
+
     size_t getNumWorkersStat() {
         LockHolder lh(tMutex);
         return threadQ.size();
@@ -223,13 +254,22 @@ protected:
      * @param maxWriters Number of Writer threads to create.
      * @param maxAuxIO Number of AuxIO threads to create (0 = auto-configure).
      * @param maxNonIO Number of NonIO threads to create (0 = auto-configure).
+     * @param workStealing Shard each TaskQueue per thread and let idle
+     *                     threads steal work from their peers.
+     * @param futureQueueType Implementation of the TaskQueues' queues of
+     *                        snoozed tasks.
+     * @param numaAware Bind threads round-robin to the NUMA nodes of the host
+     *                  and run each KVShard's tasks on its node's threads.
      */
     ExecutorPool(size_t maxThreads,
                  size_t nTaskSets,
                  ThreadPoolConfig::ThreadCount maxReaders,
                  ThreadPoolConfig::ThreadCount maxWriters,
                  size_t maxAuxIO,
-                 size_t maxNonIO);
+                 size_t maxNonIO,
+                 bool workStealing = false,
+                 FutureQueueType futureQueueType = FutureQueueType::Heap,
+                 bool numaAware = false);
 
     virtual ~ExecutorPool();
 
@@ -267,8 +307,24 @@ protected:
      */
     size_t calcNumWriters(ThreadPoolConfig::ThreadCount threadCount) const;
 
+    /**
+     * Calculate the number of shards to split the TaskQueues of the given
+     * task type into.
+     */
+    size_t calcNumTaskQueueShards(task_type_t type);
+
     const size_t numTaskSets;
 
+    /// Are TaskQueues sharded per thread, with idle threads stealing work?
+    const bool workStealing;
+
+    /// Implementation of the TaskQueues' future queues.
+    const FutureQueueType futureQueueType;
+
+    /// Number of NUMA nodes threads are bound to (thread i of each type to
+    /// node i % numaNodes); 1 if NUMA placement is disabled.
+    const size_t numaNodes;
+
     /**
      * Maximum number of threads of any given class (Reader, Writer, AuxIO,
      * NonIO).
@@ -28,6 +28,7 @@
 #include <folly/Portability.h>
 #include <folly/portability/SysResource.h>
 #include <platform/timeutils.h>
+#include <utilities/numa_topology.h>
 #include <sstream>
 
 extern "C" {
@@ -119,6 +120,19 @@ void ExecutorThread::run() {
 
     priority = getpriority(PRIO_PROCESS, 0);
 
+    if (numaNode >= 0) {
+        if (cb::numa::bindCurrentThreadToNode(numaNode)) {
+            EP_LOG_INFO("Bound thread {} to NUMA node {}",
+                        getName(),
+                        numaNode);
+        } else {
+            EP_LOG_WARN("Failed to bind thread {} to NUMA node {}",
+                        getName(),
+                        numaNode);
+            numaNode = -1;
+        }
+    }
+
     for (uint8_t tick = 1;; tick++) {
 
         if (state != EXECUTOR_RUNNING) {
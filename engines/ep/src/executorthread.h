@@ -83,9 +83,24 @@ public:
         std::chrono::steady_clock::time_point timepoint;
     };
 
-    ExecutorThread(ExecutorPool* m, task_type_t type, const std::string nm)
+    /**
+     * @param m Pool the thread belongs to
+     * @param type Type of tasks the thread runs
+     * @param nm Name of the thread
+     * @param idx Index of the thread among the threads of its type; selects
+     *        the TaskQueue shard it prefers to take work from.
+     * @param node NUMA node (index) to bind the thread to once started, or
+     *        -1 to leave it unbound.
+     */
+    ExecutorThread(ExecutorPool* m,
+                   task_type_t type,
+                   const std::string nm,
+                   size_t idx = 0,
+                   int node = -1)
         : manager(m),
           taskType(type),
+          index(idx),
+          numaNode(node),
           name(nm),
           state(EXECUTOR_RUNNING),
           now(std::chrono::steady_clock::now()),
@@ -146,12 +161,24 @@ public:
     /// Return the threads' OS priority.
     int getPriority() const;
 
+    /// @return the index of the thread among threads of the same type.
+    size_t getIndex() const {
+        return index;
+    }
+
+    /// @return the NUMA node the thread is bound to, or -1 if unbound.
+    int getNumaNode() const {
+        return numaNode;
+    }
+
 protected:
     void cancelCurrentTask(ExecutorPool& manager);
 
     cb_thread_t thread;
     ExecutorPool *manager;
     task_type_t taskType;
+    const size_t index;
+    std::atomic<int> numaNode;
     const std::string name;
     std::atomic<executor_state_t> state;
 
@@ -0,0 +1,95 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "flush_batch_controller.h"
+
+#include <algorithm>
+
+FlushBatchController::FlushBatchController(
+        size_t maxLimit, std::chrono::milliseconds targetLatency)
+    : maxLimit(std::max(size_t(1), maxLimit)),
+      targetLatency(targetLatency),
+      limit(this->maxLimit.load()) {
+    window.reserve(windowSize);
+}
+
+void FlushBatchController::setMaxLimit(size_t value) {
+    maxLimit = std::max(size_t(1), value);
+    limit = maxLimit.load();
+}
+
+size_t FlushBatchController::getBatchLimit(bool persistenceWaiters) const {
+    return persistenceWaiters ? maxLimit.load() : limit.load();
+}
+
+size_t FlushBatchController::getMinLimit() const {
+    return std::max(size_t(1), maxLimit / minLimitDivisor);
+}
+
+void FlushBatchController::recordBatch(std::chrono::microseconds latency,
+                                       size_t backlog,
+                                       bool persistenceWaiters) {
+    std::lock_guard<std::mutex> lh(windowMutex);
+    if (window.size() < windowSize) {
+        window.push_back(latency.count());
+    } else {
+        window[windowNext] = latency.count();
+    }
+    windowNext = (windowNext + 1) % windowSize;
+
+    sawBacklog |= backlog > 0;
+    sawWaiters |= persistenceWaiters;
+    if (++batchesSinceAdjust >= adjustInterval) {
+        adjust();
+    }
+}
+
+void FlushBatchController::adjust() {
+    auto latencies = window;
+    const auto p99Index = (latencies.size() * 99 + 99) / 100 - 1;
+    std::nth_element(latencies.begin(),
+                     latencies.begin() + p99Index,
+                     latencies.end());
+    const auto p99 = std::chrono::microseconds(latencies[p99Index]);
+    p99Latency = p99.count();
+
+    auto target = std::chrono::duration_cast<std::chrono::microseconds>(
+            targetLatency.load());
+    if (sawWaiters) {
+        target /= 2;
+    }
+
+    const size_t current = limit;
+    if (p99 > target) {
+        const auto decreased = std::max(getMinLimit(), current - current / 4);
+        if (decreased < current) {
+            limit = decreased;
+            ++numDecreases;
+        }
+    } else if (sawBacklog && p99 < target * 3 / 4) {
+        const auto increased = std::min(
+                maxLimit.load(), current + std::max(size_t(1), getMinLimit()));
+        if (increased > current) {
+            limit = increased;
+            ++numIncreases;
+        }
+    }
+
+    batchesSinceAdjust = 0;
+    sawBacklog = false;
+    sawWaiters = false;
+}
@@ -0,0 +1,129 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+/**
+ * Sizes the flush-batches of a Flusher from the observed latency of the
+ * batches it flushes (see flusher_batch_auto_tune).
+ *
+ * Small batches cost throughput (one commit, and sync, per batch) while
+ * large batches delay persistence - and so SeqnoPersistence requests and
+ * SyncWrites waiting on persistence - of everything queued behind them.
+ * The controller starts at the static limit (the flusher batch split
+ * trigger, which remains the ceiling) and every adjustInterval batches
+ * compares the p99 of the last windowSize batch latencies with the target:
+ *
+ * - over the target: decrease the limit multiplicatively;
+ * - comfortably under the target with a backlog left after the batches
+ *   (the disk queue is not being drained): increase it additively;
+ * - otherwise keep it.
+ *
+ * While there are persistence waiters (SeqnoPersistence requests or
+ * in-flight SyncWrites) the target is halved. A vBucket which itself has
+ * waiters is always flushed with the ceiling, so it reaches the seqno they
+ * are waiting for in as few commits as possible.
+ */
+class FlushBatchController {
+public:
+    /// Number of batch latencies the p99 is taken over
+    static constexpr size_t windowSize = 128;
+    /// Number of batches between adjustments of the limit
+    static constexpr size_t adjustInterval = 16;
+    /// The floor of the limit, as a fraction of the ceiling
+    static constexpr size_t minLimitDivisor = 64;
+
+    FlushBatchController(size_t maxLimit,
+                         std::chrono::milliseconds targetLatency);
+
+    /// Set the ceiling of the limit, and restart tuning from it.
+    void setMaxLimit(size_t value);
+
+    size_t getMaxLimit() const {
+        return maxLimit;
+    }
+
+    void setTargetLatency(std::chrono::milliseconds value) {
+        targetLatency = value;
+    }
+
+    /**
+     * @param persistenceWaiters Whether the vBucket to be flushed has
+     *        anything waiting for it to be persisted
+     * @return the (approximate) number of items to flush in the vBucket's
+     *         next batch
+     */
+    size_t getBatchLimit(bool persistenceWaiters) const;
+
+    /**
+     * Record a successfully flushed batch.
+     *
+     * @param latency How long the batch took to flush
+     * @param backlog Items still waiting for persistence after the batch
+     * @param persistenceWaiters Whether the vBucket had anything waiting for
+     *        it to be persisted
+     */
+    void recordBatch(std::chrono::microseconds latency,
+                     size_t backlog,
+                     bool persistenceWaiters);
+
+    /// @return the current limit, for vBuckets without persistence waiters.
+    size_t getLimit() const {
+        return limit;
+    }
+
+    /// @return the p99 batch latency at the last adjustment.
+    std::chrono::microseconds getP99Latency() const {
+        return std::chrono::microseconds(p99Latency.load());
+    }
+
+    size_t getNumIncreases() const {
+        return numIncreases;
+    }
+
+    size_t getNumDecreases() const {
+        return numDecreases;
+    }
+
+private:
+    size_t getMinLimit() const;
+
+    /// Adjust the limit given the latencies in the window. Caller must
+    /// hold windowMutex.
+    void adjust();
+
+    std::atomic<size_t> maxLimit;
+    std::atomic<std::chrono::milliseconds> targetLatency;
+    std::atomic<size_t> limit;
+
+    std::atomic<uint64_t> p99Latency{0};
+    std::atomic<size_t> numIncreases{0};
+    std::atomic<size_t> numDecreases{0};
+
+    std::mutex windowMutex;
+    /// Ring buffer of the latest batch latencies (in us)
+    std::vector<uint64_t> window;
+    size_t windowNext = 0;
+    /// State accumulated since the last adjustment
+    size_t batchesSinceAdjust = 0;
+    bool sawBacklog = false;
+    bool sawWaiters = false;
+};
@@ -21,15 +21,113 @@
 #include "common.h"
 #include "ep_bucket.h"
 #include "executorpool.h"
+#include "syncobject.h"
 #include "tasks.h"
 
+#include <phosphor/phosphor.h>
 #include <platform/timeutils.h>
 
 #include <stdlib.h>
 #include <chrono>
+#include <optional>
 #include <sstream>
 #include <thread>
 
+/**
+ * Prepares (see EPBucket::prepareFlush) the next flush-batch of a vBucket on
+ * a NonIO thread, while the Flusher commits the previous batch.
+ *
+ * The vBucket's lock is held by the Flusher for the lifetime of the task (it
+ * must be released by the thread which acquired it); the task only reads the
+ * vBucket's checkpoints under that protection.
+ */
+class FlushPrepareTask : public GlobalTask {
+public:
+    FlushPrepareTask(EPBucket& bucket, VBucketPtr vb)
+        : GlobalTask(&bucket.getEPEngine(), TaskId::FlushPrepareTask, 0, false),
+          bucket(bucket),
+          vb(std::move(vb)),
+          description("Preparing flush batch for " +
+                      this->vb->getId().to_string()) {
+    }
+
+    std::string getDescription() override {
+        return description;
+    }
+
+    std::chrono::microseconds maxExpectedDuration() override {
+        // Gathering and sorting a batch is bounded by the flusher batch
+        // limit; should take a few milliseconds at most.
+        return std::chrono::milliseconds(50);
+    }
+
+    bool run() override {
+        TRACE_EVENT1("ep-engine/task",
+                     "FlushPrepareTask",
+                     "vb",
+                     (vb->getId()).get());
+        prepare();
+        return false;
+    }
+
+    /**
+     * Claim the prepared batch. If the task has not started running yet the
+     * batch is prepared on the calling thread instead (the NonIO threads may
+     * all be busy, or stopped during shutdown); if it is running, waits for
+     * it to complete.
+     */
+    VBucket::ItemsToFlush take() {
+        if (prepare()) {
+            cancel();
+        }
+
+        std::unique_lock<std::mutex> lh(sync);
+        sync.wait(lh, [this]() { return prepareState == State::Done; });
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        return std::move(toFlush);
+    }
+
+private:
+    /// @return true if the batch was prepared by this call.
+    bool prepare() {
+        {
+            std::lock_guard<std::mutex> lh(sync);
+            if (prepareState != State::Pending) {
+                return false;
+            }
+            prepareState = State::Running;
+        }
+
+        VBucket::ItemsToFlush items;
+        std::exception_ptr err;
+        try {
+            items = bucket.prepareFlush(*vb);
+        } catch (...) {
+            err = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lh(sync);
+        toFlush = std::move(items);
+        error = err;
+        prepareState = State::Done;
+        sync.notify_all();
+        return true;
+    }
+
+    enum class State { Pending, Running, Done };
+
+    EPBucket& bucket;
+    const VBucketPtr vb;
+    const std::string description;
+
+    SyncObject sync;
+    State prepareState = State::Pending;
+    VBucket::ItemsToFlush toFlush;
+    std::exception_ptr error;
+};
+
 Flusher::Flusher(EPBucket* st, KVShard* k)
     : store(st),
       _state(State::Initializing),
@@ -38,7 +136,9 @@ Flusher::Flusher(EPBucket* st, KVShard* k)
       doHighPriority(false),
       numHighPriority(0),
       pendingMutation(false),
-      shard(k) {
+      shard(k),
+      batchController(st->getFlusherBatchSplitTrigger(),
+                      st->getFlusherBatchTargetLatency()) {
 }
 
 Flusher::~Flusher() {
@@ -157,6 +257,7 @@ void Flusher::schedule_UNLOCKED() {
     ExecutorPool* iom = ExecutorPool::get();
     ExTask task = std::make_shared<FlusherTask>(
             ObjectRegistry::getCurrentEngine(), this, shard->getId());
+    task->setNumaNode(iom->getNumaNodeForShard(shard->getId()));
     this->setTaskId(task->getId());
     iom->schedule(task);
 }
@@ -297,6 +398,14 @@ bool Flusher::flushVB() {
         doHighPriority = false;
     }
 
+    if (store->isFlusherGroupCommit()) {
+        return flushLPVBsGrouped();
+    }
+
+    if (store->isFlusherPipelined()) {
+        return flushLPVBsPipelined();
+    }
+
     Vbid vbid;
     if (!lpVbs.popFront(vbid)) {
         // Return no more so we don't rewake the task
@@ -304,7 +413,144 @@ bool Flusher::flushVB() {
     }
 
     const auto res = store->flushVBucket(vbid);
+    handleLPFlushResult(vbid, res);
+
+    // Return more (as we may have low priority vBuckets to flush)
+    return true;
+}
+
+bool Flusher::flushLPVBsPipelined() {
+    // Only consider the vBuckets which are ready now, so high priority
+    // vBuckets and state changes are still serviced between runs.
+    auto budget = lpVbs.size();
+    if (budget == 0) {
+        // Return no more so we don't rewake the task
+        return false;
+    }
+
+    // Pop and lock the next low priority vBucket which isn't contended
+    // (excluding the one currently held, whose next batch cannot be
+    // prepared before the current one is committed).
+    auto lockNext = [this, &budget](Vbid& vbid,
+                                    std::optional<Vbid> held) {
+        while (budget > 0 && lpVbs.popFront(vbid)) {
+            --budget;
+            if (vbid == held) {
+                lpVbs.pushUnique(vbid);
+                continue;
+            }
+            auto vb = store->getLockedVBucket(vbid, std::try_to_lock);
+            if (!vb.owns_lock()) {
+                // Try another bucket if this one is locked to avoid blocking
+                // flusher.
+                lpVbs.pushUnique(vbid);
+                continue;
+            }
+            if (vb) {
+                return vb;
+            }
+        }
+        return LockedVBucketPtr{{}, {}};
+    };
+
+    Vbid vbid;
+    auto vb = lockNext(vbid, {});
+    if (!vb) {
+        return !lpVbs.empty();
+    }
+    auto flushStart = std::chrono::steady_clock::now();
+    auto toFlush = store->prepareFlush(*vb);
+
+    while (true) {
+        // Start preparing the next vBucket's batch, then commit the current
+        // one. Commits (and hence persistence notifications) are still made
+        // one at a time, in order, by this thread.
+        Vbid nextVbid;
+        auto nextVb = lockNext(nextVbid, vbid);
+        std::shared_ptr<FlushPrepareTask> nextTask;
+        const auto nextFlushStart = std::chrono::steady_clock::now();
+        if (nextVb) {
+            nextTask = std::make_shared<FlushPrepareTask>(*store,
+                                                          nextVb.getVB());
+            ExecutorPool::get()->schedule(nextTask);
+        }
+
+        if (pipelinedPreCommitHook) {
+            pipelinedPreCommitHook(vbid);
+        }
+
+        std::optional<EPBucket::FlushResult> res;
+        try {
+            res = store->commitFlush(vb, std::move(toFlush), flushStart);
+        } catch (...) {
+            // Don't release the next vBucket's lock while its batch may still
+            // be being prepared; and re-flush that batch next time.
+            if (nextTask) {
+                try {
+                    nextTask->take().flushHandle->markFlushFailed();
+                } catch (...) {
+                }
+            }
+            throw;
+        }
+        handleLPFlushResult(vbid, *res);
+
+        if (!nextTask) {
+            break;
+        }
+        toFlush = nextTask->take();
+        vb = std::move(nextVb);
+        vbid = nextVbid;
+        flushStart = nextFlushStart;
+    }
+
+    // Return more (as we may have low priority vBuckets to flush)
+    return true;
+}
 
+bool Flusher::flushLPVBsGrouped() {
+    // Only consider the vBuckets which are ready now, so high priority
+    // vBuckets and state changes are still serviced between runs.
+    auto budget = lpVbs.size();
+    if (budget == 0) {
+        // Return no more so we don't rewake the task
+        return false;
+    }
+
+    std::vector<Vbid> vbids;
+    std::vector<LockedVBucketPtr> vbs;
+    Vbid vbid;
+    while (budget > 0 && lpVbs.popFront(vbid)) {
+        --budget;
+        auto vb = store->getLockedVBucket(vbid, std::try_to_lock);
+        if (!vb.owns_lock()) {
+            // Try another bucket if this one is locked to avoid blocking
+            // flusher.
+            lpVbs.pushUnique(vbid);
+            continue;
+        }
+        if (vb) {
+            vbids.push_back(vbid);
+            vbs.push_back(std::move(vb));
+        }
+    }
+    if (vbs.empty()) {
+        return !lpVbs.empty();
+    }
+
+    // The vBuckets stay locked until the whole group is durable.
+    const auto results = store->flushVBucketsGrouped(vbs);
+    vbs.clear();
+    for (size_t i = 0; i < vbids.size(); ++i) {
+        handleLPFlushResult(vbids[i], results[i]);
+    }
+
+    // Return more (as we may have low priority vBuckets to flush)
+    return true;
+}
+
+void Flusher::handleLPFlushResult(Vbid vbid,
+                                  const EPBucket::FlushResult& res) {
     if (res.moreAvailable == EPBucket::MoreAvailable::Yes) {
         // More items still available, add vbid back to pending set.
         lpVbs.pushUnique(vbid);
@@ -314,9 +560,6 @@ bool Flusher::flushVB() {
     if (res.wakeupCkptRemover == EPBucket::WakeCkptRemover::Yes) {
         store->wakeUpCheckpointRemover();
     }
-
-    // Return more (as we may have low priority vBuckets to flush)
-    return true;
 }
 
 size_t Flusher::getHPQueueSize() const {
@@ -16,7 +16,9 @@
  */
 #pragma once
 
+#include "ep_bucket.h"
 #include "executorthread.h"
+#include "flush_batch_controller.h"
 #include "utility.h"
 #include "vb_ready_queue.h"
 
@@ -28,7 +30,6 @@
 #define NO_VBUCKETS_INSTANTIATED 0xFFFF
 #define RETRY_FLUSH_VBUCKET (-1)
 
-class EPBucket;
 class KVShard;
 
 /**
@@ -64,12 +65,27 @@ public:
     // the task.
     std::function<void()> stepPreSnoozeHook;
 
+    // Testing hook - if non-empty, called from flushLPVBsPipelined() just
+    // before committing the batch of the given vBucket (once the next
+    // vBucket's FlushPrepareTask, if any, has been scheduled).
+    std::function<void(Vbid)> pipelinedPreCommitHook;
+
     size_t getHPQueueSize() const;
 
     size_t getLPQueueSize() const;
 
     size_t getHighPriorityCount() const;
 
+    /// The controller sizing this Flusher's batches when
+    /// flusher_batch_auto_tune is enabled.
+    FlushBatchController& getBatchController() {
+        return batchController;
+    }
+
+    const FlushBatchController& getBatchController() const {
+        return batchController;
+    }
+
 private:
     enum class State {
         Initializing,
@@ -87,6 +103,25 @@ private:
      * @return true if there is more work to do
      */
     bool flushVB();
+
+    /**
+     * Flush the low priority vBuckets which are ready, preparing each
+     * vBucket's flush-batch on a NonIO thread while the previous vBucket's
+     * batch is committed (see flusher_pipelined).
+     * @return true if there is more work to do
+     */
+    bool flushLPVBsPipelined();
+
+    /**
+     * Flush the low priority vBuckets which are ready as a single group
+     * commit, made durable together (see flusher_group_commit).
+     * @return true if there is more work to do
+     */
+    bool flushLPVBsGrouped();
+
+    /// Requeue / wake the CheckpointRemover after flushing a low priority
+    /// vBucket, as requested by the flush result.
+    void handleLPFlushResult(Vbid vbid, const EPBucket::FlushResult& res);
     void completeFlush();
     void initialize();
     void schedule_UNLOCKED();
@@ -110,5 +145,7 @@ private:
 
     KVShard *shard;
 
+    FlushBatchController batchController;
+
     DISALLOW_COPY_AND_ASSIGN(Flusher);
 };
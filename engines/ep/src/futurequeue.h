@@ -28,17 +28,71 @@
 
 #include <algorithm>
 #include <chrono>
+#include <cstdint>
+#include <functional>
 #include <mutex>
 #include <queue>
 
 #include "globaltask.h"
 
+/**
+ * Interface of a (thread-safe) queue of tasks waiting for their wakeTime,
+ * as used by TaskQueue. See FutureQueue (binary heap) and
+ * TimerWheelFutureQueue (hierarchical timing wheel).
+ */
+class TaskFutureQueue {
+public:
+    virtual ~TaskFutureQueue() = default;
+
+    virtual void push(ExTask task) = 0;
+
+    virtual size_t size() = 0;
+
+    virtual bool empty() = 0;
+
+    /*
+     * Update the wakeTime of task (which is done even if the task is not
+     * queued).
+     * @returns true if 'task' is in the queue.
+     */
+    virtual bool updateWaketime(
+            const ExTask& task,
+            std::chrono::steady_clock::time_point newTime) = 0;
+
+    /*
+     * snooze the task (by altering its wakeTime).
+     * @returns true if 'task' is in the queue.
+     */
+    virtual bool snooze(const ExTask& task, const double secs) = 0;
+
+    /**
+     * @returns a time no later than the wakeTime of the earliest task, or
+     *          time_point::max() if the queue is empty.
+     */
+    virtual std::chrono::steady_clock::time_point getEarliestWaketime() = 0;
+
+    /**
+     * Remove all tasks whose wakeTime is <= now, passing each to onReady.
+     * @returns the number of tasks removed.
+     */
+    virtual size_t popReady(std::chrono::steady_clock::time_point now,
+                            const std::function<void(ExTask)>& onReady) = 0;
+};
+
+/// The available TaskFutureQueue implementations.
+enum class FutureQueueType : uint8_t {
+    /// FutureQueue
+    Heap,
+    /// TimerWheelFutureQueue
+    TimerWheel
+};
+
 template <class C = std::deque<ExTask>,
           class Compare = CompareByDueDate>
-class FutureQueue {
+class FutureQueue : public TaskFutureQueue {
 public:
 
-    void push(ExTask task) {
+    void push(ExTask task) override {
         std::lock_guard<std::mutex> lock(queueMutex);
         queue.push(task);
     }
@@ -53,23 +107,46 @@ public:
         return queue.top();
     }
 
-    size_t size() {
+    size_t size() override {
         std::lock_guard<std::mutex> lock(queueMutex);
         return queue.size();
     }
 
-    bool empty() {
+    bool empty() override {
         std::lock_guard<std::mutex> lock(queueMutex);
         return queue.empty();
     }
 
+    /**
+     * @returns the wakeTime of the top() task, or time_point::max() if the
+     *          queue is empty.
+     */
+    std::chrono::steady_clock::time_point getEarliestWaketime() override {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        return queue.empty() ? std::chrono::steady_clock::time_point::max()
+                             : queue.top()->getWaketime();
+    }
+
+    size_t popReady(std::chrono::steady_clock::time_point now,
+                    const std::function<void(ExTask)>& onReady) override {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        size_t numReady = 0;
+        while (!queue.empty() && queue.top()->getWaketime() <= now) {
+            onReady(queue.top());
+            queue.pop();
+            numReady++;
+        }
+        return numReady;
+    }
+
     /*
      * Update the wakeTime of task and ensure the heap property is
      * maintained.
      * @returns true if 'task' is in the FutureQueue.
      */
-    bool updateWaketime(const ExTask& task,
-                        std::chrono::steady_clock::time_point newTime) {
+    bool updateWaketime(
+            const ExTask& task,
+            std::chrono::steady_clock::time_point newTime) override {
         std::lock_guard<std::mutex> lock(queueMutex);
         task->updateWaketime(newTime);
         // After modifiying the task's wakeTime, rebuild the heap
@@ -81,7 +158,7 @@ public:
      * heap property is maintained.
      * @returns true if 'task' is in the FutureQueue.
      */
-    bool snooze(const ExTask& task, const double secs) {
+    bool snooze(const ExTask& task, const double secs) override {
         std::lock_guard<std::mutex> lock(queueMutex);
         task->snooze(secs);
         // After modifiying the task's wakeTime, rebuild the heap
@@ -205,6 +205,20 @@ public:
         return static_cast<queue_priority_t>(priority);
     }
 
+    /**
+     * Set the NUMA node (index) whose threads should preferably run this
+     * task; -1 (the default) for no preference. See
+     * ExecutorPool::getNumaNodeForShard(). Must be set before the task is
+     * scheduled.
+     */
+    void setNumaNode(int node) {
+        numaNode = node;
+    }
+
+    int getNumaNode() const {
+        return numaNode;
+    }
+
     /*
      * Lookup the task name for TaskId id.
      * The data used is generated from tasks.def.h
@@ -281,6 +295,7 @@ protected:
 
 private:
     atomic_time_point waketime; // used for priority_queue
+    int numaNode = -1;
 };
 
 typedef std::shared_ptr<GlobalTask> ExTask;
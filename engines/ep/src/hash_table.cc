@@ -19,6 +19,7 @@
 
 #include "ep_time.h"
 #include "item.h"
+#include "locks.h"
 #include "stats.h"
 #include "stored_value_factories.h"
 
@@ -82,6 +83,17 @@ std::string to_string(MutationStatus status) {
     return "<invalid>(" + std::to_string(int(status)) + ")";
 }
 
+HashTable::Layout HashTable::layoutFromString(const std::string& layout) {
+    if (layout == "chained") {
+        return Layout::Chained;
+    }
+    if (layout == "tagged") {
+        return Layout::Tagged;
+    }
+    throw std::invalid_argument(
+            "HashTable::layoutFromString: unknown layout '" + layout + "'");
+}
+
 std::ostream& operator<<(std::ostream& os, const HashTable::Position& pos) {
     os << "{lock:" << pos.lock << " bucket:" << pos.hash_bucket << "/" << pos.ht_size << "}";
     return os;
@@ -134,13 +146,39 @@ StoredValue* HashTable::FindUpdateResult::selectSVToModify(const Item& itm) {
     return selectSVToModify(itm.isPending());
 }
 
+/**
+ * Holds all of the HashTable's mutexes (as per MultiLockHolder), and also
+ * excludes optimistic readers from every lock for its lifetime.
+ */
+class HashTable::AllLocksHolder {
+public:
+    explicit AllLocksHolder(HashTable& ht) : mlh(ht.mutexes), ht(ht) {
+        for (auto& lockState : ht.lockStates) {
+            lockState.beginWrite();
+        }
+    }
+
+    ~AllLocksHolder() {
+        for (auto& lockState : ht.lockStates) {
+            lockState.endWrite();
+        }
+    }
+
+private:
+    MultiLockHolder mlh;
+    HashTable& ht;
+};
+
 HashTable::HashTable(EPStats& st,
                      std::unique_ptr<AbstractStoredValueFactory> svFactory,
                      size_t initialSize,
-                     size_t locks)
+                     size_t locks,
+                     Layout layout)
     : initialSize(initialSize),
+      layout(layout),
       size(initialSize),
       mutexes(locks),
+      lockStates(locks),
       stats(st),
       valFact(std::move(svFactory)),
       visitors(0),
@@ -150,6 +188,9 @@ HashTable::HashTable(EPStats& st,
       maxDeletedRevSeqno(0),
       probabilisticCounter(freqCounterIncFactor) {
     values.resize(size);
+    if (layout == Layout::Tagged) {
+        tagBlocks.resize(size);
+    }
     activeState = true;
 }
 
@@ -178,7 +219,7 @@ void HashTable::clear(bool deactivate) {
                     "non-active object");
         }
     }
-    MultiLockHolder mlh(mutexes);
+    AllLocksHolder alh(*this);
     clear_UNLOCKED(deactivate);
 }
 
@@ -186,21 +227,29 @@ void HashTable::clear_UNLOCKED(bool deactivate) {
     if (deactivate) {
         setActiveState(false);
     }
-    size_t clearedMemSize = 0;
-    size_t clearedValSize = 0;
-    for (int i = 0; i < (int)size; i++) {
-        while (values[i]) {
+    size_t clearedMetaDataSize = 0;
+    for (int i = 0; i < (int)getNumBuckets(); i++) {
+        auto& head = bucketHead(i);
+        while (head) {
             // Take ownership of the StoredValue from the vector, update
             // statistics and release it.
-            auto v = std::move(values[i]);
-            clearedMemSize += v->size();
-            clearedValSize += v->valuelen();
-            values[i] = std::move(v->getNext());
+            auto v = std::move(head);
+            clearedMetaDataSize += v->metaDataSize();
+            head = std::move(v->getNext());
         }
     }
+    for (auto& block : tagBlocks) {
+        block = TagBlock();
+    }
+    for (auto& block : resizeTagBlocks) {
+        block = TagBlock();
+    }
+    if (isResizing()) {
+        // Nothing left to migrate; switch straight over to the new table.
+        completeResize_UNLOCKED();
+    }
 
-    stats.coreLocal.get()->currentSize.fetch_sub(clearedMemSize -
-                                                 clearedValSize);
+    stats.coreLocal.get()->currentSize.fetch_sub(clearedMetaDataSize);
 
     valueStats.reset();
 }
@@ -219,7 +268,11 @@ static bool isCurrently(size_t size, ssize_t a, ssize_t b) {
 }
 
 void HashTable::resize() {
-    size_t ni = getNumInMemoryItems();
+    resize(getAutoResizeSize());
+}
+
+size_t HashTable::getAutoResizeSize() const {
+    size_t ni = getNumInMemoryItems() / targetItemsPerBucket();
     int i(0);
     size_t new_size(0);
 
@@ -246,7 +299,7 @@ void HashTable::resize() {
         new_size = nearest(ni, prime_size_table[i-1], prime_size_table[i]);
     }
 
-    resize(new_size);
+    return new_size;
 }
 
 void HashTable::resize(size_t newSize) {
@@ -262,48 +315,134 @@ void HashTable::resize(size_t newSize) {
     }
 
     // Don't resize to the same size, either.
-    if (newSize == size) {
+    if (newSize == size && !isResizing()) {
         return;
     }
 
     TRACE_EVENT2(
             "HashTable", "resize", "size", size.load(), "newSize", newSize);
 
-    MultiLockHolder mlh(mutexes);
-    if (visitors.load() > 0) {
-        // Do not allow a resize while any visitors are actually
-        // processing.  The next attempt will have to pick it up.  New
-        // visitors cannot start doing meaningful work (we own all
-        // locks at this point).
-        return;
+    // Migrate chunk by chunk, releasing all locks between chunks so other
+    // operations can proceed. If a different resize is already in progress
+    // then help complete it first, and then start ours.
+    bool started = false;
+    while (true) {
+        AllLocksHolder alh(*this);
+        if (visitors.load() > 0) {
+            // Do not allow a resize while any visitors are actually
+            // processing.  The next attempt will have to pick it up.  New
+            // visitors cannot start doing meaningful work (we own all
+            // locks at this point).
+            return;
+        }
+        if (!isResizing()) {
+            if (started || newSize == size) {
+                // Our resize has completed (or is no longer necessary).
+                return;
+            }
+            beginResize_UNLOCKED(newSize);
+            started = true;
+        }
+        migrateChunk_UNLOCKED(resizeChunkBuckets);
     }
+}
 
-    // Get a place for the new items.
-    table_type newValues(newSize);
+bool HashTable::resizeIncremental(
+        std::chrono::steady_clock::duration maxDuration) {
+    if (!isActive()) {
+        throw std::logic_error(
+                "HashTable::resizeIncremental: Cannot call on a "
+                "non-active object");
+    }
 
+    const auto deadline = std::chrono::steady_clock::now() + maxDuration;
+    // Only pick a new size if we aren't continuing an existing resize.
+    const size_t newSize = isResizing() ? 0 : getAutoResizeSize();
+    bool started = false;
+    while (true) {
+        AllLocksHolder alh(*this);
+        if (visitors.load() > 0) {
+            // As per resize(); the next attempt will pick it up.
+            return !isResizing();
+        }
+        if (!isResizing()) {
+            if (started || newSize == 0 || newSize == size) {
+                return true;
+            }
+            TRACE_EVENT2("HashTable",
+                         "resizeIncremental",
+                         "size",
+                         size.load(),
+                         "newSize",
+                         newSize);
+            beginResize_UNLOCKED(newSize);
+            started = true;
+        }
+        migrateChunk_UNLOCKED(resizeChunkBuckets);
+        if (std::chrono::steady_clock::now() >= deadline) {
+            return !isResizing();
+        }
+    }
+}
+
+void HashTable::beginResize_UNLOCKED(size_t newSize) {
     stats.coreLocal.get()->memOverhead.fetch_sub(memorySize());
-    ++numResizes;
 
-    // Set the new size so all the hashy stuff works.
-    size_t oldSize = size;
-    size.store(newSize);
+    // Get a place for the new items.
+    resizeValues = table_type(newSize);
+    if (layout == Layout::Tagged) {
+        resizeTagBlocks = std::vector<TagBlock>(newSize);
+    }
+    resizeCursor.store(0);
+    resizeSize.store(newSize);
+
+    stats.coreLocal.get()->memOverhead.fetch_add(memorySize());
+}
+
+void HashTable::migrateChunk_UNLOCKED(size_t maxBuckets) {
+    const size_t oldSize = size;
+    const int newSize = static_cast<int>(resizeSize);
+    const size_t end = std::min(oldSize, resizeCursor + maxBuckets);
 
     // Move existing records into the new space.
-    for (size_t i = 0; i < oldSize; i++) {
+    for (size_t i = resizeCursor; i < end; i++) {
         while (values[i]) {
             // unlink the front element from the hash chain at values[i].
             auto v = std::move(values[i]);
             values[i] = std::move(v->getNext());
 
-            // And re-link it into the correct place in newValues.
-            int newBucket = getBucketForHash(v->getKey().hash());
-            v->setNext(std::move(newValues[newBucket]));
-            newValues[newBucket] = std::move(v);
+            // And re-link it into the correct place in resizeValues; this
+            // must match the bucket getBucketForHash() selects once
+            // resizeCursor has moved past i.
+            const int h = v->getKey().hash();
+            const int newBucket = abs(h % newSize);
+            tagInsert(oldSize + newBucket, *v);
+            v->setNext(std::move(resizeValues[newBucket]));
+            resizeValues[newBucket] = std::move(v);
+        }
+        if (layout == Layout::Tagged) {
+            tagBlocks[i] = TagBlock();
         }
     }
+    resizeCursor.store(end);
+
+    if (end == oldSize) {
+        completeResize_UNLOCKED();
+    }
+}
+
+void HashTable::completeResize_UNLOCKED() {
+    stats.coreLocal.get()->memOverhead.fetch_sub(memorySize());
+    ++numResizes;
 
     // Finally assign the new table to values.
-    values = std::move(newValues);
+    values = std::move(resizeValues);
+    resizeValues = table_type();
+    tagBlocks = std::move(resizeTagBlocks);
+    resizeTagBlocks = std::vector<TagBlock>();
+    size.store(resizeSize);
+    resizeSize.store(0);
+    resizeCursor.store(0);
 
     stats.coreLocal.get()->memOverhead.fetch_add(memorySize());
 }
@@ -314,36 +453,82 @@ HashTable::FindInnerResult HashTable::findInner(const DocKey& key) {
                 "HashTable::find: Cannot call on a "
                 "non-active object");
     }
-    HashBucketLock hbl = getLockedBucket(key);
-    // Scan through all elements in the hash bucket chain looking for Committed
-    // and Pending items with the same key.
+    const auto hash = key.hash();
+    HashBucketLock hbl = getLockedBucketForHash(hash);
+    const auto found = findInBucket(hbl.getBucketNum(), hash, key);
+    return {std::move(hbl), found.first, found.second};
+}
+
+std::pair<StoredValue*, StoredValue*> HashTable::findInBucket(
+        int bucket, uint32_t hash, const DocKey& key) {
     StoredValue* foundCmt = nullptr;
     StoredValue* foundPend = nullptr;
-    for (StoredValue* v = values[hbl.getBucketNum()].get().get(); v;
+    auto classify = [&foundCmt, &foundPend](StoredValue* v) {
+        if (v->isPending() || v->isCompleted()) {
+            Expects(!foundPend);
+            foundPend = v;
+        } else {
+            Expects(!foundCmt);
+            foundCmt = v;
+        }
+    };
+
+    if (layout == Layout::Tagged) {
+        const auto& block = tagBlockFor(bucket);
+        if (!block.overflowed) {
+            // The TagBlock indexes the entire chain - only need to look at
+            // the StoredValues whose tag matches.
+            const auto tag = tagForHash(hash);
+            for (size_t i = 0; i < TagBlock::NumSlots; i++) {
+                if (block.tags[i] == tag && block.slots[i] &&
+                    block.slots[i]->hasKey(key)) {
+                    classify(block.slots[i]);
+                }
+            }
+            return {foundCmt, foundPend};
+        }
+    }
+
+    // Scan through all elements in the hash bucket chain looking for Committed
+    // and Pending items with the same key.
+    for (StoredValue* v = bucketHead(bucket).get().get(); v;
          v = v->getNext().get().get()) {
         if (v->hasKey(key)) {
-            if (v->isPending() || v->isCompleted()) {
-                Expects(!foundPend);
-                foundPend = v;
-            } else {
-                Expects(!foundCmt);
-                foundCmt = v;
-            }
+            classify(v);
         }
     }
 
-    return {std::move(hbl), foundCmt, foundPend};
+    return {foundCmt, foundPend};
+}
+
+HashTable::BucketLockState* HashTable::tryBeginOptimisticRead(uint32_t hash,
+                                                              int& bucket) {
+    bucket = getBucketForHash(hash);
+    auto& lockState = lockStates[mutexForBucket(bucket)];
+    if (lockState.tryBeginRead()) {
+        // As per getLockedBucketForHash(), a resize chunk may have moved the
+        // hash to a different bucket before we registered; once registered
+        // no chunk can run until we have finished.
+        if (bucket == getBucketForHash(hash) &&
+            &lockState == &lockStates[mutexForBucket(bucket)]) {
+            return &lockState;
+        }
+        lockState.endRead();
+    }
+    lockState.optimisticReadFallbacks++;
+    return nullptr;
 }
 
 std::unique_ptr<Item> HashTable::getRandomKey(long rnd) {
     /* Try to locate a partition */
-    size_t start = rnd % size;
+    const size_t numBuckets = getNumBuckets();
+    size_t start = rnd % numBuckets;
     size_t curr = start;
     std::unique_ptr<Item> ret;
 
     do {
         ret = getRandomKeyFromSlot(curr++);
-        if (curr == size) {
+        if (curr == numBuckets) {
             curr = 0;
         }
     } while (ret == nullptr && curr != start);
@@ -417,12 +602,14 @@ StoredValue* HashTable::unlocked_addNewStoredValue(const HashBucketLock& hbl,
     const auto emptyProperties = valueStats.prologue(nullptr);
 
     // Create a new StoredValue and link it into the head of the bucket chain.
-    auto v = (*valFact)(itm, std::move(values[hbl.getBucketNum()]));
+    auto& head = bucketHead(hbl.getBucketNum());
+    auto v = (*valFact)(itm, std::move(head));
 
     valueStats.epilogue(emptyProperties, v.get().get());
 
-    values[hbl.getBucketNum()] = std::move(v);
-    return values[hbl.getBucketNum()].get().get();
+    tagInsert(hbl.getBucketNum(), *v);
+    head = std::move(v);
+    return head.get().get();
 }
 
 HashTable::Statistics::StoredValueProperties::StoredValueProperties(
@@ -719,15 +906,16 @@ HashTable::unlocked_replaceByCopy(const HashBucketLock& hbl,
     auto releasedSv = unlocked_release(hbl, &vToCopy);
 
     /* Copy the StoredValue and link it into the head of the bucket chain. */
-    auto newSv = valFact->copyStoredValue(
-            vToCopy, std::move(values[hbl.getBucketNum()]));
+    auto& head = bucketHead(hbl.getBucketNum());
+    auto newSv = valFact->copyStoredValue(vToCopy, std::move(head));
 
     // Adding a new item into the HashTable; update stats.
     const auto emptyProperties = valueStats.prologue(nullptr);
     valueStats.epilogue(emptyProperties, newSv.get().get());
 
-    values[hbl.getBucketNum()] = std::move(newSv);
-    return {values[hbl.getBucketNum()].get().get(), std::move(releasedSv)};
+    tagInsert(hbl.getBucketNum(), *newSv);
+    head = std::move(newSv);
+    return {head.get().get(), std::move(releasedSv)};
 }
 
 HashTable::DeleteResult HashTable::unlocked_softDelete(
@@ -793,37 +981,48 @@ HashTable::FindROResult HashTable::findForRead(
         WantsDeleted wantsDeleted,
         const ForGetReplicaOp fetchRequestedForReplicaItem) {
     auto result = findInner(key);
+    const auto* sv = selectForRead(result.committedSV,
+                                   result.pendingSV,
+                                   wantsDeleted,
+                                   fetchRequestedForReplicaItem);
+
+    // If we found a non-deleted, committed item check if we should update
+    // ref-count. We don't update ref-counts for deleted items.
+    if (sv && sv == result.committedSV && !sv->isDeleted() &&
+        trackReference == TrackReference::Yes) {
+        updateFreqCounter(*result.committedSV);
+    }
 
+    return {sv, std::move(result.lock)};
+}
+
+const StoredValue* HashTable::selectForRead(
+        StoredValue* committed,
+        StoredValue* pending,
+        WantsDeleted wantsDeleted,
+        ForGetReplicaOp fetchRequestedForReplicaItem) {
     /// Reading normally uses the Committed StoredValue - however if a
     /// pendingSV is found we must check if it's marked as MaybeVisible -
     /// which will block reading.
     /// However if this request is for a GET_REPLICA then we should only
     /// return committed items
-    if (fetchRequestedForReplicaItem == ForGetReplicaOp::No &&
-        result.pendingSV && result.pendingSV->isPreparedMaybeVisible()) {
+    if (fetchRequestedForReplicaItem == ForGetReplicaOp::No && pending &&
+        pending->isPreparedMaybeVisible()) {
         // Return the pending one as an indication the caller cannot read it.
-        return {result.pendingSV, std::move(result.lock)};
+        return pending;
     }
-    auto* sv = result.committedSV;
 
-    if (!sv) {
+    if (!committed) {
         // No item found - return null.
-        return {nullptr, std::move(result.lock)};
+        return nullptr;
     }
 
-    if (result.committedSV->isDeleted()) {
-        // Deleted items should only be returned if caller asked for them,
-        // and we don't update ref-counts for them.
-        return {(wantsDeleted == WantsDeleted::Yes) ? sv : nullptr,
-                std::move(result.lock)};
+    if (committed->isDeleted()) {
+        // Deleted items should only be returned if caller asked for them.
+        return (wantsDeleted == WantsDeleted::Yes) ? committed : nullptr;
     }
 
-    // Found a non-deleted item. Now check if we should update ref-count.
-    if (trackReference == TrackReference::Yes) {
-        updateFreqCounter(*sv);
-    }
-
-    return {sv, std::move(result.lock)};
+    return committed;
 }
 
 HashTable::FindResult HashTable::findForWrite(const DocKey& key,
@@ -963,7 +1162,8 @@ StoredValue::UniquePtr HashTable::unlocked_release(
     // Remove the first (should only be one) StoredValue matching the given
     // pointer
     auto released = hashChainRemoveFirst(
-            values[hbl.getBucketNum()], [valueToRelease](const StoredValue* v) {
+            bucketHead(hbl.getBucketNum()),
+            [valueToRelease](const StoredValue* v) {
                 return v == valueToRelease;
             });
 
@@ -974,6 +1174,7 @@ StoredValue::UniquePtr HashTable::unlocked_release(
                 "HashTable::unlocked_release_base: StoredValue to be released "
                 "not found in HashTable; possibly HashTable leak");
     }
+    tagRemove(hbl.getBucketNum(), released.get().get());
 
     // Update statistics for the item which is now gone.
     const auto preProps = valueStats.prologue(released.get().get());
@@ -1043,12 +1244,12 @@ MutationStatus HashTable::insertFromWarmup(const Item& itm,
 
 bool HashTable::reallocateStoredValue(StoredValue&& sv) {
     // Search the chain and reallocate
-    for (StoredValue::UniquePtr* curr =
-                 &values[getBucketForHash(sv.getKey().hash())];
-         curr->get().get();
+    const auto bucket = getBucketForHash(sv.getKey().hash());
+    for (StoredValue::UniquePtr* curr = &bucketHead(bucket); curr->get().get();
          curr = &curr->get()->getNext()) {
         if (&sv == curr->get().get()) {
             auto newSv = valFact->copyStoredValue(sv, std::move(sv.getNext()));
+            tagReplace(bucket, &sv, newSv.get().get());
             curr->swap(newSv);
             return true;
         }
@@ -1063,13 +1264,15 @@ void HashTable::dump() const {
 nlohmann::json HashTable::dumpStoredValuesAsJson() const {
     MultiLockHolder mlh(mutexes);
     auto obj = nlohmann::json::array();
-    for (const auto& chain : values) {
-        if (chain) {
-            for (StoredValue* sv = chain.get().get(); sv != nullptr;
-                 sv = sv->getNext().get().get()) {
-                std::stringstream ss;
-                ss << sv->getKey();
-                obj.push_back(*sv);
+    for (const auto* table : {&values, &resizeValues}) {
+        for (const auto& chain : *table) {
+            if (chain) {
+                for (StoredValue* sv = chain.get().get(); sv != nullptr;
+                     sv = sv->getNext().get().get()) {
+                    std::stringstream ss;
+                    ss << sv->getKey();
+                    obj.push_back(*sv);
+                }
             }
         }
     }
@@ -1104,18 +1307,20 @@ void HashTable::visitDepth(HashTableDepthVisitor &visitor) {
     VisitorTracker vt(&visitors);
     lh.unlock();
 
-    for (int l = 0; l < static_cast<int>(mutexes.size()); l++) {
-        for (int i = l; i < static_cast<int>(size); i+= mutexes.size()) {
+    const size_t numBuckets = getNumBuckets();
+    for (size_t l = 0; l < mutexes.size(); l++) {
+        for (size_t i = firstBucketForLock(l); i < numBuckets;
+             i = nextBucketForLock(l, i)) {
             // (re)acquire mutex on each HashBucket, to minimise any impact
             // on front-end threads.
             LockHolder lh(mutexes[l]);
 
             size_t depth = 0;
-            StoredValue* p = values[i].get().get();
+            StoredValue* p = bucketHead(i).get().get();
             if (p) {
                 // TODO: Perf: This check seems costly - do we think it's still
                 // worth keeping?
-                auto hashbucket = getBucketForHash(p->getKey().hash());
+                size_t hashbucket = getBucketForHash(p->getKey().hash());
                 if (i != hashbucket) {
                     throw std::logic_error("HashTable::visit: inconsistency "
                             "between StoredValue's calculated hashbucket "
@@ -1130,7 +1335,7 @@ void HashTable::visitDepth(HashTableDepthVisitor &visitor) {
                 mem += p->size();
                 p = p->getNext().get().get();
             }
-            visitor.visit(i, depth, mem);
+            visitor.visit(static_cast<int>(i), depth, mem);
             ++visited;
         }
     }
@@ -1161,6 +1366,10 @@ HashTable::Position HashTable::pauseResumeVisit(HashTableVisitor& visitor,
     VisitorTracker vt(&visitors);
     lh.unlock();
 
+    // While we are registered as a visitor no resize chunks can run, so the
+    // number of buckets (old plus new, if a resize is in progress) is stable.
+    const size_t numBuckets = getNumBuckets();
+
     // Start from the requested lock number if in range.
     size_t lock = (start_pos.lock < mutexes.size()) ? start_pos.lock : 0;
     size_t hash_bucket = 0;
@@ -1169,26 +1378,28 @@ HashTable::Position HashTable::pauseResumeVisit(HashTableVisitor& visitor,
 
         // If the bucket position is *this* lock, then start from the
         // recorded bucket (as long as we haven't resized).
-        hash_bucket = lock;
-        if (start_pos.lock == lock &&
-            start_pos.ht_size == size &&
-            start_pos.hash_bucket < size) {
+        hash_bucket = firstBucketForLock(lock);
+        if (start_pos.lock == lock && start_pos.ht_size == numBuckets &&
+            start_pos.hash_bucket < numBuckets &&
+            mutexForBucket(start_pos.hash_bucket) == lock) {
             hash_bucket = start_pos.hash_bucket;
         }
 
         // Iterate across all values in the hash buckets owned by this lock.
         // Note: we don't record how far into the bucket linked-list we
         // pause at; so any restart will begin from the next bucket.
-        for (; !paused && hash_bucket < size; hash_bucket += mutexes.size()) {
+        for (; !paused && hash_bucket < numBuckets;
+             hash_bucket = nextBucketForLock(lock, hash_bucket)) {
             visitor.setUpHashBucketVisit();
 
             // HashBucketLock scope. If a visitor needs additional locking
             // around the HashBucket visit then we need to release it before
             // tearDownHashBucketVisit() is called.
             {
-                HashBucketLock lh(hash_bucket, mutexes[lock]);
+                HashBucketLock lh(
+                        hash_bucket, mutexes[lock], &lockStates[lock]);
 
-                StoredValue* v = values[hash_bucket].get().get();
+                StoredValue* v = bucketHead(hash_bucket).get().get();
                 while (!paused && v) {
                     StoredValue* tmp = v->getNext().get().get();
                     paused = !visitor.visit(lh, *v);
@@ -1202,21 +1413,22 @@ HashTable::Position HashTable::pauseResumeVisit(HashTableVisitor& visitor,
         // If the visitor paused us before we visited all hash buckets owned
         // by this lock, we don't want to skip the remaining hash buckets, so
         // stop the outer for loop from advancing to the next lock.
-        if (paused && hash_bucket < size) {
+        if (paused && hash_bucket < numBuckets) {
             break;
         }
 
-        // Finished all buckets owned by this lock. Set hash_bucket to 'size'
-        // to give a consistent marker for "end of lock".
-        hash_bucket = size;
+        // Finished all buckets owned by this lock. Set hash_bucket to
+        // 'numBuckets' to give a consistent marker for "end of lock".
+        hash_bucket = numBuckets;
     }
 
     // Return the *next* location that should be visited.
-    return HashTable::Position(size, lock, hash_bucket);
+    return HashTable::Position(numBuckets, lock, hash_bucket);
 }
 
 HashTable::Position HashTable::endPosition() const  {
-    return HashTable::Position(size, mutexes.size(), size);
+    const auto numBuckets = getNumBuckets();
+    return HashTable::Position(numBuckets, mutexes.size(), numBuckets);
 }
 
 bool HashTable::unlocked_ejectItem(const HashTable::HashBucketLock&,
@@ -1245,8 +1457,9 @@ bool HashTable::unlocked_ejectItem(const HashTable::HashBucketLock&,
         // Remove the item from the hash table.
         int bucket_num = getBucketForHash(vptr->getKey().hash());
         auto removed = hashChainRemoveFirst(
-                values[bucket_num],
+                bucketHead(bucket_num),
                 [vptr](const StoredValue* v) { return v == vptr; });
+        tagRemove(bucket_num, removed.get().get());
 
         if (removed->isResident()) {
             ++stats.numValueEjects;
@@ -1263,8 +1476,14 @@ bool HashTable::unlocked_ejectItem(const HashTable::HashBucketLock&,
 }
 
 std::unique_ptr<Item> HashTable::getRandomKeyFromSlot(int slot) {
-    auto lh = getLockedBucket(slot);
-    for (StoredValue* v = values[slot].get().get(); v;
+    const auto mutex = mutexForBucket(slot);
+    HashBucketLock lh(slot, mutexes[mutex], &lockStates[mutex]);
+    if (static_cast<size_t>(slot) >= getNumBuckets() ||
+        mutexForBucket(slot) != mutex) {
+        // The table was resized since the slot was chosen.
+        return nullptr;
+    }
+    for (StoredValue* v = bucketHead(slot).get().get(); v;
             v = v->getNext().get().get()) {
         if (!v->isTempItem() && !v->isDeleted() && v->isResident() &&
             v->isCommitted()) {
@@ -1314,6 +1533,79 @@ void HashTable::unlocked_restoreMeta(const std::unique_lock<std::mutex>& htLock,
     valueStats.epilogue(preProps, &v);
 }
 
+void HashTable::tagInsert(int bucket, StoredValue& v) {
+    if (layout != Layout::Tagged) {
+        return;
+    }
+    auto& block = tagBlockFor(bucket);
+    if (block.overflowed) {
+        return;
+    }
+    for (size_t i = 0; i < TagBlock::NumSlots; i++) {
+        if (!block.slots[i]) {
+            block.tags[i] = tagForHash(v.getKey().hash());
+            block.slots[i] = &v;
+            return;
+        }
+    }
+    // No free slot - the chain is now longer than the TagBlock can index.
+    block.overflowed = true;
+}
+
+void HashTable::tagRemove(int bucket, const StoredValue* v) {
+    if (layout != Layout::Tagged) {
+        return;
+    }
+    auto& block = tagBlockFor(bucket);
+    if (block.overflowed) {
+        // The removed SV may or may not have been indexed; and the chain may
+        // now fit in the TagBlock again. Simplest to re-index from the chain.
+        tagRebuild(bucket);
+        return;
+    }
+    for (size_t i = 0; i < TagBlock::NumSlots; i++) {
+        if (block.slots[i] == v) {
+            block.tags[i] = 0;
+            block.slots[i] = nullptr;
+            return;
+        }
+    }
+}
+
+void HashTable::tagReplace(int bucket,
+                           const StoredValue* from,
+                           StoredValue* to) {
+    if (layout != Layout::Tagged) {
+        return;
+    }
+    auto& block = tagBlockFor(bucket);
+    for (size_t i = 0; i < TagBlock::NumSlots; i++) {
+        if (block.slots[i] == from) {
+            block.slots[i] = to;
+            return;
+        }
+    }
+}
+
+void HashTable::tagRebuild(int bucket) {
+    if (layout != Layout::Tagged) {
+        return;
+    }
+    auto& block = tagBlockFor(bucket);
+    block = TagBlock();
+    size_t slot = 0;
+    for (StoredValue* v = bucketHead(bucket).get().get(); v;
+         v = v->getNext().get().get()) {
+        if (slot == TagBlock::NumSlots) {
+            block.overflowed = true;
+            return;
+        }
+        block.tags[slot] = tagForHash(v->getKey().hash());
+        block.slots[slot] = v;
+        ++slot;
+    }
+}
+
 uint8_t HashTable::generateFreqValue(uint8_t counter) {
     return probabilisticCounter.generateValue(counter);
 }
@@ -1333,6 +1625,55 @@ void HashTable::updateFreqCounter(StoredValue& v) {
     }
 }
 
+void HashTable::applyFreqCounterUpdate(const DocKey& key,
+                                       uint8_t expected,
+                                       uint8_t newValue) {
+    auto result = findInner(key);
+    auto* sv = result.committedSV;
+    // Skip if the item has gone, or its counter changed (e.g. another reader
+    // already incremented it, or it was decayed) since we read it.
+    if (!sv || sv->getFreqCounterValue() != expected) {
+        return;
+    }
+    sv->setFreqCounterValue(newValue);
+
+    if (newValue == std::numeric_limits<uint8_t>::max()) {
+        frequencyCounterSaturated();
+    }
+}
+
+uint64_t HashTable::getNumContendedLocks() const {
+    uint64_t result = 0;
+    for (const auto& lockState : lockStates) {
+        result += lockState.waitStats.contended;
+    }
+    return result;
+}
+
+std::chrono::nanoseconds HashTable::getLockWaitTime() const {
+    uint64_t result = 0;
+    for (const auto& lockState : lockStates) {
+        result += lockState.waitStats.waitTimeNs;
+    }
+    return std::chrono::nanoseconds(result);
+}
+
+uint64_t HashTable::getNumOptimisticReads() const {
+    uint64_t result = 0;
+    for (const auto& lockState : lockStates) {
+        result += lockState.optimisticReads;
+    }
+    return result;
+}
+
+uint64_t HashTable::getNumOptimisticReadFallbacks() const {
+    uint64_t result = 0;
+    for (const auto& lockState : lockStates) {
+        result += lockState.optimisticReadFallbacks;
+    }
+    return result;
+}
+
 std::ostream& operator<<(std::ostream& os, const HashTable& ht) {
     os << "HashTable[" << &ht << "] with"
        << " numItems:" << ht.getNumItems()
@@ -1343,11 +1684,13 @@ std::ostream& operator<<(std::ostream& os, const HashTable& ht) {
        << " numSystemItems:" << ht.getNumSystemItems()
        << " numPreparedSW:" << ht.getNumPreparedSyncWrites()
        << " values: " << std::endl;
-    for (const auto& chain : ht.values) {
-        if (chain) {
-            for (StoredValue* sv = chain.get().get(); sv != nullptr;
-                 sv = sv->getNext().get().get()) {
-                os << "    " << *sv << std::endl;
+    for (const auto* table : {&ht.values, &ht.resizeValues}) {
+        for (const auto& chain : *table) {
+            if (chain) {
+                for (StoredValue* sv = chain.get().get(); sv != nullptr;
+                     sv = sv->getNext().get().get()) {
+                    os << "    " << *sv << std::endl;
+                }
             }
         }
     }
@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include "lock_timer.h"
 #include "probabilistic_counter.h"
 #include "stored-value.h"
 #include "storeddockey.h"
@@ -25,7 +26,9 @@
 #include <platform/non_negative_counter.h>
 
 #include <array>
+#include <chrono>
 #include <functional>
+#include <thread>
 
 class AbstractStoredValueFactory;
 class HashTableVisitor;
@@ -140,10 +143,28 @@ enum class DeletionDurability : uint8_t {};
  * bucket; then chaining is used (StoredValue::chain_next_or_replacement) to
  * handle any collisions.
  *
- * The HashTable can be resized if it grows too full - this is done by
- * acquiring all the ht_locks, and then allocating a new vector of buckets and
- * re-hashing all elements into the new table. While resizing is occuring all
- * other access to the HashTable is blocked.
+ * Optionally (Layout::Tagged) each bucket additionally has a TagBlock - a
+ * single cache line holding a one-byte hash fragment ("tag") and a pointer for
+ * up to TagBlock::NumSlots of the StoredValues in that bucket's chain. Lookups
+ * first compare the tags within the TagBlock, and only dereference the
+ * StoredValues whose tag matches - avoiding a dependent cache miss for every
+ * hop along the chain. The chain remains the owner of the StoredValues (and
+ * is what visitors iterate), the TagBlock is purely an index into it; if a
+ * chain grows larger than NumSlots the TagBlock is marked as overflowed and
+ * lookups fall back to walking the chain.
+ *
+ * The HashTable can be resized if it grows too full. Resizing is incremental:
+ * a new vector of buckets is allocated alongside the existing one, and then
+ * the old buckets are migrated (re-hashed into the new table) a chunk at a
+ * time - see migrateChunk(). Each chunk acquires all the ht_locks, but only
+ * for the time taken to migrate that chunk; between chunks other access to
+ * the HashTable proceeds.
+ * While a resize is in progress the buckets of both tables form a single
+ * "virtual" bucket space - [0, size) are the old buckets and
+ * [size, size + resizeSize) are the new ones. A key maps to its old bucket
+ * if that bucket hasn't been migrated yet, otherwise to its new bucket; see
+ * getBucketForHash(). Each new bucket N is guarded by mutex N mod ht_locks,
+ * just like the old buckets.
  *
  * Support for holding both Committed and Pending items requires that we
  * can represent having for each key, either:
@@ -173,6 +194,24 @@ public:
     using AtomicDatatypeCombo = std::array<std::atomic<ssize_t>,
             mcbp::datatype::highest + 1>;
 
+    /**
+     * Physical layout of the hash buckets.
+     */
+    enum class Layout : uint8_t {
+        /// Each bucket is just the head of a chain of StoredValues.
+        Chained,
+        /// Each bucket has a cache-line sized TagBlock of hash fragments
+        /// which is probed before any StoredValue in the chain is accessed.
+        Tagged,
+    };
+
+    /**
+     * Convert the textual representation of a Layout (as used by the
+     * ht_layout configuration parameter) to a Layout.
+     * @throws std::invalid_argument if the string is not a known layout.
+     */
+    static Layout layoutFromString(const std::string& layout);
+
     /**
      * Represents a position within the hashtable.
      *
@@ -326,6 +365,68 @@ public:
         EPStats& epStats;
     };
 
+    /**
+     * Per-lock state which allows the buckets guarded by a lock to be read
+     * without acquiring it - see findForReadOptimistic().
+     *
+     * Every holder of the lock is treated as a writer, as callers may modify
+     * any StoredValue in the bucket while they hold it. On acquiring the lock
+     * a writer makes `version` odd and then waits for any optimistic readers
+     * already inside to leave. An optimistic reader registers in `readers`
+     * and then checks `version`, backing out (to take the lock instead) if it
+     * is odd. Readers therefore never observe a StoredValue which is being
+     * modified or freed, and never wait for each other.
+     */
+    struct alignas(64) BucketLockState {
+        /// Called by a writer after acquiring the lock.
+        void beginWrite() {
+            const auto v = version.load(std::memory_order_relaxed);
+            Expects(!(v & 1));
+            version.store(v + 1);
+            while (readers.load() != 0) {
+                std::this_thread::yield();
+            }
+        }
+
+        /// Called by a writer before releasing the lock.
+        void endWrite() {
+            const auto v = version.load(std::memory_order_relaxed);
+            if (v & 1) {
+                version.store(v + 1, std::memory_order_release);
+            }
+        }
+
+        /// @return true if the reader may proceed; false if a writer is active.
+        bool tryBeginRead() {
+            // Don't write to `readers` (and so steal its cache line from the
+            // writer waiting on it) if a writer is already known to be active.
+            if (version.load(std::memory_order_acquire) & 1) {
+                return false;
+            }
+            readers.fetch_add(1);
+            if (version.load() & 1) {
+                endRead();
+                return false;
+            }
+            return true;
+        }
+
+        void endRead() {
+            readers.fetch_sub(1, std::memory_order_release);
+        }
+
+        /// Odd while the lock is held.
+        std::atomic<uint64_t> version{0};
+        /// Number of optimistic readers currently inside.
+        std::atomic<uint32_t> readers{0};
+        /// Time spent waiting to acquire the lock.
+        LockWaitStats waitStats;
+        /// Number of successful optimistic reads.
+        cb::RelaxedAtomic<uint64_t> optimisticReads{0};
+        /// Number of optimistic reads which fell back to taking the lock.
+        cb::RelaxedAtomic<uint64_t> optimisticReadFallbacks{0};
+    };
+
     /**
      * Represents a locked hash bucket that provides RAII semantics for the lock
      *
@@ -337,12 +438,28 @@ public:
         HashBucketLock()
             : bucketNum(-1) {}
 
-        HashBucketLock(int bucketNum, std::mutex& mutex)
-            : bucketNum(bucketNum), htLock(mutex) {
+        /**
+         * Lock the given mutex. If the BucketLockState for the mutex is
+         * given, optimistic readers are excluded while locked and any wait
+         * to acquire the mutex is recorded.
+         */
+        HashBucketLock(int bucketNum,
+                       std::mutex& mutex,
+                       BucketLockState* lockState = nullptr)
+            : bucketNum(bucketNum),
+              lockState(lockState),
+              htLock(lockState ? lockAndRecordWait(mutex, lockState->waitStats)
+                               : std::unique_lock<std::mutex>(mutex)) {
+            if (lockState) {
+                lockState->beginWrite();
+            }
         }
 
         HashBucketLock(HashBucketLock&& other)
-            : bucketNum(other.bucketNum), htLock(std::move(other.htLock)) {
+            : bucketNum(other.bucketNum),
+              lockState(other.lockState),
+              htLock(std::move(other.htLock)) {
+            other.lockState = nullptr;
         }
 
         // Cannot copy HashBucketLock.
@@ -350,11 +467,18 @@ public:
         HashBucketLock& operator=(const HashBucketLock& other) = delete;
 
         HashBucketLock& operator=(HashBucketLock&& other) {
+            endWrite();
             bucketNum = other.bucketNum;
+            lockState = other.lockState;
+            other.lockState = nullptr;
             htLock = std::move(other.htLock);
             return *this;
         }
 
+        ~HashBucketLock() {
+            endWrite();
+        }
+
         int getBucketNum() const {
             return bucketNum;
         }
@@ -367,8 +491,25 @@ public:
             return htLock;
         }
 
+        /**
+         * Release the lock before this object is destroyed, re-admitting
+         * optimistic readers. Use this rather than getHTLock().unlock(),
+         * which would leave them excluded until the next holder.
+         */
+        void unlock() {
+            endWrite();
+            htLock.unlock();
+        }
+
     private:
+        void endWrite() {
+            if (lockState && htLock.owns_lock()) {
+                lockState->endWrite();
+            }
+        }
+
         int bucketNum;
+        BucketLockState* lockState = nullptr;
         std::unique_lock<std::mutex> htLock;
     };
 
@@ -379,22 +520,33 @@ public:
      * @param svFactory Factory to use for constructing stored values
      * @param initialSize the number of hash table buckets to initially create.
      * @param locks the number of locks in the hash table
+     * @param layout the physical layout of the hash buckets
      */
     HashTable(EPStats& st,
               std::unique_ptr<AbstractStoredValueFactory> svFactory,
               size_t initialSize,
-              size_t locks);
+              size_t locks,
+              Layout layout = Layout::Chained);
 
     ~HashTable();
 
     size_t memorySize() {
         return sizeof(HashTable)
-            + (size * sizeof(StoredValue*))
-            + (mutexes.size() * sizeof(std::mutex));
+            + ((size + resizeSize) * sizeof(StoredValue*))
+            + ((tagBlocks.size() + resizeTagBlocks.size()) * sizeof(TagBlock))
+            + (mutexes.size() * (sizeof(std::mutex) + sizeof(BucketLockState)));
     }
 
     /**
-     * Get the number of hash table buckets this hash table has.
+     * Get the physical layout of this hash table's buckets.
+     */
+    Layout getLayout() const {
+        return layout;
+    }
+
+    /**
+     * Get the number of hash table buckets this hash table has. While a
+     * resize is in progress this is the size being resized from.
      */
     size_t getSize() { return size; }
 
@@ -403,6 +555,29 @@ public:
      */
     size_t getNumLocks() { return mutexes.size(); }
 
+    /**
+     * Get the number of times acquiring one of this hash table's locks had to
+     * wait for another holder.
+     */
+    uint64_t getNumContendedLocks() const;
+
+    /**
+     * Get the total time spent waiting for this hash table's locks.
+     */
+    std::chrono::nanoseconds getLockWaitTime() const;
+
+    /**
+     * Get the number of findForReadOptimistic() calls which completed without
+     * acquiring a lock.
+     */
+    uint64_t getNumOptimisticReads() const;
+
+    /**
+     * Get the number of findForReadOptimistic() calls which required the
+     * caller to fall back to acquiring a lock.
+     */
+    uint64_t getNumOptimisticReadFallbacks() const;
+
     /**
      * Get the number of in-memory non-resident and resident items within
      * this hash table.
@@ -536,10 +711,38 @@ public:
     void resize();
 
     /**
-     * Resize to the specified size.
+     * Resize to the specified size. Buckets are migrated to the new table in
+     * chunks (see class comment), returning once the resize has completed.
+     * If a visitor is running the resize is abandoned part way; it will be
+     * continued by a later call to resize() or resizeIncremental().
      */
     void resize(size_t to);
 
+    /**
+     * Automatically resize to fit the current data, migrating buckets for up
+     * to the given duration. If the resize has not completed when the
+     * duration has elapsed it is left in progress (lookups, insertions and
+     * visitors handle both old and new tables), and continued by the next
+     * call.
+     *
+     * @param maxDuration how long to spend migrating buckets before returning.
+     * @return true if no resize is in progress on return.
+     */
+    bool resizeIncremental(std::chrono::steady_clock::duration maxDuration);
+
+    /**
+     * @return true if a resize has been started but not yet completed.
+     */
+    bool isResizing() const {
+        return resizeSize != 0;
+    }
+
+    /**
+     * Number of old buckets each (all-locks-held) chunk of an incremental
+     * resize migrates.
+     */
+    static constexpr size_t resizeChunkBuckets = 1024;
+
     /**
      * Result of the findForRead() method.
      */
@@ -581,6 +784,79 @@ public:
             WantsDeleted wantsDeleted = WantsDeleted::No,
             ForGetReplicaOp fetchRequestedForReplicaItem = ForGetReplicaOp::No);
 
+    /**
+     * Find an item with the specified key for read-only access, without
+     * acquiring the key's HashBucketLock unless another thread holds it.
+     *
+     * Selects the same StoredValue as findForRead() would, and passes it (or
+     * nullptr if not found) to `reader` while no other thread can modify the
+     * key's hash bucket. As the lock is not held, `reader` must only read
+     * the StoredValue, must not retain it after returning, and must not
+     * acquire any HashTable lock. `reader` returns false if it cannot handle
+     * the StoredValue without the lock (e.g. it needs to modify it), in which
+     * case the caller should use findForRead() instead.
+     *
+     * @param key The key of the item to find
+     * @param trackReference Should this lookup update referenced status (only
+     *        applied if `reader` returns true)
+     * @param wantsDeleted whether a deleted value needs to be returned
+     * @param fetchRequestedForReplicaItem as per findForRead()
+     * @param reader Callable of the form bool(const StoredValue*)
+     * @return true if `reader` was invoked and returned true; false if the
+     *         caller must fall back to findForRead().
+     */
+    template <class Reader>
+    bool findForReadOptimistic(const DocKey& key,
+                               TrackReference trackReference,
+                               WantsDeleted wantsDeleted,
+                               ForGetReplicaOp fetchRequestedForReplicaItem,
+                               Reader&& reader) {
+        if (!isActive()) {
+            throw std::logic_error(
+                    "HashTable::findForReadOptimistic: Cannot call on a "
+                    "non-active object");
+        }
+        const auto hash = key.hash();
+        int bucket;
+        auto* lockState = tryBeginOptimisticRead(hash, bucket);
+        if (!lockState) {
+            return false;
+        }
+
+        bool handled;
+        uint8_t freq = 0;
+        uint8_t newFreq = 0;
+        try {
+            const auto found = findInBucket(bucket, hash, key);
+            const auto* sv = selectForRead(found.first,
+                                           found.second,
+                                           wantsDeleted,
+                                           fetchRequestedForReplicaItem);
+            if (sv && sv == found.first && !sv->isDeleted() &&
+                trackReference == TrackReference::Yes) {
+                freq = sv->getFreqCounterValue();
+                newFreq = generateFreqValue(freq);
+            }
+            handled = reader(sv);
+        } catch (...) {
+            lockState->endRead();
+            throw;
+        }
+        lockState->endRead();
+
+        if (!handled) {
+            lockState->optimisticReadFallbacks++;
+            return false;
+        }
+        lockState->optimisticReads++;
+        if (newFreq != freq) {
+            // The probabilistic counter only rarely increments for hot keys,
+            // so take the lock just for the (uncommon) update.
+            applyFreqCounterUpdate(key, freq, newFreq);
+        }
+        return true;
+    }
+
     /**
      * Result of the findFor...() methods which return a non-const result.
      */
@@ -1220,9 +1496,31 @@ private:
     // The container for actually holding the StoredValues.
     using table_type = std::vector<StoredValue::UniquePtr>;
 
+    /**
+     * Cache-line sized index over the chain of a single hash bucket, used by
+     * Layout::Tagged.
+     *
+     * Holds a one-byte hash fragment and (non-owning) pointer for up to
+     * NumSlots StoredValues of the bucket's chain; empty slots have a null
+     * pointer. If the chain holds more StoredValues than fit then
+     * `overflowed` is set, and the chain must be walked to find a key.
+     * Guarded by the same mutex as the bucket it indexes.
+     */
+    struct alignas(64) TagBlock {
+        static constexpr size_t NumSlots = 7;
+
+        std::array<uint8_t, NumSlots> tags{};
+        bool overflowed = false;
+        std::array<StoredValue*, NumSlots> slots{};
+    };
+    static_assert(sizeof(TagBlock) == 64,
+                  "TagBlock should occupy exactly one cache line");
+
     friend class StoredValue;
     friend std::ostream& operator<<(std::ostream& os, const HashTable& ht);
 
+    class AllLocksHolder;
+
     inline bool isActive() const { return activeState; }
     inline void setActiveState(bool newv) { activeState = newv; }
 
@@ -1233,7 +1531,8 @@ private:
      * @return HashBucektLock which contains a lock and the hash bucket number
      */
     inline HashBucketLock getLockedBucket(int bucket) {
-        return HashBucketLock(bucket, mutexes[mutexForBucket(bucket)]);
+        const auto mutex = mutexForBucket(bucket);
+        return HashBucketLock(bucket, mutexes[mutex], &lockStates[mutex]);
     }
 
     /**
@@ -1251,13 +1550,72 @@ private:
                         "Cannot call on a non-active object");
             }
             int bucket = getBucketForHash(h);
-            HashBucketLock rv(bucket, mutexes[mutexForBucket(bucket)]);
-            if (bucket == getBucketForHash(h)) {
+            const auto mutex = mutexForBucket(bucket);
+            HashBucketLock rv(bucket, mutexes[mutex], &lockStates[mutex]);
+            // The bucket for a hash (and the mutex for a bucket) can change
+            // until we hold a mutex, if a resize chunk was migrating; check
+            // we locked the right one.
+            if (bucket == getBucketForHash(h) &&
+                mutex == mutexForBucket(bucket)) {
                 return rv;
             }
         }
     }
 
+    /**
+     * @return the head of the chain for the given (virtual) bucket - in the
+     *         old table or, if a resize is in progress, the new table.
+     */
+    StoredValue::UniquePtr& bucketHead(int bucket) {
+        if (static_cast<size_t>(bucket) < size) {
+            return values[bucket];
+        }
+        return resizeValues[bucket - size];
+    }
+
+    /// @return the total number of (virtual) buckets in old and new tables.
+    size_t getNumBuckets() const {
+        return size + resizeSize;
+    }
+
+    /// @return the first (virtual) bucket guarded by the given lock.
+    size_t firstBucketForLock(size_t lock) const {
+        return lock < size ? lock : size + lock;
+    }
+
+    /// @return the next (virtual) bucket guarded by the same lock as bucket.
+    size_t nextBucketForLock(size_t lock, size_t bucket) const {
+        const auto next = bucket + mutexes.size();
+        if (bucket < size && next >= size) {
+            // Move on to the new table (if resizing).
+            return size + lock;
+        }
+        return next;
+    }
+
+    /**
+     * @return the target size for an automatic resize given the current
+     *         number of items.
+     */
+    size_t getAutoResizeSize() const;
+
+    /**
+     * Start resizing to newSize - allocates the new table; does not migrate
+     * any buckets. Must be called with all mutexes held.
+     */
+    void beginResize_UNLOCKED(size_t newSize);
+
+    /**
+     * Migrate up to maxBuckets old buckets into the new table, and if all
+     * buckets have been migrated complete the resize by replacing the old
+     * table with the new one. Must be called with all mutexes held, and a
+     * resize in progress.
+     */
+    void migrateChunk_UNLOCKED(size_t maxBuckets);
+
+    /// Replace the old table with the new; all buckets must be migrated.
+    void completeResize_UNLOCKED();
+
     /**
      * Result of the findInner() method.
      */
@@ -1297,15 +1655,117 @@ private:
      */
     FindInnerResult findInner(const DocKey& key);
 
+    /**
+     * Search the given bucket for Committed and Pending items with the given
+     * key. Caller must hold the bucket's lock, or be an optimistic reader of
+     * it.
+     *
+     * @return pair of (Committed, Pending) StoredValues; nullptr if not found.
+     */
+    std::pair<StoredValue*, StoredValue*> findInBucket(int bucket,
+                                                       uint32_t hash,
+                                                       const DocKey& key);
+
+    /**
+     * @return which of the committed / pending StoredValues findForRead()
+     *         should return.
+     */
+    static const StoredValue* selectForRead(
+            StoredValue* committed,
+            StoredValue* pending,
+            WantsDeleted wantsDeleted,
+            ForGetReplicaOp fetchRequestedForReplicaItem);
+
+    /**
+     * Register as an optimistic reader of the lock guarding the bucket for
+     * the given hash.
+     *
+     * @param hash the key's hash
+     * @param[out] bucket the bucket for the hash
+     * @return the BucketLockState registered with (call endRead() when
+     *         done), or nullptr if a writer holds the lock.
+     */
+    BucketLockState* tryBeginOptimisticRead(uint32_t hash, int& bucket);
+
+    /**
+     * Set the frequency counter of the committed StoredValue with the given
+     * key to newValue, if it is still `expected`. Acquires the bucket lock.
+     */
+    void applyFreqCounterUpdate(const DocKey& key,
+                                uint8_t expected,
+                                uint8_t newValue);
+
+    /// @return the tag (hash fragment) stored in a TagBlock for the hash.
+    static uint8_t tagForHash(uint32_t h) {
+        // Bucket selection uses the hash modulo the table size; use the top
+        // bits of a multiplicative re-hash for the tag so all bits of the
+        // (weakly mixed) key hash contribute, and the two are largely
+        // independent.
+        return static_cast<uint8_t>((h * 0x9E3779B1U) >> 24);
+    }
+
+    /**
+     * Record in the bucket's TagBlock that the given StoredValue has been
+     * linked into the bucket's chain. No-op for Layout::Chained.
+     */
+    void tagInsert(int bucket, StoredValue& v);
+
+    /**
+     * Record in the bucket's TagBlock that the given StoredValue has been
+     * unlinked from the bucket's chain. No-op for Layout::Chained.
+     */
+    void tagRemove(int bucket, const StoredValue* v);
+
+    /**
+     * Record in the bucket's TagBlock that the StoredValue `from` has been
+     * replaced in the chain by `to` (same key). No-op for Layout::Chained.
+     */
+    void tagReplace(int bucket, const StoredValue* from, StoredValue* to);
+
+    /**
+     * Re-populate the bucket's TagBlock from the bucket's chain. No-op for
+     * Layout::Chained.
+     */
+    void tagRebuild(int bucket);
+
+    /**
+     * @return the number of StoredValues per bucket which auto-resize aims
+     * for. A TagBlock can index several StoredValues without touching them,
+     * so the Tagged layout runs at a higher load factor to keep its memory
+     * overhead per item in check.
+     */
+    size_t targetItemsPerBucket() const {
+        return layout == Layout::Tagged ? 3 : 1;
+    }
+
     // The initial (and minimum) size of the HashTable.
     const size_t initialSize;
 
+    // Physical layout of the buckets.
+    const Layout layout;
+
     // The size of the hash table (number of buckets) - i.e. number of elements
     // in `values`
     std::atomic<size_t> size;
     table_type values;
+    // Layout::Tagged only: one TagBlock per element in `values`; empty for
+    // Layout::Chained.
+    std::vector<TagBlock> tagBlocks;
+
+    // Incremental resize state; only modified while holding all mutexes.
+    // The size being resized to (number of elements in resizeValues), or
+    // zero if no resize is in progress.
+    std::atomic<size_t> resizeSize{0};
+    // The new table which buckets are being migrated into.
+    table_type resizeValues;
+    // Layout::Tagged only: TagBlocks for resizeValues.
+    std::vector<TagBlock> resizeTagBlocks;
+    // Old buckets [0, resizeCursor) have been migrated to resizeValues.
+    std::atomic<size_t> resizeCursor{0};
     // Mutable so that we can make dumpStoredValuesAsJson const
     mutable std::vector<std::mutex> mutexes;
+    // One per element of `mutexes`.
+    std::vector<BucketLockState> lockStates;
     EPStats&             stats;
     std::unique_ptr<AbstractStoredValueFactory> valFact;
     std::atomic<size_t>       visitors;
@@ -1334,7 +1794,14 @@ private:
     std::function<void()> frequencyCounterSaturated{[]() {}};
 
     int getBucketForHash(int h) {
-        return abs(h % static_cast<int>(size));
+        const int oldSize = static_cast<int>(size);
+        const int bucket = abs(h % oldSize);
+        const int newSize = static_cast<int>(resizeSize);
+        if (newSize == 0 || static_cast<size_t>(bucket) >= resizeCursor) {
+            return bucket;
+        }
+        // Old bucket already migrated; use the new table.
+        return oldSize + abs(h % newSize);
     }
 
     inline size_t mutexForBucket(size_t bucket_num) {
@@ -1342,9 +1809,22 @@ private:
             throw std::logic_error("HashTable::mutexForBucket: Cannot call on a "
                     "non-active object");
         }
+        const size_t oldSize = size;
+        if (bucket_num >= oldSize) {
+            // Bucket in the new table of an in-progress resize.
+            bucket_num -= oldSize;
+        }
         return bucket_num % mutexes.size();
     }
 
+    /// @return the TagBlock for the given (virtual) bucket.
+    TagBlock& tagBlockFor(int bucket) {
+        if (static_cast<size_t>(bucket) < size) {
+            return tagBlocks[bucket];
+        }
+        return resizeTagBlocks[bucket - size];
+    }
+
     std::unique_ptr<Item> getRandomKeyFromSlot(int slot);
 
     /** Searches for the first element in the specified hashChain which matches
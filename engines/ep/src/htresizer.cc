@@ -32,7 +32,9 @@ public:
     ResizingVisitor() { }
 
     void visitBucket(const VBucketPtr& vb) override {
-        vb->ht.resize();
+        // Migrate at most one chunk duration's worth of buckets per vBucket;
+        // any remaining buckets are migrated by subsequent runs of the task.
+        vb->ht.resizeIncremental(maxChunkDuration);
     }
 };
 
@@ -48,11 +50,11 @@ bool HashtableResizerTask::run() {
     TRACE_EVENT0("ep-engine/task", "HashtableResizerTask");
     auto pv = std::make_unique<ResizingVisitor>();
 
-    // [per-VBucket Task] While a Hashtable is resizing no user
-    // requests can be performed (the resizing process needs to
-    // acquire all HT locks). As such we are sensitive to the duration
-    // of this task - we want to log anything which has a
-    // non-negligible impact on frontend operations.
+    // [per-VBucket Task] While a chunk of a Hashtable resize is being
+    // migrated no user requests can be performed on that vBucket (migrating
+    // needs to acquire all HT locks). Chunks are short, but we are still
+    // sensitive to the duration of this task - we want to log anything which
+    // has a non-negligible impact on frontend operations.
     const auto maxExpectedDurationForVisitorTask =
             std::chrono::milliseconds(100);
 
@@ -249,7 +249,7 @@ std::ostream& operator<<(std::ostream& os, const Blob& b) {
     return os;
 }
 
-bool Item::compressValue(bool force) {
+bool Item::compressValue(bool force, float minCompressionRatio) {
     auto datatype = getDataType();
     if (!mcbp::datatype::is_snappy(datatype)) {
         // Attempt compression only if datatype indicates
@@ -257,9 +257,10 @@ bool Item::compressValue(bool force) {
         cb::compression::Buffer deflated;
         if (cb::compression::deflate(cb::compression::Algorithm::Snappy,
                                      {getData(), getNBytes()}, deflated)) {
-            if (deflated.size() > getNBytes() && !force) {
-                //No point doing the compression if the deflated length
-                //is greater than the original length
+            if (deflated.size() > getNBytes() * minCompressionRatio &&
+                !force) {
+                // No point doing the compression if the deflated length
+                // isn't sufficiently smaller than the original length
                 return true;
             }
             setData(deflated.data(), deflated.size());
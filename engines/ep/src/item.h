@@ -154,8 +154,10 @@ public:
     /* Snappy compress value and update datatype
      * @param force force compression regardless if it makes
      *              the value larger than the original
+     * @param minCompressionRatio (unless forced) keep the original value if
+     *              the compressed one is larger than this fraction of it
      */
-    bool compressValue(bool force = false);
+    bool compressValue(bool force = false, float minCompressionRatio = 1.0);
 
     /* Snappy uncompress value and update datatype */
     bool decompressValue();
@@ -1853,9 +1853,10 @@ std::string KVBucket::validateKey(const DocKey& key,
 
         if (diskItem.getFlags() != v->getFlags()) {
             return "flags_mismatch";
-        } else if (v->isResident() && memcmp(diskItem.getData(),
-                                             v->getValue()->getData(),
-                                             diskItem.getNBytes())) {
+        } else if (v->isResident() &&
+                   memcmp(diskItem.getData(),
+                          v->getValueView().data(),
+                          diskItem.getNBytes())) {
             return "data_mismatch";
         } else {
             return "valid";
@@ -168,6 +168,8 @@ void KVStoreStats::reset() {
     batchSize.reset();
     snapshotHisto.reset();
 
+    getMultiHisto.reset();
+    getMultiPrefetchCount.reset();
     getMultiFsReadCount.reset();
     getMultiFsReadHisto.reset();
     getMultiFsReadPerDocHisto.reset();
@@ -396,6 +398,11 @@ void KVStore::addStats(const AddStatFn& add_stat,
                       st.io_bgfetch_doc_bytes,
                       add_stat,
                       c);
+    add_prefixed_stat(prefix,
+                      "io_bg_fetch_prefetch_count",
+                      st.getMultiPrefetchCount,
+                      add_stat,
+                      c);
     add_prefixed_stat(prefix,
                       "io_document_write_bytes",
                       st.io_document_write_bytes,
@@ -463,6 +470,7 @@ void KVStore::addTimingStats(const AddStatFn& add_stat, const void* c) {
     add_prefixed_stat(prefix, "writeSize", st.writeSizeHisto, add_stat, c);
     add_prefixed_stat(prefix, "saveDocCount", st.batchSize, add_stat, c);
 
+    add_prefixed_stat(prefix, "getMulti", st.getMultiHisto, add_stat, c);
     add_prefixed_stat(
             prefix, "getMultiFsReadCount", st.getMultiFsReadHisto, add_stat, c);
     add_prefixed_stat(prefix,
@@ -427,6 +427,13 @@ public:
     cb::RelaxedAtomic<size_t> getMultiFsReadCount;
     Hdr1sfInt32Histogram getMultiFsReadHisto;
 
+    // Time spent in each getMulti() request (batch of bg-fetches)
+    Hdr1sfMicroSecHistogram getMultiHisto;
+
+    // Number of (coalesced) document reads hinted to the OS ahead of
+    // getMulti() reading them
+    cb::RelaxedAtomic<size_t> getMultiPrefetchCount;
+
     // Histogram of filesystem read()s per getMulti() request, divided by
     // the number of documents fetched; gives an average read() count
     // per fetched document.
@@ -453,6 +460,7 @@ public:
                delTimeHisto.getMemFootPrint() + compactHisto.getMemFootPrint() +
                snapshotHisto.getMemFootPrint() + commitHisto.getMemFootPrint() +
                saveDocsHisto.getMemFootPrint() + batchSize.getMemFootPrint() +
+               getMultiHisto.getMemFootPrint() +
                getMultiFsReadHisto.getMemFootPrint() +
                getMultiFsReadPerDocHisto.getMemFootPrint() +
                fsStats.getMemFootPrint() + fsStatsCompaction.getMemFootPrint() +
@@ -659,6 +667,31 @@ public:
      */
     virtual bool commit(VB::Commit& commitData) = 0;
 
+    /**
+     * Begin a group commit: until completeSyncGroup(), the commits made by
+     * the calling thread are written but not made durable, and their
+     * completion callbacks are deferred. The whole group is then made
+     * durable together.
+     *
+     * @return false if group commit is not supported (or not enabled), in
+     *         which case each commit is durable when it returns.
+     */
+    virtual bool beginSyncGroup() {
+        return false;
+    }
+
+    /**
+     * Make the commits since beginSyncGroup() durable, then invoke their
+     * deferred completion callbacks (in commit order).
+     *
+     * @return true if successful; false if the group could not be made
+     *         durable - none of its commits may then be relied upon, and
+     *         their callbacks are invoked as failed.
+     */
+    virtual bool completeSyncGroup() {
+        return true;
+    }
+
     /**
      * Rollback the current transaction.
      */
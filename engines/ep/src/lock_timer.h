@@ -18,7 +18,44 @@
 #pragma once
 
 #include "bucket_logger.h"
+#include <relaxed_atomic.h>
 #include <chrono>
+#include <mutex>
+
+/**
+ * Cumulative statistics on time spent waiting to acquire a lock.
+ *
+ * Only contended acquisitions are counted and timed (see
+ * lockAndRecordWait()), so an uncontended lock costs no clock reads.
+ */
+struct LockWaitStats {
+    /// Number of acquisitions which had to wait for another holder.
+    cb::RelaxedAtomic<uint64_t> contended{0};
+    /// Total time spent waiting by those acquisitions.
+    cb::RelaxedAtomic<uint64_t> waitTimeNs{0};
+
+    void recordWait(std::chrono::steady_clock::duration waited) {
+        contended++;
+        waitTimeNs.fetch_add(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(waited)
+                        .count());
+    }
+};
+
+/**
+ * Acquire the given mutex, recording into `stats` how long we waited if it
+ * was already held.
+ */
+template <typename Mutex>
+std::unique_lock<Mutex> lockAndRecordWait(Mutex& m, LockWaitStats& stats) {
+    std::unique_lock<Mutex> lock(m, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        const auto start = std::chrono::steady_clock::now();
+        lock.lock();
+        stats.recordWait(std::chrono::steady_clock::now() - start);
+    }
+    return lock;
+}
 
 /**
  * Lock holder wrapper to assist to debugging locking issues - Logs when the
@@ -43,6 +80,9 @@
  *
  *   LockTimer<LockHolder> lh(mutex, "my_func_lockholder")
  *
+ * Optionally a LockWaitStats can be given, into which the time taken to
+ * acquire the lock is also accumulated (if it had to wait).
+ *
  */
 template <typename T, size_t ACQUIRE_MS = 100, size_t HELD_MS = 100>
 class LockTimer {
@@ -52,10 +92,18 @@ public:
      *  the log file.
      *  @param m underlying mutex to acquire
      *  @param name_ A name for this mutex, used in log messages.
+     *  @param waitStats If non-null, record contended acquire time here.
      */
-    LockTimer(typename T::mutex_type& m, const char* name_)
+    LockTimer(typename T::mutex_type& m,
+              const char* name_,
+              LockWaitStats* waitStats = nullptr)
         : name(name_), start(std::chrono::steady_clock::now()), lock_holder(m) {
         acquired = std::chrono::steady_clock::now();
+        // LockTimer cannot tell if the lock was contended; treat anything
+        // slower than an uncontended acquire as having waited.
+        if (waitStats && acquired - start > std::chrono::microseconds(1)) {
+            waitStats->recordWait(acquired - start);
+        }
         const uint64_t msec =
                 std::chrono::duration_cast<std::chrono::milliseconds>(acquired -
                                                                       start)
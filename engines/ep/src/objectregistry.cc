@@ -19,6 +19,7 @@
 
 #include "ep_engine.h"
 #include "item.h"
+#include "slab_allocator.h"
 #include "stored-value.h"
 #include "threadlocal.h"
 #include <platform/cb_arena_malloc.h>
@@ -84,13 +85,21 @@ void ObjectRegistry::onDeleteBlob(const Blob *blob)
    }
 }
 
+/// @return the number of bytes allocated for the given StoredValue.
+static size_t getStoredValueAllocationSize(const StoredValue* sv) {
+    if (sv->isSlabAllocated()) {
+        return SlabAllocator::getChunkSize(sv->getObjectSize());
+    }
+    return cb::ArenaMalloc::malloc_usable_size(sv);
+}
+
 void ObjectRegistry::onCreateStoredValue(const StoredValue *sv)
 {
    EventuallyPersistentEngine *engine = th->get();
    if (verifyEngine(engine)) {
        auto& coreLocalStats = engine->getEpStats().coreLocal.get();
 
-       size_t size = cb::ArenaMalloc::malloc_usable_size(sv);
+       size_t size = getStoredValueAllocationSize(sv);
        coreLocalStats->numStoredVal++;
        coreLocalStats->totalStoredValSize.fetch_add(size);
    }
@@ -102,7 +111,7 @@ void ObjectRegistry::onDeleteStoredValue(const StoredValue *sv)
    if (verifyEngine(engine)) {
        auto& coreLocalStats = engine->getEpStats().coreLocal.get();
 
-       size_t size = cb::ArenaMalloc::malloc_usable_size(sv);
+       size_t size = getStoredValueAllocationSize(sv);
        coreLocalStats->totalStoredValSize.fetch_sub(size);
        coreLocalStats->numStoredVal--;
    }
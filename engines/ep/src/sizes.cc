@@ -69,6 +69,18 @@ int main(int, char **) {
     display("StoredValue with 15 byte key",
             StoredValue::getRequiredStorage(
                     DocKey("1234567890abcde", DocKeyEncodesCollectionId::No)));
+    {
+        // Per-item memory for a 15 byte key with an 8 byte value; either
+        // with the value in a separate Blob or stored inline.
+        const DocKey key("1234567890abcde", DocKeyEncodesCollectionId::No);
+        const size_t valueLen = 8;
+        const value_t blob(Blob::New(valueLen));
+        display("StoredValue with 15 byte key + 8 byte Blob value",
+                StoredValue::getRequiredStorage(key) + blob->getSize());
+        display("StoredValue with 15 byte key + 8 byte inline value",
+                StoredValue::getRequiredStorage(
+                        key, StoredValue::getInlineValueCapacity(valueLen)));
+    }
     display("Ordered Stored Value", sizeof(OrderedStoredValue));
     display("Blob", sizeof(Blob));
     display("value_t", sizeof(value_t));
@@ -0,0 +1,207 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "slab_allocator.h"
+
+#include <new>
+#include <stdexcept>
+#include <string>
+
+/**
+ * Header of each slab, located at the start of the (slabSize aligned) slab
+ * memory. Chunks follow the header.
+ */
+struct SlabAllocator::Slab {
+    Slab(std::shared_ptr<SizeClasses> owner,
+         SizeClass& sizeClass,
+         uint32_t capacity)
+        : owner(std::move(owner)), sizeClass(sizeClass), capacity(capacity) {
+    }
+
+    /// Space reserved for the header; a cache line (and a multiple of
+    /// chunkAlignment).
+    static constexpr size_t headerSize = 64;
+
+    char* chunks() {
+        return reinterpret_cast<char*>(this) + headerSize;
+    }
+
+    /// Keeps the size classes alive while this slab exists.
+    std::shared_ptr<SizeClasses> owner;
+    SizeClass& sizeClass;
+    /// Singly-linked list of free chunks (link stored in the chunk itself).
+    void* freeList = nullptr;
+    /// Number of chunks in this slab.
+    const uint32_t capacity;
+    /// Number of chunks currently allocated.
+    uint32_t used = 0;
+    /// Number of chunks ever handed out from the (initially unused) tail.
+    uint32_t bumped = 0;
+};
+
+SlabAllocator::SlabAllocator(size_t maxChunkSize)
+    : maxChunkSize(getChunkSize(maxChunkSize)),
+      sizeClasses(std::make_shared<SizeClasses>(this->maxChunkSize /
+                                                chunkAlignment)) {
+    static_assert(sizeof(Slab) <= Slab::headerSize,
+                  "Slab header does not fit in headerSize");
+    static_assert(Slab::headerSize % chunkAlignment == 0,
+                  "Slab headerSize must preserve chunk alignment");
+    if (this->maxChunkSize == 0 ||
+        this->maxChunkSize > (slabSize - Slab::headerSize) / 2) {
+        throw std::invalid_argument(
+                "SlabAllocator: invalid maxChunkSize:" +
+                std::to_string(maxChunkSize));
+    }
+    for (size_t ii = 0; ii < sizeClasses->size(); ++ii) {
+        (*sizeClasses)[ii].chunkSize = (ii + 1) * chunkAlignment;
+    }
+}
+
+SlabAllocator::~SlabAllocator() {
+    for (auto& sizeClass : *sizeClasses) {
+        std::lock_guard<std::mutex> guard(sizeClass.mutex);
+        sizeClass.orphaned = true;
+        // Free the empty slabs. Any others still hold live chunks (and a
+        // reference to sizeClasses); they are freed by deallocate() once
+        // empty. We still hold a reference, so dropping each slab's one
+        // under the mutex is safe.
+        for (auto it = sizeClass.partial.begin();
+             it != sizeClass.partial.end();) {
+            auto* slab = *it;
+            if (slab->used == 0) {
+                it = sizeClass.partial.erase(it);
+                freeSlab(sizeClass, slab);
+            } else {
+                ++it;
+            }
+        }
+    }
+}
+
+void* SlabAllocator::allocate(size_t size) {
+    if (size == 0 || size > maxChunkSize) {
+        return nullptr;
+    }
+    auto& sizeClass = getSizeClass(size);
+    std::lock_guard<std::mutex> guard(sizeClass.mutex);
+
+    Slab* slab;
+    if (sizeClass.partial.empty()) {
+        slab = allocateSlab(sizeClass);
+        sizeClass.partial.insert(slab);
+    } else {
+        // Lowest address first, to pack objects into as few slabs as
+        // possible.
+        slab = *sizeClass.partial.begin();
+    }
+
+    void* chunk;
+    if (slab->freeList) {
+        chunk = slab->freeList;
+        slab->freeList = *static_cast<void**>(chunk);
+    } else {
+        chunk = slab->chunks() + size_t(slab->bumped) * sizeClass.chunkSize;
+        slab->bumped++;
+    }
+
+    if (++slab->used == slab->capacity) {
+        sizeClass.partial.erase(slab);
+    }
+    sizeClass.usedChunks++;
+    return chunk;
+}
+
+void SlabAllocator::deallocate(void* ptr) {
+    auto* slab = getSlab(ptr);
+    auto& sizeClass = slab->sizeClass;
+    // Released after the mutex, as it may be the last reference to the size
+    // classes (if the allocator has been destroyed).
+    std::shared_ptr<SizeClasses> owner;
+    std::lock_guard<std::mutex> guard(sizeClass.mutex);
+
+    *static_cast<void**>(ptr) = slab->freeList;
+    slab->freeList = ptr;
+    if (slab->used-- == slab->capacity) {
+        sizeClass.partial.insert(slab);
+    }
+    sizeClass.usedChunks--;
+
+    // Return empty slabs to the global allocator, keeping one around to
+    // avoid thrashing when a size class hovers around a slab boundary
+    // (unless the allocator has gone, in which case nothing will reuse it).
+    if (slab->used == 0 &&
+        (sizeClass.orphaned || sizeClass.partial.size() > 1)) {
+        sizeClass.partial.erase(slab);
+        owner = freeSlab(sizeClass, slab);
+    }
+}
+
+bool SlabAllocator::isFragmented(const void* ptr) {
+    auto* slab = getSlab(ptr);
+    auto& sizeClass = slab->sizeClass;
+    std::lock_guard<std::mutex> guard(sizeClass.mutex);
+    if (sizeClass.partial.empty() || slab == *sizeClass.partial.begin()) {
+        // Relocating would just allocate from this slab again.
+        return false;
+    }
+    return slab->used * 2 < slab->capacity;
+}
+
+size_t SlabAllocator::getNumSlabs() const {
+    size_t slabs = 0;
+    for (const auto& sizeClass : *sizeClasses) {
+        std::lock_guard<std::mutex> guard(sizeClass.mutex);
+        slabs += sizeClass.numSlabs;
+    }
+    return slabs;
+}
+
+size_t SlabAllocator::getUsedBytes() const {
+    size_t used = 0;
+    for (const auto& sizeClass : *sizeClasses) {
+        std::lock_guard<std::mutex> guard(sizeClass.mutex);
+        used += sizeClass.usedChunks * sizeClass.chunkSize;
+    }
+    return used;
+}
+
+SlabAllocator::SizeClass& SlabAllocator::getSizeClass(size_t size) {
+    return (*sizeClasses)[getChunkSize(size) / chunkAlignment - 1];
+}
+
+SlabAllocator::Slab* SlabAllocator::allocateSlab(SizeClass& sizeClass) {
+    void* memory = ::operator new(slabSize, std::align_val_t(slabSize));
+    const auto capacity = static_cast<uint32_t>(
+            (slabSize - Slab::headerSize) / sizeClass.chunkSize);
+    sizeClass.numSlabs++;
+    return new (memory) Slab(sizeClasses, sizeClass, capacity);
+}
+
+std::shared_ptr<SlabAllocator::SizeClasses> SlabAllocator::freeSlab(
+        SizeClass& sizeClass, Slab* slab) {
+    auto owner = std::move(slab->owner);
+    slab->~Slab();
+    ::operator delete(slab, std::align_val_t(slabSize));
+    sizeClass.numSlabs--;
+    return owner;
+}
+
+SlabAllocator::Slab* SlabAllocator::getSlab(const void* ptr) {
+    return reinterpret_cast<Slab*>(reinterpret_cast<uintptr_t>(ptr) &
+                                   ~(uintptr_t(slabSize) - 1));
+}
@@ -0,0 +1,149 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+/**
+ * Size-classed slab allocator for small, fixed-lifetime objects (currently
+ * StoredValues).
+ *
+ * Memory is obtained from the global allocator in slabs of slabSize bytes
+ * (aligned to slabSize, so the owning slab of any chunk can be found by
+ * masking the chunk address). Each slab is carved into equal sized chunks of
+ * one size class; size classes are multiples of chunkAlignment up to the
+ * configured maximum.
+ *
+ * Allocation always uses the lowest-addressed slab of the size class which
+ * has a free chunk. This naturally packs live objects into the low slabs;
+ * objects which live in a sparsely-used slab can be relocated (see
+ * isFragmented()) which empties that slab, at which point it is returned to
+ * the global allocator. This replaces visiting and reallocating every object
+ * to reduce fragmentation.
+ *
+ * As slabs are allocated via the global allocator, memory tracking
+ * (mem_used) remains exact - it accounts for whole slabs, including any
+ * currently unused chunks.
+ *
+ * Chunks may outlive the SlabAllocator (e.g. a StoredValue released from a
+ * HashTable which is then destroyed): each slab holds a reference to the
+ * allocator's size classes, so deallocate() remains valid and the remaining
+ * slabs are freed as they become empty.
+ *
+ * Thread-safe; each size class is guarded by its own mutex.
+ */
+class SlabAllocator {
+public:
+    /// Size (and alignment) of each slab.
+    static constexpr size_t slabSize = 64 * 1024;
+
+    /// Chunk sizes are rounded up to a multiple of this.
+    static constexpr size_t chunkAlignment = 16;
+
+    /**
+     * @param maxChunkSize Largest allocation which will be served from
+     *        slabs; larger requests return nullptr.
+     */
+    explicit SlabAllocator(size_t maxChunkSize = 512);
+
+    /// Frees all empty slabs; slabs with live chunks are freed when their
+    /// last chunk is deallocated.
+    ~SlabAllocator();
+
+    SlabAllocator(const SlabAllocator&) = delete;
+    SlabAllocator& operator=(const SlabAllocator&) = delete;
+
+    /**
+     * Allocate a chunk of at least size bytes.
+     * @return pointer to the chunk, or nullptr if size is larger than
+     *         the maximum chunk size (caller should fall back to the global
+     *         allocator).
+     */
+    void* allocate(size_t size);
+
+    /**
+     * Return a chunk previously returned by allocate() to the allocator which
+     * owns it.
+     */
+    static void deallocate(void* ptr);
+
+    /// @return the size of chunk which would be used for an allocation of
+    ///         size bytes.
+    static size_t getChunkSize(size_t size) {
+        return (size + chunkAlignment - 1) & ~(chunkAlignment - 1);
+    }
+
+    /**
+     * @return true if the given chunk lives in a sparsely used slab which is
+     *         not the current allocation target for its size class - i.e.
+     *         relocating the object (allocating a new chunk, copying and
+     *         freeing this one) would help to empty the slab.
+     */
+    static bool isFragmented(const void* ptr);
+
+    size_t getMaxChunkSize() const {
+        return maxChunkSize;
+    }
+
+    /// @return the number of slabs currently allocated.
+    size_t getNumSlabs() const;
+
+    /// @return the total bytes of chunks currently allocated.
+    size_t getUsedBytes() const;
+
+private:
+    struct Slab;
+
+    struct SizeClass {
+        size_t chunkSize = 0;
+        mutable std::mutex mutex;
+        /// Slabs with at least one free chunk, ordered by address.
+        std::set<Slab*> partial;
+        size_t numSlabs = 0;
+        size_t usedChunks = 0;
+        /// Set once the SlabAllocator has been destroyed; empty slabs are
+        /// then freed immediately.
+        bool orphaned = false;
+    };
+
+    using SizeClasses = std::vector<SizeClass>;
+
+    SizeClass& getSizeClass(size_t size);
+
+    Slab* allocateSlab(SizeClass& sizeClass);
+
+    /**
+     * Free the given (empty) slab.
+     * @return the slab's reference to the size classes; to be released
+     *         after sizeClass.mutex, as it may be the last one.
+     */
+    static std::shared_ptr<SizeClasses> freeSlab(SizeClass& sizeClass,
+                                                 Slab* slab);
+
+    static Slab* getSlab(const void* ptr);
+
+    const size_t maxChunkSize;
+    /// Shared with every slab, so outlives this object while any chunk is
+    /// allocated.
+    const std::shared_ptr<SizeClasses> sizeClasses;
+};
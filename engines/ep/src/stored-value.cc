@@ -20,12 +20,15 @@
 #include "ep_time.h"
 #include "item.h"
 #include "objectregistry.h"
+#include "slab_allocator.h"
 #include "stats.h"
 
 #include <nlohmann/json.hpp>
 #include <platform/cb_malloc.h>
 #include <platform/compress.h>
+#include <gsl/gsl>
 
+#include <cstring>
 #include <sstream>
 
 const int64_t StoredValue::state_pending_seqno = -2;
@@ -36,7 +39,9 @@ const int64_t StoredValue::state_temp_init = -5;
 StoredValue::StoredValue(const Item& itm,
                          UniquePtr n,
                          EPStats& stats,
-                         bool isOrdered)
+                         bool isOrdered,
+                         size_t inlineCapacity,
+                         bool slabAllocated)
     : value(itm.getValue()),
       chain_next_or_replacement(std::move(n)),
       cas(itm.getCas()),
@@ -55,12 +60,22 @@ StoredValue::StoredValue(const Item& itm,
     setStale(false);
     setCommitted(itm.getCommitted());
     setAge(0);
+    bits.set(inlineStorageIndex, inlineCapacity != 0);
+    setValueInline(false);
+    bits.set(slabAllocatedIndex, slabAllocated);
     // dirty initialised below
 
     // Placement-new the key which lives in memory directly after this
     // object.
     new (key()) SerialisedDocKey(itm.getKey());
 
+    if (hasInlineStorage()) {
+        auto* header = getInlineValueHeader();
+        header->capacity = gsl::narrow_cast<uint8_t>(inlineCapacity);
+        header->length = 0;
+        assignValue(itm.getValue());
+    }
+
     if (isTempInitialItem()) {
         markClean();
     } else {
@@ -82,7 +97,10 @@ StoredValue::~StoredValue() {
     ObjectRegistry::onDeleteStoredValue(this);
 }
 
-StoredValue::StoredValue(const StoredValue& other, UniquePtr n, EPStats& stats)
+StoredValue::StoredValue(const StoredValue& other,
+                         UniquePtr n,
+                         EPStats& stats,
+                         bool slabAllocated)
     : value(other.value), // Implicitly also copies the frequency counter
       chain_next_or_replacement(std::move(n)),
       cas(other.cas),
@@ -100,11 +118,22 @@ StoredValue::StoredValue(const StoredValue& other, UniquePtr n, EPStats& stats)
     setStale(false);
     setCommitted(other.getCommitted());
     setAge(0);
+    bits.set(inlineStorageIndex, other.hasInlineStorage());
+    setValueInline(other.isValueInline());
+    bits.set(slabAllocatedIndex, slabAllocated);
     // Placement-new the key which lives in memory directly after this
     // object.
     StoredDocKey sKey(other.getKey());
     new (key()) SerialisedDocKey(sKey);
 
+    if (hasInlineStorage()) {
+        // Copy the inline header and any value (the storage for which was
+        // allocated as part of other.getObjectSize()).
+        std::memcpy(getInlineValueHeader(),
+                    other.getInlineValueHeader(),
+                    other.getInlineStorageSize());
+    }
+
     if (isDeleted()) {
         setDeletionSource(other.getDeletionSource());
     }
@@ -139,7 +168,7 @@ void StoredValue::restoreValue(const Item& itm) {
     auto freq = itm.getFreqCounterValue();
     auto age = getAge();
 
-    value = itm.getValue();
+    assignValue(itm.getValue());
 
     setFreqCounterValue(freq);
     setCommitted(itm.getCommitted());
@@ -163,6 +192,10 @@ void StoredValue::restoreMeta(const Item& itm) {
 }
 
 size_t StoredValue::uncompressedValuelen() const {
+    if (isValueInline()) {
+        // Inline values are never compressed.
+        return valuelen();
+    }
     if (!value) {
         return 0;
     }
@@ -186,6 +219,60 @@ size_t StoredValue::getRequiredStorage(const DocKey& key) {
     return sizeof(StoredValue) + SerialisedDocKey::getObjectSize(key.size());
 }
 
+size_t StoredValue::getRequiredStorage(const DocKey& key,
+                                       size_t inlineCapacity) {
+    if (inlineCapacity == 0) {
+        return getRequiredStorage(key);
+    }
+    return getRequiredStorage(key) + sizeof(InlineValueHeader) +
+           inlineCapacity;
+}
+
+size_t StoredValue::getInlineValueCapacity(size_t valueLen) {
+    const size_t alignment = 8;
+    const size_t total = sizeof(InlineValueHeader) + valueLen;
+    const size_t rounded = (total + alignment - 1) & ~(alignment - 1);
+    return std::min(rounded - sizeof(InlineValueHeader), maxInlineValueSize);
+}
+
+std::string_view StoredValue::getValueView() const {
+    if (isValueInline()) {
+        const auto* header = getInlineValueHeader();
+        return {reinterpret_cast<const char*>(header + 1), header->length};
+    }
+    if (value) {
+        return {value->getData(), value->valueSize()};
+    }
+    return {};
+}
+
+value_t StoredValue::shareValue() const {
+    if (isValueInline()) {
+        const auto view = getValueView();
+        return value_t(Blob::New(view.data(), view.size()));
+    }
+    return value;
+}
+
+void StoredValue::assignValue(const value_t& newValue) {
+    if (hasInlineStorage() && newValue &&
+        !mcbp::datatype::is_snappy(datatype)) {
+        auto* header = getInlineValueHeader();
+        const auto len = newValue->valueSize();
+        if (len <= header->capacity) {
+            std::memcpy(header + 1, newValue->getData(), len);
+            header->length = gsl::narrow_cast<uint8_t>(len);
+            // Drop any previous Blob, maintaining the tag.
+            auto tag = getValueTag();
+            value.reset();
+            setValueTag(tag);
+            setValueInline(true);
+            return;
+        }
+    }
+    replaceValue(newValue);
+}
+
 std::unique_ptr<Item> StoredValue::toItem(
         Vbid vbid,
         HideLockedCas hideLockedCas,
@@ -237,6 +324,10 @@ std::unique_ptr<Item> StoredValue::toItemAbort(Vbid vbid) const {
 }
 
 void StoredValue::reallocate() {
+    if (!value) {
+        // Nothing to reallocate (no value, or the value is inline).
+        return;
+    }
     // Allocate a new Blob for this stored value; copy the existing Blob to
     // the new one and free the old.
     replaceValue(std::unique_ptr<Blob>{Blob::Copy(*value)});
@@ -245,6 +336,9 @@ void StoredValue::reallocate() {
 void StoredValue::Deleter::operator()(StoredValue* val) {
     if (val->isOrdered()) {
         delete static_cast<OrderedStoredValue*>(val);
+    } else if (val->isSlabAllocated()) {
+        val->~StoredValue();
+        SlabAllocator::deallocate(val);
     } else {
         delete val;
     }
@@ -290,7 +384,7 @@ bool StoredValue::operator!=(const StoredValue& other) const {
 }
 
 bool StoredValue::deleteImpl(DeleteSource delSource) {
-    if (isDeleted() && !getValue()) {
+    if (isDeleted() && !hasValue()) {
         // SV is already marked as deleted and has no value - no further
         // deletion possible.
         return false;
@@ -314,7 +408,7 @@ std::unique_ptr<Item> StoredValue::toItemBase(Vbid vbid,
             getKey(),
             getFlags(),
             getExptime(),
-            includeValue == IncludeValue::Yes ? value : value_t{},
+            includeValue == IncludeValue::Yes ? shareValue() : value_t{},
             datatype,
             hideLockedCas == HideLockedCas::Yes ? static_cast<uint64_t>(-1)
                                                 : getCas(),
@@ -355,12 +449,16 @@ void StoredValue::setValueImpl(const Item& itm) {
         setResident(false);
     } else {
         setResident(true);
-        replaceValue(itm.getValue().get());
+        assignValue(itm.getValue());
     }
     setCommitted(itm.getCommitted());
 }
 
 bool StoredValue::compressValue() {
+    if (isValueInline()) {
+        // Inline values are small enough that compression is not worthwhile.
+        return true;
+    }
     if (!mcbp::datatype::is_snappy(datatype)) {
         // Attempt compression only if datatype indicates
         // that the value is not compressed already
@@ -409,9 +507,10 @@ std::optional<item_info> StoredValue::getItemInfo(uint64_t vbuuid) const {
     info.datatype = datatype;
     info.document_state =
             isDeleted() ? DocumentState::Deleted : DocumentState::Alive;
-    if (getValue()) {
-        info.value[0].iov_base = const_cast<char*>(getValue()->getData());
-        info.value[0].iov_len = getValue()->valueSize();
+    if (hasValue()) {
+        const auto view = getValueView();
+        info.value[0].iov_base = const_cast<char*>(view.data());
+        info.value[0].iov_len = view.size();
     }
     info.key = getKey();
     return info;
@@ -539,15 +638,19 @@ std::ostream& operator<<(std::ostream& os, const StoredValue& sv) {
     os << " fc:" << uint32_t(sv.getFreqCounterValue());
 
     os << " vallen:" << sv.valuelen();
-    if (sv.getValue().get()) {
-        os << " val age:" << uint32_t(sv.getValue()->getAge()) << " :\"";
-        const char* data = sv.getValue()->getData();
+    if (sv.hasValue()) {
+        if (sv.isValueInline()) {
+            os << " val inline :\"";
+        } else {
+            os << " val age:" << uint32_t(sv.getValue()->getAge()) << " :\"";
+        }
+        const auto value = sv.getValueView();
         // print up to first 40 bytes of value.
-        const size_t limit = std::min(size_t(40), sv.getValue()->valueSize());
+        const size_t limit = std::min(size_t(40), value.size());
         for (size_t ii = 0; ii < limit; ii++) {
-            os << data[ii];
+            os << value[ii];
         }
-        if (limit < sv.getValue()->valueSize()) {
+        if (limit < value.size()) {
             os << " <cut>";
         }
         os << "\"";
@@ -80,8 +80,28 @@ class OrderedStoredValue;
  *               + - - - - - - - - - +
  *  variable {   | key[]             |
  *   length  {   | ...               |
+ *               + - - - - - - - - - +
+ *  optional {   | inline capacity   |
+ *    inline {   | inline length     |
+ *     value {   | inline value[]    |
  *               +-------------------+
  *
+ * Inline values
+ * =============
+ *
+ * For small documents the Blob allocation (and its refcount / size header)
+ * can cost as much as the value itself. If the StoredValueFactory is
+ * configured with a non-zero inline value threshold, values no larger than
+ * the threshold are copied into a small region allocated directly after the
+ * key instead, and `value` is left null (only its tag is used). The capacity
+ * of that region is fixed when the StoredValue is created; a later update
+ * which no longer fits reverts to a normal Blob (the inline storage is then
+ * unused until the StoredValue is reallocated).
+ * Code which needs the value bytes irrespective of where they live should use
+ * getValueView() / shareValue() / hasValue() rather than getValue().
+ * Only plain StoredValue supports inline values - OrderedStoredValue always
+ * uses a Blob.
+ *
  * OrderedStoredValue
  * ==================
  *
@@ -225,7 +245,8 @@ public:
      *                  value exists but has zero length
      */
     bool isCompressible() {
-        if (mcbp::datatype::is_snappy(datatype) || !valuelen()) {
+        if (isValueInline() || mcbp::datatype::is_snappy(datatype) ||
+            !valuelen()) {
             return false;
         }
         return value->isCompressible();
@@ -238,7 +259,9 @@ public:
         }
 
         if (policy == EvictionPolicy::Value) {
-            return isResident() && !isDirty() && !isDeleted();
+            // Ejecting an inline value would not free any memory.
+            return isResident() && !isDirty() && !isDeleted() &&
+                   !isValueInline();
         } else {
             return !isDirty() && !isDeleted();
         }
@@ -276,12 +299,47 @@ public:
     }
 
     /**
-     * Get this item's value.
+     * Get this item's value Blob.
+     *
+     * Note: this is null if the value is stored inline (see isValueInline());
+     * use getValueView() or shareValue() when the value may be inline.
      */
     const value_t &getValue() const {
         return value;
     }
 
+    /**
+     * @return true if this object's memory was obtained from a SlabAllocator
+     *         (and hence must be returned to it, not the global allocator).
+     */
+    bool isSlabAllocated() const {
+        return bits.test(slabAllocatedIndex);
+    }
+
+    /// @return true if the value is stored inline, after the key.
+    bool isValueInline() const {
+        return bits.test(inlineValueIndex);
+    }
+
+    /// @return true if this item has a value, either in a Blob or inline.
+    bool hasValue() const {
+        return isValueInline() || value;
+    }
+
+    /**
+     * @return a view of this item's value, wherever it is stored. Empty if
+     *         the item has no value.
+     */
+    std::string_view getValueView() const;
+
+    /**
+     * @return this item's value as a Blob which can be shared with an Item.
+     *         For inline values a new Blob holding a copy is created, so each
+     *         read of an inline value costs an allocation (and copy) instead
+     *         of a reference count increment on a shared Blob.
+     */
+    value_t shareValue() const;
+
     /**
      * Get the expiration time of this item.
      *
@@ -489,6 +547,9 @@ public:
      }
 
     size_t valuelen() const {
+        if (isValueInline()) {
+            return getInlineValueHeader()->length;
+        }
         if (!value) {
             return 0;
         }
@@ -507,7 +568,8 @@ public:
      * @return the amount of memory used by this item.
      */
     size_t size() const {
-        return getObjectSize() + valuelen();
+        // An inline value is already accounted for by getObjectSize().
+        return getObjectSize() + (isValueInline() ? 0 : valuelen());
     }
 
     /**
@@ -518,7 +580,8 @@ public:
      * For uncompressed items this is the same as size().
      */
     size_t uncompressedSize() const {
-        return getObjectSize() + uncompressedValuelen();
+        // Inline values are never compressed.
+        return getObjectSize() + (isValueInline() ? 0 : uncompressedValuelen());
     }
 
     size_t metaDataSize() const {
@@ -564,6 +627,7 @@ public:
     void resetValue() {
         auto age = getAge();
         value.reset();
+        setValueInline(false);
         setAge(age);
     }
 
@@ -576,6 +640,7 @@ public:
         // Maintain the tag
         auto tag = getValueTag();
         value.reset(data.release());
+        setValueInline(false);
         setValueTag(tag);
     }
 
@@ -587,6 +652,7 @@ public:
         // Maintain the tag
         auto tag = getValueTag();
         this->value = value;
+        setValueInline(false);
         setValueTag(tag);
     }
 
@@ -727,8 +793,9 @@ public:
     static const int64_t state_temp_init;
 
     /**
-     * Return the size in byte of this object; both the fixed fields and the
-     * variable-length key. Doesn't include value size (allocated externally).
+     * Return the size in byte of this object; the fixed fields, the
+     * variable-length key and any inline value storage. Doesn't include the
+     * size of an out-of-line value (Blob).
      */
     inline size_t getObjectSize() const;
 
@@ -761,6 +828,24 @@ public:
     /// Return how many bytes are need to store item given key as a StoredValue
     static size_t getRequiredStorage(const DocKey& key);
 
+    /**
+     * Return how many bytes are needed to store an item with the given key
+     * as a StoredValue with inline storage for a value of up to
+     * inlineCapacity bytes.
+     */
+    static size_t getRequiredStorage(const DocKey& key, size_t inlineCapacity);
+
+    /**
+     * Return the inline value capacity which should be allocated to hold a
+     * value of the given length. Rounded up so the inline region (including
+     * its header) is a multiple of 8 bytes, leaving some slack for updates
+     * to grow in place.
+     */
+    static size_t getInlineValueCapacity(size_t valueLen);
+
+    /// Largest value (in bytes) which may be stored inline.
+    static constexpr size_t maxInlineValueSize = 128;
+
     /**
      * @return the deletion source of the stored value
      */
@@ -832,11 +917,17 @@ protected:
      *           which the new item is being inserted).
      * @param stats EPStats to update for this new StoredValue
      * @param isOrdered Are we constructing an OrderedStoredValue?
+     * @param inlineCapacity Number of bytes of inline value storage which
+     *        have been allocated after the key (zero if none).
+     * @param slabAllocated Was the memory for this object obtained from a
+     *        SlabAllocator?
      */
     StoredValue(const Item& itm,
                 UniquePtr n,
                 EPStats& stats,
-                bool isOrdered);
+                bool isOrdered,
+                size_t inlineCapacity = 0,
+                bool slabAllocated = false);
 
     // Destructor. protected, as needs to be carefully deleted (via
     // StoredValue::Destructor) depending on the value of isOrdered flag.
@@ -852,10 +943,13 @@ protected:
      *           ownership of. (Typically the top of the hash bucket into
      *           which the new item is being inserted).
      * @param stats EPStats to update for this new StoredValue
+     * @param slabAllocated Was the memory for this object obtained from a
+     *        SlabAllocator?
      */
     StoredValue(const StoredValue& other,
                 UniquePtr n,
-                EPStats& stats);
+                EPStats& stats,
+                bool slabAllocated = false);
 
     /* Do not allow assignment */
     StoredValue& operator=(const StoredValue& other) = delete;
@@ -890,6 +984,33 @@ protected:
      */
     void setValueImpl(const Item& itm);
 
+    /**
+     * Set the value of this SV; copying it into the inline storage if there
+     * is room, otherwise referencing the given Blob. Maintains the tag.
+     */
+    void assignValue(const value_t& newValue);
+
+    /// Header of the inline value region.
+    struct InlineValueHeader {
+        uint8_t capacity;
+        uint8_t length;
+    };
+
+    bool hasInlineStorage() const {
+        return bits.test(inlineStorageIndex);
+    }
+
+    void setValueInline(bool value) {
+        bits.set(inlineValueIndex, value);
+    }
+
+    /// @return the inline value header, located directly after the key.
+    inline InlineValueHeader* getInlineValueHeader();
+    inline const InlineValueHeader* getInlineValueHeader() const;
+
+    /// @return the total size of the inline region (header + capacity).
+    inline size_t getInlineStorageSize() const;
+
     // name clash with public OSV isStale
     bool isStalePriv() const {
         return bits.test(staleIndex);
@@ -992,15 +1113,17 @@ protected:
      */
     static constexpr size_t dirtyIndex = 0;
     static constexpr size_t deletedIndex = 1;
-    // Bit 2 of bits is currently unused and may be used for new purposes.
-    // static constexpr size_t unused = 2;
+    // inlineStorage := true if inline value storage was allocated after the
+    //                  key. Fixed for the lifetime of the object.
+    static constexpr size_t inlineStorageIndex = 2;
     // ordered := true if this is an instance of OrderedStoredValue
     static constexpr size_t orderedIndex = 3;
-    // Bit 4 and 5 of bits are currently unused and may be used for new purposes
-    // These bits were used for nru value but this was replaced by
-    // frequencyCounter stored in the tag of value
-    // static constexpr size_t unused = 4;
-    // static constexpr size_t unused = 5;
+    // inlineValue := true if the value currently lives in the inline storage
+    //                (and `value` is null).
+    static constexpr size_t inlineValueIndex = 4;
+    // slabAllocated := true if this object lives in a SlabAllocator chunk.
+    //                  Fixed for the lifetime of the object.
+    static constexpr size_t slabAllocatedIndex = 5;
     static constexpr size_t residentIndex = 6;
     // stale := Indicates if a newer instance of the item is added. Logically
     //          part of OSV, but is physically located in SV as there are spare
@@ -1191,11 +1314,30 @@ SerialisedDocKey* StoredValue::key() {
     }
 }
 
+StoredValue::InlineValueHeader* StoredValue::getInlineValueHeader() {
+    // Inline storage is located immediately following the key.
+    auto* k = key();
+    return reinterpret_cast<InlineValueHeader*>(
+            reinterpret_cast<uint8_t*>(k) + k->getObjectSize());
+}
+
+const StoredValue::InlineValueHeader* StoredValue::getInlineValueHeader()
+        const {
+    return const_cast<StoredValue&>(*this).getInlineValueHeader();
+}
+
+size_t StoredValue::getInlineStorageSize() const {
+    if (!hasInlineStorage()) {
+        return 0;
+    }
+    return sizeof(InlineValueHeader) + getInlineValueHeader()->capacity;
+}
+
 size_t StoredValue::getObjectSize() const {
     // Size of fixed part of OrderedStoredValue or StoredValue, plus size of
-    // (variable) key.
+    // (variable) key and any inline value storage.
     if (isOrdered()) {
         return sizeof(OrderedStoredValue) + getKey().getObjectSize();
     }
-    return sizeof(*this) + getKey().getObjectSize();
+    return sizeof(*this) + getKey().getObjectSize() + getInlineStorageSize();
 }
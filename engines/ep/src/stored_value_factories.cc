@@ -22,22 +22,51 @@
 StoredValue::UniquePtr StoredValueFactory::operator()(
         const Item& itm, StoredValue::UniquePtr next) {
     // Allocate a buffer to store the StoredValue and any trailing bytes
-    // that maybe required.
-    return StoredValue::UniquePtr(
-            new (::operator new(StoredValue::getRequiredStorage(itm.getKey())))
-                    StoredValue(itm,
-                                std::move(next),
-                                *stats,
-                                /*isOrdered*/ false));
+    // that maybe required (key and inline value).
+    const auto inlineCapacity = getInlineCapacity(itm);
+    bool slabAllocated;
+    void* memory = allocate(
+            StoredValue::getRequiredStorage(itm.getKey(), inlineCapacity),
+            slabAllocated);
+    return StoredValue::UniquePtr(new (memory) StoredValue(itm,
+                                                           std::move(next),
+                                                           *stats,
+                                                           /*isOrdered*/ false,
+                                                           inlineCapacity,
+                                                           slabAllocated));
+}
+
+size_t StoredValueFactory::getInlineCapacity(const Item& itm) const {
+    if (inlineValueThreshold == 0 || !itm.getValue() ||
+        mcbp::datatype::is_snappy(itm.getDataType())) {
+        return 0;
+    }
+    const auto len = itm.getNBytes();
+    if (len > inlineValueThreshold) {
+        return 0;
+    }
+    return StoredValue::getInlineValueCapacity(len);
 }
 
 StoredValue::UniquePtr StoredValueFactory::copyStoredValue(
         const StoredValue& other, StoredValue::UniquePtr next) {
     // Allocate a buffer to store the copy of StoredValue and any
     // trailing bytes required for the key.
-    return StoredValue::UniquePtr(
-            new (::operator new(other.getObjectSize()))
-                    StoredValue(other, std::move(next), *stats));
+    bool slabAllocated;
+    void* memory = allocate(other.getObjectSize(), slabAllocated);
+    return StoredValue::UniquePtr(new (memory) StoredValue(
+            other, std::move(next), *stats, slabAllocated));
+}
+
+void* StoredValueFactory::allocate(size_t size, bool& slabAllocated) {
+    if (slabAllocator) {
+        if (void* memory = slabAllocator->allocate(size)) {
+            slabAllocated = true;
+            return memory;
+        }
+    }
+    slabAllocated = false;
+    return ::operator new(size);
 }
 
 StoredValue::UniquePtr OrderedStoredValueFactory::operator()(
@@ -21,8 +21,10 @@
  * Factories for creating StoredValue and subclasses of StoredValue.
  */
 
+#include <algorithm>
 #include <memory>
 
+#include "slab_allocator.h"
 #include "stored-value.h"
 
 /**
@@ -63,7 +65,23 @@ class StoredValueFactory : public AbstractStoredValueFactory {
 public:
     using value_type = StoredValue;
 
-    StoredValueFactory(EPStats& s) : stats(&s) {
+    /**
+     * @param s EPStats to update for created StoredValues
+     * @param inlineValueThreshold Values of up to this many bytes are stored
+     *        inline in the StoredValue instead of in a separate Blob. Zero
+     *        disables inline values.
+     * @param useSlabAllocator If true, StoredValues are allocated from a
+     *        SlabAllocator owned by this factory instead of individually
+     *        from the global allocator.
+     */
+    StoredValueFactory(EPStats& s,
+                       size_t inlineValueThreshold = 0,
+                       bool useSlabAllocator = false)
+        : stats(&s),
+          inlineValueThreshold(std::min(inlineValueThreshold,
+                                        StoredValue::maxInlineValueSize)),
+          slabAllocator(useSlabAllocator ? std::make_unique<SlabAllocator>()
+                                         : nullptr) {
     }
 
     /**
@@ -76,7 +94,24 @@ public:
             const StoredValue& other, StoredValue::UniquePtr next) override;
 
 private:
+    /// @return the inline value capacity to allocate for the given item.
+    size_t getInlineCapacity(const Item& itm) const;
+
+    /**
+     * Allocate memory for a StoredValue of the given size; from the slab
+     * allocator if in use (and the size is supported), else from the global
+     * allocator.
+     * @param[out] slabAllocated set to true if from the slab allocator.
+     */
+    void* allocate(size_t size, bool& slabAllocated);
+
     EPStats* stats;
+    const size_t inlineValueThreshold;
+    /// Optional allocator for StoredValues created by this factory.
+    /// StoredValues released from the HashTable may outlive it (and this
+    /// factory); the SlabAllocator keeps their slabs valid until they are
+    /// freed.
+    const std::unique_ptr<SlabAllocator> slabAllocator;
 };
 
 /**
@@ -18,13 +18,45 @@
 #include "executorpool.h"
 #include "executorthread.h"
 #include "taskqueue.h"
+#include "timer_wheel_future_queue.h"
 
+#include <algorithm>
 #include <cmath>
+#include <gsl/gsl>
+#include <stdexcept>
+
+TaskQueue::TaskQueue(ExecutorPool* m,
+                     task_type_t t,
+                     const char* nm,
+                     size_t numShards,
+                     FutureQueueType futureQueueType,
+                     size_t numaNodes)
+    : name(nm),
+      queueType(t),
+      manager(m),
+      numaNodes(std::max(numaNodes, size_t{1})) {
+    if (numShards == 0) {
+        throw std::invalid_argument(
+                "TaskQueue::TaskQueue: numShards must be non-zero");
+    }
+    shards.reserve(numShards);
+    for (size_t ii = 0; ii < numShards; ++ii) {
+        shards.push_back(std::make_unique<Shard>(futureQueueType));
+    }
+}
 
-TaskQueue::TaskQueue(ExecutorPool *m, task_type_t t, const char *nm) :
-    name(nm), queueType(t), manager(m), sleepers(0)
-{
-    // EMPTY
+TaskQueue::Shard::Shard(FutureQueueType futureQueueType) {
+    switch (futureQueueType) {
+    case FutureQueueType::Heap:
+        futureQueue = std::make_unique<FutureQueue<>>();
+        return;
+    case FutureQueueType::TimerWheel:
+        futureQueue = std::make_unique<TimerWheelFutureQueue>();
+        return;
+    }
+    throw std::invalid_argument(
+            "TaskQueue::Shard::Shard: invalid futureQueueType:" +
+            std::to_string(int(futureQueueType)));
 }
 
 TaskQueue::~TaskQueue() {
@@ -36,49 +68,111 @@ const std::string TaskQueue::getName() const {
 }
 
 size_t TaskQueue::getReadyQueueSize() {
-    LockHolder lh(mutex);
-    return readyQueue.size();
+    size_t size = 0;
+    for (auto& shard : shards) {
+        LockHolder lh(shard->mutex);
+        size += shard->readyQueue.size();
+    }
+    return size;
 }
 
 size_t TaskQueue::getFutureQueueSize() {
-    LockHolder lh(mutex);
-    return futureQueue.size();
+    size_t size = 0;
+    for (auto& shard : shards) {
+        LockHolder lh(shard->mutex);
+        size += shard->futureQueue->size();
+    }
+    return size;
+}
+
+size_t TaskQueue::getLocalShardIndex(const ExecutorThread& t) const {
+    return t.getIndex() % shards.size();
+}
+
+size_t TaskQueue::getShardNode(size_t shard) const {
+    // Shard i is the local shard of thread i, which is bound to node
+    // i % numaNodes. (Threads beyond the number of shards wrap around, and
+    // may be on another node if shards.size() isn't a multiple of numaNodes.)
+    return shard % numaNodes;
+}
+
+size_t TaskQueue::getShardIndex(const ExTask& task) const {
+    const auto node = task->getNumaNode();
+    if (numaNodes > 1 && node >= 0 && size_t(node) < numaNodes &&
+        size_t(node) < shards.size()) {
+        // Pick one of the shards of the task's node: those with index
+        // node + k * numaNodes (see getShardNode), of which there are
+        // ceil((shards.size() - node) / numaNodes).
+        const size_t nodeShards =
+                (shards.size() - node + numaNodes - 1) / numaNodes;
+        const auto shard = node + numaNodes * (task->getId() % nodeShards);
+        Expects(getShardNode(shard) == size_t(node));
+        return shard;
+    }
+    return task->getId() % shards.size();
 }
 
-ExTask TaskQueue::_popReadyTask() {
-    ExTask t = readyQueue.top();
-    readyQueue.pop();
+ExTask TaskQueue::_popReadyTask(Shard& shard) {
+    ExTask t = shard.readyQueue.top();
+    shard.readyQueue.pop();
     manager->lessWork(queueType);
     return t;
 }
 
 void TaskQueue::doWake(size_t &numToWake) {
-    LockHolder lh(mutex);
-    _doWake_UNLOCKED(numToWake);
+    for (auto& shard : shards) {
+        if (!numToWake) {
+            break;
+        }
+        LockHolder lh(shard->mutex);
+        _doWake_UNLOCKED(*shard, numToWake);
+    }
 }
 
-void TaskQueue::_doWake_UNLOCKED(size_t &numToWake) {
-    if (sleepers && numToWake)  {
-        if (numToWake < sleepers) {
+void TaskQueue::_doWake_UNLOCKED(Shard& shard, size_t& numToWake) {
+    if (shard.sleepers && numToWake) {
+        if (numToWake < shard.sleepers) {
             for (; numToWake; --numToWake) {
-                mutex.notify_one(); // cond_signal 1
+                shard.mutex.notify_one(); // cond_signal 1
             }
         } else {
-            mutex.notify_all(); // cond_broadcast
-            numToWake -= sleepers;
+            shard.mutex.notify_all(); // cond_broadcast
+            numToWake -= shard.sleepers;
+        }
+    }
+}
+
+void TaskQueue::_doWakeOtherShards(const Shard& shard, size_t& numToWake) {
+    for (auto& other : shards) {
+        if (!numToWake) {
+            break;
         }
+        if (other.get() == &shard) {
+            continue;
+        }
+        LockHolder lh(other->mutex);
+        _doWake_UNLOCKED(*other, numToWake);
+    }
+}
+
+std::chrono::steady_clock::time_point TaskQueue::getEarliestWaketime() {
+    auto earliest = std::chrono::steady_clock::time_point::max();
+    for (auto& shard : shards) {
+        earliest = std::min(earliest,
+                            shard->futureQueue->getEarliestWaketime());
     }
+    return earliest;
 }
 
-bool TaskQueue::_doSleep(ExecutorThread &t,
+bool TaskQueue::_doSleep(ExecutorThread& t,
+                         Shard& shard,
                          std::unique_lock<std::mutex>& lock) {
     t.updateCurrentTime();
 
     // Determine the time point to wake this thread - either "forever" if the
-    // futureQueue is empty, or the earliest wake time in the futureQueue.
-    const auto wakeTime = futureQueue.empty()
-                                  ? std::chrono::steady_clock::time_point::max()
-                                  : futureQueue.top()->getWaketime();
+    // futureQueues are empty, or the earliest wake time in any of them (a
+    // task in another shard may be stolen by this thread).
+    const auto wakeTime = getEarliestWaketime();
 
     if (t.getCurTime() < wakeTime && manager->trySleep(queueType)) {
         // Atomically switch from running to sleeping; iff we were previously
@@ -88,17 +182,17 @@ bool TaskQueue::_doSleep(ExecutorThread &t,
                                              EXECUTOR_SLEEPING)) {
             return false;
         }
-        sleepers++;
+        shard.sleepers++;
         // zzz....
         const auto snooze = wakeTime - t.getCurTime();
 
         if (snooze > std::chrono::seconds((int)round(MIN_SLEEP_TIME))) {
-            mutex.wait_for(lock, MIN_SLEEP_TIME);
+            shard.mutex.wait_for(lock, MIN_SLEEP_TIME);
         } else {
-            mutex.wait_for(lock, snooze);
+            shard.mutex.wait_for(lock, snooze);
         }
         // ... woke!
-        sleepers--;
+        shard.sleepers--;
         manager->woke();
 
         // Finished our sleep, atomically switch back to running iff we were
@@ -115,36 +209,82 @@ bool TaskQueue::_doSleep(ExecutorThread &t,
 }
 
 bool TaskQueue::_sleepThenFetchNextTask(ExecutorThread& t) {
-    std::unique_lock<std::mutex> lh(mutex);
-    if (!_doSleep(t, lh)) {
-        return false; // shutting down
+    const auto local = getLocalShardIndex(t);
+    {
+        std::unique_lock<std::mutex> lh(shards[local]->mutex);
+        if (!_doSleep(t, *shards[local], lh)) {
+            return false; // shutting down
+        }
+        if (_fetchNextTaskInner(t, *shards[local], lh)) {
+            return true;
+        }
     }
-    return _fetchNextTaskInner(t, lh);
+    return _stealNextTask(t, local);
 }
 
 bool TaskQueue::_fetchNextTask(ExecutorThread& t) {
-    std::unique_lock<std::mutex> lh(mutex);
-    return _fetchNextTaskInner(t, lh);
+    const auto local = getLocalShardIndex(t);
+    {
+        std::unique_lock<std::mutex> lh(shards[local]->mutex);
+        if (_fetchNextTaskInner(t, *shards[local], lh)) {
+            return true;
+        }
+    }
+    return _stealNextTask(t, local);
+}
+
+bool TaskQueue::_stealNextTask(ExecutorThread& t, size_t localShard) {
+    // Peers on the same NUMA node as this thread are tried first, then
+    // those on other nodes.
+    const auto localNode = t.getIndex() % numaNodes;
+    for (const bool sameNode : {true, false}) {
+        for (size_t offset = 1; offset < shards.size(); ++offset) {
+            const auto victimIndex = (localShard + offset) % shards.size();
+            if (numaNodes > 1 &&
+                sameNode != (getShardNode(victimIndex) == localNode)) {
+                continue;
+            }
+            auto& victim = *shards[victimIndex];
+            // Don't queue up behind the owner (or another thief) of a busy
+            // shard; move on to the next one instead.
+            std::unique_lock<std::mutex> lh(victim.mutex, std::try_to_lock);
+            if (lh.owns_lock() && _fetchNextTaskInner(t, victim, lh)) {
+                numSteals.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        if (numaNodes == 1) {
+            break;
+        }
+    }
+    return false;
 }
 
 bool TaskQueue::_fetchNextTaskInner(ExecutorThread& t,
-                                    const std::unique_lock<std::mutex>&) {
+                                    Shard& shard,
+                                    std::unique_lock<std::mutex>& lh) {
     bool ret = false;
 
-    size_t numToWake = _moveReadyTasks(t.getCurTime());
+    size_t numToWake = _moveReadyTasks(shard, t.getCurTime());
 
-    if (!readyQueue.empty() && readyQueue.top()->isdead()) {
-        t.setCurrentTask(_popReadyTask()); // clean out dead tasks first
+    if (!shard.readyQueue.empty() && shard.readyQueue.top()->isdead()) {
+        t.setCurrentTask(_popReadyTask(shard)); // clean out dead tasks first
         ret = true;
-    } else if (!readyQueue.empty()) {
-        ExTask tid = _popReadyTask(); // and pop out the top task
+    } else if (!shard.readyQueue.empty()) {
+        ExTask tid = _popReadyTask(shard); // and pop out the top task
         t.setCurrentTask(tid);
         ret = true;
     } else {
         numToWake = numToWake ? numToWake - 1 : 0; // 1 fewer task ready
     }
 
-    _doWake_UNLOCKED(numToWake);
+    _doWake_UNLOCKED(shard, numToWake);
+    if (numToWake) {
+        // Not enough sleepers in this shard; threads sleeping in the other
+        // shards can steal the remaining ready tasks.
+        lh.unlock();
+        _doWakeOtherShards(shard, numToWake);
+    }
     return ret;
 }
 
@@ -159,22 +299,13 @@ bool TaskQueue::sleepThenFetchNextTask(ExecutorThread& thread) {
 }
 
 size_t TaskQueue::_moveReadyTasks(
-        const std::chrono::steady_clock::time_point tv) {
-    if (!readyQueue.empty()) {
+        Shard& shard, const std::chrono::steady_clock::time_point tv) {
+    if (!shard.readyQueue.empty()) {
         return 0;
     }
 
-    size_t numReady = 0;
-    while (!futureQueue.empty()) {
-        ExTask tid = futureQueue.top();
-        if (tid->getWaketime() <= tv) {
-            futureQueue.pop();
-            readyQueue.push(tid);
-            numReady++;
-        } else {
-            break;
-        }
-    }
+    const size_t numReady = shard.futureQueue->popReady(
+            tv, [&shard](ExTask task) { shard.readyQueue.push(task); });
 
     manager->addWork(numReady, queueType);
 
@@ -183,10 +314,11 @@ size_t TaskQueue::_moveReadyTasks(
 }
 
 std::chrono::steady_clock::time_point TaskQueue::_reschedule(ExTask& task) {
-    LockHolder lh(mutex);
+    auto& shard = getShard(task);
+    LockHolder lh(shard.mutex);
 
-    futureQueue.push(task);
-    return futureQueue.top()->getWaketime();
+    shard.futureQueue->push(task);
+    return shard.futureQueue->getEarliestWaketime();
 }
 
 std::chrono::steady_clock::time_point TaskQueue::reschedule(ExTask& task) {
@@ -198,15 +330,16 @@ std::chrono::steady_clock::time_point TaskQueue::reschedule(ExTask& task) {
 void TaskQueue::_schedule(ExTask &task) {
     TaskQueue* sleepQ;
     size_t numToWake = 1;
+    auto& shard = getShard(task);
 
     {
-        LockHolder lh(mutex);
+        LockHolder lh(shard.mutex);
 
         // If we are rescheduling a previously cancelled task, we should reset
         // the task state to the initial value of running.
         task->setState(TASK_RUNNING, TASK_DEAD);
 
-        futureQueue.push(task);
+        shard.futureQueue->push(task);
 
         EP_LOG_TRACE("{}: Schedule a task \"{}\" id {}",
                      name,
@@ -214,8 +347,9 @@ void TaskQueue::_schedule(ExTask &task) {
                      task->getId());
 
         sleepQ = manager->getSleepQ(queueType);
-        _doWake_UNLOCKED(numToWake);
+        _doWake_UNLOCKED(shard, numToWake);
     }
+    _doWakeOtherShards(shard, numToWake);
     if (this != sleepQ) {
         sleepQ->doWake(numToWake);
     }
@@ -232,19 +366,21 @@ void TaskQueue::_wake(ExTask &task) {
     TaskQueue* sleepQ;
     // One task is being made ready regardless of the queue it's in.
     size_t readyCount = 1;
+    auto& shard = getShard(task);
     {
-        LockHolder lh(mutex);
+        LockHolder lh(shard.mutex);
         EP_LOG_DEBUG("{}: Wake a task \"{}\" id {}",
                      name,
                      task->getDescription(),
                      task->getId());
 
-        futureQueue.updateWaketime(task, now);
+        shard.futureQueue->updateWaketime(task, now);
         task->setState(TASK_RUNNING, TASK_SNOOZED);
 
-        _doWake_UNLOCKED(readyCount);
+        _doWake_UNLOCKED(shard, readyCount);
         sleepQ = manager->getSleepQ(queueType);
     }
+    _doWakeOtherShards(shard, readyCount);
     if (this != sleepQ) {
         sleepQ->doWake(readyCount);
     }
@@ -255,6 +391,17 @@ void TaskQueue::wake(ExTask &task) {
     _wake(task);
 }
 
+FutureQueueType TaskQueue::futureQueueTypeFromString(const std::string& type) {
+    if (type == "heap") {
+        return FutureQueueType::Heap;
+    }
+    if (type == "timer_wheel") {
+        return FutureQueueType::TimerWheel;
+    }
+    throw std::invalid_argument(
+            "TaskQueue::futureQueueTypeFromString: unknown type:" + type);
+}
+
 const std::string TaskQueue::taskType2Str(task_type_t type) {
     switch (type) {
     case WRITER_TASK_IDX:
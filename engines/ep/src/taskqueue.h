@@ -19,17 +19,58 @@
 #include "syncobject.h"
 #include "task_type.h"
 
+#include <atomic>
 #include <chrono>
 #include <list>
+#include <memory>
 #include <queue>
+#include <vector>
 
 class ExecutorPool;
 class ExecutorThread;
 
+/**
+ * Queue of tasks of a single task type, serviced by the ExecutorThreads of
+ * that type.
+ *
+ * A TaskQueue is split into one or more shards, each with its own mutex,
+ * future queue and ready queue. A task always lives in the same (home) shard,
+ * selected by its id, so wake / snooze / reschedule only ever touch one shard.
+ * Each thread prefers the shard matching its index (its local shard) and only
+ * when that has no ready task does it try to steal a ready task from the
+ * other shards. With a single shard (the default) this is the classic shared
+ * queue.
+ *
+ * When threads are bound to NUMA nodes, tasks which prefer a node (e.g. the
+ * Flusher and BgFetcher of a KVShard) are only placed in the shards local to
+ * that node's threads, and threads steal from peers on the same node before
+ * those on other nodes.
+ *
+ * Note task priorities are only strictly honoured within a shard - a thread
+ * will run a ready task from its local shard before a higher priority task
+ * which is ready in a peer's shard.
+ */
 class TaskQueue {
     friend class ExecutorPool;
 public:
-    TaskQueue(ExecutorPool *m, task_type_t t, const char *nm);
+    /**
+     * @param m Pool which owns this queue
+     * @param t Type of tasks in this queue
+     * @param nm Name prefix of this queue (for stats)
+     * @param numShards Number of shards to split the queue into; threads
+     *        steal work between shards when greater than one.
+     * @param futureQueueType Implementation of the queue of tasks waiting
+     *        for their wakeTime.
+     * @param numaNodes Number of NUMA nodes threads are bound to (thread i
+     *        to node i % numaNodes); tasks with a NUMA node set are placed in
+     *        the shards of that node's threads.
+     */
+    TaskQueue(ExecutorPool* m,
+              task_type_t t,
+              const char* nm,
+              size_t numShards = 1,
+              FutureQueueType futureQueueType = FutureQueueType::Heap,
+              size_t numaNodes = 1);
     ~TaskQueue();
 
     void schedule(ExTask &task);
@@ -64,6 +105,13 @@ public:
 
     static const std::string taskType2Str(task_type_t type);
 
+    /**
+     * Convert the string representation of a FutureQueueType (as used by
+     * the executor_pool_future_queue config param) to the enum.
+     * @throws std::invalid_argument if the string is not recognised.
+     */
+    static FutureQueueType futureQueueTypeFromString(const std::string& type);
+
     const std::string getName() const;
 
     const task_type_t getQueueType() const { return queueType; }
@@ -72,33 +120,75 @@ public:
 
     size_t getFutureQueueSize();
 
+    size_t getNumShards() const {
+        return shards.size();
+    }
+
+    /// @return the index of the shard the given task is queued in.
+    size_t getShardIndex(const ExTask& task) const;
+
+    /// @return the NUMA node of the threads the given shard is local to.
+    size_t getShardNode(size_t shard) const;
+
+    /// @return the number of tasks threads have taken from a shard other
+    ///         than their local one.
+    size_t getNumSteals() const {
+        return numSteals.load(std::memory_order_relaxed);
+    }
+
     void snooze(ExTask& task, const double secs) {
-        futureQueue.snooze(task, secs);
+        getShard(task).futureQueue->snooze(task, secs);
     }
 
 private:
+    struct Shard {
+        explicit Shard(FutureQueueType futureQueueType);
+
+        SyncObject mutex;
+        size_t sleepers = 0; // number of threads sleeping in this shard
+
+        // sorted by task priority.
+        std::priority_queue<ExTask, std::deque<ExTask>, CompareByPriority>
+                readyQueue;
+
+        // ordered by waketime. Guarded by `mutex`.
+        std::unique_ptr<TaskFutureQueue> futureQueue;
+    };
+
+    /// @return the shard which the given task belongs to.
+    Shard& getShard(const ExTask& task) {
+        return *shards[getShardIndex(task)];
+    }
+
+    /// @return the index of the shard the given thread prefers.
+    size_t getLocalShardIndex(const ExecutorThread& t) const;
+
     void _schedule(ExTask &task);
     std::chrono::steady_clock::time_point _reschedule(ExTask& task);
     bool _sleepThenFetchNextTask(ExecutorThread& t);
     bool _fetchNextTask(ExecutorThread& thread);
     bool _fetchNextTaskInner(ExecutorThread& t,
-                             const std::unique_lock<std::mutex>& lh);
+                             Shard& shard,
+                             std::unique_lock<std::mutex>& lh);
+    bool _stealNextTask(ExecutorThread& t, size_t localShard);
     void _wake(ExTask &task);
-    bool _doSleep(ExecutorThread &thread, std::unique_lock<std::mutex>& lock);
-    void _doWake_UNLOCKED(size_t &numToWake);
-    size_t _moveReadyTasks(const std::chrono::steady_clock::time_point tv);
-    ExTask _popReadyTask();
+    bool _doSleep(ExecutorThread& thread,
+                  Shard& shard,
+                  std::unique_lock<std::mutex>& lock);
+    void _doWake_UNLOCKED(Shard& shard, size_t& numToWake);
+    void _doWakeOtherShards(const Shard& shard, size_t& numToWake);
+    size_t _moveReadyTasks(Shard& shard,
+                           const std::chrono::steady_clock::time_point tv);
+    ExTask _popReadyTask(Shard& shard);
+    std::chrono::steady_clock::time_point getEarliestWaketime();
 
-    SyncObject mutex;
     const std::string name;
     task_type_t queueType;
     ExecutorPool *manager;
-    size_t sleepers; // number of threads sleeping in this taskQueue
 
-    // sorted by task priority.
-    std::priority_queue<ExTask, std::deque<ExTask>,
-                        CompareByPriority> readyQueue;
+    std::vector<std::unique_ptr<Shard>> shards;
+
+    const size_t numaNodes;
 
-    // sorted by waketime. Guarded by `mutex`.
-    FutureQueue<> futureQueue;
+    std::atomic<size_t> numSteals{0};
 };
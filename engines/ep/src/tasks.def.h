@@ -63,6 +63,7 @@ TASK(StatSnap, WRITER_TASK_IDX, 9)
 TASK(PendingOpsNotification, NONIO_TASK_IDX, 0)
 TASK(RespondAmbiguousNotification, NONIO_TASK_IDX, 0)
 TASK(NotifyHighPriorityReqTask, NONIO_TASK_IDX, 0)
+TASK(FlushPrepareTask, NONIO_TASK_IDX, 0)
 TASK(ItemPager, NONIO_TASK_IDX, 1)
 TASK(ExpiredItemPager, NONIO_TASK_IDX, 1)
 TASK(ItemPagerVisitor, NONIO_TASK_IDX, 1)
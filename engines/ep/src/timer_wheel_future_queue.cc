@@ -0,0 +1,319 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "timer_wheel_future_queue.h"
+
+#include <folly/lang/Bits.h>
+
+#include <stdexcept>
+#include <string>
+
+void TimerWheelFutureQueue::push(ExTask task) {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    const auto id = task->getId();
+    auto found = index.find(id);
+    if (found != index.end()) {
+        reposition(found->second);
+        return;
+    }
+
+    const auto pos = getPosition(toTick(task->getWaketime()));
+    auto& slot = getSlot(pos.first, pos.second);
+    slot.push_back(Entry{std::move(task), pos.first, pos.second});
+    index.emplace(id, std::prev(slot.end()));
+    updateOccupied(pos.first, pos.second);
+}
+
+size_t TimerWheelFutureQueue::size() {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    return index.size();
+}
+
+bool TimerWheelFutureQueue::empty() {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    return index.empty();
+}
+
+bool TimerWheelFutureQueue::updateWaketime(
+        const ExTask& task, std::chrono::steady_clock::time_point newTime) {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    task->updateWaketime(newTime);
+    auto found = index.find(task->getId());
+    if (found == index.end()) {
+        return false;
+    }
+    reposition(found->second);
+    return true;
+}
+
+bool TimerWheelFutureQueue::snooze(const ExTask& task, const double secs) {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    task->snooze(secs);
+    auto found = index.find(task->getId());
+    if (found == index.end()) {
+        return false;
+    }
+    reposition(found->second);
+    return true;
+}
+
+std::chrono::steady_clock::time_point
+TimerWheelFutureQueue::getEarliestWaketime() {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    if (index.empty()) {
+        return std::chrono::steady_clock::time_point::max();
+    }
+
+    // Level 0 slots are a single tick wide; give the exact answer.
+    const int slot = findOccupied(0, getSlotIndex(current, 0));
+    if (slot >= 0) {
+        auto earliest = std::chrono::steady_clock::time_point::max();
+        for (const auto& entry : wheels[0][slot]) {
+            earliest = std::min(earliest, entry.task->getWaketime());
+        }
+        return earliest;
+    }
+
+    // Otherwise the start of the first occupied slot is a lower bound -
+    // popReady() will cascade the slot once that time is reached.
+    for (int level = 1; level < numLevels; ++level) {
+        const int slot = findOccupied(level, getSlotIndex(current, level));
+        if (slot >= 0) {
+            return fromTick(getSlotStart(level, uint8_t(slot)));
+        }
+    }
+
+    // Only overflow tasks, which are beyond the block of ticks spanned by
+    // the wheels.
+    const int shift = slotBits * numLevels;
+    return fromTick(((current >> shift) + 1) << shift);
+}
+
+size_t TimerWheelFutureQueue::popReady(
+        std::chrono::steady_clock::time_point now,
+        const std::function<void(ExTask)>& onReady) {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    const int64_t target = toTick(now);
+    size_t numReady = 0;
+
+    for (;;) {
+        // Find the earliest occupied slot - that of the lowest level with
+        // any occupied slot (from the current tick onwards).
+        int level = 0;
+        int slot = -1;
+        for (; level < numLevels; ++level) {
+            slot = findOccupied(level, getSlotIndex(current, level));
+            if (slot >= 0) {
+                break;
+            }
+        }
+
+        if (slot < 0) {
+            // The wheels are empty. If the target is beyond the block of
+            // ticks which they span then overflow tasks may now fit in them.
+            const int shift = slotBits * numLevels;
+            if (!overflow.empty() && target > current &&
+                (target >> shift) != (current >> shift)) {
+                current = target;
+                repositionAll(overflowLevel, 0);
+                continue;
+            }
+            current = std::max(current, target);
+            break;
+        }
+
+        const int64_t slotStart =
+                std::max(current, getSlotStart(level, uint8_t(slot)));
+
+        if (level > 0) {
+            if (slotStart > target) {
+                // Nothing due yet.
+                current = std::max(current, target);
+                break;
+            }
+            // Advance into the slot and cascade its tasks down.
+            current = slotStart;
+            repositionAll(uint8_t(level), uint8_t(slot));
+            continue;
+        }
+
+        // Level 0 - all tasks in slots before the target tick are due; the
+        // target slot (or the current slot if now lags the current tick)
+        // may contain some which are not.
+        if (slotStart > target && slotStart != current) {
+            current = std::max(current, target);
+            break;
+        }
+        current = slotStart;
+        auto& tasks = wheels[0][slot];
+        for (auto it = tasks.begin(); it != tasks.end();) {
+            if (it->task->getWaketime() <= now) {
+                index.erase(it->task->getId());
+                onReady(std::move(it->task));
+                it = tasks.erase(it);
+                numReady++;
+            } else {
+                ++it;
+            }
+        }
+        updateOccupied(0, uint8_t(slot));
+        if (!tasks.empty() || slotStart >= target) {
+            break;
+        }
+    }
+    return numReady;
+}
+
+void TimerWheelFutureQueue::assertInvariants() {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    size_t count = 0;
+    auto checkSlot = [this, &count](uint8_t level, uint8_t slotIdx) {
+        auto& slot = getSlot(level, slotIdx);
+        if (level != overflowLevel &&
+            bool(occupied[level] & (uint64_t(1) << slotIdx)) == slot.empty()) {
+            throw std::logic_error(
+                    "TimerWheelFutureQueue::assertInvariants: occupied bit "
+                    "incorrect for level:" +
+                    std::to_string(level) + " slot:" + std::to_string(slotIdx));
+        }
+        for (auto it = slot.begin(); it != slot.end(); ++it) {
+            count++;
+            const auto tick = toTick(it->task->getWaketime());
+            const auto expected = getPosition(tick);
+            if (it->level != level || it->slot != slotIdx ||
+                expected != std::make_pair(level, slotIdx)) {
+                throw std::logic_error(
+                        "TimerWheelFutureQueue::assertInvariants: task:" +
+                        it->task->getDescription() +
+                        " tick:" + std::to_string(tick) +
+                        " current:" + std::to_string(current) +
+                        " is at level:" + std::to_string(level) +
+                        " slot:" + std::to_string(slotIdx) +
+                        " expected level:" + std::to_string(expected.first) +
+                        " slot:" + std::to_string(expected.second));
+            }
+            auto found = index.find(it->task->getId());
+            if (found == index.end() || found->second != it) {
+                throw std::logic_error(
+                        "TimerWheelFutureQueue::assertInvariants: task:" +
+                        it->task->getDescription() + " not indexed");
+            }
+        }
+    };
+
+    for (int level = 0; level < numLevels; ++level) {
+        for (size_t slot = 0; slot < numSlots; ++slot) {
+            checkSlot(uint8_t(level), uint8_t(slot));
+        }
+    }
+    checkSlot(overflowLevel, 0);
+
+    if (count != index.size()) {
+        throw std::logic_error(
+                "TimerWheelFutureQueue::assertInvariants: index size:" +
+                std::to_string(index.size()) +
+                " != number of tasks:" + std::to_string(count));
+    }
+}
+
+int64_t TimerWheelFutureQueue::toTick(
+        std::chrono::steady_clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+                   time.time_since_epoch())
+            .count();
+}
+
+std::chrono::steady_clock::time_point TimerWheelFutureQueue::fromTick(
+        int64_t tick) {
+    return std::chrono::steady_clock::time_point(
+            std::chrono::milliseconds(tick));
+}
+
+std::pair<uint8_t, uint8_t> TimerWheelFutureQueue::getPosition(
+        int64_t tick) const {
+    if (tick <= current) {
+        // Already due; keep in the current slot.
+        return {0, getSlotIndex(current, 0)};
+    }
+    // The lowest level whose block (of numSlots slots) contains both the
+    // current tick and tick.
+    for (int level = 0; level < numLevels; ++level) {
+        const int shift = slotBits * (level + 1);
+        if ((tick >> shift) == (current >> shift)) {
+            return {uint8_t(level), getSlotIndex(tick, level)};
+        }
+    }
+    return {overflowLevel, 0};
+}
+
+int64_t TimerWheelFutureQueue::getSlotStart(int level, uint8_t slot) const {
+    const int shift = slotBits * (level + 1);
+    return ((current >> shift) << shift) |
+           (int64_t(slot) << (slotBits * level));
+}
+
+TimerWheelFutureQueue::Slot& TimerWheelFutureQueue::getSlot(uint8_t level,
+                                                            uint8_t slot) {
+    return level == overflowLevel ? overflow : wheels[level][slot];
+}
+
+void TimerWheelFutureQueue::reposition(Slot::iterator it) {
+    const auto oldLevel = it->level;
+    const auto oldSlot = it->slot;
+    const auto pos = getPosition(toTick(it->task->getWaketime()));
+    if (pos == std::make_pair(oldLevel, oldSlot)) {
+        return;
+    }
+    auto& to = getSlot(pos.first, pos.second);
+    to.splice(to.end(), getSlot(oldLevel, oldSlot), it);
+    it->level = pos.first;
+    it->slot = pos.second;
+    updateOccupied(oldLevel, oldSlot);
+    updateOccupied(pos.first, pos.second);
+}
+
+void TimerWheelFutureQueue::repositionAll(uint8_t level, uint8_t slot) {
+    Slot moving;
+    moving.splice(moving.end(), getSlot(level, slot));
+    updateOccupied(level, slot);
+    while (!moving.empty()) {
+        auto it = moving.begin();
+        const auto pos = getPosition(toTick(it->task->getWaketime()));
+        auto& to = getSlot(pos.first, pos.second);
+        to.splice(to.end(), moving, it);
+        it->level = pos.first;
+        it->slot = pos.second;
+        updateOccupied(pos.first, pos.second);
+    }
+}
+
+void TimerWheelFutureQueue::updateOccupied(uint8_t level, uint8_t slot) {
+    if (level == overflowLevel) {
+        return;
+    }
+    const auto bit = uint64_t(1) << slot;
+    if (wheels[level][slot].empty()) {
+        occupied[level] &= ~bit;
+    } else {
+        occupied[level] |= bit;
+    }
+}
+
+int TimerWheelFutureQueue::findOccupied(int level, uint8_t from) const {
+    const uint64_t candidates = occupied[level] & (~uint64_t(0) << from);
+    return candidates ? int(folly::findFirstSet(candidates)) - 1 : -1;
+}
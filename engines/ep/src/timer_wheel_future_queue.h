@@ -0,0 +1,146 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include "futurequeue.h"
+
+#include <array>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+/**
+ * TaskFutureQueue implemented as a hierarchical timing wheel.
+ *
+ * Tasks are bucketed by their wakeTime (at millisecond resolution, "ticks")
+ * into one of numLevels wheels of numSlots slots each. Level 0 has one slot
+ * per tick, and each further level has slots numSlots times wider than the
+ * previous one. Tasks due too far in the future for the top level wheel are
+ * kept in an overflow list.
+ *
+ * Each task is found via an index keyed by task id, so push, snooze and
+ * updateWaketime (wake) are O(1) regardless of the number of queued tasks.
+ * This compares with O(n) for FutureQueue, which has to search for the task
+ * and rebuild its heap.
+ *
+ * The wheels are positioned at the "current" tick. It is only advanced by
+ * popReady(). As it moves into each occupied slot of a higher level, the
+ * slot's tasks are cascaded down to the lower levels. Each task therefore
+ * moves at most numLevels times before becoming ready.
+ *
+ * Unlike FutureQueue there is no top(). getEarliestWaketime() returns a
+ * lower bound, which is exact while the earliest task is in level 0.
+ *
+ * Each task may only be queued once; pushing a task which is already
+ * queued just updates its position.
+ */
+class TimerWheelFutureQueue : public TaskFutureQueue {
+public:
+    /// log2 of the number of slots of each wheel.
+    static constexpr int slotBits = 6;
+    static constexpr size_t numSlots = size_t(1) << slotBits;
+    /// Number of wheels. All levels together span numSlots^numLevels ticks
+    /// (~4.6 hours).
+    static constexpr int numLevels = 4;
+
+    void push(ExTask task) override;
+
+    size_t size() override;
+
+    bool empty() override;
+
+    bool updateWaketime(const ExTask& task,
+                        std::chrono::steady_clock::time_point newTime) override;
+
+    bool snooze(const ExTask& task, const double secs) override;
+
+    std::chrono::steady_clock::time_point getEarliestWaketime() override;
+
+    size_t popReady(std::chrono::steady_clock::time_point now,
+                    const std::function<void(ExTask)>& onReady) override;
+
+    /**
+     * Checks that the invariants of the timer wheel are valid.
+     * If not then throws std::logic_error.
+     */
+    void assertInvariants();
+
+private:
+    /// Level used for tasks beyond the span of the wheels.
+    static constexpr uint8_t overflowLevel = numLevels;
+
+    struct Entry {
+        ExTask task;
+        uint8_t level;
+        uint8_t slot;
+    };
+    using Slot = std::list<Entry>;
+
+    static int64_t toTick(std::chrono::steady_clock::time_point time);
+
+    static std::chrono::steady_clock::time_point fromTick(int64_t tick);
+
+    /// @return the slot index of the given tick at the given level.
+    static uint8_t getSlotIndex(int64_t tick, int level) {
+        return uint8_t((tick >> (slotBits * level)) & (numSlots - 1));
+    }
+
+    /// @return the (level, slot) a task due at tick belongs in, relative to
+    ///         the current tick.
+    std::pair<uint8_t, uint8_t> getPosition(int64_t tick) const;
+
+    /// @return the first tick covered by the given slot of the given level.
+    int64_t getSlotStart(int level, uint8_t slot) const;
+
+    Slot& getSlot(uint8_t level, uint8_t slot);
+
+    /// Move the entry at `it` to its position according to its task's
+    /// wakeTime.
+    void reposition(Slot::iterator it);
+
+    /// Move all of the entries in the given slot to their positions
+    /// according to the current tick (cascading them down a level).
+    void repositionAll(uint8_t level, uint8_t slot);
+
+    /// Update the occupancy bit of the given slot after a change.
+    void updateOccupied(uint8_t level, uint8_t slot);
+
+    /// @return the index of the first occupied slot of the given level at
+    ///         or after `from`, or -1 if there is none.
+    int findOccupied(int level, uint8_t from) const;
+
+    std::array<std::array<Slot, numSlots>, numLevels> wheels;
+
+    /// Bitmap per level of non-empty slots.
+    std::array<uint64_t, numLevels> occupied{};
+    static_assert(numSlots <= 64, "occupied bitmap too small for numSlots");
+
+    /// Tasks beyond the span of the wheels.
+    Slot overflow;
+
+    /// Location of each queued task, by task id.
+    std::unordered_map<size_t, Slot::iterator> index;
+
+    /// The tick the wheels are positioned at.
+    int64_t current = 0;
+
+    // All access to the wheels must be done with the queueMutex
+    std::mutex queueMutex;
+};
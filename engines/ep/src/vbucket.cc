@@ -182,7 +182,11 @@ VBucket::VBucket(Vbid i,
                  bool mightContainXattrs,
                  const nlohmann::json& replTopology,
                  uint64_t maxVisibleSeqno)
-    : ht(st, std::move(valFact), config.getHtSize(), config.getHtLocks()),
+    : ht(st,
+         std::move(valFact),
+         config.getHtSize(),
+         config.getHtLocks(),
+         HashTable::layoutFromString(config.getHtLayout())),
       checkpointManager(std::make_unique<CheckpointManager>(st,
                                                             i,
                                                             chkConfig,
@@ -206,6 +210,7 @@ VBucket::VBucket(Vbid i,
       metaDataDisk(0),
       numExpiredItems(0),
       maxAllowedReplicasForSyncWrites(config.getSyncWritesMaxAllowedReplicas()),
+      optimisticReads(config.isHtOptimisticReads()),
       eviction(evictionPolicy),
       stats(st),
       persistenceSeqno(0),
@@ -329,6 +334,14 @@ size_t VBucket::getSyncWriteAbortedCount() const {
     return durabilityMonitor->getNumAborted();
 }
 
+size_t VBucket::getSyncWriteTrackedCount() const {
+    folly::SharedMutex::ReadHolder lh(stateLock);
+    if (!durabilityMonitor) {
+        return 0;
+    }
+    return durabilityMonitor->getNumTracked();
+}
+
 void VBucket::fireAllOps(EventuallyPersistentEngine &engine,
                          ENGINE_ERROR_CODE code) {
     std::unique_lock<std::mutex> lh(pendingOpLock);
@@ -809,8 +822,7 @@ void VBucket::handlePreExpiry(const HashTable::HashBucketLock& hbl,
                 cb::UserDataView(ss.str()).getSanitizedValue());
     }
 
-    value_t value = v.getValue();
-    if (value) {
+    if (v.hasValue()) {
         std::unique_ptr<Item> itm(v.toItem(id));
         item_info itm_info;
         EventuallyPersistentEngine* engine = ObjectRegistry::getCurrentEngine();
@@ -1661,7 +1673,7 @@ ENGINE_ERROR_CODE VBucket::set(
             // full eviction.
             if (v) {
                 // temp item is already created. Simply schedule a bg fetch job
-                hbl.getHTLock().unlock();
+                hbl.unlock();
                 bgFetch(itm.getKey(), cookie, engine, true);
                 return ENGINE_EWOULDBLOCK;
             }
@@ -1775,7 +1787,7 @@ ENGINE_ERROR_CODE VBucket::replace(
                 break;
             case MutationStatus::NeedBgFetch: {
                 // temp item is already created. Simply schedule a bg fetch job
-                hbl.getHTLock().unlock();
+                hbl.unlock();
                 bgFetch(itm.getKey(), cookie, engine, true);
                 ret = ENGINE_EWOULDBLOCK;
                 break;
@@ -1889,7 +1901,7 @@ ENGINE_ERROR_CODE VBucket::prepare(
         }
         // we unlock ht lock here because we want to avoid potential lock
         // inversions arising from notifyNewSeqno() call
-        hbl.getHTLock().unlock();
+        hbl.unlock();
         notifyNewSeqno(*notifyCtx);
         doCollectionsStats(cHandle, *notifyCtx);
     } break;
@@ -1899,7 +1911,7 @@ ENGINE_ERROR_CODE VBucket::prepare(
     case MutationStatus::NeedBgFetch: { // CAS operation with non-resident item
         // + full eviction.
         if (v) { // temp item is already created. Simply schedule a
-            hbl.getHTLock().unlock(); // bg fetch job.
+            hbl.unlock(); // bg fetch job.
             bgFetch(itm.getKey(), cookie, engine, true);
             return ENGINE_EWOULDBLOCK;
         }
@@ -2028,7 +2040,7 @@ ENGINE_ERROR_CODE VBucket::setWithMeta(
         }
         // we unlock ht lock here because we want to avoid potential lock
         // inversions arising from notifyNewSeqno() call
-        hbl.getHTLock().unlock();
+        hbl.unlock();
         notifyNewSeqno(*notifyCtx);
         doCollectionsStats(cHandle, *notifyCtx);
     } break;
@@ -2038,7 +2050,7 @@ ENGINE_ERROR_CODE VBucket::setWithMeta(
     case MutationStatus::NeedBgFetch: { // CAS operation with non-resident item
         // + full eviction.
         if (v) { // temp item is already created. Simply schedule a
-            hbl.getHTLock().unlock(); // bg fetch job.
+            hbl.unlock(); // bg fetch job.
             bgFetch(itm.getKey(), cookie, engine, true);
             return ENGINE_EWOULDBLOCK;
         }
@@ -2103,7 +2115,7 @@ ENGINE_ERROR_CODE VBucket::deleteItem(
                         return ENGINE_KEY_ENOENT;
                     }
                 } else if (htRes.committed->isTempInitialItem()) {
-                    hbl.getHTLock().unlock();
+                    hbl.unlock();
                     bgFetch(cHandle.getKey(), cookie, engine, true);
                     return ENGINE_EWOULDBLOCK;
                 } else { // Non-existent or deleted key.
@@ -2363,13 +2375,13 @@ ENGINE_ERROR_CODE VBucket::deleteWithMeta(
         }
         // we unlock ht lock here because we want to avoid potential lock
         // inversions arising from notifyNewSeqno() call
-        hbl.getHTLock().unlock();
+        hbl.unlock();
         notifyNewSeqno(*notifyCtx);
         doCollectionsStats(cHandle, *notifyCtx);
         break;
     }
     case MutationStatus::NeedBgFetch:
-        hbl.getHTLock().unlock();
+        hbl.unlock();
         bgFetch(key, cookie, engine, metaBgFetch);
         return ENGINE_EWOULDBLOCK;
 
@@ -2429,7 +2441,7 @@ void VBucket::deleteExpiredItem(const Item& it,
                     processExpiredItem(hbl, *result.storedValue, cHandle);
             // we unlock ht lock here because we want to avoid potential lock
             // inversions arising from notifyNewSeqno() call
-            hbl.getHTLock().unlock();
+            hbl.unlock();
             notifyNewSeqno(notifyCtx);
             doCollectionsStats(cHandle, notifyCtx);
         }
@@ -2475,7 +2487,7 @@ void VBucket::deleteExpiredItem(const Item& it,
                     processExpiredItem(hbl, *result.storedValue, cHandle);
             // we unlock ht lock here because we want to avoid potential
             // lock inversions arising from notifyNewSeqno() call
-            hbl.getHTLock().unlock();
+            hbl.unlock();
             notifyNewSeqno(notifyCtx);
             doCollectionsStats(cHandle, notifyCtx);
         }
@@ -2535,7 +2547,7 @@ ENGINE_ERROR_CODE VBucket::add(
             return addTempItemAndBGFetch(
                     hbl, itm.getKey(), cookie, engine, true);
         case AddStatus::BgFetch:
-            hbl.getHTLock().unlock();
+            hbl.unlock();
             bgFetch(itm.getKey(), cookie, engine, true);
             return ENGINE_EWOULDBLOCK;
         case AddStatus::Success:
@@ -2615,7 +2627,7 @@ std::pair<MutationStatus, GetValue> VBucket::processGetAndUpdateTtl(
             rv.item->setCas(v->getCas());
             // we unlock ht lock here because we want to avoid potential lock
             // inversions arising from notifyNewSeqno() call
-            hbl.getHTLock().unlock();
+            hbl.unlock();
             notifyNewSeqno(notifyCtx);
             doCollectionsStats(cHandle, notifyCtx);
         }
@@ -2686,6 +2698,49 @@ GetValue VBucket::getInternal(
     const bool getDeletedValue = (options & GET_DELETED_VALUE);
     const bool bgFetchRequired = (options & QUEUE_BG_FETCH);
 
+    // Fast path: attempt to read the item without acquiring the
+    // HashBucketLock. Only the cases which do not need to modify the
+    // HashTable (expire the item, cleanup temp items, bgFetch) are handled
+    // here; the remainder fall through to the locked path below.
+    if (optimisticReads) {
+        std::optional<GetValue> result;
+        auto reader = [&](const StoredValue* v) {
+            if (!v) {
+                if (!getDeletedValue && (eviction == EvictionPolicy::Value)) {
+                    result = GetValue();
+                    return true;
+                }
+                return false;
+            }
+            if (v->isTempItem() ||
+                (!v->isDeleted() && v->isExpired(ep_real_time()))) {
+                return false;
+            }
+            if (v->isPreparedMaybeVisible()) {
+                result = GetValue(nullptr,
+                                  ENGINE_SYNC_WRITE_RECOMMIT_IN_PROGRESS);
+                return true;
+            }
+            if ((v->isDeleted() && !getDeletedValue) ||
+                cHandle.isLogicallyDeleted(v->getBySeqno())) {
+                result = GetValue();
+                return true;
+            }
+            if (!v->isResident() && !metadataOnly) {
+                return false;
+            }
+            result = getInternalResident(*v, options, getKeyOnly);
+            return true;
+        };
+        if (ht.findForReadOptimistic(cHandle.getKey(),
+                                     trackReference,
+                                     WantsDeleted::Yes,
+                                     getReplicaItem,
+                                     reader)) {
+            return std::move(*result);
+        }
+    }
+
     auto res = fetchValidValue(WantsDeleted::Yes,
                                trackReference,
                                QueueExpired::Yes,
@@ -2740,28 +2795,7 @@ GetValue VBucket::getInternal(
                     cHandle.getKey(), cookie, engine, queueBgFetch, *v);
         }
 
-        std::unique_ptr<Item> item;
-        if (getKeyOnly == GetKeyOnly::Yes) {
-            item = v->toItem(getId(),
-                             StoredValue::HideLockedCas::No,
-                             StoredValue::IncludeValue::No);
-        } else {
-            const auto hideLockedCas =
-                    ((options & HIDE_LOCKED_CAS) &&
-                                     v->isLocked(ep_current_time())
-                             ? StoredValue::HideLockedCas::Yes
-                             : StoredValue::HideLockedCas::No);
-            item = v->toItem(getId(), hideLockedCas);
-        }
-
-        if (options & TRACK_STATISTICS) {
-            opsGet++;
-        }
-
-        return GetValue(std::move(item),
-                        ENGINE_SUCCESS,
-                        v->getBySeqno(),
-                        !v->isResident());
+        return getInternalResident(*v, options, getKeyOnly);
     } else {
         if (!getDeletedValue && (eviction == EvictionPolicy::Value)) {
             return GetValue();
@@ -2785,6 +2819,30 @@ GetValue VBucket::getInternal(
     }
 }
 
+GetValue VBucket::getInternalResident(const StoredValue& v,
+                                     get_options_t options,
+                                     GetKeyOnly getKeyOnly) {
+    std::unique_ptr<Item> item;
+    if (getKeyOnly == GetKeyOnly::Yes) {
+        item = v.toItem(getId(),
+                        StoredValue::HideLockedCas::No,
+                        StoredValue::IncludeValue::No);
+    } else {
+        const auto hideLockedCas =
+                ((options & HIDE_LOCKED_CAS) && v.isLocked(ep_current_time())
+                         ? StoredValue::HideLockedCas::Yes
+                         : StoredValue::HideLockedCas::No);
+        item = v.toItem(getId(), hideLockedCas);
+    }
+
+    if (options & TRACK_STATISTICS) {
+        opsGet++;
+    }
+
+    return GetValue(
+            std::move(item), ENGINE_SUCCESS, v.getBySeqno(), !v.isResident());
+}
+
 ENGINE_ERROR_CODE VBucket::getMetaData(
         const void* cookie,
         EventuallyPersistentEngine& engine,
@@ -2874,7 +2932,7 @@ ENGINE_ERROR_CODE VBucket::getKeyStats(
             return ENGINE_KEY_ENOENT;
         }
         if (eviction == EvictionPolicy::Full && v->isTempInitialItem()) {
-            res.lock.getHTLock().unlock();
+            res.lock.unlock();
             bgFetch(cHandle.getKey(), cookie, engine, true);
             return ENGINE_EWOULDBLOCK;
         }
@@ -3653,8 +3711,8 @@ VBucket::processExpiredItem(
      * but functionally correct and for performance reasons
      * only the system xattrs need to be stored.
      */
-    value_t value = v.getValue();
-    bool onlyMarkDeleted = value && mcbp::datatype::is_xattr(v.getDatatype());
+    bool onlyMarkDeleted =
+            v.hasValue() && mcbp::datatype::is_xattr(v.getDatatype());
     v.setRevSeqno(v.getRevSeqno() + 1);
     VBNotifyCtx notifyCtx;
     StoredValue* newSv;
@@ -3884,9 +3942,8 @@ std::unique_ptr<Item> VBucket::pruneXattrDocument(
     // Need to take a copy of the value, prune it, and add it back
 
     // Create work-space document
-    std::vector<char> workspace(
-            v.getValue()->getData(),
-            v.getValue()->getData() + v.getValue()->valueSize());
+    const auto value = v.getValueView();
+    std::vector<char> workspace(value.begin(), value.end());
 
     // Now attach to the XATTRs in the document
     cb::xattr::Blob xattr({workspace.data(), workspace.size()},
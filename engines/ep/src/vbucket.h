@@ -341,6 +341,12 @@ public:
      */
     size_t getSyncWriteAbortedCount() const;
 
+    /**
+     * @returns the number of SyncWrites currently tracked (in-flight) by the
+     * DurabilityMonitor for this vbucket.
+     */
+    size_t getSyncWriteTrackedCount() const;
+
     bool isTakeoverBackedUp() {
         return takeover_backed_up.load();
     }
@@ -1335,6 +1341,18 @@ public:
             const Collections::VB::Manifest::CachingReadHandle& cHandle,
             ForGetReplicaOp getReplicaItem = ForGetReplicaOp::No);
 
+    /**
+     * Build the result of getInternal() for a StoredValue which can be
+     * returned without any further fetch or modification.
+     *
+     * @param v the StoredValue found for the key
+     * @param options flags as passed to getInternal()
+     * @param getKeyOnly if GetKeyOnly::Yes we want only the key
+     */
+    GetValue getInternalResident(const StoredValue& v,
+                                 get_options_t options,
+                                 GetKeyOnly getKeyOnly);
+
     /**
      * Retrieve the meta data for given key
      *
@@ -1755,6 +1773,10 @@ public:
      */
     const size_t maxAllowedReplicasForSyncWrites;
 
+    /// Should getInternal() first attempt to read without taking the
+    /// HashBucketLock? (See HashTable::findForReadOptimistic()).
+    const bool optimisticReads;
+
     /**
      * A custom delete function for deleting VBucket objects. Any thread could
      * be the last thread to release a VBucketPtr and deleting a VB will
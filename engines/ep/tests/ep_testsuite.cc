@@ -6787,18 +6787,24 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_dcp_max_running_backfills",
               "ep_dcp_num_running_backfills",
               "ep_dcp_producer_count",
+              "ep_dcp_producer_flow_control_mem_budget",
+              "ep_dcp_producer_unacked_bytes",
               "ep_dcp_queue_fill",
               "ep_dcp_total_bytes",
               "ep_dcp_total_uncompressed_data_size",
               "ep_dcp_total_queue"}},
             {"hash",
              {"vb_0:counted",
+              "vb_0:lock_contended",
+              "vb_0:lock_wait_us",
               "vb_0:locks",
               "vb_0:max_depth",
               "vb_0:mem_size",
               "vb_0:mem_size_counted",
               "vb_0:min_depth",
               "vb_0:num_system_items",
+              "vb_0:opt_read_fallbacks",
+              "vb_0:opt_reads",
               "vb_0:reported",
               "vb_0:resized",
               "vb_0:size",
@@ -6943,6 +6949,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_data_traffic_enabled",
               "ep_dbname",
               "ep_dcp_backfill_byte_limit",
+              "ep_dcp_backfill_shared_scans",
               "ep_dcp_conn_buffer_size",
               "ep_dcp_conn_buffer_size_aggr_mem_threshold",
               "ep_dcp_conn_buffer_size_aggressive_perc",
@@ -6954,9 +6961,12 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_dcp_idle_timeout",
               "ep_dcp_noop_mandatory_for_v5_features",
               "ep_dcp_noop_tx_interval",
+              "ep_dcp_producer_adaptive_flow_control",
+              "ep_dcp_producer_flow_control_mem_threshold",
               "ep_dcp_producer_snapshot_marker_yield_limit",
               "ep_dcp_consumer_process_buffered_messages_yield_limit",
               "ep_dcp_consumer_process_buffered_messages_batch_size",
+              "ep_dcp_consumer_process_buffered_messages_tasks",
               "ep_dcp_scan_byte_limit",
               "ep_dcp_scan_item_limit",
               "ep_dcp_takeover_max_time",
@@ -6966,22 +6976,36 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_defragmenter_interval",
               "ep_defragmenter_stored_value_age_threshold",
               "ep_durability_timeout_task_interval",
+              "ep_executor_pool_future_queue",
+              "ep_executor_pool_numa_aware",
+              "ep_executor_pool_work_stealing",
               "ep_exp_pager_enabled",
               "ep_exp_pager_initial_run_time",
               "ep_exp_pager_stime",
               "ep_failpartialwarmup",
+              "ep_flusher_batch_auto_tune",
+              "ep_flusher_batch_target_latency_ms",
+              "ep_flusher_group_commit",
+              "ep_flusher_pipelined",
               "ep_flusher_total_batch_limit",
               "ep_fsync_after_every_n_bytes_written",
               "ep_couchstore_tracing",
               "ep_couchstore_write_validation",
               "ep_couchstore_mprotect",
+              "ep_couchstore_bg_fetch_prefetch",
+              "ep_couchstore_io_backend",
+              "ep_couchstore_io_uring_direct_reads",
               "ep_getl_default_timeout",
               "ep_getl_max_timeout",
               "ep_hlc_drift_ahead_threshold_us",
               "ep_hlc_drift_behind_threshold_us",
+              "ep_ht_inline_value_threshold",
+              "ep_ht_layout",
               "ep_ht_locks",
+              "ep_ht_optimistic_reads",
               "ep_ht_resize_interval",
               "ep_ht_size",
+              "ep_ht_slab_allocator",
               "ep_item_compressor_chunk_duration",
               "ep_item_compressor_interval",
               "ep_item_eviction_age_percentage",
@@ -7148,12 +7172,14 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_data_traffic_enabled",
               "ep_dbname",
               "ep_dcp_backfill_byte_limit",
+              "ep_dcp_backfill_shared_scans",
               "ep_dcp_conn_buffer_size",
               "ep_dcp_conn_buffer_size_aggr_mem_threshold",
               "ep_dcp_conn_buffer_size_aggressive_perc",
               "ep_dcp_conn_buffer_size_max",
               "ep_dcp_conn_buffer_size_perc",
               "ep_dcp_consumer_process_buffered_messages_batch_size",
+              "ep_dcp_consumer_process_buffered_messages_tasks",
               "ep_dcp_consumer_process_buffered_messages_yield_limit",
               "ep_dcp_enable_noop",
               "ep_dcp_flow_control_policy",
@@ -7161,6 +7187,8 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_dcp_min_compression_ratio",
               "ep_dcp_noop_mandatory_for_v5_features",
               "ep_dcp_noop_tx_interval",
+              "ep_dcp_producer_adaptive_flow_control",
+              "ep_dcp_producer_flow_control_mem_threshold",
               "ep_dcp_producer_snapshot_marker_yield_limit",
               "ep_dcp_scan_byte_limit",
               "ep_dcp_scan_item_limit",
@@ -7180,6 +7208,9 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_diskqueue_memory",
               "ep_diskqueue_pending",
               "ep_durability_timeout_task_interval",
+              "ep_executor_pool_future_queue",
+              "ep_executor_pool_numa_aware",
+              "ep_executor_pool_work_stealing",
               "ep_exp_pager_enabled",
               "ep_exp_pager_initial_run_time",
               "ep_exp_pager_stime",
@@ -7189,18 +7220,29 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_expiry_pager_task_time",
               "ep_failpartialwarmup",
               "ep_flush_duration_total",
+              "ep_flusher_batch_auto_tune",
+              "ep_flusher_batch_target_latency_ms",
+              "ep_flusher_group_commit",
+              "ep_flusher_pipelined",
               "ep_flusher_total_batch_limit",
               "ep_fsync_after_every_n_bytes_written",
               "ep_couchstore_tracing",
               "ep_couchstore_write_validation",
               "ep_couchstore_mprotect",
+              "ep_couchstore_bg_fetch_prefetch",
+              "ep_couchstore_io_backend",
+              "ep_couchstore_io_uring_direct_reads",
               "ep_getl_default_timeout",
               "ep_getl_max_timeout",
               "ep_hlc_drift_ahead_threshold_us",
               "ep_hlc_drift_behind_threshold_us",
+              "ep_ht_inline_value_threshold",
+              "ep_ht_layout",
               "ep_ht_locks",
+              "ep_ht_optimistic_reads",
               "ep_ht_resize_interval",
               "ep_ht_size",
+              "ep_ht_slab_allocator",
               "ep_io_bg_fetch_read_count",
               "ep_io_compaction_read_bytes",
               "ep_io_compaction_write_bytes",
@@ -7521,6 +7563,11 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
         eng_stats.insert(eng_stats.end(),
                          std::initializer_list<std::string>{"ep_flusher_state",
                                                             "ep_flusher_todo"});
+        eng_stats.insert(eng_stats.end(),
+                         {"ep_flusher_batch_limit",
+                          "ep_flusher_batch_limit_increases",
+                          "ep_flusher_batch_limit_decreases",
+                          "ep_flusher_batch_p99_latency_us"});
         eng_stats.insert(eng_stats.end(),
                          {"ep_commit_num",
                           "ep_commit_time",
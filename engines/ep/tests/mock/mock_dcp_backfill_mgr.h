@@ -41,5 +41,9 @@ public:
         return scanBuffer;
     }
 
+    size_t getNumSnoozingBackfills() const {
+        return snoozingBackfills.size();
+    }
+
     using BackfillManager::getNumBackfills;
 };
@@ -109,11 +109,6 @@ TEST_F(CheckpointRemoverEPTest, CheckpointManagerMemoryUsage) {
     // We should have one checkpoint which is for the state change
     ASSERT_EQ(1, checkpointManager->getNumCheckpoints());
 
-    // The queue (toWrite) is implemented as std:list, therefore
-    // when we add an item it results in the creation of 3 pointers -
-    // forward ptr, backward ptr and ptr to object.
-    const size_t perElementOverhead = 3 * sizeof(uintptr_t);
-
     // Allocator used for tracking memory used by the CheckpointQueue
     checkpoint_index::allocator_type memoryTrackingAllocator;
     // Emulate the Checkpoint metaKeyIndex so we can determine the number
@@ -132,29 +127,23 @@ TEST_F(CheckpointRemoverEPTest, CheckpointManagerMemoryUsage) {
 
     // Check that the expected memory usage of the checkpoints is correct
     size_t expected_size = 0;
+    size_t queueEntries = 0;
     for (auto& checkpoint :
          CheckpointManagerTestIntrospector::public_getCheckpointList(
                  *checkpointManager)) {
         // Add the overhead of the Checkpoint object
         expected_size += sizeof(Checkpoint);
-#ifdef WIN32
-        // On windows for an empty list we still allocate space for
-        // containing one element.
-        expected_size += perElementOverhead;
-#if _DEBUG
-        // additional 16 bytes overhead in an empty list with Debug CRT.
-        expected_size += 16;
-#endif
-#endif
 
+        queueEntries = 0;
         for (auto& itr : *checkpoint) {
             // Add the size of the item
             expected_size += itr->size();
-            // Add the size of adding to the queue
-            expected_size += perElementOverhead;
             // Add to the emulated metaKeyIndex
             metaKeyIndex.emplace(itr->getKey(), entry);
+            queueEntries++;
         }
+        // Add the chunks allocated by the queue (toWrite)
+        expected_size += getCheckpointQueueAllocation(queueEntries);
     }
 
     const auto metaKeyIndexSize =
@@ -168,8 +157,10 @@ TEST_F(CheckpointRemoverEPTest, CheckpointManagerMemoryUsage) {
     size_t new_expected_size = expected_size;
     // Add the size of the item
     new_expected_size += item.size();
-    // Add the size of adding to the queue
-    new_expected_size += perElementOverhead;
+    // Add the size of adding to the queue (non-zero only if the item did not
+    // fit in the last allocated chunk)
+    new_expected_size += getCheckpointQueueAllocation(queueEntries + 1) -
+                         getCheckpointQueueAllocation(queueEntries);
     // Add to the keyIndex
     committedKeyIndex.emplace(item.getKey(), entry);
 
@@ -255,10 +246,12 @@ TEST_F(CheckpointRemoverEPTest, CursorDropMemoryFreed) {
 
     createDcpStream(*producer);
 
-    // The queue (toWrite) is implemented as std:list, therefore
-    // when we add an item it results in the creation of 3 pointers -
-    // forward ptr, backward ptr and ptr to object.
-    const size_t perElementOverhead = 3 * sizeof(uintptr_t);
+    // Number of entries in the queue (toWrite) of the checkpoint before we
+    // add any items; initialSize already includes the chunks for these.
+    const auto initialQueueEntries = getCheckpointQueueEntries(
+            *CheckpointManagerTestIntrospector::public_getCheckpointList(
+                     *checkpointManager)
+                     .front());
 
     // Allocator used for tracking memory used by the CheckpointQueue
     checkpoint_index::allocator_type memoryTrackingAllocator;
@@ -281,8 +274,6 @@ TEST_F(CheckpointRemoverEPTest, CursorDropMemoryFreed) {
         std::string doc_key = "key_" + std::to_string(i);
         Item item = store_item(vbid, makeStoredDocKey(doc_key), "value");
         expectedFreedMemoryFromItems += item.size();
-        // Add the size of adding to the queue
-        expectedFreedMemoryFromItems += perElementOverhead;
         // Add to the emulated keyIndex
         keyIndex.emplace(item.getKey(), entry);
     }
@@ -311,8 +302,11 @@ TEST_F(CheckpointRemoverEPTest, CursorDropMemoryFreed) {
 
     // Add the size of the checkpoint end
     expectedFreedMemoryFromItems += chkptEnd->size();
-    // Add the size of adding to the queue
-    expectedFreedMemoryFromItems += perElementOverhead;
+    // Add the size of adding the items and the checkpoint end to the queue
+    expectedFreedMemoryFromItems +=
+            getCheckpointQueueAllocation(initialQueueEntries +
+                                         getMaxCheckpointItems(*vb) + 1) -
+            getCheckpointQueueAllocation(initialQueueEntries);
     // Add to the emulated keyIndex
     keyIndex.emplace(chkptEnd->getKey(), entry);
 
@@ -1647,6 +1647,12 @@ TEST_P(CheckpointTest, dedupeMemoryTest) {
 TEST_P(CheckpointTest, checkpointMemoryTest) {
     // Get the intial size of the checkpoint.
     auto initialSize = this->manager->getMemoryUsage();
+    // Number of entries in the queue (toWrite); initialSize already includes
+    // the chunks for these.
+    const auto initialQueueEntries = getCheckpointQueueEntries(
+            *CheckpointManagerTestIntrospector::public_getCheckpointList(
+                     *(this->manager))
+                     .front());
 
     // Allocator used for tracking memory used by the CheckpointQueue
     checkpoint_index::allocator_type memoryTrackingAllocator;
@@ -1683,18 +1689,14 @@ TEST_P(CheckpointTest, checkpointMemoryTest) {
                               GenerateCas::Yes,
                               /*preLinkDocCtx*/ nullptr);
 
-    // The queue (toWrite) is implemented as std:list, therefore
-    // when we add an item it results in the creation of 3 pointers -
-    // forward ptr, backward ptr and ptr to object.
-    const size_t perElementOverhead = 3 * sizeof(uintptr_t);
-
     // Check that checkpoint size is the initial size plus the addition of
     // qiSmall.
     auto expectedSize = initialSize;
     // Add the size of the item
     expectedSize += qiSmall->size();
     // Add the size of adding to the queue
-    expectedSize += perElementOverhead;
+    expectedSize += getCheckpointQueueAllocation(initialQueueEntries + 1) -
+                    getCheckpointQueueAllocation(initialQueueEntries);
     // Add to the emulated keyIndex
     keyIndex.emplace(qiSmall->getKey(), entry);
 
@@ -1727,8 +1729,11 @@ TEST_P(CheckpointTest, checkpointMemoryTest) {
     expectedSize = initialSize;
     // Add the size of the item
     expectedSize += qiBig->size();
-    // Add the size of adding to the queue
-    expectedSize += perElementOverhead;
+    // Add the size of adding to the queue. De-duplication only clears the
+    // slot of qiSmall (the tail chunk is never compacted), so the queue has
+    // used two slots.
+    expectedSize += getCheckpointQueueAllocation(initialQueueEntries + 2) -
+                    getCheckpointQueueAllocation(initialQueueEntries);
     // Add to the keyIndex
     keyIndex.emplace(qiBig->getKey(), entry);
 
@@ -1772,6 +1777,10 @@ TEST_P(CheckpointTest, checkpointMemoryTest) {
 TEST_P(CheckpointTest, checkpointTrackingMemoryOverheadTest) {
     // Get the intial size of the checkpoint overhead.
     const auto initialOverhead = this->manager->getMemoryOverhead();
+    const auto initialQueueEntries = getCheckpointQueueEntries(
+            *CheckpointManagerTestIntrospector::public_getCheckpointList(
+                     *(this->manager))
+                     .front());
 
     // Allocator used for tracking memory used by the CheckpointQueue
     checkpoint_index::allocator_type memoryTrackingAllocator;
@@ -1811,13 +1820,15 @@ TEST_P(CheckpointTest, checkpointTrackingMemoryOverheadTest) {
 
     // Re-measure the checkpoint overhead
     const auto updatedOverhead = this->manager->getMemoryOverhead();
-    // Three pointers - forward, backward and pointer to item
-    const auto perElementListOverhead = sizeof(uintptr_t) * 3;
+    // Non-zero only if a new chunk had to be allocated for the item
+    const auto queueOverhead =
+            getCheckpointQueueAllocation(initialQueueEntries + 1) -
+            getCheckpointQueueAllocation(initialQueueEntries);
     // Add entry into keyIndex
     keyIndex.emplace(qiSmall->getKey(), entry);
 
     const auto keyIndexSize = *(keyIndex.get_allocator().getBytesAllocated());
-    EXPECT_EQ(perElementListOverhead + (keyIndexSize - initialKeyIndexSize),
+    EXPECT_EQ(queueOverhead + (keyIndexSize - initialKeyIndexSize),
               updatedOverhead - initialOverhead);
 
     bool isLastMutationItem;
@@ -2237,39 +2248,132 @@ TEST_P(CheckpointTest, expelCheckpointItemsMemoryRecoveredTest) {
     // Get the memory usage after expelling
     auto checkpointMemoryUsageAfterExpel = this->manager->getMemoryUsage();
 
-    size_t extra = 0;
-    // A list is comprised of 3 pointers (forward, backwards and
-    // pointer to the element).
-    const size_t perElementOverhead = extra + (3 * sizeof(uintptr_t));
-#if WIN32
-    // On windows for an empty list we still allocate space for
-    // containing one element.
-    extra = perElementOverhead;
-#if _DEBUG
-    // additional 16 bytes overhead in an empty list with Debug CRT.
-    extra += 16;
-#endif
-#endif
-
     const size_t reductionInCheckpointMemoryUsage =
             checkpointMemoryUsageBeforeExpel - checkpointMemoryUsageAfterExpel;
-    const size_t checkpointListSaving =
-            (perElementOverhead * expelResult.expelCount);
+    // All of the items share the first chunk of the queue with the remaining
+    // items, so no queue memory is recovered - only that of the items.
     const auto& checkpointStartItem =
             this->manager->public_createCheckpointItem(
                     0, Vbid(0), queue_op::checkpoint_start);
-    const size_t queuedItemSaving =
-            checkpointStartItem->size() + (sizeOfItem * (itemCount - 1));
     const size_t expectedMemoryRecovered =
-            checkpointListSaving + queuedItemSaving;
+            checkpointStartItem->size() + (sizeOfItem * (itemCount - 1));
 
     EXPECT_EQ(3, expelResult.expelCount);
-    EXPECT_EQ(expectedMemoryRecovered,
-              expelResult.estimateOfFreeMemory - extra);
+    EXPECT_EQ(expectedMemoryRecovered, expelResult.estimateOfFreeMemory);
     EXPECT_EQ(expectedMemoryRecovered, reductionInCheckpointMemoryUsage);
     EXPECT_EQ(3, this->global_stats.itemsExpelledFromCheckpoints);
 }
 
+// Test that expelling items which fill whole chunks of the checkpoint queue
+// releases those chunks, and that the estimate of the memory recovered
+// accounts for them.
+TEST_P(CheckpointTest, expelCheckpointItemsReleasesQueueChunks) {
+    const int itemCount = 2 * CheckpointQueue::maxChunkSize;
+
+    for (auto ii = 0; ii < itemCount; ++ii) {
+        ASSERT_TRUE(this->queueNewItem("key" + std::to_string(ii)));
+    }
+    ASSERT_EQ(1, this->manager->getNumCheckpoints());
+
+    // Move the cursor to the second to last item; everything before it
+    // (including the first queue chunk) can be expelled.
+    bool isLastMutationItem{true};
+    for (auto ii = 0; ii < itemCount; ++ii) {
+        manager->nextItem(cursor, isLastMutationItem);
+        ASSERT_FALSE(isLastMutationItem);
+    }
+
+    const auto& checkpoint =
+            *CheckpointManagerTestIntrospector::public_getCheckpointList(
+                     *(this->manager))
+                     .front();
+    const auto queueMemoryBeforeExpel = checkpoint.getWriteQueueChunkBytes();
+    const auto checkpointMemoryUsageBeforeExpel =
+            this->manager->getMemoryUsage();
+
+    auto expelResult = this->manager->expelUnreferencedCheckpointItems();
+    EXPECT_EQ(itemCount, expelResult.expelCount);
+
+    // All but the chunk holding the remaining item (and the new dummy) have
+    // been released from the checkpoint.
+    const auto queueMemoryReleased =
+            queueMemoryBeforeExpel - checkpoint.getWriteQueueChunkBytes();
+    EXPECT_LT(0, queueMemoryReleased);
+    EXPECT_GE(CheckpointQueue::getChunkAllocationSize(
+                      CheckpointQueue::maxChunkSize),
+              checkpoint.getWriteQueueChunkBytes());
+
+    EXPECT_EQ(checkpointMemoryUsageBeforeExpel -
+                      this->manager->getMemoryUsage(),
+              expelResult.estimateOfFreeMemory);
+}
+
+// De-duplicating a few hot keys interleaved with other keys must not leave
+// each of those other items pinning a mostly empty queue chunk: sparse chunks
+// are compacted, and the cursor and key index entries follow the items which
+// are moved.
+TEST_P(CheckpointTest, dedupCompactsQueueChunks) {
+    const int numColdKeys = 20;
+    const int numHotKeys = 4;
+    const auto queueHotKeys = [this]() {
+        for (size_t ii = 0; ii < CheckpointQueue::maxChunkSize; ++ii) {
+            this->queueNewItem("hot" + std::to_string(ii % numHotKeys));
+        }
+    };
+
+    // Queue the first few cold keys, and move the cursor to the last of them.
+    const int cursorColdKey = 5;
+    for (int cold = 0; cold <= cursorColdKey; ++cold) {
+        ASSERT_TRUE(this->queueNewItem("cold" + std::to_string(cold)));
+        queueHotKeys();
+    }
+    bool isLastMutationItem;
+    const auto cursorKey =
+            makeStoredDocKey("cold" + std::to_string(cursorColdKey));
+    while (manager->nextItem(cursor, isLastMutationItem)->getKey() !=
+           cursorKey) {
+        ASSERT_FALSE(isLastMutationItem);
+    }
+
+    for (int cold = cursorColdKey + 1; cold < numColdKeys; ++cold) {
+        ASSERT_TRUE(this->queueNewItem("cold" + std::to_string(cold)));
+        queueHotKeys();
+    }
+    ASSERT_EQ(1, this->manager->getNumCheckpoints());
+    EXPECT_EQ(numColdKeys + numHotKeys, this->manager->getNumOpenChkItems());
+
+    // Without compaction each cold key would pin a chunk of maxChunkSize.
+    const auto& checkpoint =
+            *CheckpointManagerTestIntrospector::public_getCheckpointList(
+                     *(this->manager))
+                     .front();
+    EXPECT_LT(checkpoint.getWriteQueueChunkBytes(),
+              numColdKeys *
+                      CheckpointQueue::getChunkAllocationSize(
+                              CheckpointQueue::maxChunkSize) /
+                      4);
+
+    // The key index still refers to the (moved) cold items, so they can be
+    // de-duplicated.
+    this->queueNewItem("cold0");
+    EXPECT_EQ(numColdKeys + numHotKeys, this->manager->getNumOpenChkItems());
+
+    // The cursor still follows the item it was at.
+    std::vector<queued_item> items;
+    manager->getItemsForCursor(cursor, items, 100000);
+    std::vector<std::string> keys;
+    for (const auto& item : items) {
+        if (!item->isCheckPointMetaItem()) {
+            keys.push_back(item->getKey().to_string());
+        }
+    }
+    ASSERT_EQ(numColdKeys - cursorColdKey - 1 + numHotKeys + 1, keys.size());
+    EXPECT_EQ(makeStoredDocKey("cold" + std::to_string(cursorColdKey + 1))
+                      .to_string(),
+              keys.front());
+    EXPECT_EQ(makeStoredDocKey("cold0").to_string(), keys.back());
+}
+
 TEST_P(CheckpointTest, InitialSnapshotDoesDoubleRefCheckpoint) {
     // Test to ensure that receiving an initial snapshot while
     // already holding cursors (in addition to the persistence cursor)
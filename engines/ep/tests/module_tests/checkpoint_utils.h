@@ -41,3 +41,17 @@ public:
         return cursor.currentPos;
     }
 };
+
+/**
+ * @return the bytes allocated by a CheckpointQueue after numEntries entries
+ *         (including the dummy item) have been appended to it, assuming none
+ *         have been expelled.
+ */
+inline size_t getCheckpointQueueAllocation(size_t numEntries) {
+    return CheckpointQueue::getAllocationForAppends(numEntries);
+}
+
+/// @return the number of entries (including the dummy item) in checkpoint.
+inline size_t getCheckpointQueueEntries(const Checkpoint& checkpoint) {
+    return std::distance(checkpoint.begin(), checkpoint.end());
+}
@@ -0,0 +1,299 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "chunked_queue.h"
+
+#include <folly/portability/GTest.h>
+#include <utilities/memory_tracking_allocator.h>
+
+#include <memory>
+#include <vector>
+
+/*
+ * Unit tests for the ChunkedQueue class.
+ */
+
+// Small (fixed size) chunks so tests can easily span several of them.
+using Queue = ChunkedQueue<std::shared_ptr<int>,
+                           MemoryTrackingAllocator<std::shared_ptr<int>>,
+                           4,
+                           4>;
+
+static const size_t chunkBytes = Queue::getChunkAllocationSize(4);
+
+class ChunkedQueueTest : public ::testing::Test {
+protected:
+    ChunkedQueueTest() : queue(allocator) {
+    }
+
+    void pushBack(int first, int last) {
+        for (int ii = first; ii < last; ++ii) {
+            queue.push_back(std::make_shared<int>(ii));
+        }
+    }
+
+    std::vector<int> contents(const Queue& q) const {
+        std::vector<int> result;
+        for (const auto& e : q) {
+            result.push_back(*e);
+        }
+        return result;
+    }
+
+    size_t bytesAllocated() const {
+        return *allocator.getBytesAllocated();
+    }
+
+    MemoryTrackingAllocator<std::shared_ptr<int>> allocator;
+    Queue queue;
+};
+
+TEST_F(ChunkedQueueTest, Empty) {
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(0, queue.size());
+    EXPECT_EQ(queue.begin(), queue.end());
+    EXPECT_EQ(0, bytesAllocated());
+}
+
+TEST_F(ChunkedQueueTest, PushBack) {
+    pushBack(0, 9);
+    EXPECT_EQ(9, queue.size());
+    EXPECT_EQ((std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7, 8}), contents(queue));
+
+    // One allocation per chunk of 4 elements.
+    EXPECT_EQ(3 * chunkBytes, bytesAllocated());
+    EXPECT_EQ(bytesAllocated(), queue.getAllocatedBytes());
+}
+
+TEST_F(ChunkedQueueTest, IterateBackwards) {
+    pushBack(0, 6);
+    std::vector<int> result;
+    auto it = queue.end();
+    do {
+        --it;
+        result.push_back(**it);
+    } while (it != queue.begin());
+    EXPECT_EQ((std::vector<int>{5, 4, 3, 2, 1, 0}), result);
+}
+
+// Erased elements are skipped, and iterators to other elements remain valid.
+TEST_F(ChunkedQueueTest, Erase) {
+    pushBack(0, 6);
+    auto two = std::next(queue.begin(), 2);
+    auto four = std::next(queue.begin(), 4);
+
+    auto next = queue.erase(std::next(queue.begin(), 3));
+    EXPECT_EQ(four, next);
+    EXPECT_EQ(5, queue.size());
+    EXPECT_EQ((std::vector<int>{0, 1, 2, 4, 5}), contents(queue));
+
+    EXPECT_EQ(2, **two);
+    EXPECT_EQ(four, std::next(two));
+    EXPECT_EQ(two, std::prev(four));
+
+    // Erasing the last element returns end().
+    EXPECT_EQ(queue.end(), queue.erase(std::next(queue.begin(), 4)));
+    EXPECT_EQ((std::vector<int>{0, 1, 2, 4}), contents(queue));
+}
+
+// A chunk whose elements have all been erased is freed, unless it is the
+// tail.
+TEST_F(ChunkedQueueTest, EraseFreesChunk) {
+    pushBack(0, 10);
+    ASSERT_EQ(3 * chunkBytes, bytesAllocated());
+
+    // Erase all elements of the second chunk.
+    auto it = std::next(queue.begin(), 4);
+    for (int ii = 0; ii < 4; ++ii) {
+        it = queue.erase(it);
+    }
+    EXPECT_EQ(8, **it);
+    EXPECT_EQ(2 * chunkBytes, bytesAllocated());
+    EXPECT_EQ((std::vector<int>{0, 1, 2, 3, 8, 9}), contents(queue));
+
+    // Erase the elements of the tail chunk; it is kept.
+    queue.erase(it);
+    queue.erase(std::next(queue.begin(), 4));
+    EXPECT_EQ(2 * chunkBytes, bytesAllocated());
+    EXPECT_EQ(4, queue.size());
+    EXPECT_EQ(std::prev(queue.end()), std::next(queue.begin(), 3));
+
+    // And is appended to.
+    pushBack(10, 11);
+    EXPECT_EQ(2 * chunkBytes, bytesAllocated());
+    EXPECT_EQ((std::vector<int>{0, 1, 2, 3, 10}), contents(queue));
+}
+
+TEST_F(ChunkedQueueTest, ExtractFront) {
+    pushBack(0, 10);
+    auto pos = std::next(queue.begin(), 6);
+    auto eight = std::next(queue.begin(), 8);
+
+    std::vector<std::shared_ptr<int>> partial;
+    partial.reserve(Queue::maxChunkSize);
+    auto extracted = queue.extractFront(pos, partial);
+    EXPECT_EQ((std::vector<int>{0, 1, 2, 3}), contents(extracted));
+    EXPECT_EQ(4, extracted.size());
+    ASSERT_EQ(2, partial.size());
+    EXPECT_EQ(4, *partial[0]);
+    EXPECT_EQ(5, *partial[1]);
+    EXPECT_EQ((std::vector<int>{6, 7, 8, 9}), contents(queue));
+    EXPECT_EQ(4, queue.size());
+
+    // Remaining iterators are still valid.
+    EXPECT_EQ(pos, queue.begin());
+    EXPECT_EQ(8, **eight);
+    EXPECT_EQ(pos, std::prev(std::prev(eight)));
+
+    // The whole first chunk was transferred; the two elements from the
+    // second chunk were moved to partial without allocating a chunk.
+    EXPECT_EQ(2 * chunkBytes, queue.getAllocatedBytes());
+    EXPECT_EQ(chunkBytes, extracted.getAllocatedBytes());
+    // Both share the same allocator.
+    EXPECT_EQ(3 * chunkBytes, bytesAllocated());
+
+    extracted.clear();
+    EXPECT_EQ(2 * chunkBytes, bytesAllocated());
+}
+
+TEST_F(ChunkedQueueTest, ExtractFrontAll) {
+    pushBack(0, 5);
+    std::vector<std::shared_ptr<int>> partial;
+    auto extracted = queue.extractFront(queue.end(), partial);
+    EXPECT_TRUE(partial.empty());
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(queue.begin(), queue.end());
+    EXPECT_EQ(0, queue.getAllocatedBytes());
+    EXPECT_EQ((std::vector<int>{0, 1, 2, 3, 4}), contents(extracted));
+
+    // Queue can be appended to again.
+    pushBack(5, 6);
+    EXPECT_EQ((std::vector<int>{5}), contents(queue));
+}
+
+TEST_F(ChunkedQueueTest, Move) {
+    pushBack(0, 5);
+    Queue other(std::move(queue));
+    EXPECT_EQ((std::vector<int>{0, 1, 2, 3, 4}), contents(other));
+
+    Queue assigned;
+    assigned = std::move(other);
+    EXPECT_EQ((std::vector<int>{0, 1, 2, 3, 4}), contents(assigned));
+    EXPECT_EQ(2 * chunkBytes, bytesAllocated());
+
+    // Memory is still accounted to the original allocator.
+    assigned.clear();
+    EXPECT_EQ(0, bytesAllocated());
+}
+
+// Elements are released when erased or when the queue is destroyed.
+TEST_F(ChunkedQueueTest, ElementLifetime) {
+    auto element = std::make_shared<int>(0);
+    queue.push_back(element);
+    queue.push_back(element);
+    EXPECT_EQ(3, element.use_count());
+
+    queue.erase(queue.begin());
+    EXPECT_EQ(2, element.use_count());
+
+    queue.clear();
+    EXPECT_EQ(1, element.use_count());
+}
+
+// Chunks start small and grow geometrically up to the maximum size.
+TEST(ChunkedQueueGrowthTest, ChunksGrow) {
+    using Growing = ChunkedQueue<std::shared_ptr<int>,
+                                 MemoryTrackingAllocator<std::shared_ptr<int>>,
+                                 16,
+                                 2>;
+    MemoryTrackingAllocator<std::shared_ptr<int>> allocator;
+    Growing queue(allocator);
+
+    queue.push_back(std::make_shared<int>(0));
+    EXPECT_EQ(Growing::getChunkAllocationSize(2),
+              *allocator.getBytesAllocated());
+
+    // Chunks of 2, 4, 8, 16, 16.
+    for (int ii = 1; ii < 40; ++ii) {
+        queue.push_back(std::make_shared<int>(ii));
+    }
+    const size_t expected = Growing::getChunkAllocationSize(2) +
+                            Growing::getChunkAllocationSize(4) +
+                            Growing::getChunkAllocationSize(8) +
+                            2 * Growing::getChunkAllocationSize(16);
+    EXPECT_EQ(expected, *allocator.getBytesAllocated());
+    EXPECT_EQ(expected, queue.getAllocatedBytes());
+    EXPECT_EQ(expected, Growing::getAllocationForAppends(40));
+}
+
+// Erasing (with relocation) most of the elements of a chunk moves the rest
+// to a smaller chunk, reporting where each moved element went.
+TEST(ChunkedQueueGrowthTest, EraseCompactsSparseChunk) {
+    using Growing = ChunkedQueue<std::shared_ptr<int>,
+                                 MemoryTrackingAllocator<std::shared_ptr<int>>,
+                                 8,
+                                 2>;
+    MemoryTrackingAllocator<std::shared_ptr<int>> allocator;
+    Growing queue(allocator);
+    // Chunks of 2, 4, 8 and 8 elements.
+    for (int ii = 0; ii < 22; ++ii) {
+        queue.push_back(std::make_shared<int>(ii));
+    }
+    const auto bytesBefore = queue.getAllocatedBytes();
+
+    // The third chunk holds 6..13; keep iterators to 9 and 12.
+    auto nine = std::next(queue.begin(), 9);
+    auto twelve = std::next(queue.begin(), 12);
+    size_t relocations = 0;
+    auto relocated = [&](Growing::iterator from, Growing::iterator to) {
+        ++relocations;
+        if (from == nine) {
+            nine = to;
+        } else if (from == twelve) {
+            twelve = to;
+        }
+    };
+
+    // Erase all but two elements of the chunk; the last erase leaves it a
+    // quarter full and compacts it.
+    Growing::iterator next;
+    for (int value : {6, 7, 8, 10, 11, 13}) {
+        auto it = queue.begin();
+        while (**it != value) {
+            ++it;
+        }
+        next = queue.erase(it, relocated);
+    }
+    EXPECT_EQ(2, relocations);
+    EXPECT_EQ(14, **next);
+    EXPECT_EQ(9, **nine);
+    EXPECT_EQ(12, **twelve);
+    EXPECT_EQ(twelve, std::next(nine));
+    EXPECT_EQ(nine, std::next(std::next(queue.begin(), 5)));
+    EXPECT_EQ(Growing::getChunkAllocationSize(8) -
+                      Growing::getChunkAllocationSize(2),
+              bytesBefore - queue.getAllocatedBytes());
+    EXPECT_EQ(*allocator.getBytesAllocated(), queue.getAllocatedBytes());
+
+    std::vector<int> result;
+    for (const auto& e : queue) {
+        result.push_back(*e);
+    }
+    EXPECT_EQ((std::vector<int>{
+                      0, 1, 2, 3, 4, 5, 9, 12, 14, 15, 16, 17, 18, 19, 20, 21}),
+              result);
+}
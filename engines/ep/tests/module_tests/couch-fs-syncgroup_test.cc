@@ -0,0 +1,318 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "src/couch-kvstore/couch-fs-syncgroup.h"
+
+#include <folly/portability/GTest.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+class SyncGroupOpsTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        path = "couch-fs-syncgroup_test." + std::to_string(getpid());
+        std::remove(path.c_str());
+        handle = ops.constructor(&errinfo);
+        ASSERT_EQ(COUCHSTORE_SUCCESS,
+                  ops.open(&errinfo, &handle, path.c_str(), O_RDWR | O_CREAT));
+    }
+
+    void TearDown() override {
+        if (handle) {
+            ops.close(&errinfo, handle);
+            ops.destructor(handle);
+        }
+        std::remove(path.c_str());
+    }
+
+    void write(const std::vector<uint8_t>& data, cs_off_t offset) {
+        ASSERT_EQ(ssize_t(data.size()),
+                  ops.pwrite(&errinfo,
+                             handle,
+                             data.data(),
+                             data.size(),
+                             offset));
+    }
+
+    /// @return the size of the file, as seen by the OS.
+    off_t sizeOnDisk() const {
+        struct stat st;
+        EXPECT_EQ(0, stat(path.c_str(), &st));
+        return st.st_size;
+    }
+
+    SyncGroupOps ops{*couchstore_get_default_file_ops()};
+    std::string path;
+    couchstore_error_info_t errinfo{};
+    couch_file_handle handle = nullptr;
+};
+
+// Outside of a group, syncs and writes go straight to the wrapped ops.
+TEST_F(SyncGroupOpsTest, NoGroup) {
+    write(std::vector<uint8_t>(10, 1), 0);
+    EXPECT_EQ(COUCHSTORE_SUCCESS, ops.sync(&errinfo, handle));
+    EXPECT_EQ(10, sizeOnDisk());
+    EXPECT_FALSE(ops.isInGroup());
+}
+
+// Writes after a deferred sync are held (but readable) until the group
+// completes.
+TEST_F(SyncGroupOpsTest, DeferredSync) {
+    std::vector<uint8_t> data(5000);
+    std::iota(data.begin(), data.end(), 0);
+    const std::vector<uint8_t> header(100, 0xab);
+
+    ops.beginGroup();
+    EXPECT_TRUE(ops.isInGroup());
+    write(data, 0);
+    EXPECT_EQ(COUCHSTORE_SUCCESS, ops.sync(&errinfo, handle));
+    write(header, data.size());
+    EXPECT_EQ(COUCHSTORE_SUCCESS, ops.sync(&errinfo, handle));
+
+    EXPECT_EQ(5000, sizeOnDisk());
+    EXPECT_EQ(5100, ops.goto_eof(&errinfo, handle));
+    std::vector<uint8_t> read(200);
+    EXPECT_EQ(150, ops.pread(&errinfo, handle, read.data(), 200, 4950));
+    EXPECT_EQ(data[4950], read[0]);
+    EXPECT_EQ(0xab, read[50]);
+    EXPECT_EQ(0xab, read[149]);
+
+    // Closing the file is deferred too.
+    EXPECT_EQ(COUCHSTORE_SUCCESS, ops.close(&errinfo, handle));
+    ops.destructor(handle);
+    handle = nullptr;
+
+    EXPECT_EQ(COUCHSTORE_SUCCESS, ops.completeGroup(&errinfo));
+    EXPECT_FALSE(ops.isInGroup());
+    EXPECT_EQ(5100, sizeOnDisk());
+}
+
+// syncfs() is only used as the barrier where it reports writeback errors.
+TEST_F(SyncGroupOpsTest, SyncfsOnlyIfReliable) {
+    EXPECT_EQ(SyncGroupOps::isSyncfsReliable(), ops.enableSyncfs("."));
+
+    std::vector<uint8_t> data(100, 1);
+    ops.beginGroup();
+    write(data, 0);
+    EXPECT_EQ(COUCHSTORE_SUCCESS, ops.sync(&errinfo, handle));
+    write(data, data.size());
+    EXPECT_EQ(COUCHSTORE_SUCCESS, ops.completeGroup(&errinfo));
+    EXPECT_EQ(200, sizeOnDisk());
+}
+
+TEST_F(SyncGroupOpsTest, SyncfsNeedsDirectory) {
+    EXPECT_FALSE(ops.enableSyncfs(path + ".missing"));
+}
+
+TEST_F(SyncGroupOpsTest, OneGroupAtATime) {
+    ops.beginGroup();
+    EXPECT_THROW(ops.beginGroup(), std::logic_error);
+    EXPECT_EQ(COUCHSTORE_SUCCESS, ops.completeGroup(&errinfo));
+    EXPECT_THROW(ops.completeGroup(&errinfo), std::logic_error);
+}
+
+/**
+ * FileOps which forwards to the default ops, but makes each sync take a
+ * while and records how many syncs were in progress at once.
+ */
+class SlowSyncOps : public FileOpsInterface {
+public:
+    couch_file_handle constructor(couchstore_error_info_t* errinfo) override {
+        return ops.constructor(errinfo);
+    }
+    couchstore_error_t open(couchstore_error_info_t* errinfo,
+                            couch_file_handle* handle,
+                            const char* path,
+                            int oflag) override {
+        return ops.open(errinfo, handle, path, oflag);
+    }
+    couchstore_error_t close(couchstore_error_info_t* errinfo,
+                             couch_file_handle handle) override {
+        return ops.close(errinfo, handle);
+    }
+    couchstore_error_t set_periodic_sync(couch_file_handle handle,
+                                         uint64_t period_bytes) override {
+        return ops.set_periodic_sync(handle, period_bytes);
+    }
+    couchstore_error_t set_tracing_enabled(couch_file_handle handle) override {
+        return ops.set_tracing_enabled(handle);
+    }
+    couchstore_error_t set_write_validation_enabled(
+            couch_file_handle handle) override {
+        return ops.set_write_validation_enabled(handle);
+    }
+    couchstore_error_t set_mprotect_enabled(couch_file_handle handle) override {
+        return ops.set_mprotect_enabled(handle);
+    }
+    ssize_t pread(couchstore_error_info_t* errinfo,
+                  couch_file_handle handle,
+                  void* buf,
+                  size_t nbytes,
+                  cs_off_t offset) override {
+        return ops.pread(errinfo, handle, buf, nbytes, offset);
+    }
+    ssize_t pwrite(couchstore_error_info_t* errinfo,
+                   couch_file_handle handle,
+                   const void* buf,
+                   size_t nbytes,
+                   cs_off_t offset) override {
+        return ops.pwrite(errinfo, handle, buf, nbytes, offset);
+    }
+    cs_off_t goto_eof(couchstore_error_info_t* errinfo,
+                      couch_file_handle handle) override {
+        return ops.goto_eof(errinfo, handle);
+    }
+    couchstore_error_t sync(couchstore_error_info_t* errinfo,
+                            couch_file_handle handle) override {
+        const auto number = ++started;
+        const auto now = ++inProgress;
+        auto seen = maxInProgress.load();
+        while (now > seen && !maxInProgress.compare_exchange_weak(seen, now)) {
+        }
+        std::this_thread::sleep_for(syncDuration);
+        ++syncs;
+        --inProgress;
+        if (number == failSync) {
+            errinfo->error = EIO;
+            return COUCHSTORE_ERROR_WRITE;
+        }
+        return ops.sync(errinfo, handle);
+    }
+    couchstore_error_t advise(couchstore_error_info_t* errinfo,
+                              couch_file_handle handle,
+                              cs_off_t offset,
+                              cs_off_t len,
+                              couchstore_file_advice_t advice) override {
+        return ops.advise(errinfo, handle, offset, len, advice);
+    }
+    FHStats* get_stats(couch_file_handle handle) override {
+        return ops.get_stats(handle);
+    }
+    void destructor(couch_file_handle handle) override {
+        ops.destructor(handle);
+    }
+
+    FileOpsInterface& ops = *couchstore_get_default_file_ops();
+    const std::chrono::milliseconds syncDuration{50};
+    std::atomic<int> inProgress{0};
+    std::atomic<int> maxInProgress{0};
+    std::atomic<int> syncs{0};
+    std::atomic<int> started{0};
+    /// The number (counting from 1) of the sync to fail, or 0 for none.
+    int failSync = 0;
+};
+
+/// Group commits of several files, over SlowSyncOps.
+class SyncGroupOpsConcurrencyTest
+    : public ::testing::TestWithParam<size_t> {
+protected:
+    void SetUp() override {
+        for (int ii = 0; ii < 4; ++ii) {
+            paths.push_back("couch-fs-syncgroup_test." +
+                            std::to_string(getpid()) + "." +
+                            std::to_string(ii));
+            std::remove(paths.back().c_str());
+            handles.push_back(ops.constructor(&errinfo));
+            ASSERT_EQ(COUCHSTORE_SUCCESS,
+                      ops.open(&errinfo,
+                               &handles.back(),
+                               paths.back().c_str(),
+                               O_RDWR | O_CREAT));
+        }
+    }
+
+    void TearDown() override {
+        for (size_t ii = 0; ii < handles.size(); ++ii) {
+            ops.close(&errinfo, handles[ii]);
+            ops.destructor(handles[ii]);
+            std::remove(paths[ii].c_str());
+        }
+    }
+
+    /// Write and sync each file within a group.
+    /// @return the time taken to complete the group, and its status
+    std::pair<std::chrono::steady_clock::duration, couchstore_error_t>
+    commitGroup() {
+        const std::vector<uint8_t> data(100, 1);
+        ops.beginGroup();
+        for (auto* handle : handles) {
+            EXPECT_EQ(ssize_t(data.size()),
+                      ops.pwrite(&errinfo,
+                                 handle,
+                                 data.data(),
+                                 data.size(),
+                                 0));
+            EXPECT_EQ(COUCHSTORE_SUCCESS, ops.sync(&errinfo, handle));
+        }
+        const auto start = std::chrono::steady_clock::now();
+        const auto status = ops.completeGroup(&errinfo);
+        return {std::chrono::steady_clock::now() - start, status};
+    }
+
+    SlowSyncOps slowOps;
+    SyncGroupOps ops{slowOps, GetParam()};
+    couchstore_error_info_t errinfo{};
+    std::vector<std::string> paths;
+    std::vector<couch_file_handle> handles;
+};
+
+// The syncs of a barrier are spread over the sync threads, so it costs
+// about one sync per thread rather than one per file.
+TEST_P(SyncGroupOpsConcurrencyTest, SyncsOverlap) {
+    const auto result = commitGroup();
+    EXPECT_EQ(COUCHSTORE_SUCCESS, result.second);
+    EXPECT_EQ(4, slowOps.syncs);
+    const auto threads = int(GetParam());
+    EXPECT_LE(slowOps.maxInProgress, threads);
+    if (threads == 1) {
+        EXPECT_EQ(1, slowOps.maxInProgress);
+        EXPECT_GE(result.first, 4 * slowOps.syncDuration);
+    } else {
+        // Generous bounds, to allow for scheduling delays.
+        EXPECT_GT(slowOps.maxInProgress, 1);
+        EXPECT_LT(result.first, 4 * slowOps.syncDuration);
+    }
+}
+
+// A failed sync fails the barrier with its error info, and no more of the
+// barrier's syncs are started.
+TEST_P(SyncGroupOpsConcurrencyTest, SyncFailure) {
+    slowOps.failSync = 2;
+    const auto result = commitGroup();
+    EXPECT_EQ(COUCHSTORE_ERROR_WRITE, result.second);
+    EXPECT_EQ(EIO, errinfo.error);
+    if (GetParam() == 1) {
+        EXPECT_EQ(2, slowOps.syncs);
+    } else {
+        EXPECT_LE(slowOps.syncs, 4);
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(SyncThreads,
+                         SyncGroupOpsConcurrencyTest,
+                         ::testing::Values(1, 2, 4),
+                         ::testing::PrintToStringParamName());
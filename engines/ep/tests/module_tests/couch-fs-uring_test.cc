@@ -0,0 +1,165 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "src/couch-kvstore/couch-fs-uring.h"
+
+#include <folly/portability/GTest.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <vector>
+
+/**
+ * Tests of IoUringOps, with and without direct (O_DIRECT) reads.
+ */
+class IoUringOpsTest : public ::testing::TestWithParam<bool> {
+protected:
+    void SetUp() override {
+        if (!IoUringOps::isSupported()) {
+            GTEST_SKIP() << "io_uring not supported";
+        }
+        ops = std::make_unique<IoUringOps>(GetParam());
+        path = "couch-fs-uring_test." + std::to_string(getpid());
+        std::remove(path.c_str());
+        handle = ops->constructor(&errinfo);
+        ASSERT_EQ(COUCHSTORE_SUCCESS,
+                  ops->open(&errinfo, &handle, path.c_str(), O_RDWR | O_CREAT));
+    }
+
+    void TearDown() override {
+        if (ops) {
+            ops->close(&errinfo, handle);
+            ops->destructor(handle);
+            std::remove(path.c_str());
+        }
+    }
+
+    void reopen() {
+        ASSERT_EQ(COUCHSTORE_SUCCESS, ops->close(&errinfo, handle));
+        ASSERT_EQ(COUCHSTORE_SUCCESS,
+                  ops->open(&errinfo, &handle, path.c_str(), O_RDWR));
+    }
+
+    /// @return size bytes of test data, starting with the given value.
+    static std::vector<uint8_t> makeData(size_t size, uint8_t first = 0) {
+        std::vector<uint8_t> data(size);
+        std::iota(data.begin(), data.end(), first);
+        return data;
+    }
+
+    void write(const std::vector<uint8_t>& data, cs_off_t offset) {
+        ASSERT_EQ(ssize_t(data.size()),
+                  ops->pwrite(&errinfo,
+                              handle,
+                              data.data(),
+                              data.size(),
+                              offset));
+    }
+
+    std::vector<uint8_t> read(size_t size, cs_off_t offset) {
+        std::vector<uint8_t> data(size);
+        const auto rv =
+                ops->pread(&errinfo, handle, data.data(), size, offset);
+        EXPECT_GE(rv, 0);
+        data.resize(std::max(rv, ssize_t(0)));
+        return data;
+    }
+
+    std::unique_ptr<IoUringOps> ops;
+    std::string path;
+    couchstore_error_info_t errinfo{};
+    couch_file_handle handle = nullptr;
+};
+
+TEST_P(IoUringOpsTest, OpenMissingFile) {
+    auto missing = ops->constructor(&errinfo);
+    EXPECT_EQ(COUCHSTORE_ERROR_NO_SUCH_FILE,
+              ops->open(&errinfo, &missing, "no_such_dir/file", O_RDONLY));
+    ops->destructor(missing);
+}
+
+TEST_P(IoUringOpsTest, WriteSyncRead) {
+    const auto first = makeData(100);
+    const auto second = makeData(5000, 100);
+    write(first, 0);
+    write(second, first.size());
+    ASSERT_EQ(COUCHSTORE_SUCCESS, ops->sync(&errinfo, handle));
+    EXPECT_EQ(cs_off_t(first.size() + second.size()),
+              ops->goto_eof(&errinfo, handle));
+
+    reopen();
+    EXPECT_EQ(first, read(first.size(), 0));
+    EXPECT_EQ(second, read(second.size(), first.size()));
+}
+
+// Data which is still buffered can be read back.
+TEST_P(IoUringOpsTest, ReadPendingWrite) {
+    const auto data = makeData(3000);
+    write(data, 0);
+    EXPECT_EQ(data, read(data.size(), 0));
+    // Spanning the end of the pending data.
+    write(data, data.size());
+    EXPECT_EQ(std::vector<uint8_t>(data.begin() + 1000, data.end()),
+              read(5000, 1000 + data.size()));
+}
+
+// Writes are submitted once maxPendingBytes are buffered.
+TEST_P(IoUringOpsTest, LargeWrites) {
+    const auto data = makeData(IoUringOps::maxPendingBytes / 2 + 1);
+    for (int ii = 0; ii < 5; ++ii) {
+        write(data, ii * data.size());
+    }
+    // Non-contiguous write.
+    write(data, 10 * data.size());
+    EXPECT_EQ(cs_off_t(11 * data.size()), ops->goto_eof(&errinfo, handle));
+    for (int ii : {0, 4, 10}) {
+        EXPECT_EQ(data, read(data.size(), ii * data.size()));
+    }
+}
+
+// Reads which aren't aligned, span several direct read buffers or extend
+// beyond EOF.
+TEST_P(IoUringOpsTest, UnalignedReads) {
+    const auto data = makeData(IoUringOps::directBufferSize * 2 + 123);
+    write(data, 0);
+    reopen();
+
+    EXPECT_EQ(std::vector<uint8_t>(data.begin() + 1, data.begin() + 10),
+              read(9, 1));
+    EXPECT_EQ(std::vector<uint8_t>(data.begin() + 4000, data.end()),
+              read(data.size(), 4000));
+    EXPECT_TRUE(read(10, data.size()).empty());
+}
+
+TEST_P(IoUringOpsTest, PeriodicSync) {
+    ASSERT_EQ(COUCHSTORE_SUCCESS, ops->set_periodic_sync(handle, 4096));
+    const auto data = makeData(IoUringOps::maxPendingBytes);
+    write(data, 0);
+    write(data, data.size());
+    EXPECT_EQ(data, read(data.size(), data.size()));
+}
+
+INSTANTIATE_TEST_SUITE_P(Direct,
+                         IoUringOpsTest,
+                         ::testing::Bool(),
+                         [](const ::testing::TestParamInfo<bool>& info) {
+                             return info.param ? "direct" : "buffered";
+                         });
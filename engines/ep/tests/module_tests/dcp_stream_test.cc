@@ -1710,6 +1710,50 @@ TEST_P(SingleThreadedActiveStreamTest, DiskSnapshotSendsChkMarker) {
     producer->cancelCheckpointCreatorTask();
 }
 
+/// Test that stepBatch() sends as many of the ready responses as fit in the
+/// given number of bytes in one call (and at least one).
+TEST_P(SingleThreadedActiveStreamTest, StepBatch) {
+    auto vb = engine->getVBucket(vbid);
+    auto& ckptMgr = *vb->checkpointManager;
+    // Get rid of set_vb_state and any other queue_op we are not interested in
+    ckptMgr.clear(*vb, 0 /*seqno*/);
+    stream.reset();
+
+    for (int ii = 0; ii < 3; ++ii) {
+        const auto key = makeStoredDocKey("key" + std::to_string(ii));
+        auto item = make_item(vbid, key, "value");
+        EXPECT_EQ(MutationStatus::WasClean,
+                  public_processSet(*vb, item, VBQueueItemCtx()));
+    }
+
+    recreateStream(*vb);
+    stream->next();
+    ASSERT_TRUE(stream->isInMemory());
+    auto outstanding = stream->public_getOutstandingItems(*vb);
+    stream->public_processItems(outstanding);
+    // SnapshotMarker and the 3 mutations
+    ASSERT_EQ(4, stream->public_readyQSize());
+
+    MockDcpMessageProducers producers(engine.get());
+    size_t nmessages = 0;
+    EXPECT_EQ(ENGINE_SUCCESS, producer->stepBatch(&producers, 1, nmessages));
+    EXPECT_EQ(1, nmessages);
+    EXPECT_EQ(cb::mcbp::ClientOpcode::DcpSnapshotMarker, producers.last_op);
+
+    EXPECT_EQ(ENGINE_SUCCESS,
+              producer->stepBatch(&producers, 1024 * 1024, nmessages));
+    EXPECT_EQ(3, nmessages);
+    EXPECT_EQ(cb::mcbp::ClientOpcode::DcpMutation, producers.last_op);
+    EXPECT_EQ(3, producers.last_byseqno);
+    EXPECT_EQ(3, producer->getItemsSent());
+
+    EXPECT_EQ(ENGINE_EWOULDBLOCK,
+              producer->stepBatch(&producers, 1024 * 1024, nmessages));
+    EXPECT_EQ(0, nmessages);
+
+    producer->cancelCheckpointCreatorTask();
+}
+
 /// Test that disk backfill remaining isn't prematurely zero (before counts
 /// read from disk by backfill task).
 TEST_P(SingleThreadedActiveStreamTest, DiskBackfillInitializingItemsRemaining) {
@@ -2807,6 +2851,167 @@ TEST_P(SingleThreadedBackfillBufferTest, SingleItemBuffer) {
     testBackfill();
 }
 
+/*
+ * Test fixture for backfills of streams of different producers sharing one
+ * disk scan (dcp_backfill_shared_scans).
+ */
+class SingleThreadedSharedBackfillTest : public SingleThreadedActiveStreamTest {
+public:
+    void SetUp() override {
+        config_string += "dcp_backfill_shared_scans=true";
+        SingleThreadedActiveStreamTest::SetUp();
+        cookie2 = create_mock_cookie(engine.get());
+        producer2 = std::make_shared<MockDcpProducer>(*engine,
+                                                      cookie2,
+                                                      "test_producer2",
+                                                      0 /*flags*/,
+                                                      false /*startTask*/);
+    }
+
+    void TearDown() override {
+        stream2.reset();
+        producer2.reset();
+        destroy_mock_cookie(cookie2);
+        SingleThreadedActiveStreamTest::TearDown();
+    }
+
+protected:
+    /// Store 3 items, only available from disk, and create a stream
+    /// (backfilling them) on each producer.
+    void createBackfillingStreams() {
+        auto vb = engine->getVBucket(vbid);
+        auto& ckptMgr = *vb->checkpointManager;
+        stream.reset();
+
+        store_item(vbid, makeStoredDocKey("key1"), "value");
+        store_item(vbid, makeStoredDocKey("key2"), "value");
+        store_item(vbid, makeStoredDocKey("key3"), "value");
+        ckptMgr.createNewCheckpoint();
+        flushVBucketToDiskIfPersistent(vbid, 3);
+        bool newCKptCreated;
+        ASSERT_EQ(3, ckptMgr.removeClosedUnrefCheckpoints(*vb, newCKptCreated));
+
+        stream = producer->mockActiveStreamRequest(0 /*flags*/,
+                                                   0 /*opaque*/,
+                                                   *vb,
+                                                   0 /*st_seqno*/,
+                                                   ~0 /*en_seqno*/,
+                                                   0x0 /*vb_uuid*/,
+                                                   0 /*snap_start_seqno*/,
+                                                   ~0 /*snap_end_seqno*/);
+        ASSERT_TRUE(stream->isBackfilling());
+        stream2 = producer2->mockActiveStreamRequest(0 /*flags*/,
+                                                     0 /*opaque*/,
+                                                     *vb,
+                                                     0 /*st_seqno*/,
+                                                     ~0 /*en_seqno*/,
+                                                     0x0 /*vb_uuid*/,
+                                                     0 /*snap_start_seqno*/,
+                                                     ~0 /*snap_end_seqno*/);
+        ASSERT_TRUE(stream2->isBackfilling());
+    }
+
+    const void* cookie2 = nullptr;
+    std::shared_ptr<MockDcpProducer> producer2;
+    std::shared_ptr<MockActiveStream> stream2;
+};
+
+// The second backfill joins the scan opened by the first, and gets all the
+// items from the scan driven by the first producer.
+TEST_P(SingleThreadedSharedBackfillTest, BackfillsShareScan) {
+    createBackfillingStreams();
+    auto& bfm = producer->getBFM();
+    auto& bfm2 = producer2->getBFM();
+
+    // Both backfills create (open / join the scan) and send their markers
+    EXPECT_EQ(backfill_status_t::backfill_success, bfm.backfill());
+    EXPECT_EQ(backfill_status_t::backfill_success, bfm2.backfill());
+    EXPECT_EQ(1, stream->public_readyQSize());
+    EXPECT_EQ(1, stream2->public_readyQSize());
+
+    // One run of the first backfill reads the items for both streams
+    EXPECT_EQ(backfill_status_t::backfill_success, bfm.backfill());
+    EXPECT_EQ(3, stream->getNumBackfillItems());
+    EXPECT_EQ(3, stream2->getNumBackfillItems());
+    EXPECT_EQ(4, stream2->public_readyQSize());
+
+    // The second backfill finds the scan finished, then both complete and
+    // are removed
+    EXPECT_EQ(backfill_status_t::backfill_success, bfm2.backfill());
+    EXPECT_EQ(backfill_status_t::backfill_success, bfm2.backfill());
+    EXPECT_EQ(backfill_status_t::backfill_success, bfm.backfill());
+    EXPECT_EQ(backfill_status_t::backfill_success, bfm.backfill());
+    EXPECT_EQ(backfill_status_t::backfill_success, bfm2.backfill());
+    EXPECT_EQ(backfill_status_t::backfill_finished, bfm.backfill());
+    EXPECT_EQ(backfill_status_t::backfill_finished, bfm2.backfill());
+    EXPECT_EQ(3, stream->getLastReadSeqno());
+    EXPECT_EQ(3, stream2->getLastReadSeqno());
+
+    // Nothing was given twice
+    EXPECT_EQ(3, stream->getNumBackfillItems());
+    EXPECT_EQ(3, stream2->getNumBackfillItems());
+}
+
+// The scan continues for the remaining members when one of them goes away.
+TEST_P(SingleThreadedSharedBackfillTest, MemberLeaves) {
+    createBackfillingStreams();
+    auto& bfm = producer->getBFM();
+    auto& bfm2 = producer2->getBFM();
+
+    EXPECT_EQ(backfill_status_t::backfill_success, bfm.backfill());
+    EXPECT_EQ(backfill_status_t::backfill_success, bfm2.backfill());
+
+    // The first stream is closed before its backfill scans; the backfill
+    // is cancelled and removed
+    stream->setDead(END_STREAM_CLOSED);
+    EXPECT_EQ(backfill_status_t::backfill_success, bfm.backfill());
+    EXPECT_EQ(backfill_status_t::backfill_success, bfm.backfill());
+    EXPECT_EQ(backfill_status_t::backfill_finished, bfm.backfill());
+    EXPECT_EQ(0, stream->getNumBackfillItems());
+
+    // Scan, complete and remove
+    EXPECT_EQ(backfill_status_t::backfill_success, bfm2.backfill());
+    EXPECT_EQ(3, stream2->getNumBackfillItems());
+    EXPECT_EQ(backfill_status_t::backfill_success, bfm2.backfill());
+    EXPECT_EQ(backfill_status_t::backfill_success, bfm2.backfill());
+    EXPECT_EQ(backfill_status_t::backfill_finished, bfm2.backfill());
+    EXPECT_EQ(3, stream2->getLastReadSeqno());
+}
+
+// While a member can't take an item, the other members' backfills snooze
+// rather than re-reading the scan; the blocked member's backfill resumes it
+// once it has space.
+TEST_P(SingleThreadedSharedBackfillTest, BlockedMemberDrives) {
+    createBackfillingStreams();
+    auto& bfm = dynamic_cast<MockDcpBackfillManager&>(producer->getBFM());
+    auto& bfm2 = producer2->getBFM();
+
+    EXPECT_EQ(backfill_status_t::backfill_success, bfm.backfill());
+    EXPECT_EQ(backfill_status_t::backfill_success, bfm2.backfill());
+
+    // The second stream's buffer only takes the first item
+    producer2->setBackfillBufferSize(1);
+    EXPECT_EQ(backfill_status_t::backfill_success, bfm.backfill());
+    EXPECT_EQ(2, stream->getNumBackfillItems());
+    EXPECT_EQ(1, stream2->getNumBackfillItems());
+    ASSERT_TRUE(producer2->getBackfillBufferFullStatus());
+
+    // The first backfill now waits for the second
+    EXPECT_EQ(0, bfm.getNumSnoozingBackfills());
+    EXPECT_EQ(backfill_status_t::backfill_success, bfm.backfill());
+    EXPECT_EQ(1, bfm.getNumSnoozingBackfills());
+    EXPECT_EQ(2, stream->getNumBackfillItems());
+
+    // Once the second stream's buffer has space its backfill reads on, for
+    // both streams
+    stream2->consumeBackfillItems(/*snapshot*/ 1 + /*mutation*/ 1);
+    ASSERT_FALSE(producer2->getBackfillBufferFullStatus());
+    producer2->setBackfillBufferSize(1024 * 1024);
+    EXPECT_EQ(backfill_status_t::backfill_success, bfm2.backfill());
+    EXPECT_EQ(3, stream->getNumBackfillItems());
+    EXPECT_EQ(3, stream2->getNumBackfillItems());
+}
+
 INSTANTIATE_TEST_SUITE_P(
         AllBucketTypes,
         SingleThreadedActiveStreamTest,
@@ -2829,6 +3034,12 @@ INSTANTIATE_TEST_SUITE_P(AllBucketTypes,
                          STParameterizedBucketTest::allConfigValues(),
                          STParameterizedBucketTest::PrintToStringParamName);
 
+INSTANTIATE_TEST_SUITE_P(
+        AllBucketTypes,
+        SingleThreadedSharedBackfillTest,
+        STParameterizedBucketTest::persistentAllBackendsConfigValues(),
+        STParameterizedBucketTest::PrintToStringParamName);
+
 void STPassiveStreamPersistentTest::SetUp() {
     // Test class is not specific for SyncRepl, but some tests check SR
     // quantities too.
@@ -787,6 +787,73 @@ TEST_P(CompressionStreamTest, force_value_compression_enabled) {
     destroy_dcp_stream();
 }
 
+/**
+ * Test that a stream forcing value compression only sends a value compressed
+ * if it achieves dcp_min_compression_ratio when
+ * dcp_producer_apply_min_compression_ratio is enabled, and that the values it
+ * compressed are accounted for in the stream stats.
+ */
+TEST_P(CompressionStreamTest, force_value_compression_min_ratio) {
+    queued_item qi = makeCompressibleItem(vbid,
+                                          makeStoredDocKey("key"),
+                                          std::string(1024, 'a'),
+                                          PROTOCOL_BINARY_DATATYPE_JSON,
+                                          false, // not compressed
+                                          isXattr());
+
+    mock_set_datatype_support(cookie, PROTOCOL_BINARY_DATATYPE_SNAPPY);
+    auto includeValue = isXattr() ? IncludeValue::No : IncludeValue::Yes;
+    setup_dcp_stream(0,
+                     includeValue,
+                     IncludeXattrs::Yes,
+                     {{"force_value_compression", "true"}});
+
+    auto getSentItem = [this, &qi]() {
+        auto dcpResponse = stream->public_makeResponseFromItem(
+                qi, SendCommitSyncWriteAs::Commit);
+        auto* mutation = dynamic_cast<MutationResponse*>(dcpResponse.get());
+        EXPECT_NE(nullptr, mutation);
+        return mutation ? mutation->getItem() : queued_item{};
+    };
+
+    // The value gets smaller, it is sent compressed
+    auto item = getSentItem();
+    ASSERT_TRUE(item);
+    EXPECT_TRUE(mcbp::datatype::is_snappy(item->getDataType()));
+    const auto compressedSize = item->getNBytes();
+
+    // No value compresses to 1% of its size, but the ratio only applies with
+    // dcp_producer_apply_min_compression_ratio
+    engine->getDcpConnMap().updateMinCompressionRatioForProducers(0.01);
+    item = getSentItem();
+    ASSERT_TRUE(item);
+    EXPECT_TRUE(mcbp::datatype::is_snappy(item->getDataType()));
+    EXPECT_EQ(compressedSize, item->getNBytes());
+
+    engine->getConfiguration().setDcpProducerApplyMinCompressionRatio(true);
+    item = getSentItem();
+    ASSERT_TRUE(item);
+    EXPECT_FALSE(mcbp::datatype::is_snappy(item->getDataType()));
+    const auto uncompressedSize = item->getNBytes();
+    EXPECT_LT(compressedSize, uncompressedSize);
+
+    std::map<std::string, std::string> stats;
+    stream->addStats(
+            [&stats](std::string_view key,
+                     std::string_view value,
+                     gsl::not_null<const void*> cookie) {
+                stats[std::string{key}] = std::string{value};
+            },
+            cookie);
+    const std::string prefix = "test_producer:stream_0_compression_";
+    EXPECT_EQ("3", stats[prefix + "items"]);
+    EXPECT_EQ(std::to_string(uncompressedSize * 3), stats[prefix + "bytes_in"]);
+    EXPECT_EQ(std::to_string(compressedSize * 2 + uncompressedSize),
+              stats[prefix + "bytes_out"]);
+
+    destroy_dcp_stream();
+}
+
 class ConnectionTest : public DCPTest,
                        public ::testing::WithParamInterface<
                                std::tuple<std::string, std::string>> {
@@ -1275,6 +1342,114 @@ TEST_P(ConnectionTest, test_producer_unknown_ctrl_msg) {
     destroy_mock_cookie(cookie);
 }
 
+/// @return the (unprefixed) flow control stats of a producer
+static std::map<std::string, std::string> getFlowControlStats(
+        DcpProducer& producer) {
+    std::map<std::string, std::string> stats;
+    producer.addStats(
+            [&stats](std::string_view key,
+                     std::string_view value,
+                     gsl::not_null<const void*> cookie) {
+                std::string k{key};
+                k = k.substr(k.rfind(':') + 1);
+                if (k.find("flow_control") == 0) {
+                    stats[k] = std::string{value};
+                }
+            },
+            static_cast<const void*>(&producer));
+    return stats;
+}
+
+/*
+ * Test that with adaptive flow control the producer's window is sized from
+ * the acks: acks taking next to no time size it to its minimum, a quarter
+ * of the consumer's buffer, and the producer pauses when it is full.
+ */
+TEST_P(ConnectionTest, AdaptiveFlowControlWindow) {
+    engine->getConfiguration().setDcpProducerAdaptiveFlowControl(true);
+    const void* cookie = create_mock_cookie(engine);
+    auto producer = std::make_shared<MockDcpProducer>(*engine,
+                                                      cookie,
+                                                      "test_producer",
+                                                      /*flags*/ 0);
+    ASSERT_EQ(ENGINE_SUCCESS,
+              producer->control(0, "connection_buffer_size", "1000"));
+
+    // Until sized from an ack, the window is the buffer size
+    EXPECT_EQ("1000", getFlowControlStats(*producer)["flow_control_window"]);
+    EXPECT_TRUE(producer->bufferLogInsert(100));
+    EXPECT_EQ(ENGINE_SUCCESS, producer->bufferAcknowledgement(0, vbid, 100));
+    EXPECT_EQ("250", getFlowControlStats(*producer)["flow_control_window"]);
+
+    EXPECT_TRUE(producer->bufferLogInsert(200));
+    EXPECT_TRUE(producer->bufferLogInsert(50));
+    EXPECT_FALSE(producer->bufferLogInsert(1));
+
+    // A producer with a stream ready pauses on the window
+    MockDcpMessageProducers producers(engine);
+    producer->notifyStreamReady(vbid);
+    EXPECT_EQ(ENGINE_EWOULDBLOCK, producer->step(&producers));
+    auto stats = getFlowControlStats(*producer);
+    EXPECT_EQ("1", stats["flow_control_paused_window_full"]);
+    EXPECT_EQ("0", stats["flow_control_paused_buffer_full"]);
+    EXPECT_EQ("0", stats["flow_control_paused_mem_budget"]);
+
+    // Without adaptive flow control, the buffer size applies
+    engine->getConfiguration().setDcpProducerAdaptiveFlowControl(false);
+    EXPECT_TRUE(producer->bufferLogInsert(1));
+
+    producer->cancelCheckpointCreatorTask();
+    destroy_mock_cookie(cookie);
+}
+
+/*
+ * Test that with adaptive flow control a producer pauses once the bytes
+ * outstanding across all producers reach their memory budget, but only once
+ * it has enough outstanding bytes for the consumer to ack.
+ */
+TEST_P(ConnectionTest, AdaptiveFlowControlMemBudget) {
+    engine->getConfiguration().setDcpProducerAdaptiveFlowControl(true);
+    engine->getConfiguration().setDcpProducerFlowControlMemThreshold(1);
+    const size_t budget = engine->getEpStats().getMaxDataSize() / 100;
+    ASSERT_LT(budget * 8, std::numeric_limits<uint32_t>::max());
+
+    const void* cookie = create_mock_cookie(engine);
+    auto producer = std::make_shared<MockDcpProducer>(*engine,
+                                                      cookie,
+                                                      "test_producer",
+                                                      /*flags*/ 0);
+    ASSERT_EQ(ENGINE_SUCCESS,
+              producer->control(
+                      0, "connection_buffer_size", std::to_string(budget * 8)));
+
+    auto& connMap = engine->getDcpConnMap();
+    EXPECT_TRUE(producer->bufferLogInsert(budget));
+    EXPECT_TRUE(connMap.isProducerFlowControlMemBudgetFull());
+    // Under a quarter of the consumer's buffer outstanding, keep sending
+    EXPECT_TRUE(producer->bufferLogInsert(budget));
+    EXPECT_FALSE(producer->bufferLogInsert(1));
+
+    MockDcpMessageProducers producers(engine);
+    producer->notifyStreamReady(vbid);
+    EXPECT_EQ(ENGINE_EWOULDBLOCK, producer->step(&producers));
+    EXPECT_EQ("1",
+              getFlowControlStats(*producer)["flow_control_paused_mem_budget"]);
+
+    EXPECT_EQ(ENGINE_SUCCESS,
+              producer->bufferAcknowledgement(0, vbid, uint32_t(budget * 2)));
+    EXPECT_FALSE(connMap.isProducerFlowControlMemBudgetFull());
+    EXPECT_TRUE(producer->bufferLogInsert(budget));
+
+    // The bytes of a closed producer no longer count against the budget
+    producer->closeAllStreams();
+    EXPECT_FALSE(connMap.isProducerFlowControlMemBudgetFull());
+    EXPECT_TRUE(producer->bufferLogInsert(budget));
+    producer->closeAllStreams();
+
+    producer->cancelCheckpointCreatorTask();
+    destroy_mock_cookie(cookie);
+}
+
 TEST_P(ConnectionTest, test_mb17042_duplicate_cookie_consumer_connections) {
     MockDcpConnMap connMap(*engine);
     connMap.initialize();
@@ -2134,6 +2134,75 @@ TEST_F(SingleThreadedEPBucketTest, MB18452_yield_dcp_processor) {
     consumer->closeStream(/*opaque*/0, vbid);
 }
 
+/*
+ * Test that with dcp_consumer_process_buffered_messages_tasks, the buffered
+ * messages of a consumer's vBuckets are applied by the processor (task) the
+ * vBucket is assigned to, independently of those of other processors.
+ */
+TEST_F(SingleThreadedEPBucketTest, ConsumerProcessorsApplyTheirVBuckets) {
+    engine->getConfiguration().setDcpConsumerProcessBufferedMessagesTasks(2);
+    const Vbid vbid1(1);
+    setVBucketStateAndRunPersistTask(vbid, vbucket_state_replica);
+    setVBucketStateAndRunPersistTask(vbid1, vbucket_state_replica);
+
+    auto consumer = std::make_shared<MockDcpConsumer>(*engine, cookie, "test");
+    ASSERT_EQ(2, consumer->getNumProcessors());
+    EXPECT_EQ(ENGINE_SUCCESS,
+              consumer->addStream(/*opaque*/ 0, vbid, /*flags*/ 0));
+    EXPECT_EQ(ENGINE_SUCCESS,
+              consumer->addStream(/*opaque*/ 0, vbid1, /*flags*/ 0));
+
+    // Force the streams to buffer rather than process messages immediately
+    const ssize_t queueCap =
+            engine->getEpStats().replicationThrottleWriteQueueCap;
+    engine->getEpStats().replicationThrottleWriteQueueCap = 0;
+
+    uint32_t opaque = 1;
+    for (auto vb : {vbid, vbid1}) {
+        consumer->snapshotMarker(opaque,
+                                 vb,
+                                 /*startseq*/ 0,
+                                 /*endseq*/ 1,
+                                 /*flags*/ 0,
+                                 /*HCS*/ {},
+                                 /*maxVisibleSeqno*/ {});
+        const DocKey docKey{"key", DocKeyEncodesCollectionId::No};
+        std::string value = "value";
+        consumer->mutation(opaque,
+                           docKey,
+                           {(const uint8_t*)value.c_str(), value.length()},
+                           0, // privileged bytes
+                           PROTOCOL_BINARY_RAW_BYTES, // datatype
+                           0, // cas
+                           vb, // vbucket
+                           0, // flags
+                           1, // bySeqno
+                           0, // revSeqno
+                           0, // exptime
+                           0, // locktime
+                           {}, // meta
+                           0); // nru
+        ++opaque;
+    }
+    engine->getEpStats().replicationThrottleWriteQueueCap = queueCap;
+
+    consumer->public_notifyVbucketReady(vbid);
+    consumer->public_notifyVbucketReady(vbid1);
+
+    // vb:1 is applied by the second processor alone
+    EXPECT_EQ(more_to_process, consumer->processBufferedItems(1));
+    EXPECT_EQ(all_processed, consumer->processBufferedItems(1));
+    EXPECT_EQ(0, store->getVBucket(vbid)->getHighSeqno());
+    EXPECT_EQ(1, store->getVBucket(vbid1)->getHighSeqno());
+
+    EXPECT_EQ(more_to_process, consumer->processBufferedItems(0));
+    EXPECT_EQ(all_processed, consumer->processBufferedItems(0));
+    EXPECT_EQ(1, store->getVBucket(vbid)->getHighSeqno());
+
+    consumer->closeStream(/*opaque*/ 0, vbid);
+    consumer->closeStream(/*opaque*/ 0, vbid1);
+}
+
 /**
  * MB-29861: Ensure that a delete time is generated for a document
  * that is received on the consumer side as a result of a disk
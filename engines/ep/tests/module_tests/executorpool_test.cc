@@ -21,6 +21,10 @@
 
 #include "executorpool_test.h"
 #include "lambda_task.h"
+#include "taskqueue.h"
+
+#include <future>
+#include <set>
 
 MockTaskable::MockTaskable() : policy(HIGH_BUCKET_PRIORITY, 1) {
 }
@@ -256,6 +260,131 @@ TEST_F(ExecutorPoolDynamicWorkerTest, setDiskIOOptimized) {
     EXPECT_EQ(MaxThreads, pool->getNumReaders());
 }
 
+TEST_F(ExecutorPoolWorkStealingTest, ShardPerThread) {
+    EXPECT_EQ(NumNonIO, pool->getHpTaskQueue(NONIO_TASK_IDX)->getNumShards());
+    EXPECT_EQ(2, pool->getHpTaskQueue(READER_TASK_IDX)->getNumShards());
+}
+
+TEST_F(ExecutorPoolWorkStealingTest, RunsAllTasks) {
+    const int numTasks = 100;
+    std::atomic<int> runCount{0};
+    for (int ii = 0; ii < numTasks; ++ii) {
+        pool->schedule(std::make_shared<LambdaTask>(
+                taskable, TaskId::ItemPager, 0, true, [&] {
+                    ++runCount;
+                    return false;
+                }));
+    }
+    pool->waitForEmptyTaskLocator();
+    EXPECT_EQ(numTasks, runCount);
+}
+
+// A task waiting in the shard of a busy thread should be stolen and run by
+// one of the other threads.
+TEST_F(ExecutorPoolWorkStealingTest, StealFromBusyShard) {
+    std::promise<void> firstStarted;
+    std::promise<void> secondRan;
+    auto secondRanFuture = secondRan.get_future();
+    bool firstSawSecond = false;
+
+    ExTask first = std::make_shared<LambdaTask>(
+            taskable, TaskId::ItemPager, 0, true, [&] {
+                firstStarted.set_value();
+                firstSawSecond = secondRanFuture.wait_for(std::chrono::seconds(
+                                         10)) == std::future_status::ready;
+                return false;
+            });
+    // Task ids are allocated sequentially and map to shards by id, so the
+    // NumNonIO'th next task shares first's shard.
+    std::vector<ExTask> tasks;
+    for (size_t ii = 0; ii < NumNonIO; ++ii) {
+        tasks.push_back(std::make_shared<LambdaTask>(
+                taskable, TaskId::ItemPager, 0, true, [&] {
+                    secondRan.set_value();
+                    return false;
+                }));
+    }
+    ExTask second = tasks.back();
+    ASSERT_EQ(first->getId() % NumNonIO, second->getId() % NumNonIO);
+
+    pool->schedule(first);
+    firstStarted.get_future().wait();
+    pool->schedule(second);
+    pool->waitForEmptyTaskLocator();
+
+    EXPECT_TRUE(firstSawSecond);
+    // Both tasks ran concurrently so at most one of them can have run on the
+    // thread owning their shard.
+    EXPECT_LE(1, pool->getHpTaskQueue(NONIO_TASK_IDX)->getNumSteals());
+}
+
+TEST_F(ExecutorPoolWorkStealingTest, WakeSnoozedTask) {
+    std::atomic<int> runCount{0};
+    ExTask task = std::make_shared<LambdaTask>(
+            taskable, TaskId::ItemPager, 600, true, [&] {
+                ++runCount;
+                return false;
+            });
+    pool->schedule(task);
+    EXPECT_TRUE(pool->wake(task->getId()));
+    pool->waitForEmptyTaskLocator();
+    EXPECT_EQ(1, runCount);
+}
+
+// With threads bound to NUMA nodes, tasks which prefer a node are only placed
+// in the shards local to that node's threads.
+TEST(TaskQueueNumaTest, TasksPlacedOnNodeShards) {
+    const size_t numShards = 6;
+    const size_t numaNodes = 2;
+    TaskQueue queue(nullptr,
+                    NONIO_TASK_IDX,
+                    "test",
+                    numShards,
+                    FutureQueueType::Heap,
+                    numaNodes);
+    MockTaskable taskable;
+
+    std::set<size_t> nodeShards;
+    std::set<size_t> anyShards;
+    for (int ii = 0; ii < 100; ++ii) {
+        ExTask task = std::make_shared<LambdaTask>(
+                taskable, TaskId::ItemPager, 0, true, [] { return false; });
+        anyShards.insert(queue.getShardIndex(task));
+        task->setNumaNode(1);
+        nodeShards.insert(queue.getShardIndex(task));
+    }
+    EXPECT_EQ(std::set<size_t>({1, 3, 5}), nodeShards);
+    EXPECT_EQ(numShards, anyShards.size());
+}
+
+// When the number of shards isn't a multiple of the number of nodes, a
+// shard's node must still be that of its own index (and not depend on the
+// distance from another shard, which wraps around).
+TEST(TaskQueueNumaTest, ShardNodesWithUnevenShards) {
+    const size_t numShards = 5;
+    const size_t numaNodes = 2;
+    TaskQueue queue(nullptr,
+                    NONIO_TASK_IDX,
+                    "test",
+                    numShards,
+                    FutureQueueType::Heap,
+                    numaNodes);
+    MockTaskable taskable;
+
+    for (size_t shard = 0; shard < numShards; ++shard) {
+        EXPECT_EQ(shard % numaNodes, queue.getShardNode(shard));
+    }
+
+    std::set<size_t> nodeShards;
+    for (int ii = 0; ii < 100; ++ii) {
+        ExTask task = std::make_shared<LambdaTask>(
+                taskable, TaskId::ItemPager, 0, true, [] { return false; });
+        task->setNumaNode(1);
+        nodeShards.insert(queue.getShardIndex(task));
+    }
+    EXPECT_EQ(std::set<size_t>({1, 3}), nodeShards);
+}
+
 TEST_P(ExecutorPoolTestWithParam, max_threads_test_parameterized) {
     ThreadCountsParams expected = GetParam();
 
@@ -61,13 +61,15 @@ public:
                      ThreadPoolConfig::ThreadCount maxReaders,
                      ThreadPoolConfig::ThreadCount maxWriters,
                      size_t maxAuxIO,
-                     size_t maxNonIO)
+                     size_t maxNonIO,
+                     bool workStealing = false)
         : ExecutorPool(maxThreads,
                        nTaskSets,
                        maxReaders,
                        maxWriters,
                        maxAuxIO,
-                       maxNonIO) {
+                       maxNonIO,
+                       workStealing) {
     }
 
     size_t getNumBuckets() {
@@ -97,6 +99,12 @@ public:
         return result;
     }
 
+    // Returns the high priority TaskQueue of the given type, non-owning.
+    TaskQueue* getHpTaskQueue(task_type_t type) {
+        LockHolder lh(tMutex);
+        return hpTaskQ[type];
+    }
+
     bool threadExists(std::string name) {
         auto names = getThreadNames();
         return std::find(names.begin(), names.end(), name) != names.end();
@@ -169,6 +177,37 @@ protected:
     MockTaskable taskable;
 };
 
+/**
+ * Test fixture for an ExecutorPool using per-thread task queue shards with
+ * work stealing.
+ */
+class ExecutorPoolWorkStealingTest : public ExecutorPoolTest {
+protected:
+    const size_t NumNonIO{4};
+
+    void SetUp() override {
+        ExecutorPoolTest::SetUp();
+        pool = std::make_unique<TestExecutorPool>(
+                10, // MaxThreads
+                NUM_TASK_GROUPS,
+                ThreadPoolConfig::ThreadCount(2), // MaxNumReaders
+                ThreadPoolConfig::ThreadCount(2), // MaxNumWriters
+                2, // MaxNumAuxio
+                NumNonIO, // MaxNumNonio
+                true /*workStealing*/);
+        pool->registerTaskable(taskable);
+    }
+
+    void TearDown() override {
+        pool->unregisterTaskable(taskable, false);
+        pool->shutdown();
+        ExecutorPoolTest::TearDown();
+    }
+
+    std::unique_ptr<TestExecutorPool> pool;
+    MockTaskable taskable;
+};
+
 struct ThreadCountsParams {
     // Input params:
     ThreadPoolConfig::ThreadCount in_reader_writer;
@@ -0,0 +1,101 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <folly/portability/GTest.h>
+
+#include "flush_batch_controller.h"
+
+using namespace std::chrono_literals;
+
+class FlushBatchControllerTest : public ::testing::Test {
+protected:
+    /// Record one adjustInterval of batches with the given latency.
+    void recordInterval(std::chrono::microseconds latency,
+                        size_t backlog,
+                        bool waiters = false) {
+        for (size_t i = 0; i < FlushBatchController::adjustInterval; ++i) {
+            controller.recordBatch(latency, backlog, waiters);
+        }
+    }
+
+    const size_t maxLimit = 6400;
+    FlushBatchController controller{maxLimit, 100ms};
+};
+
+// The limit starts at the ceiling, and is reduced while the p99 latency is
+// over target - down to the floor.
+TEST_F(FlushBatchControllerTest, DecreaseOverTarget) {
+    EXPECT_EQ(maxLimit, controller.getLimit());
+
+    recordInterval(200ms, 0);
+    EXPECT_EQ(maxLimit * 3 / 4, controller.getLimit());
+    EXPECT_EQ(1, controller.getNumDecreases());
+    EXPECT_EQ(200ms, controller.getP99Latency());
+
+    for (int i = 0; i < 100; ++i) {
+        recordInterval(200ms, 0);
+    }
+    EXPECT_EQ(maxLimit / FlushBatchController::minLimitDivisor,
+              controller.getLimit());
+
+    // A vBucket with persistence waiters still gets the ceiling.
+    EXPECT_EQ(maxLimit, controller.getBatchLimit(true));
+    EXPECT_EQ(controller.getLimit(), controller.getBatchLimit(false));
+}
+
+// Under target, the limit only grows while there is a backlog.
+TEST_F(FlushBatchControllerTest, IncreaseWithBacklog) {
+    // The p99 is over the window, so it takes a full window of fast batches
+    // for the slow ones to age out.
+    recordInterval(200ms, 0);
+    for (size_t i = 0; i < FlushBatchController::windowSize /
+                                   FlushBatchController::adjustInterval;
+         ++i) {
+        recordInterval(10ms, 0);
+    }
+    const auto reduced = controller.getLimit();
+    EXPECT_LT(reduced, maxLimit);
+    recordInterval(10ms, 0);
+    EXPECT_EQ(reduced, controller.getLimit());
+
+    recordInterval(10ms, 1000);
+    EXPECT_EQ(reduced + maxLimit / FlushBatchController::minLimitDivisor,
+              controller.getLimit());
+    EXPECT_EQ(1, controller.getNumIncreases());
+
+    // Never above the ceiling.
+    for (int i = 0; i < 100; ++i) {
+        recordInterval(10ms, 1000);
+    }
+    EXPECT_EQ(maxLimit, controller.getLimit());
+}
+
+// Persistence waiters halve the target latency.
+TEST_F(FlushBatchControllerTest, WaitersTightenTarget) {
+    recordInterval(60ms, 1000);
+    EXPECT_EQ(maxLimit, controller.getLimit());
+
+    recordInterval(60ms, 1000, true);
+    EXPECT_EQ(maxLimit * 3 / 4, controller.getLimit());
+}
+
+TEST_F(FlushBatchControllerTest, SetMaxLimit) {
+    recordInterval(200ms, 0);
+    controller.setMaxLimit(100);
+    EXPECT_EQ(100, controller.getLimit());
+    EXPECT_EQ(100, controller.getBatchLimit(true));
+}
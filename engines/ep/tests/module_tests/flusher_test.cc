@@ -31,7 +31,7 @@ class FlusherTest : public ::testing::Test {
 protected:
     void SetUp() override {
         SingleThreadedExecutorPool::replaceExecutorPoolWithFake();
-        engine = SynchronousEPEngine::build({});
+        engine = SynchronousEPEngine::build(config_string);
         task_executor = reinterpret_cast<SingleThreadedExecutorPool*>(
                 ExecutorPool::get());
 
@@ -52,6 +52,22 @@ protected:
         ExecutorPool::shutdown();
     }
 
+    /**
+     * Make three low priority vBuckets of the first shard ready to flush a
+     * mutation each.
+     *
+     * @return the vBuckets, in the order they were queued for the flusher.
+     */
+    std::vector<Vbid> queueReadyVBuckets();
+
+    /**
+     * Check that a single Flusher run persists all of the low priority
+     * vBuckets (of the same shard) which are ready.
+     */
+    void testFlushOfReadyVBuckets();
+
+    std::string config_string;
+
     SynchronousEPEngineUniquePtr engine;
 
     // Non-owning poitner to SingleThreadedExecutorPool.
@@ -149,4 +165,114 @@ TEST_F(FlusherTest, GetToLowPrioWhenSomeHighPriIsPending) {
     // Run the FLusher again, should drain the low-priority queue
     task_executor->runNextTask(WRITER_TASK_IDX, flusherName);
     ASSERT_EQ(0, flusher->getLPQueueSize());
-}
\ No newline at end of file
+}
+
+std::vector<Vbid> FlusherTest::queueReadyVBuckets() {
+    // Pick three vBuckets on the same shard (see above).
+    auto shards = engine->getKVBucket()->getVBuckets().getNumShards();
+    const std::vector<Vbid> vbids{vbid0, Vbid(shards), Vbid(2 * shards)};
+
+    auto kvBucket = engine->getKVBucket();
+    for (auto vbid : vbids) {
+        kvBucket->setVBucketState(vbid, vbucket_state_replica);
+    }
+    EXPECT_EQ(vbids.size(), flusher->getLPQueueSize());
+    task_executor->runNextTask(WRITER_TASK_IDX, flusherName);
+    EXPECT_EQ(0, flusher->getLPQueueSize());
+
+    for (auto vbid : vbids) {
+        auto item = make_item(vbid, makeStoredDocKey("key"), "value");
+        item.setCas();
+        uint64_t seqno;
+        EXPECT_EQ(ENGINE_SUCCESS,
+                  kvBucket->setWithMeta(item,
+                                        0 /*cas*/,
+                                        &seqno,
+                                        nullptr /*cookie*/,
+                                        {vbucket_state_replica},
+                                        CheckConflicts::No,
+                                        /*allowExisting*/ true));
+    }
+    EXPECT_EQ(vbids.size(), flusher->getLPQueueSize());
+    return vbids;
+}
+
+void FlusherTest::testFlushOfReadyVBuckets() {
+    const auto vbids = queueReadyVBuckets();
+    ASSERT_EQ(vbids.size(), flusher->getLPQueueSize());
+
+    // Test: One run of the Flusher persists all the vBuckets.
+    task_executor->runNextTask(WRITER_TASK_IDX, flusherName);
+    EXPECT_EQ(0, flusher->getLPQueueSize());
+    for (auto vbid : vbids) {
+        EXPECT_EQ(1, engine->getVBucket(vbid)->getPersistenceSeqno())
+                << vbid;
+    }
+}
+
+// With flusher_pipelined, a single Flusher run commits all of the low priority
+// vBuckets which are ready (the next vBucket's batch being prepared while the
+// previous one is committed), in the order they were queued.
+TEST_F(FlusherTest, PipelinedFlushOfReadyVBuckets) {
+    engine->getConfiguration().setFlusherPipelined(true);
+    testFlushOfReadyVBuckets();
+}
+
+// With flusher_pipelined, the next vBucket's batch is prepared by a
+// FlushPrepareTask on a NonIO thread, and handed over to the flusher which
+// commits the batches in the order the vBuckets were queued.
+TEST_F(FlusherTest, PipelinedFlushPreparesOnNonIO) {
+    engine->getConfiguration().setFlusherPipelined(true);
+    const auto vbids = queueReadyVBuckets();
+    ASSERT_EQ(vbids.size(), flusher->getLPQueueSize());
+
+    std::vector<Vbid> committed;
+    flusher->pipelinedPreCommitHook = [this, &vbids, &committed](Vbid vbid) {
+        const auto index = committed.size();
+        committed.push_back(vbid);
+
+        // The previous batches are persisted, this one (and the next) not
+        // yet.
+        for (size_t ii = 0; ii < vbids.size(); ++ii) {
+            EXPECT_EQ(uint64_t(ii < index ? 1 : 0),
+                      engine->getVBucket(vbids[ii])->getPersistenceSeqno())
+                    << vbids[ii];
+        }
+
+        // The next vBucket's batch is prepared on NonIO before this one is
+        // committed.
+        if (index + 1 < vbids.size()) {
+            task_executor->runNextTask(
+                    NONIO_TASK_IDX,
+                    "Preparing flush batch for " +
+                            vbids[index + 1].to_string());
+        }
+    };
+
+    task_executor->runNextTask(WRITER_TASK_IDX, flusherName);
+    flusher->pipelinedPreCommitHook = {};
+
+    EXPECT_EQ(vbids, committed);
+    EXPECT_EQ(0, flusher->getLPQueueSize());
+    for (auto vbid : vbids) {
+        EXPECT_EQ(1, engine->getVBucket(vbid)->getPersistenceSeqno())
+                << vbid;
+        EXPECT_FALSE(task_executor->isTaskScheduled(
+                NONIO_TASK_IDX,
+                "Preparing flush batch for " + vbid.to_string()));
+    }
+}
+
+class FlusherGroupCommitTest : public FlusherTest {
+protected:
+    void SetUp() override {
+        config_string = "flusher_group_commit=true";
+        FlusherTest::SetUp();
+    }
+};
+
+// With flusher_group_commit, a single Flusher run commits all of the low
+// priority vBuckets which are ready, and makes them durable together.
+TEST_F(FlusherGroupCommitTest, GroupCommitOfReadyVBuckets) {
+    testFlushOfReadyVBuckets();
+}
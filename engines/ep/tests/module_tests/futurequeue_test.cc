@@ -20,6 +20,11 @@
 #include "futurequeue.h"
 #include "tests/module_tests/executorpool_test.h"
 #include "tests/module_tests/test_task.h"
+#include "timer_wheel_future_queue.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
 
 class FutureQueueTest : public ::testing::TestWithParam<std::string> {
 public:
@@ -224,3 +229,239 @@ TEST_F(FutureQueueTest, taskNotInQueue) {
     EXPECT_EQ(-1,
               static_cast<TestTask*>(queue.top().get())->order);
 }
+
+class TimerWheelFutureQueueTest : public ::testing::Test {
+public:
+    static std::chrono::steady_clock::time_point ms(int64_t count) {
+        return std::chrono::steady_clock::time_point(
+                std::chrono::milliseconds(count));
+    }
+
+    ExTask makeTask(std::chrono::steady_clock::time_point waketime,
+                    int order = 0) {
+        ExTask task = std::make_shared<TestTask>(
+                taskable, TaskId::PendingOpsNotification, order);
+        task->updateWaketime(waketime);
+        return task;
+    }
+
+    /// @return the order of each task made ready by queue.popReady(now).
+    std::vector<int> popReady(std::chrono::steady_clock::time_point now) {
+        std::vector<int> ready;
+        queue.popReady(now, [&ready](ExTask task) {
+            ready.push_back(static_cast<TestTask*>(task.get())->order);
+        });
+        queue.assertInvariants();
+        std::sort(ready.begin(), ready.end());
+        return ready;
+    }
+
+    TimerWheelFutureQueue queue;
+    MockTaskable taskable;
+};
+
+TEST_F(TimerWheelFutureQueueTest, initAssumptions) {
+    EXPECT_EQ(0u, queue.size());
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(std::chrono::steady_clock::time_point::max(),
+              queue.getEarliestWaketime());
+    EXPECT_TRUE(popReady(ms(1000)).empty());
+}
+
+TEST_F(TimerWheelFutureQueueTest, popReady) {
+    queue.push(makeTask(ms(30), 3));
+    queue.push(makeTask(ms(10), 1));
+    queue.push(makeTask(ms(20), 2));
+    queue.assertInvariants();
+    EXPECT_EQ(3u, queue.size());
+    EXPECT_EQ(ms(10), queue.getEarliestWaketime());
+
+    EXPECT_EQ(std::vector<int>{1}, popReady(ms(15)));
+    EXPECT_EQ(2u, queue.size());
+    EXPECT_EQ(ms(20), queue.getEarliestWaketime());
+
+    EXPECT_EQ(std::vector<int>({2, 3}), popReady(ms(100)));
+    EXPECT_TRUE(queue.empty());
+}
+
+/*
+ * Tasks are only ready once their (sub-millisecond) wakeTime is reached,
+ * even though the wheel's resolution is a millisecond.
+ */
+TEST_F(TimerWheelFutureQueueTest, subTickWaketime) {
+    const auto waketime = ms(10) + std::chrono::microseconds(500);
+    queue.push(makeTask(waketime, 1));
+
+    EXPECT_TRUE(popReady(ms(10)).empty());
+    EXPECT_EQ(waketime, queue.getEarliestWaketime());
+    EXPECT_EQ(std::vector<int>{1}, popReady(waketime));
+}
+
+/*
+ * Tasks due at very different times are placed in different levels, and
+ * cascaded down the levels as time advances.
+ */
+TEST_F(TimerWheelFutureQueueTest, cascade) {
+    // One task per level (64ms, 4s, 4.4m and 4.6h spans), plus overflow.
+    const std::vector<int64_t> waketimes = {
+            5, 100, 5000, 300000, 20000000, 50000000};
+    for (size_t ii = 0; ii < waketimes.size(); ++ii) {
+        queue.push(makeTask(ms(waketimes[ii]), ii));
+    }
+    queue.assertInvariants();
+
+    for (size_t ii = 0; ii < waketimes.size(); ++ii) {
+        // The earliest wakeTime may be a lower bound, but is never later
+        // than the task's.
+        EXPECT_LE(queue.getEarliestWaketime(), ms(waketimes[ii]));
+
+        EXPECT_TRUE(popReady(ms(waketimes[ii] - 1)).empty());
+        EXPECT_EQ(std::vector<int>{int(ii)}, popReady(ms(waketimes[ii])));
+        EXPECT_EQ(waketimes.size() - ii - 1, queue.size());
+    }
+}
+
+/*
+ * A task pushed with a wakeTime before the wheel's current time is made ready
+ * by the next popReady, even if "now" is also before the current time.
+ */
+TEST_F(TimerWheelFutureQueueTest, pushDueTask) {
+    EXPECT_TRUE(popReady(ms(100)).empty());
+
+    queue.push(makeTask(ms(50), 1));
+    queue.assertInvariants();
+    EXPECT_EQ(ms(50), queue.getEarliestWaketime());
+    EXPECT_EQ(std::vector<int>{1}, popReady(ms(60)));
+}
+
+TEST_F(TimerWheelFutureQueueTest, updateWaketime) {
+    std::vector<ExTask> tasks;
+    for (int ii = 0; ii < 10; ++ii) {
+        tasks.push_back(makeTask(ms(1000 + ii * 1000), ii));
+        queue.push(tasks.back());
+    }
+
+    // Move the last task to the front.
+    EXPECT_TRUE(queue.updateWaketime(tasks.back(), ms(10)));
+    queue.assertInvariants();
+    EXPECT_EQ(ms(10), queue.getEarliestWaketime());
+    EXPECT_EQ(std::vector<int>{9}, popReady(ms(10)));
+
+    // And the first to the back.
+    EXPECT_TRUE(queue.updateWaketime(tasks.front(), ms(100000)));
+    queue.assertInvariants();
+    EXPECT_EQ(std::vector<int>({1, 2, 3, 4, 5, 6, 7, 8}),
+              popReady(ms(99999)));
+    EXPECT_EQ(std::vector<int>{0}, popReady(ms(100000)));
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST_F(TimerWheelFutureQueueTest, snooze) {
+    // Tasks due at steady_clock::now(); so far in the future that they are
+    // in the overflow.
+    auto task = makeTask(std::chrono::steady_clock::now(), 1);
+    queue.push(task);
+    queue.push(makeTask(std::chrono::steady_clock::now(), 2));
+
+    EXPECT_TRUE(queue.snooze(task, 60));
+    queue.assertInvariants();
+
+    const auto now = std::chrono::steady_clock::now();
+    EXPECT_EQ(std::vector<int>{2}, popReady(now));
+    EXPECT_LE(queue.getEarliestWaketime(), task->getWaketime());
+    EXPECT_TRUE(popReady(now + std::chrono::seconds(59)).empty());
+    EXPECT_EQ(std::vector<int>{1}, popReady(now + std::chrono::seconds(61)));
+}
+
+/*
+ * snooze/wake a task not in the queue.
+ */
+TEST_F(TimerWheelFutureQueueTest, taskNotInQueue) {
+    queue.push(makeTask(ms(10), 1));
+
+    auto task = makeTask(ms(20));
+    EXPECT_FALSE(queue.snooze(task, 5.0));
+    EXPECT_FALSE(queue.updateWaketime(task, ms(5)));
+    EXPECT_EQ(ms(5), task->getWaketime());
+
+    EXPECT_EQ(1u, queue.size());
+    EXPECT_EQ(ms(10), queue.getEarliestWaketime());
+    queue.assertInvariants();
+}
+
+/*
+ * Pushing a task which is already queued just moves it.
+ */
+TEST_F(TimerWheelFutureQueueTest, pushQueuedTask) {
+    auto task = makeTask(ms(1000), 1);
+    queue.push(task);
+    task->updateWaketime(ms(10));
+    queue.push(task);
+    queue.assertInvariants();
+
+    EXPECT_EQ(1u, queue.size());
+    EXPECT_EQ(ms(10), queue.getEarliestWaketime());
+    EXPECT_EQ(std::vector<int>{1}, popReady(ms(10)));
+    EXPECT_TRUE(queue.empty());
+}
+
+/*
+ * Drive the timer wheel and a FutureQueue through the same randomised
+ * sequence of push, snooze, wake and popReady of 10,000 tasks, checking they
+ * agree on which tasks are ready.
+ */
+TEST_F(TimerWheelFutureQueueTest, matchesFutureQueue) {
+    const int numTasks = 10000;
+    // Span several times the range of the wheels, to exercise the overflow.
+    const int64_t span = int64_t(1) << 26;
+    std::mt19937_64 gen(0);
+    std::uniform_int_distribution<int64_t> waketimeDist(0, span);
+    std::uniform_int_distribution<int> taskDist(0, numTasks - 1);
+    std::uniform_int_distribution<int64_t> stepDist(0, span / 100);
+
+    FutureQueue<> heap;
+    std::vector<ExTask> tasks;
+    for (int ii = 0; ii < numTasks; ++ii) {
+        tasks.push_back(makeTask(ms(waketimeDist(gen)), ii));
+        queue.push(tasks.back());
+        heap.push(tasks.back());
+    }
+    queue.assertInvariants();
+
+    std::vector<bool> queued(numTasks, true);
+    int64_t now = 0;
+    for (int iteration = 0; !heap.empty(); ++iteration) {
+        // Reschedule some tasks: wake, snooze, or push again. Stop after a
+        // while so that the queues drain.
+        for (int ii = 0; iteration < 200 && ii < 20; ++ii) {
+            const auto idx = taskDist(gen);
+            const auto newTime = ms(now + waketimeDist(gen) / 10);
+            if (!queued[idx]) {
+                tasks[idx]->updateWaketime(newTime);
+                queue.push(tasks[idx]);
+                heap.push(tasks[idx]);
+                queued[idx] = true;
+            } else if (ii % 2) {
+                EXPECT_TRUE(queue.updateWaketime(tasks[idx], ms(now)));
+                EXPECT_TRUE(heap.updateWaketime(tasks[idx], ms(now)));
+            } else {
+                EXPECT_TRUE(queue.updateWaketime(tasks[idx], newTime));
+                EXPECT_TRUE(heap.updateWaketime(tasks[idx], newTime));
+            }
+        }
+        queue.assertInvariants();
+        ASSERT_EQ(heap.size(), queue.size());
+        ASSERT_LE(queue.getEarliestWaketime(), heap.getEarliestWaketime());
+
+        now += stepDist(gen);
+        std::vector<int> expected;
+        heap.popReady(ms(now), [&expected, &queued](ExTask task) {
+            const auto order = static_cast<TestTask*>(task.get())->order;
+            expected.push_back(order);
+            queued[order] = false;
+        });
+        std::sort(expected.begin(), expected.end());
+        ASSERT_EQ(expected, popReady(ms(now))) << "now:" << now;
+    }
+    EXPECT_TRUE(queue.empty());
+}
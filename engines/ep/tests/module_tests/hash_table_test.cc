@@ -34,6 +34,7 @@
 #include <algorithm>
 #include <limits>
 #include <string>
+#include <thread>
 #include <utility>
 
 EPStats global_stats;
@@ -253,6 +254,45 @@ TEST_F(HashTableTest, Resize) {
     verifyFound(h, keys);
 }
 
+// Check that while an incremental resize is in progress items can be found,
+// added, removed and visited across both the old and new tables.
+TEST_F(HashTableTest, IncrementalResize) {
+    HashTable h(global_stats, makeFactory(), 5, 3);
+    // Start from a table larger than a single resize chunk, so the resize
+    // cannot complete in one chunk.
+    h.resize(3079);
+    ASSERT_LT(HashTable::resizeChunkBuckets, h.getSize());
+
+    auto keys = generateKeys(20000);
+    storeMany(h, keys);
+
+    // Zero duration - migrates a single chunk.
+    EXPECT_FALSE(h.resizeIncremental(std::chrono::seconds(0)));
+    ASSERT_TRUE(h.isResizing());
+    EXPECT_EQ(3079, h.getSize());
+
+    verifyFound(h, keys);
+    EXPECT_EQ(20000, count(h));
+
+    // Mutate while part-migrated.
+    auto moreKeys = generateKeys(21000, 20000);
+    storeMany(h, moreKeys);
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(del(h, keys[i]));
+    }
+    keys.erase(keys.begin(), keys.begin() + 1000);
+    verifyFound(h, keys);
+    verifyFound(h, moreKeys);
+    EXPECT_EQ(20000, count(h));
+
+    EXPECT_TRUE(h.resizeIncremental(std::chrono::seconds(60)));
+    EXPECT_FALSE(h.isResizing());
+    EXPECT_EQ(24571, h.getSize());
+    verifyFound(h, keys);
+    verifyFound(h, moreKeys);
+    EXPECT_EQ(20000, count(h));
+}
+
 class AccessGenerator : public Generator<bool> {
 public:
     AccessGenerator(std::vector<StoredDocKey> k, HashTable& h)
@@ -333,6 +373,175 @@ TEST_F(HashTableTest, PoisonKey) {
     EXPECT_EQ(1, count(h));
 }
 
+TEST_F(HashTableTest, TaggedFind) {
+    HashTable h(global_stats, makeFactory(), 5, 1, HashTable::Layout::Tagged);
+    ASSERT_EQ(HashTable::Layout::Tagged, h.getLayout());
+    testFind(h);
+}
+
+// Check that keys can still be found (and removed) when the TagBlocks have
+// overflowed, and again once the chains shrink back to fit in them.
+TEST_F(HashTableTest, TaggedOverflowAndResize) {
+    size_t initialSize = global_stats.getCurrentSize();
+    HashTable h(global_stats, makeFactory(), 5, 3, HashTable::Layout::Tagged);
+
+    // 1000 keys in 5 buckets - every TagBlock overflows.
+    auto keys = generateKeys(1000);
+    storeMany(h, keys);
+    verifyFound(h, keys);
+    EXPECT_EQ(1000, count(h));
+
+    // Grow so the chains fit in the TagBlocks again.
+    h.resize(6143);
+    verifyFound(h, keys);
+
+    // Shrink (overflowing again), then auto-resize.
+    h.resize(7);
+    verifyFound(h, keys);
+    h.resize();
+    verifyFound(h, keys);
+
+    // Remove every other key; remaining keys must still be found and the
+    // removed ones must not.
+    std::vector<StoredDocKey> remaining;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (i % 2) {
+            EXPECT_TRUE(del(h, keys[i]));
+            EXPECT_FALSE(h.findForRead(keys[i]).storedValue);
+        } else {
+            remaining.push_back(keys[i]);
+        }
+    }
+    verifyFound(h, remaining);
+
+    for (const auto& key : remaining) {
+        EXPECT_TRUE(del(h, key));
+    }
+    EXPECT_EQ(0, count(h));
+    EXPECT_EQ(initialSize, global_stats.getCurrentSize());
+}
+
+TEST_F(HashTableTest, LayoutFromString) {
+    EXPECT_EQ(HashTable::Layout::Chained,
+              HashTable::layoutFromString("chained"));
+    EXPECT_EQ(HashTable::Layout::Tagged, HashTable::layoutFromString("tagged"));
+    EXPECT_THROW(HashTable::layoutFromString("open"), std::invalid_argument);
+}
+
+// Check that an optimistic read selects the same item as findForRead(), and
+// backs out whenever the bucket's lock is held.
+TEST_F(HashTableTest, OptimisticRead) {
+    HashTable h(global_stats, makeFactory(), 5, 1);
+    auto key = makeStoredDocKey("key");
+    store(h, key);
+
+    const StoredValue* found = nullptr;
+    auto reader = [&found](const StoredValue* v) {
+        found = v;
+        return true;
+    };
+    auto readOptimistic = [&h, &reader](const DocKey& k) {
+        return h.findForReadOptimistic(k,
+                                       TrackReference::No,
+                                       WantsDeleted::No,
+                                       ForGetReplicaOp::No,
+                                       reader);
+    };
+
+    EXPECT_TRUE(readOptimistic(key));
+    EXPECT_EQ(h.findForRead(key).storedValue, found);
+    EXPECT_TRUE(readOptimistic(makeStoredDocKey("missing")));
+    EXPECT_EQ(nullptr, found);
+    EXPECT_EQ(2, h.getNumOptimisticReads());
+    EXPECT_EQ(0, h.getNumOptimisticReadFallbacks());
+
+    // While the (only) lock is held the reader must not be invoked.
+    {
+        auto res = h.findForWrite(key);
+        ASSERT_TRUE(res.storedValue);
+        found = nullptr;
+        EXPECT_FALSE(readOptimistic(key));
+        EXPECT_EQ(nullptr, found);
+    }
+    EXPECT_EQ(1, h.getNumOptimisticReadFallbacks());
+
+    // A reader which declines the StoredValue also falls back.
+    EXPECT_FALSE(h.findForReadOptimistic(key,
+                                         TrackReference::No,
+                                         WantsDeleted::No,
+                                         ForGetReplicaOp::No,
+                                         [](const StoredValue*) {
+                                             return false;
+                                         }));
+    EXPECT_EQ(2, h.getNumOptimisticReadFallbacks());
+
+    // Releasing the lock early via HashBucketLock::unlock() re-admits
+    // optimistic readers immediately.
+    {
+        auto res = h.findForWrite(key);
+        res.lock.unlock();
+        EXPECT_TRUE(readOptimistic(key));
+    }
+    EXPECT_EQ(h.findForRead(key).storedValue, found);
+    EXPECT_EQ(3, h.getNumOptimisticReads());
+    EXPECT_EQ(2, h.getNumOptimisticReadFallbacks());
+}
+
+// Optimistic readers must never observe a StoredValue (or value) which is
+// being modified or freed by a concurrent writer.
+TEST_F(HashTableTest, ConcurrentOptimisticRead) {
+    HashTable h(global_stats, makeFactory(), 5, 1);
+    auto key = makeStoredDocKey("key");
+    const std::string small(10, 'a');
+    const std::string large(1000, 'b');
+
+    std::atomic<bool> done{false};
+    std::thread writer([&]() {
+        for (int i = 0; i < 10000; ++i) {
+            const auto& value = (i % 2) ? small : large;
+            Item item(key, 0, 0, value.data(), value.size());
+            h.set(item);
+            if (i % 3 == 0) {
+                del(h, key);
+            }
+        }
+        done = true;
+    });
+
+    std::vector<std::thread> readers;
+    std::atomic<size_t> mismatches{0};
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&]() {
+            while (!done) {
+                h.findForReadOptimistic(
+                        key,
+                        TrackReference::Yes,
+                        WantsDeleted::No,
+                        ForGetReplicaOp::No,
+                        [&mismatches](const StoredValue* v) {
+                            if (v) {
+                                auto item = v->toItem(Vbid(0));
+                                const std::string value(
+                                        item->getData(), item->getNBytes());
+                                if (value != std::string(value.size(),
+                                                         value.front())) {
+                                    mismatches++;
+                                }
+                            }
+                            return true;
+                        });
+            }
+        });
+    }
+
+    writer.join();
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(0, mismatches);
+    EXPECT_NE(0, h.getNumOptimisticReads());
+}
+
 // Test fixture for HashTable statistics tests.
 class HashTableStatsTest
     : public HashTableTest,
@@ -1119,6 +1328,25 @@ TEST_F(HashTableTest, reallocateStoredValue) {
     EXPECT_FALSE(ht3.reallocateStoredValue(std::forward<StoredValue>(*v2)));
 }
 
+// Check that reallocating a StoredValue updates the TagBlock index, so a
+// subsequent find returns the new (and not the freed) StoredValue.
+TEST_F(HashTableTest, reallocateStoredValueTagged) {
+    HashTable ht(global_stats, makeFactory(), 5, 1, HashTable::Layout::Tagged);
+    auto keys = generateKeys(10);
+    storeMany(ht, keys);
+
+    for (const auto& key : keys) {
+        StoredValue* v = ht.findForWrite(key, WantsDeleted::No).storedValue;
+        ASSERT_NE(nullptr, v);
+        EXPECT_TRUE(ht.reallocateStoredValue(std::forward<StoredValue>(*v)));
+        auto* newV = ht.findForWrite(key, WantsDeleted::No).storedValue;
+        ASSERT_NE(nullptr, newV);
+        EXPECT_NE(v, newV);
+        EXPECT_TRUE(newV->hasKey(key));
+    }
+    EXPECT_EQ(10, count(ht));
+}
+
 // MB-33944: Test that calling HashTable::insertFromWarmup() doesn't fail
 // of the given key is already resident (for example if a BG load already
 // loaded it).
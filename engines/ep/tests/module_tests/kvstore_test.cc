@@ -20,6 +20,7 @@
 
 #include "bucket_logger.h"
 #include "collections/vbucket_manifest.h"
+#include "couch-kvstore/couch-fs-syncgroup.h"
 #include "couch-kvstore/couch-kvstore-config.h"
 #include "couch-kvstore/couch-kvstore.h"
 #include "item.h"
@@ -46,6 +47,7 @@
 #include "vbucket_state.h"
 #include "workload.h"
 
+#include <folly/portability/Fcntl.h>
 #include <folly/portability/GMock.h>
 #include <folly/portability/GTest.h>
 #include <kvstore.h>
@@ -313,6 +315,114 @@ TEST_F(CouchKVStoreTest, StatsTest) {
     EXPECT_GE(io_total_write_bytes, io_write_bytes);
 }
 
+// Verify that getMulti() fetches all of a batch of documents correctly,
+// when reading them in file order and prefetching them.
+TEST_F(CouchKVStoreTest, GetMultiPrefetch) {
+    CouchKVStoreConfig config(1024, 4, data_dir, "couchdb", 0);
+    ASSERT_TRUE(config.getBgFetchPrefetch());
+    auto kvstore = setup_kv_store(config);
+
+    const int numItems = 20;
+    kvstore->begin(std::make_unique<TransactionContext>(vbid));
+    for (int i = 0; i < numItems; i++) {
+        kvstore->set(makeCommittedItem(
+                makeStoredDocKey("key" + std::to_string(i)),
+                "value" + std::to_string(i)));
+    }
+    ASSERT_TRUE(kvstore->commit(flush));
+
+    // Fetch in an order different to that on disk, plus a missing key and
+    // a metadata-only fetch.
+    vb_bgfetch_queue_t itms;
+    for (int i = numItems; i >= 0; i--) {
+        vb_bgfetch_item_ctx_t ctx;
+        ctx.isMetaOnly = i == 1 ? GetMetaOnly::Yes : GetMetaOnly::No;
+        ctx.bgfetched_list.push_back(
+                std::make_unique<FrontEndBGFetchItem>(nullptr, false));
+        itms[DiskDocKey{makeStoredDocKey("key" + std::to_string(i))}] =
+                std::move(ctx);
+    }
+    kvstore->getMulti(vbid, itms);
+
+    for (int i = 0; i <= numItems; i++) {
+        const auto& gv =
+                itms[DiskDocKey{makeStoredDocKey("key" + std::to_string(i))}]
+                        .value;
+        if (i == numItems) {
+            EXPECT_EQ(ENGINE_KEY_ENOENT, gv.getStatus());
+            continue;
+        }
+        ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus()) << "key" << i;
+        if (i != 1) {
+            EXPECT_EQ("value" + std::to_string(i),
+                      gv.item->getValue()->to_s());
+        }
+    }
+
+    std::map<std::string, std::string> stats;
+    kvstore->addStats(add_stat_callback, &stats, "");
+    EXPECT_LE(1u, stoul(stats["rw_0:io_bg_fetch_prefetch_count"]));
+    EXPECT_EQ(1u, kvstore->getKVStoreStat().getMultiHisto.getValueCount());
+}
+
+// Verify that with group commit enabled, the commits of a sync group only
+// invoke their callbacks once the group has been completed.
+TEST_F(CouchKVStoreTest, GroupCommit) {
+    CouchKVStoreConfig config(1024, 4, data_dir, "couchdb", 0);
+    config.setGroupCommit(true);
+    auto kvstore = setup_kv_store(config, {Vbid(0), Vbid(1)});
+
+    struct CountingContext : public TransactionContext {
+        CountingContext(Vbid vbid, int& sets)
+            : TransactionContext(vbid), sets(sets) {
+        }
+        void setCallback(const queued_item&,
+                         KVStore::MutationSetResultState result) override {
+            EXPECT_EQ(KVStore::MutationSetResultState::Insert, result);
+            ++sets;
+        }
+        int& sets;
+    };
+
+    int sets = 0;
+    ASSERT_TRUE(kvstore->beginSyncGroup());
+    for (auto vb : {Vbid(0), Vbid(1)}) {
+        kvstore->begin(std::make_unique<CountingContext>(vb, sets));
+        kvstore->set(makeCommittedItem(makeStoredDocKey("key"), "value"));
+        EXPECT_TRUE(kvstore->commit(flush));
+    }
+    EXPECT_EQ(0, sets);
+
+    EXPECT_TRUE(kvstore->completeSyncGroup());
+    EXPECT_EQ(2, sets);
+
+    for (auto vb : {Vbid(0), Vbid(1)}) {
+        auto gv = kvstore->get(DiskDocKey{makeStoredDocKey("key")}, vb);
+        EXPECT_EQ(ENGINE_SUCCESS, gv.getStatus()) << vb;
+    }
+
+    // Outside of a group, callbacks are invoked by commit.
+    kvstore->begin(std::make_unique<CountingContext>(vbid, sets));
+    kvstore->set(makeCommittedItem(makeStoredDocKey("key2"), "value"));
+    EXPECT_TRUE(kvstore->commit(flush));
+    EXPECT_EQ(3, sets);
+}
+
+// A syncfs() group barrier is refused (and group commit disabled) where the
+// kernel's syncfs doesn't report writeback errors.
+TEST_F(CouchKVStoreTest, GroupCommitSyncfsNeedsReliableSyncfs) {
+    CouchKVStoreConfig config(1024, 4, data_dir, "couchdb", 0);
+    config.setGroupCommit(true);
+    config.setGroupCommitSyncfs(true);
+    auto kvstore = setup_kv_store(config);
+
+    const bool grouped = kvstore->beginSyncGroup();
+    EXPECT_EQ(SyncGroupOps::isSyncfsReliable(), grouped);
+    if (grouped) {
+        EXPECT_TRUE(kvstore->completeSyncGroup());
+    }
+}
+
 // Verify the compaction stats returned from operations are accurate.
 TEST_F(CouchKVStoreTest, CompactStatsTest) {
     CouchKVStoreConfig config(1, 4, data_dir, "couchdb", 0);
@@ -929,6 +1039,35 @@ TEST_F(CouchKVStoreErrorInjectionTest, getMulti_open_doc_with_docinfo) {
     EXPECT_EQ(ENGINE_TMPFAIL, itms[DiskDocKey{*items.at(0)}].value.getStatus());
 }
 
+#ifdef POSIX_FADV_WILLNEED
+/**
+ * Verify that getMulti() advises the kernel of the documents it is about to
+ * read through the FileOps of the file it has open, without opening the file
+ * again.
+ */
+TEST_F(CouchKVStoreErrorInjectionTest, getMulti_prefetch_advise) {
+    populate_items(10);
+    vb_bgfetch_queue_t itms(make_bgfetch_queue());
+    {
+        /* Establish FileOps expectation */
+        EXPECT_CALL(ops, open(_, _, _, _)).Times(1);
+        EXPECT_CALL(ops, advise(_, _, _, _, _)).Times(AnyNumber());
+        EXPECT_CALL(ops,
+                    advise(_,
+                           _,
+                           _,
+                           _,
+                           couchstore_file_advice_t(POSIX_FADV_WILLNEED)))
+                .Times(AtLeast(1));
+        kvstore->getMulti(Vbid(0), itms);
+    }
+    for (const auto& item : items) {
+        EXPECT_EQ(ENGINE_SUCCESS, itms[DiskDocKey{*item}].value.getStatus());
+    }
+    EXPECT_LE(1u, kvstore->getKVStoreStat().getMultiPrefetchCount.load());
+}
+#endif
+
 /**
  * Injects error during CouchKVStore::compactDB/couchstore_compact_db_ex
  */
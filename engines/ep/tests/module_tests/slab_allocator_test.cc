@@ -0,0 +1,154 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "slab_allocator.h"
+
+#include <folly/portability/GTest.h>
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+TEST(SlabAllocatorTest, ChunkSize) {
+    EXPECT_EQ(16, SlabAllocator::getChunkSize(1));
+    EXPECT_EQ(16, SlabAllocator::getChunkSize(16));
+    EXPECT_EQ(32, SlabAllocator::getChunkSize(17));
+    EXPECT_EQ(64, SlabAllocator::getChunkSize(59));
+}
+
+TEST(SlabAllocatorTest, InvalidMaxChunkSize) {
+    EXPECT_THROW(SlabAllocator{0}, std::invalid_argument);
+    EXPECT_THROW(SlabAllocator{SlabAllocator::slabSize},
+                 std::invalid_argument);
+}
+
+TEST(SlabAllocatorTest, TooLarge) {
+    SlabAllocator allocator(64);
+    EXPECT_EQ(nullptr, allocator.allocate(65));
+    EXPECT_EQ(nullptr, allocator.allocate(0));
+    EXPECT_EQ(0, allocator.getNumSlabs());
+}
+
+TEST(SlabAllocatorTest, AllocateDeallocate) {
+    SlabAllocator allocator;
+    auto* a = allocator.allocate(59);
+    auto* b = allocator.allocate(60);
+    ASSERT_NE(nullptr, a);
+    ASSERT_NE(nullptr, b);
+    EXPECT_NE(a, b);
+    EXPECT_EQ(0,
+              reinterpret_cast<uintptr_t>(a) % SlabAllocator::chunkAlignment);
+    EXPECT_EQ(1, allocator.getNumSlabs());
+    EXPECT_EQ(2 * 64, allocator.getUsedBytes());
+
+    // Chunks must be usable for their full size.
+    std::memset(a, 'a', 64);
+    std::memset(b, 'b', 64);
+
+    SlabAllocator::deallocate(a);
+    EXPECT_EQ(64, allocator.getUsedBytes());
+
+    // Freed chunk is reused.
+    EXPECT_EQ(a, allocator.allocate(64));
+    SlabAllocator::deallocate(a);
+    SlabAllocator::deallocate(b);
+    EXPECT_EQ(0, allocator.getUsedBytes());
+}
+
+// Allocating more than one slab's worth of chunks and then freeing all but
+// a couple should report the chunk which is not in the allocation target
+// slab as fragmented, and relocating it should release its slab.
+TEST(SlabAllocatorTest, Fragmentation) {
+    SlabAllocator allocator;
+    const size_t size = 256;
+    std::vector<void*> chunks;
+    while (allocator.getNumSlabs() < 3) {
+        chunks.push_back(allocator.allocate(size));
+    }
+    ASSERT_EQ(3, allocator.getNumSlabs());
+
+    // Free every chunk except the first (in the first slab) and the last
+    // (in the third slab).
+    for (size_t ii = 1; ii < chunks.size() - 1; ++ii) {
+        SlabAllocator::deallocate(chunks[ii]);
+    }
+    // The empty second slab is returned.
+    EXPECT_EQ(2, allocator.getNumSlabs());
+
+    // Both remaining slabs are sparse, but only the one which isn't the
+    // allocation target (the lowest addressed) is worth relocating from.
+    auto* first = chunks.front();
+    auto* last = chunks.back();
+    ASSERT_NE(SlabAllocator::isFragmented(first),
+              SlabAllocator::isFragmented(last));
+    auto* fragmented = SlabAllocator::isFragmented(first) ? first : last;
+    auto* remaining = (fragmented == first) ? last : first;
+
+    // "Relocate" the fragmented chunk; the slab it was in should be freed.
+    auto* relocated = allocator.allocate(size);
+    SlabAllocator::deallocate(fragmented);
+    EXPECT_EQ(1, allocator.getNumSlabs());
+    EXPECT_FALSE(SlabAllocator::isFragmented(relocated));
+
+    SlabAllocator::deallocate(relocated);
+    SlabAllocator::deallocate(remaining);
+    EXPECT_EQ(0, allocator.getUsedBytes());
+}
+
+// Chunks may be deallocated after the allocator has been destroyed; their
+// slabs must remain valid until then.
+TEST(SlabAllocatorTest, ChunksOutliveAllocator) {
+    std::vector<void*> chunks;
+    {
+        SlabAllocator allocator;
+        while (allocator.getNumSlabs() < 2) {
+            chunks.push_back(allocator.allocate(256));
+        }
+        // An empty slab of another size class is freed with the allocator.
+        SlabAllocator::deallocate(allocator.allocate(64));
+        EXPECT_EQ(3, allocator.getNumSlabs());
+    }
+    for (auto* chunk : chunks) {
+        std::memset(chunk, 'x', 256);
+        SlabAllocator::deallocate(chunk);
+    }
+}
+
+TEST(SlabAllocatorTest, Concurrent) {
+    SlabAllocator allocator;
+    const int numThreads = 4;
+    const int numAllocs = 10000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; ++t) {
+        threads.emplace_back([&allocator, t]() {
+            std::vector<void*> chunks;
+            for (int ii = 0; ii < numAllocs; ++ii) {
+                const size_t size = 16 + ((ii + t) % 8) * 16;
+                auto* chunk = allocator.allocate(size);
+                std::memset(chunk, t, size);
+                chunks.push_back(chunk);
+            }
+            for (auto* chunk : chunks) {
+                SlabAllocator::deallocate(chunk);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(0, allocator.getUsedBytes());
+}
@@ -457,6 +457,195 @@ TEST_F(OrderedStoredValueTest, copyStoreValue) {
     EXPECT_EQ(100, copy->getFreqCounterValue());
 }
 
+/**
+ * Test fixture for StoredValues created with inline value storage.
+ */
+class InlineStoredValueTest : public ::testing::Test {
+public:
+    InlineStoredValueTest()
+        : factory(stats, threshold),
+          ht(stats,
+             std::make_unique<StoredValueFactory>(stats, threshold),
+             /*size*/ 47,
+             /*locks*/ 1),
+          item(make_item(Vbid(0), makeStoredDocKey("key"), "value")) {
+    }
+
+    void SetUp() override {
+        sv = factory(item, {});
+    }
+
+protected:
+    static constexpr size_t threshold = 16;
+    EPStats stats;
+    StoredValueFactory factory;
+    HashTable ht;
+    Item item;
+    StoredValue::UniquePtr sv;
+};
+
+TEST_F(InlineStoredValueTest, createInline) {
+    ASSERT_TRUE(sv->isValueInline());
+    EXPECT_TRUE(sv->hasValue());
+    EXPECT_FALSE(sv->getValue()) << "No Blob expected for an inline value";
+    EXPECT_EQ("value", sv->getValueView());
+    EXPECT_EQ(5, sv->valuelen());
+    EXPECT_EQ(5, sv->uncompressedValuelen());
+
+    // The value is part of the object; size() should not count it twice.
+    const auto key = makeStoredDocKey("key");
+    EXPECT_EQ(StoredValue::getRequiredStorage(
+                      key, StoredValue::getInlineValueCapacity(5)),
+              sv->getObjectSize());
+    EXPECT_EQ(sv->getObjectSize(), sv->size());
+    EXPECT_EQ(sv->getObjectSize(), sv->metaDataSize());
+    EXPECT_EQ(sv->getObjectSize(), sv->uncompressedSize());
+}
+
+TEST_F(InlineStoredValueTest, notInlineAboveThreshold) {
+    auto big = factory(make_item(Vbid(0),
+                                 makeStoredDocKey("big"),
+                                 std::string(threshold + 1, 'x')),
+                       {});
+    EXPECT_FALSE(big->isValueInline());
+    ASSERT_TRUE(big->getValue());
+    EXPECT_EQ(StoredValue::getRequiredStorage(makeStoredDocKey("big")),
+              big->getObjectSize());
+    EXPECT_EQ(big->getObjectSize() + threshold + 1, big->size());
+}
+
+TEST_F(InlineStoredValueTest, toItem) {
+    auto itm = sv->toItem(Vbid(0));
+    ASSERT_TRUE(itm->getValue());
+    EXPECT_EQ("value", std::string(itm->getData(), itm->getNBytes()));
+
+    auto info = sv->getItemInfo(0);
+    ASSERT_TRUE(info);
+    EXPECT_EQ("value",
+              std::string(static_cast<const char*>(info->value[0].iov_base),
+                          info->value[0].iov_len));
+}
+
+// Updates which fit in the inline capacity are applied in place; larger ones
+// fall back to a Blob (and can move back inline later).
+TEST_F(InlineStoredValueTest, setValue) {
+    const auto objectSize = sv->getObjectSize();
+    sv->setFreqCounterValue(77);
+
+    sv->setValue(make_item(Vbid(0), makeStoredDocKey("key"), "value2"));
+    EXPECT_TRUE(sv->isValueInline());
+    EXPECT_EQ("value2", sv->getValueView());
+    EXPECT_EQ(objectSize, sv->getObjectSize());
+    EXPECT_EQ(77, sv->getFreqCounterValue());
+
+    const std::string large(64, 'x');
+    sv->setValue(make_item(Vbid(0), makeStoredDocKey("key"), large));
+    EXPECT_FALSE(sv->isValueInline());
+    ASSERT_TRUE(sv->getValue());
+    EXPECT_EQ(large, sv->getValueView());
+    EXPECT_EQ(objectSize, sv->getObjectSize());
+    EXPECT_EQ(objectSize + large.size(), sv->size());
+    EXPECT_EQ(77, sv->getFreqCounterValue());
+
+    sv->setValue(make_item(Vbid(0), makeStoredDocKey("key"), "v3"));
+    EXPECT_TRUE(sv->isValueInline());
+    EXPECT_FALSE(sv->getValue());
+    EXPECT_EQ("v3", sv->getValueView());
+}
+
+TEST_F(InlineStoredValueTest, ejectAndRestore) {
+    sv->markClean();
+    // Value eviction of an inline value frees nothing.
+    EXPECT_FALSE(sv->eligibleForEviction(EvictionPolicy::Value));
+    EXPECT_TRUE(sv->eligibleForEviction(EvictionPolicy::Full));
+
+    sv->ejectValue();
+    EXPECT_FALSE(sv->isValueInline());
+    EXPECT_FALSE(sv->hasValue());
+    EXPECT_FALSE(sv->isResident());
+    EXPECT_EQ(0, sv->valuelen());
+
+    sv->restoreValue(item);
+    EXPECT_TRUE(sv->isValueInline());
+    EXPECT_TRUE(sv->isResident());
+    EXPECT_EQ("value", sv->getValueView());
+}
+
+TEST_F(InlineStoredValueTest, del) {
+    EXPECT_TRUE(sv->del(DeleteSource::Explicit));
+    EXPECT_FALSE(sv->hasValue());
+    EXPECT_FALSE(sv->isValueInline());
+    EXPECT_FALSE(sv->del(DeleteSource::Explicit));
+}
+
+TEST_F(InlineStoredValueTest, copyStoredValue) {
+    auto copy = factory.copyStoredValue(*sv, {});
+    EXPECT_TRUE(copy->isValueInline());
+    EXPECT_EQ("value", copy->getValueView());
+    EXPECT_EQ(sv->getObjectSize(), copy->getObjectSize());
+    EXPECT_EQ(*sv, *copy);
+}
+
+// HashTable memory statistics must balance for inline values.
+TEST_F(InlineStoredValueTest, hashTableStats) {
+    ASSERT_EQ(0, ht.getItemMemory());
+    ASSERT_EQ(MutationStatus::WasClean, ht.set(item));
+    {
+        auto res = ht.findForWrite(item.getKey());
+        ASSERT_TRUE(res.storedValue);
+        ASSERT_TRUE(res.storedValue->isValueInline());
+        EXPECT_EQ(res.storedValue->size(), ht.getItemMemory());
+        EXPECT_EQ(res.storedValue->metaDataSize(), ht.getMetadataMemory());
+    }
+
+    // Grow out of line and back again.
+    auto large = make_item(Vbid(0), item.getKey(), std::string(64, 'x'));
+    ASSERT_EQ(MutationStatus::WasDirty, ht.set(large));
+    ASSERT_EQ(MutationStatus::WasDirty, ht.set(item));
+
+    ht.clear();
+    EXPECT_EQ(0, ht.getItemMemory());
+    EXPECT_EQ(0, ht.getMetadataMemory());
+    EXPECT_EQ(0, ht.getUncompressedItemMemory());
+}
+
+// StoredValues from a slab allocating factory should be allocated from (and
+// returned to) its slabs, including copies made by defragmentation.
+TEST(SlabStoredValueTest, allocateAndCopy) {
+    EPStats stats;
+    StoredValueFactory factory(stats, /*inlineValueThreshold*/ 0, true);
+    auto item = make_item(Vbid(0), makeStoredDocKey("key"), "value");
+    auto sv = factory(item, {});
+    EXPECT_TRUE(sv->isSlabAllocated());
+    EXPECT_EQ(0,
+              reinterpret_cast<uintptr_t>(sv.get().get()) %
+                      SlabAllocator::chunkAlignment);
+
+    auto copy = factory.copyStoredValue(*sv, {});
+    EXPECT_TRUE(copy->isSlabAllocated());
+    EXPECT_EQ(*sv, *copy);
+    EXPECT_NE(sv.get().get(), copy.get().get());
+
+    // A factory without a slab allocator uses the global allocator.
+    StoredValueFactory plainFactory(stats);
+    EXPECT_FALSE(plainFactory(item, {})->isSlabAllocated());
+}
+
+// A StoredValue released from a HashTable may outlive the HashTable and its
+// factory; freeing it afterwards must still be valid.
+TEST(SlabStoredValueTest, outlivesFactory) {
+    EPStats stats;
+    auto item = make_item(Vbid(0), makeStoredDocKey("key"), "value");
+    StoredValue::UniquePtr sv;
+    {
+        StoredValueFactory factory(stats, /*inlineValueThreshold*/ 0, true);
+        sv = factory(item, {});
+        ASSERT_TRUE(sv->isSlabAllocated());
+    }
+    EXPECT_EQ(item.getKey(), sv->getKey());
+    sv.reset();
+}
+
 /**
  * Test fixture for implementation testing of StoredValue, requiring access
  * to protected items in StoredValue
@@ -389,6 +389,36 @@ struct MEMCACHED_PUBLIC_CLASS DcpIface {
             gsl::not_null<const void*> cookie,
             gsl::not_null<dcp_message_producers*> producers) = 0;
 
+    /**
+     * Like step(), but allow the engine to inject a batch of messages on the
+     * stream in one call (saving the per call overhead of step()). The
+     * engine adds messages until it has none ready, a message producer
+     * fails or (approximately) max_bytes have been added; always at least
+     * one message if it has any.
+     *
+     * The default implementation injects a single message with step().
+     *
+     * @param cookie a unique handle the engine should pass on to the
+     *               message producers
+     * @param producers functions the client may use to add messages to
+     *                  the DCP stream
+     * @param max_bytes the number of bytes of messages the caller wants
+     * @param nmessages set to the number of messages added
+     * @return as for step(): ENGINE_EWOULDBLOCK if no message was ready,
+     *         the error of a failed message producer (but ENGINE_SUCCESS
+     *         if it was ENGINE_E2BIG and messages were added), else
+     *         ENGINE_SUCCESS
+     */
+    virtual ENGINE_ERROR_CODE step_batch(
+            gsl::not_null<const void*> cookie,
+            gsl::not_null<dcp_message_producers*> producers,
+            size_t max_bytes,
+            size_t& nmessages) {
+        const auto ret = step(cookie, producers);
+        nmessages = (ret == ENGINE_SUCCESS) ? 1 : 0;
+        return ret;
+    }
+
     /**
      * Called from the memcached core to open a new DCP connection.
      *
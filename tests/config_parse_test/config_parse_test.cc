@@ -656,6 +656,34 @@ TEST_F(SettingsTest, ConnectionIdleTime) {
     }
 }
 
+TEST_F(SettingsTest, SchedTimeBudget) {
+    nonNumericValuesShouldFail("sched_time_budget");
+
+    nlohmann::json obj;
+    obj["sched_time_budget"] = 250;
+    try {
+        Settings settings(obj);
+        EXPECT_EQ(250, settings.getSchedTimeBudget());
+        EXPECT_TRUE(settings.has.sched_time_budget);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+}
+
+TEST_F(SettingsTest, ThreadRebalanceInterval) {
+    nonNumericValuesShouldFail("thread_rebalance_interval");
+
+    nlohmann::json obj;
+    obj["thread_rebalance_interval"] = 5;
+    try {
+        Settings settings(obj);
+        EXPECT_EQ(5, settings.getThreadRebalanceInterval());
+        EXPECT_TRUE(settings.has.thread_rebalance_interval);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+}
+
 TEST_F(SettingsTest, DatatypeJson) {
     nonBooleanValuesShouldFail("datatype_json");
 
@@ -0,0 +1,191 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/**
+ * Compare the ways a DCP mutation may be encoded into the output stream of
+ * a connection: built in a scratch buffer and then copied, or built in place
+ * in space reserved in the output (as Connection::sendDcpItemMessage does).
+ *
+ * For the evbuffer (used by TLS connections) the value is encoded along with
+ * the rest of the message. For the GatherWriter (used by plain connections)
+ * the value is referenced.
+ */
+
+#include <benchmark/benchmark.h>
+#include <daemon/gather_writer.h>
+#include <daemon/sendbuffer.h>
+#include <event2/buffer.h>
+#include <mcbp/protocol/framebuilder.h>
+#include <memcached/protocol_binary.h>
+#include <gsl/gsl>
+
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+class DcpEncodeBench : public ::benchmark::Fixture {
+public:
+    void SetUp(benchmark::State& state) override {
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sockets) !=
+            0) {
+            throw std::runtime_error("DcpEncodeBench: socketpair failed");
+        }
+        output = evbuffer_new();
+        value.assign(state.range(0), 'x');
+        scratch.resize(8192);
+        drain.resize(256 * 1024);
+    }
+
+    void TearDown(benchmark::State&) override {
+        evbuffer_free(output);
+        close(sockets[0]);
+        close(sockets[1]);
+    }
+
+protected:
+    enum class Mode { Scratch, InPlace };
+
+    /// Encode a mutation (with the value unless withValue is false) in the
+    /// given buffer.
+    /// @return the size of the message, excluding a value not encoded.
+    size_t encode(cb::char_buffer buffer, bool withValue) {
+        cb::mcbp::RequestBuilder builder(buffer);
+        builder.setMagic(cb::mcbp::Magic::ClientRequest);
+        builder.setOpcode(cb::mcbp::ClientOpcode::DcpMutation);
+        builder.setExtras(extras.getBuffer());
+        builder.setKey(std::string_view{key});
+        builder.setOpaque(0xdeadbeef);
+        builder.setVBucket(Vbid(0));
+        builder.setCas(1);
+        auto* req = builder.getFrame();
+        if (withValue) {
+            builder.setValue(std::string_view{value});
+        } else {
+            req->setBodylen(
+                    gsl::narrow<uint32_t>(req->getBodylen() + value.size()));
+        }
+        return req->getFrame().size() - (withValue ? 0 : value.size());
+    }
+
+    size_t messageSize(bool withValue) const {
+        return sizeof(cb::mcbp::Request) + sizeof(extras) + key.size() +
+               (withValue ? value.size() : 0);
+    }
+
+    /// Send everything in the output, and read it on the other end
+    void flush() {
+        writer.write(sockets[0]);
+        while (read(sockets[1], drain.data(), drain.size()) > 0) {
+        }
+        writer.spill(output);
+        while (evbuffer_get_length(output) > 0) {
+            if (evbuffer_write(output, sockets[0]) < 0 && errno != EAGAIN) {
+                throw std::runtime_error("DcpEncodeBench: write failed");
+            }
+            while (read(sockets[1], drain.data(), drain.size()) > 0) {
+            }
+        }
+    }
+
+    void addToEvbuffer(Mode mode) {
+        if (mode == Mode::Scratch) {
+            const auto size = encode({scratch.data(), scratch.size()}, true);
+            evbuffer_add(output, scratch.data(), size);
+            return;
+        }
+
+        const auto size = messageSize(true);
+        evbuffer_iovec space;
+        if (evbuffer_reserve_space(output, size, &space, 1) != 1) {
+            throw std::bad_alloc();
+        }
+        encode({static_cast<char*>(space.iov_base), size}, true);
+        space.iov_len = size;
+        evbuffer_commit_space(output, &space, 1);
+    }
+
+    void addToGatherWriter(Mode mode) {
+        if (mode == Mode::Scratch) {
+            const auto size = encode({scratch.data(), scratch.size()}, false);
+            writer.copy({scratch.data(), size});
+        } else {
+            const auto size = messageSize(false);
+            encode(writer.reserve(size), false);
+            writer.commit(size);
+        }
+        writer.reference(
+                std::make_unique<SendBuffer>(std::string_view{value}));
+    }
+
+    void run(benchmark::State& state, Mode mode, bool gather) {
+        // Add a batch of messages per write, as for a DCP step batch
+        const int messagesPerWrite = 32;
+        for (auto _ : state) {
+            for (int ii = 0; ii < messagesPerWrite; ++ii) {
+                if (gather) {
+                    addToGatherWriter(mode);
+                } else {
+                    addToEvbuffer(mode);
+                }
+            }
+            flush();
+        }
+        state.SetItemsProcessed(state.iterations() * messagesPerWrite);
+    }
+
+    int sockets[2];
+    evbuffer* output = nullptr;
+    GatherWriter writer;
+    const cb::mcbp::request::DcpMutationPayload extras{1, 1, 0, 0, 0, 0};
+    const std::string key = "benchmark-document-key";
+    std::string value;
+    std::vector<char> scratch;
+    std::vector<char> drain;
+};
+
+BENCHMARK_DEFINE_F(DcpEncodeBench, EvbufferScratch)(benchmark::State& state) {
+    run(state, Mode::Scratch, false);
+}
+
+BENCHMARK_DEFINE_F(DcpEncodeBench, EvbufferInPlace)(benchmark::State& state) {
+    run(state, Mode::InPlace, false);
+}
+
+BENCHMARK_DEFINE_F(DcpEncodeBench, GatherScratch)(benchmark::State& state) {
+    run(state, Mode::Scratch, true);
+}
+
+BENCHMARK_DEFINE_F(DcpEncodeBench, GatherInPlace)(benchmark::State& state) {
+    run(state, Mode::InPlace, true);
+}
+
+BENCHMARK_REGISTER_F(DcpEncodeBench, EvbufferScratch)
+        ->RangeMultiplier(4)
+        ->Range(64, 4096);
+BENCHMARK_REGISTER_F(DcpEncodeBench, EvbufferInPlace)
+        ->RangeMultiplier(4)
+        ->Range(64, 4096);
+BENCHMARK_REGISTER_F(DcpEncodeBench, GatherScratch)
+        ->RangeMultiplier(4)
+        ->Range(64, 4096);
+BENCHMARK_REGISTER_F(DcpEncodeBench, GatherInPlace)
+        ->RangeMultiplier(4)
+        ->Range(64, 4096);
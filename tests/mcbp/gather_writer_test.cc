@@ -0,0 +1,282 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include <daemon/gather_writer.h>
+#include <daemon/sendbuffer.h>
+#include <event2/buffer.h>
+#include <folly/portability/GTest.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <string>
+
+/// A SendBuffer counting the number of live instances
+class CountedSendBuffer : public SendBuffer {
+public:
+    CountedSendBuffer(std::string_view view, int& live)
+        : SendBuffer(view), live(live) {
+        ++live;
+    }
+    ~CountedSendBuffer() override {
+        --live;
+    }
+
+protected:
+    int& live;
+};
+
+class GatherWriterTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_EQ(0,
+                  socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sockets));
+        output = evbuffer_new();
+    }
+
+    void TearDown() override {
+        evbuffer_free(output);
+        close(sockets[0]);
+        close(sockets[1]);
+    }
+
+    /// @return everything available on the other end of the socket
+    std::string receive() {
+        std::string ret;
+        char buffer[4096];
+        ssize_t nr;
+        while ((nr = read(sockets[1], buffer, sizeof(buffer))) > 0) {
+            ret.append(buffer, nr);
+        }
+        return ret;
+    }
+
+    /// Limit the send buffer of the writing end of the socket.
+    void setSendBufferSize(int size) {
+        ASSERT_EQ(0,
+                  setsockopt(sockets[0],
+                             SOL_SOCKET,
+                             SO_SNDBUF,
+                             &size,
+                             sizeof(size)));
+    }
+
+    /// Write to the socket until it doesn't accept any more.
+    /// @return the number of bytes written
+    size_t fillSocket() {
+        const std::string junk(4096, 'j');
+        size_t total = 0;
+        ssize_t nw;
+        while ((nw = ::write(sockets[0], junk.data(), junk.size())) > 0) {
+            total += nw;
+        }
+        EXPECT_EQ(EAGAIN, errno);
+        return total;
+    }
+
+    int sockets[2];
+    evbuffer* output = nullptr;
+    GatherWriter writer;
+    int live = 0;
+};
+
+// Copied and referenced data is sent in order with a single sendmsg, and the
+// referenced buffers released.
+TEST_F(GatherWriterTest, Write) {
+    const std::string value1(100, 'a');
+    const std::string value2(2000, 'b');
+    writer.copy("header1");
+    writer.reference(std::make_unique<CountedSendBuffer>(value1, live));
+    writer.copy("header2");
+    writer.copy("extras2");
+    writer.reference(std::make_unique<CountedSendBuffer>(value2, live));
+    EXPECT_EQ(2, live);
+    EXPECT_EQ(7 + 100 + 14 + 2000, writer.size());
+
+    EXPECT_EQ(1, writer.write(sockets[0]));
+    EXPECT_TRUE(writer.empty());
+    EXPECT_EQ(0, writer.size());
+    EXPECT_EQ(0, live);
+    EXPECT_EQ("header1" + value1 + "header2extras2" + value2, receive());
+}
+
+// Data may be encoded in place in reserved space, and only the committed part
+// of it is sent (in order with the rest of the output).
+TEST_F(GatherWriterTest, ReserveCommit) {
+    const std::string value(100, 'a');
+    writer.copy("header1");
+    auto space = writer.reserve(16);
+    ASSERT_EQ(16, space.size());
+    std::copy_n("header2", 7, space.data());
+    writer.commit(7);
+    writer.reference(std::make_unique<CountedSendBuffer>(value, live));
+
+    // Nothing is added by a reservation which isn't committed
+    writer.reserve(16);
+    writer.commit(0);
+    writer.copy("header3");
+    EXPECT_EQ(7 + 7 + 100 + 7, writer.size());
+
+    EXPECT_THROW(writer.commit(1024), std::logic_error);
+
+    EXPECT_EQ(1, writer.write(sockets[0]));
+    EXPECT_TRUE(writer.empty());
+    EXPECT_EQ(0, live);
+    EXPECT_EQ("header1header2" + value + "header3", receive());
+}
+
+// Whatever the socket doesn't accept is moved to the evbuffer (in order),
+// keeping the referenced buffers until the evbuffer is done with them.
+TEST_F(GatherWriterTest, Spill) {
+    setSendBufferSize(4096);
+
+    std::string expected;
+    const std::string value(10000, 'v');
+    for (int ii = 0; ii < 20; ++ii) {
+        const auto header = "header" + std::to_string(ii);
+        writer.copy(header);
+        writer.reference(std::make_unique<CountedSendBuffer>(value, live));
+        expected += header + value;
+    }
+
+    writer.write(sockets[0]);
+    EXPECT_FALSE(writer.empty());
+    auto received = receive();
+    ASSERT_LT(received.size(), expected.size());
+
+    writer.spill(output);
+    EXPECT_TRUE(writer.empty());
+    EXPECT_EQ(expected.size() - received.size(), evbuffer_get_length(output));
+    EXPECT_LT(0, live);
+
+    while (evbuffer_get_length(output) > 0) {
+        evbuffer_write(output, sockets[0]);
+        received += receive();
+    }
+    EXPECT_EQ(expected, received);
+    EXPECT_EQ(0, live);
+
+    // The writer may be reused
+    writer.copy("next");
+    EXPECT_EQ(1, writer.write(sockets[0]));
+    EXPECT_EQ("next", receive());
+}
+
+// A partial sendmsg may end within a segment (copied or referenced); the
+// next write() resumes from there.
+TEST_F(GatherWriterTest, PartialWrite) {
+    setSendBufferSize(4096);
+
+    std::string expected;
+    const std::string value(30000, 'v');
+    const std::string header(20000, 'h');
+    for (int ii = 0; ii < 4; ++ii) {
+        writer.copy(header);
+        writer.reference(std::make_unique<CountedSendBuffer>(value, live));
+        expected += header + value;
+    }
+
+    std::string received;
+    int writes = 0;
+    while (!writer.empty()) {
+        ASSERT_LT(writes++, 10000) << "no progress writing";
+        writer.write(sockets[0]);
+        received += receive();
+        EXPECT_EQ(expected.size() - received.size(), writer.size());
+        EXPECT_LE(live, 4);
+    }
+    EXPECT_LT(1, writes);
+    EXPECT_EQ(expected, received);
+    EXPECT_EQ(0, live);
+}
+
+// If the socket doesn't accept anything (EAGAIN) the output is kept as is,
+// to be written (or spilled) later.
+TEST_F(GatherWriterTest, WouldBlock) {
+    const auto junk = fillSocket();
+    const std::string value(1000, 'v');
+    writer.copy("header");
+    writer.reference(std::make_unique<CountedSendBuffer>(value, live));
+
+    EXPECT_EQ(0, writer.write(sockets[0]));
+    EXPECT_EQ(6 + value.size(), writer.size());
+    EXPECT_EQ(1, live);
+
+    EXPECT_EQ(junk, receive().size());
+    EXPECT_EQ(1, writer.write(sockets[0]));
+    EXPECT_TRUE(writer.empty());
+    EXPECT_EQ(0, live);
+    EXPECT_EQ("header" + value, receive());
+}
+
+// The same, but spilling the output to the evbuffer (as the connection does
+// after every write()) and sending it from there.
+TEST_F(GatherWriterTest, WouldBlockSpill) {
+    const auto junk = fillSocket();
+    const std::string value(1000, 'v');
+    writer.copy("header");
+    writer.reference(std::make_unique<CountedSendBuffer>(value, live));
+
+    EXPECT_EQ(0, writer.write(sockets[0]));
+    writer.spill(output);
+    EXPECT_TRUE(writer.empty());
+    EXPECT_EQ(6 + value.size(), evbuffer_get_length(output));
+    EXPECT_EQ(1, live);
+
+    EXPECT_EQ(junk, receive().size());
+    EXPECT_EQ(6 + value.size(), evbuffer_write(output, sockets[0]));
+    EXPECT_EQ(0, live);
+    EXPECT_EQ("header" + value, receive());
+}
+
+// More segments than fit the iovecs of one sendmsg are sent with several.
+TEST_F(GatherWriterTest, ManySegments) {
+    std::string expected;
+    for (int ii = 0; ii < 300; ++ii) {
+        const auto header = std::to_string(ii);
+        writer.copy(header);
+        writer.reference(std::make_unique<CountedSendBuffer>("value", live));
+        expected += header + "value";
+    }
+
+    EXPECT_EQ(3, writer.write(sockets[0]));
+    EXPECT_TRUE(writer.empty());
+    EXPECT_EQ(0, live);
+    EXPECT_EQ(expected, receive());
+}
+
+// A write error (here EPIPE) leaves the output in place for the bufferevent
+// to pick up the error.
+TEST_F(GatherWriterTest, WriteError) {
+    // As memcached does
+    auto* previous = std::signal(SIGPIPE, SIG_IGN);
+    close(sockets[1]);
+    sockets[1] = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    writer.copy("header");
+    writer.reference(std::make_unique<CountedSendBuffer>("value", live));
+    EXPECT_EQ(0, writer.write(sockets[0]));
+    EXPECT_EQ(11, writer.size());
+    EXPECT_EQ(1, live);
+
+    writer.spill(output);
+    EXPECT_EQ(11, evbuffer_get_length(output));
+    EXPECT_EQ(-1, evbuffer_write(output, sockets[0]));
+    EXPECT_EQ(EPIPE, errno);
+    std::signal(SIGPIPE, previous);
+}
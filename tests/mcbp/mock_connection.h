@@ -26,4 +26,16 @@ class MockConnection : public Connection {
 public:
     MockConnection(struct FrontEndThread& thr) : Connection(thr) {
     }
+
+    /// Account for a time slice which executed the given number of requests
+    /// and took the given time (as executeCommandsCallback() does)
+    void runSlice(int requests, std::chrono::nanoseconds ns) {
+        sliceEvents = requests;
+        numEvents = 0;
+        addCpuTime(ns);
+    }
+
+    std::chrono::nanoseconds getRequestCost() const {
+        return requestCost;
+    }
 };
@@ -0,0 +1,143 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/**
+ * Measure the cost of notifying a front end thread about IO completions
+ * (as notify_io_complete() does for bg-fetch completions) from a number of
+ * background threads, and how many wakeups of the front end thread they
+ * result in.
+ */
+
+#include <benchmark/benchmark.h>
+#include <daemon/front_end_thread.h>
+#include <event2/event.h>
+
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+class NotificationBench : public ::benchmark::Fixture {
+public:
+    NotificationBench() {
+        if (!create_notification_channel(thread)) {
+            throw std::runtime_error(
+                    "NotificationBench: failed to create notification "
+                    "channel");
+        }
+    }
+
+    void SetUp(benchmark::State&) override {
+        base = event_base_new();
+        if (event_assign(&thread.notify_event,
+                         base,
+                         thread.notify[0],
+                         EV_READ | EV_PERSIST,
+                         callback,
+                         this) == -1 ||
+            event_add(&thread.notify_event, nullptr) == -1) {
+            throw std::runtime_error(
+                    "NotificationBench: failed to monitor notification "
+                    "channel");
+        }
+        processed = 0;
+        wakeups = 0;
+        stop = false;
+        loop = std::thread([this]() {
+            while (!stop) {
+                event_base_loop(base, EVLOOP_ONCE);
+            }
+        });
+    }
+
+    void TearDown(benchmark::State&) override {
+        stop = true;
+        notify_thread(thread);
+        loop.join();
+        event_del(&thread.notify_event);
+        event_base_free(base);
+    }
+
+protected:
+    /// The front end thread: drain the channel and "run" the connections
+    /// with completed IO, like thread_libevent_process()
+    static void callback(evutil_socket_t, short, void* arg) {
+        auto& bench = *reinterpret_cast<NotificationBench*>(arg);
+        drain_notification_channel(bench.thread);
+        ++bench.wakeups;
+
+        FrontEndThread::PendingIoMap pending;
+        {
+            std::lock_guard<std::mutex> lock(bench.thread.pending_io.mutex);
+            bench.thread.pending_io.map.swap(pending);
+        }
+        bench.processed += pending.size();
+    }
+
+    /// A background thread completing IO for the given connections, like
+    /// add_conn_to_pending_io_list() and notify_io_complete()
+    void complete(uintptr_t first, size_t count) {
+        for (uintptr_t id = first; id < first + count; ++id) {
+            {
+                std::lock_guard<std::mutex> lock(thread.pending_io.mutex);
+                thread.pending_io.map[reinterpret_cast<Connection*>(id)]
+                        .emplace_back(nullptr, ENGINE_SUCCESS);
+            }
+            notify_thread(thread);
+        }
+    }
+
+    FrontEndThread thread;
+    event_base* base = nullptr;
+    std::thread loop;
+    std::atomic_bool stop{false};
+    std::atomic<size_t> processed{0};
+    std::atomic<size_t> wakeups{0};
+};
+
+/// Each iteration, state.range(0) threads each complete 1000 bg-fetches
+/// (for different connections) and wait for all of them to be processed.
+BENCHMARK_DEFINE_F(NotificationBench, BgFetchCompletions)
+(benchmark::State& state) {
+    const size_t numThreads = state.range(0);
+    const size_t perThread = 1000;
+    size_t total = 0;
+    for (auto _ : state) {
+        std::vector<std::thread> completers;
+        for (size_t ii = 0; ii < numThreads; ++ii) {
+            const auto first = 1 + total + ii * perThread;
+            completers.emplace_back(
+                    [this, first, perThread]() { complete(first, perThread); });
+        }
+        for (auto& t : completers) {
+            t.join();
+        }
+        total += numThreads * perThread;
+        while (processed < total) {
+            std::this_thread::yield();
+        }
+    }
+    state.SetItemsProcessed(total);
+    state.counters["wakeups_per_completion"] = double(wakeups) / total;
+}
+
+BENCHMARK_REGISTER_F(NotificationBench, BgFetchCompletions)
+        ->Arg(1)
+        ->Arg(4)
+        ->Arg(16)
+        ->UseRealTime();
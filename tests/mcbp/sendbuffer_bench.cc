@@ -0,0 +1,189 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/**
+ * Compare the ways a GET response value may be added to the output stream
+ * of a connection: copied into the evbuffer, added to the evbuffer by
+ * reference with a SendBuffer pinning the value (as Connection does for
+ * TLS connections, for values above SendBuffer::MinimumDataSize), or
+ * referenced by a GatherWriter and sent with sendmsg (as Connection does for
+ * plain connections).
+ */
+
+#include <benchmark/benchmark.h>
+#include <daemon/gather_writer.h>
+#include <daemon/sendbuffer.h>
+#include <event2/buffer.h>
+#include <mcbp/protocol/header.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/// The value of an item, shared by all the responses sending it (like a
+/// Blob referenced by an Item).
+struct Value {
+    explicit Value(size_t size) : data(size, 'x') {
+    }
+    std::atomic<int> refcount{0};
+    std::string data;
+};
+
+/// Pins the value and a bucket-wide counter for the lifetime of the buffer,
+/// like ItemSendBuffer does.
+class PinnedSendBuffer : public SendBuffer {
+public:
+    PinnedSendBuffer(Value& value, std::atomic<uint32_t>& sendBuffers)
+        : SendBuffer(value.data), value(value), sendBuffers(sendBuffers) {
+        value.refcount++;
+        sendBuffers++;
+    }
+    ~PinnedSendBuffer() override {
+        value.refcount--;
+        sendBuffers--;
+    }
+
+protected:
+    Value& value;
+    std::atomic<uint32_t>& sendBuffers;
+};
+
+class SendBufferBench : public ::benchmark::Fixture {
+public:
+    void SetUp(benchmark::State& state) override {
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sockets) !=
+            0) {
+            throw std::runtime_error("SendBufferBench: socketpair failed");
+        }
+        output = evbuffer_new();
+        value = std::make_unique<Value>(state.range(0));
+        drain.resize(256 * 1024);
+    }
+
+    void TearDown(benchmark::State&) override {
+        evbuffer_free(output);
+        close(sockets[0]);
+        close(sockets[1]);
+    }
+
+protected:
+    enum class Mode { Copy, Reference, Gather };
+
+    /// The header and extras of a GET response
+    struct Header {
+        uint8_t data[sizeof(cb::mcbp::Response) + sizeof(uint32_t)] = {};
+    };
+
+    /// Send everything in the output buffer, and read it on the other end
+    void flush() {
+        while (evbuffer_get_length(output) > 0) {
+            if (evbuffer_write(output, sockets[0]) < 0 && errno != EAGAIN) {
+                throw std::runtime_error("SendBufferBench: write failed");
+            }
+            while (read(sockets[1], drain.data(), drain.size()) > 0) {
+            }
+        }
+    }
+
+    /// Gather the output for sendmsg, as a plain Connection does
+    void gather() {
+        writer.write(sockets[0]);
+        while (read(sockets[1], drain.data(), drain.size()) > 0) {
+        }
+        writer.spill(output);
+        flush();
+    }
+
+    void run(benchmark::State& state, Mode mode) {
+        // Pipeline a few responses per write, as for a multi-get
+        const int responsesPerWrite = 8;
+        const Header header;
+        const std::string_view headerData{
+                reinterpret_cast<const char*>(header.data),
+                sizeof(header.data)};
+        for (auto _ : state) {
+            for (int ii = 0; ii < responsesPerWrite; ++ii) {
+                switch (mode) {
+                case Mode::Copy:
+                    evbuffer_add(output, headerData.data(), headerData.size());
+                    evbuffer_add(output,
+                                 value->data.data(),
+                                 value->data.size());
+                    break;
+                case Mode::Reference: {
+                    evbuffer_add(output, headerData.data(), headerData.size());
+                    auto* buffer = new PinnedSendBuffer(*value, sendBuffers);
+                    auto data = buffer->getPayload();
+                    evbuffer_add_reference(output,
+                                           data.data(),
+                                           data.size(),
+                                           SendBuffer::cleanup,
+                                           buffer);
+                    break;
+                }
+                case Mode::Gather:
+                    writer.copy(headerData);
+                    writer.reference(std::make_unique<PinnedSendBuffer>(
+                            *value, sendBuffers));
+                    break;
+                }
+            }
+            if (mode == Mode::Gather) {
+                gather();
+            } else {
+                flush();
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * responsesPerWrite);
+        state.SetBytesProcessed(state.iterations() * responsesPerWrite *
+                                value->data.size());
+    }
+
+    int sockets[2];
+    evbuffer* output = nullptr;
+    GatherWriter writer;
+    std::unique_ptr<Value> value;
+    std::atomic<uint32_t> sendBuffers{0};
+    std::vector<char> drain;
+};
+
+BENCHMARK_DEFINE_F(SendBufferBench, Copy)(benchmark::State& state) {
+    run(state, Mode::Copy);
+}
+
+BENCHMARK_DEFINE_F(SendBufferBench, Reference)(benchmark::State& state) {
+    run(state, Mode::Reference);
+}
+
+BENCHMARK_DEFINE_F(SendBufferBench, Gather)(benchmark::State& state) {
+    run(state, Mode::Gather);
+}
+
+BENCHMARK_REGISTER_F(SendBufferBench, Copy)
+        ->RangeMultiplier(2)
+        ->Range(64, 8192);
+BENCHMARK_REGISTER_F(SendBufferBench, Reference)
+        ->RangeMultiplier(2)
+        ->Range(64, 8192);
+BENCHMARK_REGISTER_F(SendBufferBench, Gather)
+        ->RangeMultiplier(2)
+        ->Range(64, 8192);
@@ -0,0 +1,99 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Tests for sizing a connection's time slice by the cost of its requests
+ * (Connection::getRequestsPerSlice() with a sched_time_budget).
+ */
+
+#include "mock_connection.h"
+
+#include <daemon/front_end_thread.h>
+#include <daemon/settings.h>
+#include <folly/portability/GTest.h>
+
+using namespace std::chrono_literals;
+
+static FrontEndThread thread;
+
+class TimeSliceTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        Settings::instance().setSchedTimeBudget(100);
+    }
+
+    void TearDown() override {
+        Settings::instance().setSchedTimeBudget(0);
+    }
+
+    const int defaultRequests =
+            Settings::instance().getRequestsPerEventNotification(
+                    EventPriority::Default);
+    MockConnection connection{thread};
+};
+
+// Without a budget (or before any request has been measured) the static
+// reqs_per_event is used.
+TEST_F(TimeSliceTest, Default) {
+    EXPECT_EQ(defaultRequests, connection.getRequestsPerSlice());
+
+    Settings::instance().setSchedTimeBudget(0);
+    connection.runSlice(10, 10us);
+    EXPECT_EQ(defaultRequests, connection.getRequestsPerSlice());
+}
+
+TEST_F(TimeSliceTest, BudgetOverCost) {
+    connection.runSlice(10, 10us);
+    EXPECT_EQ(1us, connection.getRequestCost());
+    EXPECT_EQ(100, connection.getRequestsPerSlice());
+}
+
+// Slices which executed no requests don't affect the cost.
+TEST_F(TimeSliceTest, NoRequests) {
+    connection.runSlice(10, 10us);
+    connection.runSlice(0, 1ms);
+    EXPECT_EQ(1us, connection.getRequestCost());
+}
+
+TEST_F(TimeSliceTest, ClampedToMax) {
+    connection.runSlice(10, 10ns);
+    EXPECT_EQ(1ns, connection.getRequestCost());
+    EXPECT_EQ(1000, connection.getRequestsPerSlice());
+}
+
+// Requests more expensive than the budget still get one per slice.
+TEST_F(TimeSliceTest, ClampedToMin) {
+    connection.runSlice(1, 1ms);
+    EXPECT_EQ(1, connection.getRequestsPerSlice());
+}
+
+// The cost is a moving average (each slice weighted 1/8) of the cost per
+// request of the slices.
+TEST_F(TimeSliceTest, MovingAverage) {
+    connection.runSlice(1, 1000ns);
+    EXPECT_EQ(1000ns, connection.getRequestCost());
+
+    connection.runSlice(2, 18000ns);
+    EXPECT_EQ(2000ns, connection.getRequestCost());
+    EXPECT_EQ(50, connection.getRequestsPerSlice());
+
+    // Converges on the new cost
+    for (int ii = 0; ii < 100; ++ii) {
+        connection.runSlice(10, 100us);
+    }
+    EXPECT_EQ(10, connection.getRequestsPerSlice());
+}
@@ -0,0 +1,130 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Tests that connections get moved off a front end thread which is busier
+ * than the others (see thread_rebalance_interval).
+ */
+
+#include "testapp.h"
+
+#include <chrono>
+#include <map>
+
+class ThreadRebalanceTest : public TestappTest {
+public:
+    static void SetUpTestCase() {
+        memcached_cfg = generate_config();
+        memcached_cfg["threads"] = 4;
+        memcached_cfg["thread_rebalance_interval"] = 1;
+        start_memcached_server();
+
+        if (HasFailure()) {
+            std::cerr << "Error in ThreadRebalanceTest::SetUpTestCase, "
+                         "terminating process"
+                      << std::endl;
+            exit(EXIT_FAILURE);
+        } else {
+            CreateTestBucket();
+        }
+    }
+
+protected:
+    /// Create a connection identifying itself as "rebalance_<id>"
+    std::unique_ptr<MemcachedConnection> createConnection(int id) {
+        auto conn = getAdminConnection().clone();
+        conn->authenticate("@admin", "password", "PLAIN");
+        conn->selectBucket(bucketName);
+        conn->hello("rebalance_" + std::to_string(id), "1.0", "");
+        return conn;
+    }
+
+    /// @return the worker thread each of the test's connections is bound to
+    std::map<int, size_t> getThreads() {
+        std::map<int, size_t> ret;
+        const std::string prefix = "rebalance_";
+        for (const auto& entry : getAdminConnection().stats("connections")) {
+            auto agent = entry.find("agent_name");
+            if (agent == entry.end() || !agent->is_string()) {
+                continue;
+            }
+            const auto name = agent->get<std::string>();
+            if (name.find(prefix) == 0) {
+                ret[std::stoi(name.substr(prefix.size()))] =
+                        entry["thread"].get<size_t>();
+            }
+        }
+        return ret;
+    }
+};
+
+/// Load all the connections bound to one worker thread (while the others
+/// are idle), and verify that some of them are moved to other threads.
+TEST_F(ThreadRebalanceTest, SkewedLoad) {
+    std::vector<std::unique_ptr<MemcachedConnection>> connections;
+    for (int ii = 0; ii < 16; ++ii) {
+        connections.emplace_back(createConnection(ii));
+    }
+
+    auto initial = getThreads();
+    ASSERT_EQ(connections.size(), initial.size());
+    const auto busy = initial[0];
+    std::vector<int> loaded;
+    for (const auto& entry : initial) {
+        if (entry.second == busy) {
+            loaded.push_back(entry.first);
+        }
+    }
+    ASSERT_LE(2, loaded.size());
+
+    // Storing a large JSON document makes the worker thread validate it
+    Document doc;
+    doc.info.id = name;
+    doc.info.datatype = cb::mcbp::Datatype::Raw;
+    doc.value = "[";
+    for (int ii = 0; ii < 20000; ++ii) {
+        doc.value.append(R"({"key":"value","number":12345},)");
+    }
+    doc.value.append("0]");
+
+    const auto timeout =
+            std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    bool moved = false;
+    while (!moved && std::chrono::steady_clock::now() < timeout) {
+        const auto end = std::chrono::steady_clock::now() +
+                         std::chrono::milliseconds(500);
+        while (std::chrono::steady_clock::now() < end) {
+            for (auto id : loaded) {
+                connections[id]->mutate(doc, Vbid(0), MutationType::Set);
+            }
+        }
+
+        const auto current = getThreads();
+        for (auto id : loaded) {
+            if (current.at(id) != busy) {
+                moved = true;
+            }
+        }
+    }
+    EXPECT_TRUE(moved) << "None of the connections on worker thread " << busy
+                       << " was moved";
+
+    // The moved connections must still work
+    for (auto id : loaded) {
+        EXPECT_EQ(doc.value, connections[id]->get(name, Vbid(0)).value);
+    }
+}
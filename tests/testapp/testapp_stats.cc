@@ -452,6 +452,57 @@ TEST_P(StatsTest, TestUnprivilegedConnections) {
     EXPECT_EQ(me, stats.front()["socket"].get<size_t>());
 }
 
+// The responses of a pipeline of GETs should be written with a handful of
+// send calls (those produced by each callback are written together), rather
+// than one (or more) per response.
+TEST_P(StatsTest, TestPipelinedGetSendSyscalls) {
+    if (GetParam() != TransportProtocols::McbpPlain) {
+        // With TLS the bufferevent encrypts and writes the data itself
+        return;
+    }
+
+    MemcachedConnection& conn = getConnection();
+    Document doc;
+    doc.info.cas = mcbp::cas::Wildcard;
+    doc.info.id = name;
+    doc.value = std::string(2048, 'x');
+    conn.mutate(doc, Vbid(0), MutationType::Set);
+
+    const auto me = conn.stats("connections").front()["socket"].get<size_t>();
+    auto getConnectionStats = [&conn, me]() {
+        return conn.stats("connections " + std::to_string(me)).front();
+    };
+
+    const int numGets = 100;
+    Frame pipeline;
+    for (int ii = 0; ii < numGets; ++ii) {
+        const auto frame = conn.encodeCmdGet(name, Vbid(0));
+        pipeline.payload.insert(pipeline.payload.end(),
+                                frame.payload.begin(),
+                                frame.payload.end());
+    }
+
+    const auto before = getConnectionStats();
+    conn.sendFrame(pipeline);
+    for (int ii = 0; ii < numGets; ++ii) {
+        BinprotGetResponse rsp;
+        conn.recvResponse(rsp);
+        ASSERT_TRUE(rsp.isSuccess()) << ii;
+        EXPECT_EQ(doc.value, rsp.getDataString());
+    }
+    const auto after = getConnectionStats();
+    auto delta = [&before, &after](const char* key) {
+        return after[key].get<size_t>() - before[key].get<size_t>();
+    };
+
+    // (That includes writing the response to the first stats call.)
+    const auto sends = delta("total_send_syscalls");
+    EXPECT_LT(sends, size_t(numGets / 4)) << after.dump(2);
+    const auto syscallsPerOp =
+            double(sends + delta("total_recv_syscalls")) / delta("total_ops");
+    EXPECT_LT(syscallsPerOp, 0.5) << after.dump(2);
+}
+
 TEST_P(StatsTest, TestConnectionsInvalidNumber) {
     MemcachedConnection& conn = getAdminConnection();
     try {
@@ -0,0 +1,221 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "numa_topology.h"
+#include "readfile.h"
+#include "string_utilities.h"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace cb {
+namespace numa {
+
+static int parseId(const std::string& list, const std::string& token) {
+    size_t end = 0;
+    int id = -1;
+    try {
+        id = std::stoi(token, &end);
+    } catch (const std::exception&) {
+    }
+    if (id < 0 || end != token.size()) {
+        throw std::invalid_argument("cb::numa::parseIdList: invalid id '" +
+                                    token + "' in '" + list + "'");
+    }
+    return id;
+}
+
+std::vector<int> parseIdList(const std::string& list) {
+    std::vector<int> ids;
+    std::string trimmed = list;
+    trimmed.erase(trimmed.find_last_not_of(" \n") + 1);
+    if (trimmed.empty()) {
+        return ids;
+    }
+
+    for (const auto& range : split_string(trimmed, ",")) {
+        const auto bounds = split_string(range, "-", 1);
+        const int first = parseId(list, bounds.front());
+        const int last = bounds.size() == 2 ? parseId(list, bounds.back())
+                                            : first;
+        if (last < first) {
+            throw std::invalid_argument(
+                    "cb::numa::parseIdList: invalid range '" + range +
+                    "' in '" + list + "'");
+        }
+        for (int id = first; id <= last; ++id) {
+            ids.push_back(id);
+        }
+    }
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    return ids;
+}
+
+std::vector<size_t> parseNumaMaps(const std::string& contents) {
+    std::vector<size_t> bytes;
+    std::istringstream lines(contents);
+    std::string line;
+    while (std::getline(lines, line)) {
+        // Resident pages per node are listed as "N<node>=<pages>", in units
+        // of the mapping's "kernelpagesize_kB=<size>".
+        std::vector<std::pair<size_t, size_t>> pages;
+        size_t pageSize = 4096;
+        std::istringstream fields(line);
+        std::string field;
+        while (fields >> field) {
+            const auto eq = field.find('=');
+            if (eq == std::string::npos) {
+                continue;
+            }
+            const auto key = field.substr(0, eq);
+            try {
+                if (key == "kernelpagesize_kB") {
+                    pageSize = std::stoull(field.substr(eq + 1)) * 1024;
+                } else if (key.size() > 1 && key[0] == 'N' &&
+                           key.find_first_not_of("0123456789", 1) ==
+                                   std::string::npos) {
+                    pages.emplace_back(std::stoul(key.substr(1)),
+                                       std::stoull(field.substr(eq + 1)));
+                }
+            } catch (const std::exception&) {
+                // Not a numeric field.
+            }
+        }
+        for (const auto& node : pages) {
+            if (node.first >= bytes.size()) {
+                bytes.resize(node.first + 1);
+            }
+            bytes[node.first] += node.second * pageSize;
+        }
+    }
+    return bytes;
+}
+
+Topology::Topology(std::vector<std::vector<int>> nodeCpus) {
+    for (size_t ii = 0; ii < nodeCpus.size(); ++ii) {
+        nodes.push_back({int(ii), std::move(nodeCpus[ii])});
+    }
+    if (nodes.empty()) {
+        nodes.push_back({0, {}});
+    }
+}
+
+Topology::Topology(std::vector<Node> nodes) : nodes(std::move(nodes)) {
+    if (this->nodes.empty()) {
+        this->nodes.push_back({0, {}});
+    }
+}
+
+const Topology& Topology::get() {
+    static const Topology topology = [] {
+        std::vector<Node> nodes;
+#ifdef __linux__
+        const std::string root = "/sys/devices/system/node/";
+        try {
+            for (int id : parseIdList(readFile(root + "online"))) {
+                const auto cpus = parseIdList(
+                        readFile(root + "node" + std::to_string(id) +
+                                 "/cpulist"));
+                nodes.push_back({id, cpus});
+            }
+        } catch (const std::exception&) {
+            // No (readable) NUMA information; treat as a single node.
+            nodes.clear();
+        }
+#endif
+        return Topology(std::move(nodes));
+    }();
+    return topology;
+}
+
+const std::vector<int>& Topology::getCpus(size_t node) const {
+    return nodes.at(node).cpus;
+}
+
+int Topology::getNodeId(size_t node) const {
+    return nodes.at(node).id;
+}
+
+bool bindCurrentThreadToNode(size_t node) {
+#ifdef __linux__
+    const auto& topology = Topology::get();
+    if (node >= topology.getNumNodes() || topology.getCpus(node).empty()) {
+        return false;
+    }
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (int cpu : topology.getCpus(node)) {
+        CPU_SET(cpu, &cpus);
+    }
+    if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+        return false;
+    }
+
+    // Prefer (but don't require) memory local to the node for the pages
+    // this thread faults in.
+    const int id = topology.getNodeId(node);
+    if (id < 64) {
+        unsigned long mask = 1UL << id;
+        syscall(SYS_set_mempolicy,
+                MPOL_PREFERRED,
+                &mask,
+                sizeof(mask) * 8 + 1);
+    }
+    return true;
+#else
+    (void)node;
+    return false;
+#endif
+}
+
+std::vector<size_t> getResidentBytesPerNode() {
+#ifdef __linux__
+    std::vector<size_t> byId;
+    try {
+        byId = parseNumaMaps(readFile("/proc/self/numa_maps"));
+    } catch (const std::exception&) {
+        return {};
+    }
+
+    // Map from OS node ids to Topology node indices.
+    const auto& topology = Topology::get();
+    std::vector<size_t> bytes(topology.getNumNodes());
+    for (size_t node = 0; node < topology.getNumNodes(); ++node) {
+        const auto id = size_t(topology.getNodeId(node));
+        if (id < byId.size()) {
+            bytes[node] = byId[id];
+        }
+    }
+    return bytes;
+#else
+    return {};
+#endif
+}
+
+} // namespace numa
+} // namespace cb
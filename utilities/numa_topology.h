@@ -0,0 +1,104 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace cb {
+namespace numa {
+
+/**
+ * Parse a Linux sysfs style list of ids, such as a cpulist ("0-3,8,10-11")
+ * or the list of online nodes.
+ *
+ * @return the ids in the list, in ascending order.
+ * @throws std::invalid_argument if the list is malformed.
+ */
+std::vector<int> parseIdList(const std::string& list);
+
+/**
+ * Parse the contents of /proc/<pid>/numa_maps, summing the memory resident on
+ * each node over all mappings.
+ *
+ * @return the number of bytes resident on each node, indexed by node id.
+ */
+std::vector<size_t> parseNumaMaps(const std::string& contents);
+
+/**
+ * The NUMA nodes of the host and the CPUs belonging to each.
+ *
+ * Node indices used by this class are dense (0..getNumNodes()-1), even if the
+ * node ids reported by the OS are not.
+ */
+class Topology {
+public:
+    /// Topology with the given CPUs per node.
+    explicit Topology(std::vector<std::vector<int>> nodeCpus);
+
+    /**
+     * @return the topology of the host, discovered (once) from sysfs. On
+     *         platforms where this is not available, a single node with no
+     *         CPUs listed.
+     */
+    static const Topology& get();
+
+    size_t getNumNodes() const {
+        return nodes.size();
+    }
+
+    /// @return true if the host has more than one NUMA node.
+    bool isNuma() const {
+        return nodes.size() > 1;
+    }
+
+    /// @return the CPUs of the given node.
+    const std::vector<int>& getCpus(size_t node) const;
+
+    /// @return the OS id of the given node.
+    int getNodeId(size_t node) const;
+
+private:
+    struct Node {
+        int id;
+        std::vector<int> cpus;
+    };
+
+    explicit Topology(std::vector<Node> nodes);
+
+    std::vector<Node> nodes;
+};
+
+/**
+ * Bind the calling thread to the given node of Topology::get(): restrict it
+ * to run on the CPUs of that node, and set its memory policy to prefer
+ * allocating pages from that node.
+ *
+ * @return true if the thread was bound; false if the node has no CPUs or
+ *         binding is not supported on this platform.
+ */
+bool bindCurrentThreadToNode(size_t node);
+
+/**
+ * @return the number of bytes of this process resident on each node (of
+ *         Topology::get()), or an empty vector if not available.
+ */
+std::vector<size_t> getResidentBytesPerNode();
+
+} // namespace numa
+} // namespace cb
@@ -24,6 +24,7 @@
 
 #include <memcached/util.h>
 #include <memcached/config_parser.h>
+#include "numa_topology.h"
 #include "string_utilities.h"
 
 #include <folly/portability/GMock.h>
@@ -466,3 +467,39 @@ TEST(ConfigParserTest, A) {
     EXPECT_EQ(0, fclose(error));
     cb::io::rmrf(outfile);
 }
+
+TEST(NumaTest, parseIdList) {
+    EXPECT_EQ(std::vector<int>{}, cb::numa::parseIdList(""));
+    EXPECT_EQ(std::vector<int>{0}, cb::numa::parseIdList("0\n"));
+    EXPECT_EQ(std::vector<int>({0, 1, 2, 3, 8, 10, 11}),
+              cb::numa::parseIdList("0-3,8,10-11"));
+    EXPECT_EQ(std::vector<int>({1, 2, 3}), cb::numa::parseIdList("3,1-2,2"));
+
+    EXPECT_THROW(cb::numa::parseIdList("a"), std::invalid_argument);
+    EXPECT_THROW(cb::numa::parseIdList("1,"), std::invalid_argument);
+    EXPECT_THROW(cb::numa::parseIdList("3-1"), std::invalid_argument);
+    EXPECT_THROW(cb::numa::parseIdList("-1"), std::invalid_argument);
+}
+
+TEST(NumaTest, parseNumaMaps) {
+    const std::string maps =
+            "00400000 default file=/opt/memcached mapped=4 N0=3 N1=1 "
+            "kernelpagesize_kB=4\n"
+            "7f0000000000 interleave:0-1 anon=512 dirty=512 N1=512 "
+            "kernelpagesize_kB=2048\n"
+            "7f1000000000 default\n";
+    EXPECT_EQ(std::vector<size_t>({3 * 4096, 4096 + 512 * 2048 * 1024}),
+              cb::numa::parseNumaMaps(maps));
+    EXPECT_TRUE(cb::numa::parseNumaMaps("").empty());
+}
+
+TEST(NumaTest, Topology) {
+    cb::numa::Topology topology({{0, 1}, {2, 3}});
+    EXPECT_EQ(2u, topology.getNumNodes());
+    EXPECT_TRUE(topology.isNuma());
+    EXPECT_EQ(std::vector<int>({2, 3}), topology.getCpus(1));
+    EXPECT_THROW(topology.getCpus(2), std::out_of_range);
+
+    // The host's topology always has at least one node.
+    EXPECT_LE(1u, cb::numa::Topology::get().getNumNodes());
+}